@@ -0,0 +1,94 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   busMetrics.ino
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240610
+   DESCRIPTION: Print the I2C transaction metrics (counters and latency
+                histogram) collected by the Controller for each expansion and
+                for each message argument
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+
+void printCounters(const BusCounters &c) {
+  static const uint32_t limits[OPTA_METRICS_LATENCY_BUCKETS] =
+      OPTA_METRICS_LATENCY_LIMITS;
+
+  Serial.print(" tr: ");
+  Serial.print(c.transactions);
+  Serial.print(" tx bytes: ");
+  Serial.print(c.bytes_tx);
+  Serial.print(" rx bytes: ");
+  Serial.print(c.bytes_rx);
+  Serial.print(" timeouts: ");
+  Serial.print(c.timeouts);
+  Serial.print(" crc err: ");
+  Serial.print(c.crc_errors);
+  Serial.print(" prot err: ");
+  Serial.print(c.protocol_errors);
+  Serial.print(" retries: ");
+  Serial.print(c.retries);
+  Serial.print(" avg us: ");
+  Serial.print(c.getAvgLatency());
+  Serial.print(" max us: ");
+  Serial.println(c.latency_us_max);
+
+  Serial.print("   latency histogram:");
+  for (int i = 0; i < OPTA_METRICS_LATENCY_BUCKETS; i++) {
+    Serial.print(" <");
+    if (i < OPTA_METRICS_LATENCY_BUCKETS - 1) {
+      Serial.print(limits[i]);
+    } else {
+      Serial.print("inf");
+    }
+    Serial.print(":");
+    Serial.print(c.latency[i]);
+  }
+  Serial.println();
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 SETUP                                      */
+/* -------------------------------------------------------------------------- */
+void setup() {
+/* -------------------------------------------------------------------------- */
+  Serial.begin(115200);
+  delay(2000);
+
+  OptaController.begin();
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  LOOP                                      */
+/* -------------------------------------------------------------------------- */
+void loop() {
+/* -------------------------------------------------------------------------- */
+  OptaController.update();
+
+  for (int i = 0; i < OptaController.getExpansionNum(); i++) {
+    const ExpansionMetrics *m = OptaController.getMetrics(i);
+    if (m == nullptr) {
+      continue;
+    }
+    Serial.print("Expansion n. ");
+    Serial.print(i);
+    Serial.println(" TOTAL");
+    printCounters(m->total);
+    for (int k = 0; k < m->arg_num; k++) {
+      Serial.print(" argument 0x");
+      Serial.println(m->arg[k], HEX);
+      printCounters(m->per_arg[k]);
+    }
+    if (m->other.transactions > 0) {
+      Serial.println(" other arguments");
+      printCounters(m->other);
+    }
+  }
+  OptaController.resetMetrics();
+  delay(5000);
+}
@@ -0,0 +1,57 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   busTrace.ino
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240612
+   DESCRIPTION: Record the I2C frames exchanged with the expansions into the
+                Controller RAM trace and periodically dump it in binary format
+                on Serial
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Capture the serial output into a file and decode it on PC
+                with the traceDecoder tool:
+                  OptaTraceDecoder <captured file>                            */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+
+void writeOnSerial(const uint8_t *data, size_t len) {
+  Serial.write(data, len);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 SETUP                                      */
+/* -------------------------------------------------------------------------- */
+void setup() {
+/* -------------------------------------------------------------------------- */
+  Serial.begin(115200);
+  delay(2000);
+
+  /* enabled before begin() to record also the assign address process */
+  OptaController.getTrace().enable(true);
+  OptaController.begin();
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  LOOP                                      */
+/* -------------------------------------------------------------------------- */
+void loop() {
+/* -------------------------------------------------------------------------- */
+  static unsigned long start = millis();
+
+  OptaController.update();
+
+  for (int i = 0; i < OptaController.getExpansionNum(); i++) {
+    uint8_t M, m, r;
+    OptaController.getFwVersion(i, M, m, r);
+  }
+
+  /* dump before the trace is full so that no frame is overwritten */
+  if (OptaController.getTrace().size() >= OPTA_BUS_TRACE_DEPTH - 4 ||
+      millis() - start > 10000) {
+    start = millis();
+    OptaController.getTrace().dump(writeOnSerial);
+  }
+}
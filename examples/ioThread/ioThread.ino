@@ -0,0 +1,65 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   ioThread.ino
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240620
+   DESCRIPTION: The expansions are scanned by the background I/O thread every
+                10 ms, the loop() copies each input of the Digital Expansions
+                to the output with the same index using only the process
+                image (it never waits for I2C)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+
+/* -------------------------------------------------------------------------- */
+/*                                 SETUP                                      */
+/* -------------------------------------------------------------------------- */
+void setup() {
+/* -------------------------------------------------------------------------- */
+  Serial.begin(115200);
+  delay(2000);
+
+  OptaController.begin();
+  /* from now on the expansions are used only through the process image */
+  OptaController.getProcessImage().begin(10);
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  LOOP                                      */
+/* -------------------------------------------------------------------------- */
+void loop() {
+/* -------------------------------------------------------------------------- */
+  static unsigned long last_print = 0;
+  ProcessImage &pi = OptaController.getProcessImage();
+
+  for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+    InputImage in;
+    if (!pi.getInputs(i, in)) {
+      continue;
+    }
+    if (in.type == EXPANSION_OPTA_DIGITAL_MEC ||
+        in.type == EXPANSION_OPTA_DIGITAL_STS) {
+      for (int k = 0; k < OPTA_DIGITAL_OUT_NUM; k++) {
+        pi.digitalWrite(i, k, (in.digital & (1 << k)) ? HIGH : LOW);
+      }
+    }
+  }
+
+  if (millis() - last_print > 5000) {
+    last_print = millis();
+    Serial.print("Scan cycles: ");
+    Serial.print(pi.getCycles());
+    Serial.print(" overruns: ");
+    Serial.print(pi.getOverruns());
+    Serial.print(" last cycle us: ");
+    Serial.print(pi.getLastCycleUs());
+    Serial.print(" max cycle us: ");
+    Serial.println(pi.getMaxCycleUs());
+  }
+  delay(1);
+}
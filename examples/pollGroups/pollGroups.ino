@@ -0,0 +1,74 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   pollGroups.ino
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240626
+   DESCRIPTION: The inputs of the first expansion are read by a polling group
+                every 5 ms (Digital) or 50 ms (Analog), executed by
+                OptaController.update(); the loop() only uses the values
+                already read and prints the statistics of the group
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+
+int group = -1;
+
+/* -------------------------------------------------------------------------- */
+void onPolled(int g) {
+/* -------------------------------------------------------------------------- */
+  (void)g;
+  DigitalExpansion d = OptaController.getExpansion(0);
+  if (d) {
+    /* update = false: value read by the polling group */
+    d.digitalWrite(0, d.digitalRead(0, false), true);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                 SETUP                                      */
+/* -------------------------------------------------------------------------- */
+void setup() {
+/* -------------------------------------------------------------------------- */
+  Serial.begin(115200);
+  delay(2000);
+
+  OptaController.begin();
+
+  PollScheduler &poll = OptaController.getPolling();
+  if (DigitalExpansion(OptaController.getExpansion(0))) {
+    group = poll.addGroup(5, onPolled);
+    poll.addItem(group, 0, GET_DIGITAL_INPUT);
+  } else if (AnalogExpansion(OptaController.getExpansion(0))) {
+    group = poll.addGroup(50);
+    poll.addItem(group, 0, GET_ALL_ANALOG_INPUT);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  LOOP                                      */
+/* -------------------------------------------------------------------------- */
+void loop() {
+/* -------------------------------------------------------------------------- */
+  static unsigned long last_print = 0;
+  OptaController.update();
+
+  const PollGroup *g = OptaController.getPolling().getGroup(group);
+  if (g != nullptr && millis() - last_print > 5000) {
+    last_print = millis();
+    Serial.print("Runs: ");
+    Serial.print(g->runs);
+    Serial.print(" overruns: ");
+    Serial.print(g->overruns);
+    Serial.print(" errors: ");
+    Serial.print(g->errors);
+    Serial.print(" avg jitter us: ");
+    Serial.print(g->getAvgJitterUs());
+    Serial.print(" max jitter us: ");
+    Serial.println(g->max_jitter_us);
+  }
+}
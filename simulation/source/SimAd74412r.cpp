@@ -0,0 +1,229 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimAd74412r.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Register level model of the AD74412R used by Opta Analog
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "SimAd74412r.h"
+#include "OptaAnalogCfg.h"
+#include "OptaCrc.h"
+#include <cstring>
+
+/* registers not defined in OptaAnalogCfg.h */
+#define AD_LIVE_STATUS_ADC_BUSY ADC_BUSY_MASK
+#define AD_ALERT_STATUS_RESET_OCCURRED 0x8000
+#define AD_SILICON_REV_VALUE 0x0002
+#define AD_READ_SELECT_STATUS_BIT 0x100
+
+namespace sim {
+
+Ad74412r::Ad74412r(Board *b, int reset_pin, int ldac_pin) : board(b) {
+  reset();
+  /* the reset and the LDAC pins are active low */
+  board->onPinWrite(reset_pin, [this](int v) {
+    if (v == 0) {
+      reset();
+    }
+  });
+  board->onPinWrite(ldac_pin, [this](int v) {
+    if (v == 0) {
+      latch_dac();
+    }
+  });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Ad74412r::reset() {
+  memset(regs, 0, sizeof(regs));
+  regs[OA_REG_ALERT_STATUS___SINGLE_PER_DEVICE] =
+      AD_ALERT_STATUS_RESET_OCCURRED;
+  regs[OA_REG_SILICON_REV___SINGLE_PER_DEVICE] = AD_SILICON_REV_VALUE;
+  readback = 0;
+  status_in_readback = false;
+  last_key = 0;
+  frame_pos = 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint64_t Ad74412r::conversion_time() {
+  uint16_t ctrl = regs[OA_REG_ADC_CONV_CTRL___SINGLE_PER_DEVICE];
+  uint64_t rv = 0;
+  for (int ch = 0; ch < SIM_AD_CHANNELS; ch++) {
+    if (ctrl & (1 << ch)) {
+      /* bit 3 of ADC_CONFIG disables the 50/60 Hz rejection */
+      rv += (regs[OPTA_AN_ADC_CONFIG(ch)] & (1 << 3)) ? SIM_AD_CONV_FAST_ns
+                                                       : SIM_AD_CONV_SLOW_ns;
+    }
+    if (ctrl & (1 << (ch + DIAG_OFFSET))) {
+      rv += (ctrl & EN_REJECTION_BIT) ? SIM_AD_CONV_SLOW_ns
+                                      : SIM_AD_CONV_FAST_ns;
+    }
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* the conversions are evaluated lazily every time the device is accessed */
+void Ad74412r::sync() {
+  uint16_t &ctrl = regs[OA_REG_ADC_CONV_CTRL___SINGLE_PER_DEVICE];
+  uint16_t &live = regs[OA_REG_LIVE_STATUS___SINGLE_PER_DEVICE];
+  uint16_t mode = (ctrl & ADC_START_STOP_MASK);
+
+  regs[OA_REG_DIN_COMP_OUT___SINGLE_PER_DEVICE] = din & 0x0F;
+
+  if (mode != START_SINGLE_CONVERSION && mode != START_CONTINUOUS_CONVERSION) {
+    return;
+  }
+  uint64_t period = conversion_time();
+  uint64_t now = Kernel::get().now();
+  if (period == 0 || now < conv_start + period) {
+    return;
+  }
+  for (int ch = 0; ch < SIM_AD_CHANNELS; ch++) {
+    if (ctrl & (1 << ch)) {
+      regs[OA_REG_ADC_RESULT + ch] = adc_code[ch];
+    }
+    if (ctrl & (1 << (ch + DIAG_OFFSET))) {
+      regs[OA_REG_DIAG_RESULT + ch] = diag_code[ch];
+    }
+  }
+  live |= ADC_DATA_READY;
+  if (mode == START_SINGLE_CONVERSION) {
+    RESET_ADC_START_STOP(ctrl);
+    live &= ~AD_LIVE_STATUS_ADC_BUSY;
+  } else {
+    conv_start += period * ((now - conv_start) / period);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Ad74412r::latch_dac() {
+  for (int ch = 0; ch < SIM_AD_CHANNELS; ch++) {
+    if (regs[OA_REG_DAC_ACTIVE + ch] != regs[OA_REG_DAC_CODE + ch]) {
+      regs[OA_REG_DAC_ACTIVE + ch] = regs[OA_REG_DAC_CODE + ch];
+      dac_change = Kernel::get().now();
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint16_t Ad74412r::reg(uint8_t addr) {
+  sync();
+  return regs[addr % SIM_AD_REGS_NUM];
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Ad74412r::write(uint8_t addr, uint16_t value) {
+  switch (addr) {
+  case OPTA_AN_NOP___SINGLE_PER_DEVICE:
+  case OA_REG_DIN_COMP_OUT___SINGLE_PER_DEVICE:
+  case OA_REG_ADC_RESULT:
+  case OA_REG_ADC_RESULT + 1:
+  case OA_REG_ADC_RESULT + 2:
+  case OA_REG_ADC_RESULT + 3:
+  case OA_REG_DIAG_RESULT:
+  case OA_REG_DIAG_RESULT + 1:
+  case OA_REG_DIAG_RESULT + 2:
+  case OA_REG_DIAG_RESULT + 3:
+  case OA_REG_DAC_ACTIVE:
+  case OA_REG_DAC_ACTIVE + 1:
+  case OA_REG_DAC_ACTIVE + 2:
+  case OA_REG_DAC_ACTIVE + 3:
+  case OA_REG_SILICON_REV___SINGLE_PER_DEVICE:
+    /* read only */
+    break;
+  case OA_REG_ALERT_STATUS___SINGLE_PER_DEVICE:
+  case OA_REG_LIVE_STATUS___SINGLE_PER_DEVICE:
+    /* write 1 to clear */
+    regs[addr] &= ~value;
+    break;
+  case OA_REG_READ_SELECT___SINGLE_PER_DEVICE:
+    regs[addr] = value;
+    readback = value & 0x7F;
+    status_in_readback = (value & AD_READ_SELECT_STATUS_BIT) != 0;
+    break;
+  case OA_REG_ADC_CONV_CTRL___SINGLE_PER_DEVICE: {
+    uint16_t mode = value & ADC_START_STOP_MASK;
+    regs[addr] = value;
+    if (mode == START_SINGLE_CONVERSION ||
+        mode == START_CONTINUOUS_CONVERSION) {
+      conv_start = Kernel::get().now();
+      regs[OA_REG_LIVE_STATUS___SINGLE_PER_DEVICE] |= AD_LIVE_STATUS_ADC_BUSY;
+    } else {
+      regs[OA_REG_LIVE_STATUS___SINGLE_PER_DEVICE] &= ~AD_LIVE_STATUS_ADC_BUSY;
+    }
+  } break;
+  case OA_REG_CMD_REGISTER___SINGLE_PER_DEVICE:
+    if (value == OPTA_AN_KEY_LDAC) {
+      latch_dac();
+    } else if (value == OPTA_AN_KEY_CLEAR_DAC) {
+      for (int ch = 0; ch < SIM_AD_CHANNELS; ch++) {
+        regs[OA_REG_DAC_ACTIVE + ch] = regs[OA_REC_DAC_CLEAR_CODE + ch];
+      }
+    } else if (value == OPTA_AN_KEY_RESET_2 &&
+               last_key == OPTA_AN_KEY_RESET_1) {
+      reset();
+      return;
+    }
+    last_key = value;
+    break;
+  default:
+    if (addr < SIM_AD_REGS_NUM) {
+      regs[addr] = value;
+    }
+    break;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Ad74412r::transfer(uint8_t *buf, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (frame_pos == 0) {
+      /* the answer is shifted out while the frame is shifted in */
+      sync();
+      uint16_t v = regs[readback];
+      if (status_in_readback) {
+        uint16_t live = regs[OA_REG_LIVE_STATUS___SINGLE_PER_DEVICE];
+        answer[0] = ((live & ADC_DATA_READY) ? 0x40 : 0) |
+                    (regs[OA_REG_ALERT_STATUS___SINGLE_PER_DEVICE] ? 0x20
+                                                                   : 0) |
+                    (din & 0x0F);
+      } else {
+        answer[0] = readback;
+      }
+      answer[1] = v >> 8;
+      answer[2] = v & 0xFF;
+      answer[3] = OptaCrc8::calc(answer, 3, 0);
+    }
+    frame[frame_pos] = buf[i];
+    buf[i] = answer[frame_pos];
+    frame_pos++;
+    if (frame_pos == 4) {
+      frame_pos = 0;
+      if (OptaCrc8::calc(frame, 3, 0) != frame[3]) {
+        crc_errors++;
+        regs[OA_REG_ALERT_STATUS___SINGLE_PER_DEVICE] |=
+            OPTA_AN_SPI_CRC_ERR_MASK;
+        continue;
+      }
+      sync();
+      write(frame[0], ((uint16_t)frame[1] << 8) | frame[2]);
+    }
+  }
+}
+
+} // namespace sim
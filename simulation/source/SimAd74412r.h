@@ -0,0 +1,75 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimAd74412r.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Register level model of the AD74412R used by Opta Analog
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Only what is used by the Opta Analog firmware is modelled:
+                - 32 bit SPI frames with CRC, the answer to a frame is the
+                  register selected by the previous READ_SELECT
+                - ADC single and continuous conversions (values are taken
+                  from adc_code / diag_code), DATA READY and BUSY flags
+                - DAC code latched into DAC_ACTIVE by LDAC pin or LDAC key
+                - software (keys) and hardware (reset pin) reset
+                The analog front end (voltages, currents, thresholds) is
+                not simulated: inputs are set directly as raw codes        */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_AD74412R_H
+#define SIM_AD74412R_H
+
+#include "SimKernel.h"
+
+#define SIM_AD_REGS_NUM 0x80
+#define SIM_AD_CHANNELS 4
+/* conversion time of a single channel (datasheet 4.8 kSPS with 50/60 Hz
+   rejection disabled, 20 SPS otherwise) */
+#define SIM_AD_CONV_FAST_ns 208000ULL
+#define SIM_AD_CONV_SLOW_ns 50000000ULL
+
+namespace sim {
+
+class Ad74412r : public SpiDevice {
+public:
+  /* reset_pin and ldac_pin are the pins of the board driving the device */
+  Ad74412r(Board *b, int reset_pin, int ldac_pin);
+  void transfer(uint8_t *buf, size_t n) override;
+
+  /* ---- inputs (raw ADC codes and digital comparators) ---- */
+  uint16_t adc_code[SIM_AD_CHANNELS] = {0, 0, 0, 0};
+  uint16_t diag_code[SIM_AD_CHANNELS] = {0, 0, 0, 0};
+  uint8_t din = 0;
+
+  /* ---- state seen from outside ---- */
+  uint16_t reg(uint8_t addr);
+  uint16_t dacActive(uint8_t ch) { return reg(0x1E + ch); }
+  uint8_t channelFunction(uint8_t ch) { return reg(0x01 + ch) & 0x0F; }
+  uint32_t crc_errors = 0;
+  /* virtual time of the last change of an active DAC code */
+  uint64_t dac_change = 0;
+
+private:
+  void reset();
+  void sync();
+  void write(uint8_t addr, uint16_t value);
+  void latch_dac();
+  uint64_t conversion_time();
+
+  Board *board;
+  uint16_t regs[SIM_AD_REGS_NUM];
+  uint8_t frame[4];
+  size_t frame_pos = 0;
+  uint8_t answer[4];
+  uint8_t readback = 0;
+  bool status_in_readback = false;
+  uint16_t last_key = 0;
+  uint64_t conv_start = 0;
+};
+
+} // namespace sim
+
+#endif
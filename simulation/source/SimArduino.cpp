@@ -0,0 +1,850 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimArduino.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Implementation of the Arduino / Renesas core API used by the
+                library on top of the simulation kernel
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "FspTimer.h"
+#include "OptaDigitalCfg.h"
+#include "SPI.h"
+#include "SimI2cBus.h"
+#include "SimKernel.h"
+#include "Wire.h"
+#include "analog.h"
+#include "boot.h"
+#include "kvstore_global_api.h"
+#include "mbed.h"
+#include "pwm.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace sim;
+
+SimSerial Serial;
+TwoWire Wire;
+SPIClass SPI;
+EEPROMClass EEPROM;
+
+static Kernel &k() { return Kernel::get(); }
+static Board *b() { return Kernel::current(); }
+
+/* time spent by the functions that are called in busy loops */
+static void call_cost() {
+  Board *brd = b();
+  k().spend((brd != nullptr) ? brd->call_cost_ns : SIM_DEFAULT_CALL_COST_ns);
+}
+
+/* ##################################################################### */
+/*                              TIME                                     */
+/* ##################################################################### */
+
+/* virtual time as seen by the clock of the board */
+static uint64_t local_ns() {
+  uint64_t t = k().now();
+  Board *brd = b();
+  if (brd != nullptr && t >= brd->clock_drift_ns) {
+    int64_t d = (int64_t)(t - brd->clock_drift_ns);
+    t += brd->clock_offset_ns;
+    t = (uint64_t)((int64_t)t + (d * brd->clock_ppm) / 1000000LL);
+  }
+  return t;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned long millis() {
+  call_cost();
+  return (unsigned long)(local_ns() / 1000000ULL);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned long micros() {
+  call_cost();
+  return (unsigned long)(local_ns() / 1000ULL);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void delay(unsigned long ms) { k().spend((uint64_t)ms * 1000000ULL); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void delayMicroseconds(unsigned int us) { k().spend((uint64_t)us * 1000ULL); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void noInterrupts() { k().disableIrq(); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void interrupts() { k().enableIrq(); }
+
+/* ##################################################################### */
+/*                              PINS                                     */
+/* ##################################################################### */
+
+void pinMode(int pin, int mode) {
+  if (pin < 0 || pin >= SIM_PIN_NUM || b() == nullptr) {
+    return;
+  }
+  b()->pins[pin].mode = mode;
+  if (b()->pins[pin].net >= 0) {
+    k().netChanged(b()->pins[pin].net);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+PinStatus digitalRead(int pin) {
+  call_cost();
+  if (pin < 0 || pin >= SIM_PIN_NUM || b() == nullptr) {
+    return LOW;
+  }
+  Pin &p = b()->pins[pin];
+  if (p.mode == SIM_PIN_OUTPUT) {
+    return p.out ? HIGH : LOW;
+  }
+  if (p.net >= 0) {
+    return k().readNet(p.net) ? HIGH : LOW;
+  }
+  return p.in ? HIGH : LOW;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void digitalWrite(int pin, PinStatus value) { digitalWrite(pin, (int)value); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void digitalWrite(int pin, int value) {
+  if (pin < 0 || pin >= SIM_PIN_NUM || b() == nullptr) {
+    return;
+  }
+  b()->pins[pin].out = (value != 0) ? 1 : 0;
+  b()->notifyPinWrite(pin, b()->pins[pin].out);
+  if (b()->pins[pin].net >= 0) {
+    k().netChanged(b()->pins[pin].net);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void attachInterrupt(int pin, voidFuncPtr fnc, PinStatus mode) {
+  if (pin < 0 || pin >= SIM_PIN_NUM || b() == nullptr) {
+    return;
+  }
+  PinIrq irq;
+  irq.mode = mode;
+  irq.fnc = fnc;
+  irq.level = (digitalRead(pin) == HIGH) ? 1 : 0;
+  b()->pin_irqs[pin] = irq;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void detachInterrupt(int pin) {
+  if (b() != nullptr) {
+    b()->pin_irqs.erase(pin);
+  }
+}
+
+/* ##################################################################### */
+/*                               I2C                                     */
+/* ##################################################################### */
+
+void TwoWire::begin() {
+  I2cPort &p = b()->i2c;
+  p.begun = true;
+  p.slave = false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void TwoWire::begin(uint8_t address) {
+  I2cPort &p = b()->i2c;
+  p.begun = true;
+  p.slave = true;
+  p.address = address;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void TwoWire::end() { b()->i2c.begun = false; }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void TwoWire::setClock(uint32_t freq) {
+  /* the timing of a slave does not change the clock of the bus */
+  if (!b()->i2c.slave) {
+    I2cBus::get().setClock(freq);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void TwoWire::beginTransmission(uint8_t address) {
+  I2cPort &p = b()->i2c;
+  p.tx.clear();
+  p.tx_address = address;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t TwoWire::endTransmission(bool stopBit) {
+  (void)stopBit;
+  Board *master = b();
+  /* the thread waiting for the end of the transfer (an RTOS thread of the
+     master board is not the board itself) */
+  Board *waiter = Kernel::thread();
+  I2cBus &bus = I2cBus::get();
+  std::vector<uint8_t> data = master->i2c.tx;
+  master->i2c.tx.clear();
+
+  Board *slave = bus.find(master->i2c.tx_address);
+  if (slave == nullptr) {
+    /* address NACK */
+    bus.count(1, true);
+    k().spend(bus.frameTime(1));
+    return 2;
+  }
+  bus.count(1 + data.size(), false);
+  k().spend(bus.frameTime(1 + data.size()));
+  if (slave->i2c.corrupt > 0 && !data.empty()) {
+    slave->i2c.corrupt--;
+    data.back() ^= 0xFF;
+  }
+
+  /* onReceive is called in the slave when the stop is received */
+  k().post(slave, k().now(), [slave, waiter, data]() {
+    slave->i2c.rx = data;
+    slave->i2c.rx_pos = 0;
+    if (slave->i2c.on_receive != nullptr) {
+      slave->i2c.on_receive((int)data.size());
+    }
+    Kernel::get().wake(waiter, Kernel::get().now() + slave->i2c_processing_ns);
+  });
+  k().block();
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+size_t TwoWire::requestFrom(uint8_t address, size_t len, bool stopBit) {
+  (void)stopBit;
+  Board *master = b();
+  Board *waiter = Kernel::thread();
+  I2cBus &bus = I2cBus::get();
+  master->i2c.rx.clear();
+  master->i2c.rx_pos = 0;
+
+  Board *slave = bus.find(address);
+  if (slave == nullptr) {
+    bus.count(1, true);
+    k().spend(bus.frameTime(1));
+    return 0;
+  }
+  bus.count(1 + len, false);
+  /* address byte, then the slave is interrupted (the clock is stretched
+     until the answer is ready) and the bytes are clocked out */
+  k().spend(bus.frameTime(1));
+  k().post(slave, k().now(), [slave, master, waiter, len]() {
+    slave->i2c.tx.clear();
+    if (slave->i2c.on_request != nullptr) {
+      slave->i2c.on_request();
+    }
+    std::vector<uint8_t> ans = slave->i2c.tx;
+    slave->i2c.tx.clear();
+    ans.resize(len, 0xFF);
+    master->i2c.rx = ans;
+    master->i2c.rx_pos = 0;
+    Kernel::get().wake(waiter, Kernel::get().now() +
+                                   slave->i2c_processing_ns +
+                                   9 * len * I2cBus::get().bitTime());
+  });
+  k().block();
+  return len;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+size_t TwoWire::write(uint8_t data) {
+  b()->i2c.tx.push_back(data);
+  return 1;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+size_t TwoWire::write(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    write(data[i]);
+  }
+  return len;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int TwoWire::available() {
+  I2cPort &p = b()->i2c;
+  return (int)(p.rx.size() - p.rx_pos);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int TwoWire::read() {
+  I2cPort &p = b()->i2c;
+  if (p.rx_pos < p.rx.size()) {
+    return p.rx[p.rx_pos++];
+  }
+  return -1;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int TwoWire::peek() {
+  I2cPort &p = b()->i2c;
+  if (p.rx_pos < p.rx.size()) {
+    return p.rx[p.rx_pos];
+  }
+  return -1;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void TwoWire::onReceive(void (*cbk)(int)) { b()->i2c.on_receive = cbk; }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void TwoWire::onRequest(void (*cbk)(void)) { b()->i2c.on_request = cbk; }
+
+/* ##################################################################### */
+/*                               SPI                                     */
+/* ##################################################################### */
+
+void SPIClass::begin() {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void SPIClass::end() {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void SPIClass::beginTransaction(SPISettings settings) {
+  if (settings.clock > 0) {
+    b()->spi_clock_hz = settings.clock;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void SPIClass::endTransaction() {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  transfer(&data, 1);
+  return data;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void SPIClass::transfer(void *buf, size_t count) {
+  Board *brd = b();
+  k().spend((uint64_t)count * 8ULL * 1000000000ULL / brd->spi_clock_hz);
+  SpiDevice *dev = brd->selectedSpiDevice();
+  if (dev != nullptr) {
+    dev->transfer((uint8_t *)buf, count);
+  } else {
+    memset(buf, 0xFF, count);
+  }
+}
+
+/* ##################################################################### */
+/*                              EEPROM                                   */
+/* ##################################################################### */
+
+uint8_t EEPROMClass::read(int idx) {
+  return b()->eeprom[(unsigned)idx % SIM_EEPROM_DIM];
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void EEPROMClass::write(int idx, uint8_t val) {
+  b()->eeprom[(unsigned)idx % SIM_EEPROM_DIM] = val;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint16_t EEPROMClass::length() { return SIM_EEPROM_DIM; }
+
+/* ##################################################################### */
+/*                             KEY VALUE STORE                           */
+/* ##################################################################### */
+
+int kv_set(const char *key, const void *buffer, size_t size, uint32_t flags) {
+  (void)flags;
+  const uint8_t *p = (const uint8_t *)buffer;
+  b()->kv[key].assign(p, p + size);
+  return MBED_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int kv_get(const char *key, void *buffer, size_t buffer_size,
+           size_t *actual_size) {
+  auto it = b()->kv.find(key);
+  if (it == b()->kv.end()) {
+    return MBED_ERROR_ITEM_NOT_FOUND;
+  }
+  size_t n = std::min(buffer_size, it->second.size());
+  memcpy(buffer, it->second.data(), n);
+  if (actual_size != nullptr) {
+    *actual_size = n;
+  }
+  return MBED_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int kv_remove(const char *key) {
+  if (b()->kv.erase(key) == 0) {
+    return MBED_ERROR_ITEM_NOT_FOUND;
+  }
+  return MBED_SUCCESS;
+}
+
+/* ##################################################################### */
+/*                              TIMER                                    */
+/* ##################################################################### */
+
+int8_t FspTimer::get_available_timer(uint8_t &type, bool force) {
+  (void)force;
+  type = 0;
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool FspTimer::begin(timer_mode_t mode, uint8_t type, uint8_t channel,
+                     float freq_hz, float duty_perc, GPTimerCbk_f cbk,
+                     void *ctx) {
+  (void)mode;
+  (void)type;
+  (void)channel;
+  (void)duty_perc;
+  if (freq_hz <= 0) {
+    return false;
+  }
+  period_ns = (uint64_t)(1000000000.0 / freq_hz);
+  callback = cbk;
+  context = ctx;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool FspTimer::setup_overflow_irq(uint8_t priority, void (*isr)()) {
+  (void)priority;
+  (void)isr;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool FspTimer::open() { return true; }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* ticks are lazy interrupts: when the board has been sleeping for a while
+   all the ticks elapsed are delivered as soon as it runs again */
+void FspTimer::schedule(uint64_t t) {
+  uint32_t g = generation;
+  k().post(
+      b(), t,
+      [this, g, t]() {
+        if (!running || g != generation) {
+          return;
+        }
+        if (callback != nullptr) {
+          timer_callback_args_t args;
+          args.p_context = context;
+          args.event = TIMER_EVENT_CYCLE_END;
+          args.capture = 0;
+          callback(&args);
+        }
+        if (running && g == generation) {
+          schedule(t + period_ns);
+        }
+      },
+      true);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool FspTimer::start() {
+  if (period_ns == 0) {
+    return false;
+  }
+  running = true;
+  generation++;
+  schedule(k().now() + period_ns);
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool FspTimer::stop() {
+  running = false;
+  generation++;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void FspTimer::end() { stop(); }
+
+/* ##################################################################### */
+/*                               PWM                                     */
+/* ##################################################################### */
+
+bool PwmOut::begin() {
+  b()->pwm[pin] = PwmState();
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PwmOut::end() { b()->pwm.erase(pin); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool PwmOut::period_us(uint32_t us) {
+  b()->pwm[pin].period_us = us;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool PwmOut::pulseWidth_us(uint32_t us) {
+  b()->pwm[pin].pulse_us = us;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PwmOut::suspend() { b()->pwm[pin].running = false; }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PwmOut::resume() { b()->pwm[pin].running = true; }
+
+/* ##################################################################### */
+/*                               ADC                                     */
+/* ##################################################################### */
+
+/* ADC channel of each analog pin (same channels of the Opta Digital
+   variant so that the input i is the channel OPTA_DIGITAL_IN_INDEX_i) */
+static const int analog_pin_channel[] = {
+    OPTA_DIGITAL_IN_INDEX_0,  OPTA_DIGITAL_IN_INDEX_1,
+    OPTA_DIGITAL_IN_INDEX_2,  OPTA_DIGITAL_IN_INDEX_3,
+    OPTA_DIGITAL_IN_INDEX_4,  OPTA_DIGITAL_IN_INDEX_5,
+    OPTA_DIGITAL_IN_INDEX_6,  OPTA_DIGITAL_IN_INDEX_7,
+    OPTA_DIGITAL_IN_INDEX_8,  OPTA_DIGITAL_IN_INDEX_9,
+    OPTA_DIGITAL_IN_INDEX_10, OPTA_DIGITAL_IN_INDEX_11,
+    OPTA_DIGITAL_IN_INDEX_12, OPTA_DIGITAL_IN_INDEX_13,
+    OPTA_DIGITAL_IN_INDEX_14, OPTA_DIGITAL_IN_INDEX_15};
+
+std::array<uint16_t, 3> getPinCfgs(int pin, PinCfgReq_t req) {
+  std::array<uint16_t, 3> rv = {0, 0, 0};
+  if (req == PIN_CFG_REQ_ADC && pin >= SIM_FIRST_ANALOG_PIN &&
+      pin <= SIM_LAST_ANALOG_PIN) {
+    rv[0] = SIM_PIN_CFG_ADC | analog_pin_channel[pin - SIM_FIRST_ANALOG_PIN];
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int digitalPinToBspPin(int pin) { return pin; }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void pinPeripheral(int bsp_pin, uint32_t cfg) {
+  (void)bsp_pin;
+  (void)cfg;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+IRQManager &IRQManager::getInstance() {
+  static IRQManager m;
+  return m;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool IRQManager::addADCScanEnd(ADC_Container *adc, void (*fnc)()) {
+  (void)adc;
+  (void)fnc;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+ADC_Container::ADC_Container(uint8_t unit, ADCCbk_f cbk, void *ctx)
+    : is_initialized(false) {
+  memset(&ctrl, 0, sizeof(ctrl));
+  memset(&cfg_extend, 0, sizeof(cfg_extend));
+  memset(&cfg, 0, sizeof(cfg));
+  memset(&channel_cfg, 0, sizeof(channel_cfg));
+  cfg.unit = unit;
+  cfg.p_callback = cbk;
+  cfg.p_context = ctx;
+  cfg.p_extend = &cfg_extend;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+fsp_err_t R_ADC_Open(adc_ctrl_t *const p_ctrl, adc_cfg_t const *const p_cfg) {
+  adc_instance_ctrl_t *c = (adc_instance_ctrl_t *)p_ctrl;
+  c->p_cfg = p_cfg;
+  c->opened = true;
+  c->scanning = false;
+  return FSP_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+fsp_err_t R_ADC_ScanCfg(adc_ctrl_t *const p_ctrl,
+                        void const *const p_channel_cfg) {
+  adc_instance_ctrl_t *c = (adc_instance_ctrl_t *)p_ctrl;
+  c->scan_mask = ((const adc_channel_cfg_t *)p_channel_cfg)->scan_mask;
+  return FSP_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void schedule_scan(adc_instance_ctrl_t *c) {
+  Board *brd = b();
+  uint32_t g = c->generation;
+  uint64_t t = k().now() + SIM_ADC_CHANNEL_CONVERSION_ns *
+                               (uint64_t)__builtin_popcount(c->scan_mask);
+  k().post(
+      brd, t,
+      [c, g, brd]() {
+        if (!c->scanning || c->generation != g) {
+          return;
+        }
+        for (int i = 0; i < SIM_ADC_CHANNELS; i++) {
+          if (c->scan_mask & (1u << i)) {
+            c->results[i] = brd->adc[i];
+          }
+        }
+        if (c->p_cfg != nullptr && c->p_cfg->p_callback != nullptr) {
+          adc_callback_args_t args;
+          args.unit = c->p_cfg->unit;
+          args.event = ADC_EVENT_SCAN_COMPLETE;
+          args.p_context = c->p_cfg->p_context;
+          c->p_cfg->p_callback(&args);
+        }
+        if (c->scanning && c->generation == g && c->p_cfg != nullptr &&
+            c->p_cfg->mode == ADC_MODE_CONTINUOUS_SCAN) {
+          schedule_scan(c);
+        } else if (c->generation == g) {
+          c->scanning = false;
+        }
+      },
+      true);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+fsp_err_t R_ADC_ScanStart(adc_ctrl_t *const p_ctrl) {
+  adc_instance_ctrl_t *c = (adc_instance_ctrl_t *)p_ctrl;
+  if (!c->opened) {
+    return FSP_ERR_NOT_OPEN;
+  }
+  c->scanning = true;
+  c->generation++;
+  schedule_scan(c);
+  return FSP_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+fsp_err_t R_ADC_ScanStop(adc_ctrl_t *const p_ctrl) {
+  adc_instance_ctrl_t *c = (adc_instance_ctrl_t *)p_ctrl;
+  c->scanning = false;
+  c->generation++;
+  return FSP_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+fsp_err_t R_ADC_Read(adc_ctrl_t *const p_ctrl, adc_channel_t const reg_id,
+                     uint16_t *const p_data) {
+  adc_instance_ctrl_t *c = (adc_instance_ctrl_t *)p_ctrl;
+  if (reg_id >= 0 && reg_id < SIM_ADC_CHANNELS) {
+    *p_data = c->results[reg_id];
+  }
+  return FSP_SUCCESS;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+fsp_err_t R_ADC_Close(adc_ctrl_t *const p_ctrl) {
+  R_ADC_ScanStop(p_ctrl);
+  ((adc_instance_ctrl_t *)p_ctrl)->opened = false;
+  return FSP_SUCCESS;
+}
+
+/* ##################################################################### */
+/*                                RTOS                                   */
+/* ##################################################################### */
+
+/* priorities of the threads started (the main thread of a board is not
+   here) */
+static std::map<Board *, osPriority> thread_priority;
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+osPriority osThreadGetPriority(osThreadId_t id) {
+  auto it = thread_priority.find((Board *)id);
+  if (it != thread_priority.end()) {
+    return it->second;
+  }
+  return osPriorityNormal;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+rtos::Thread::Thread(osPriority p, uint32_t stack_size,
+                     unsigned char *stack_mem, const char *n)
+    : priority(p), name(n) {
+  (void)stack_size;
+  (void)stack_mem;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* a thread still running is released by Kernel::stop() */
+rtos::Thread::~Thread() {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+osStatus rtos::Thread::start(mbed::Callback<void()> task) {
+  if (th != nullptr) {
+    return osError;
+  }
+  th = k().spawn((name != nullptr) ? name : "thread", task);
+  thread_priority[th] = priority;
+  return osOK;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+osStatus rtos::Thread::join() {
+  if (th == nullptr) {
+    return osError;
+  }
+  k().join(th);
+  thread_priority.erase(th);
+  th = nullptr;
+  return osOK;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::Mutex::lock() {
+  Board *self = Kernel::thread();
+  while (count > 0 && owner != self) {
+    waiters.push_back(self);
+    k().block();
+  }
+  owner = self;
+  count++;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool rtos::Mutex::trylock() {
+  if (count > 0 && owner != Kernel::thread()) {
+    return false;
+  }
+  owner = Kernel::thread();
+  count++;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::Mutex::unlock() {
+  if (count > 0 && --count == 0) {
+    owner = nullptr;
+    /* all the waiters try again, the first one scheduled gets the mutex */
+    for (auto w : waiters) {
+      k().wake(w, k().now());
+    }
+    waiters.clear();
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::ThisThread::sleep_for(
+    std::chrono::duration<uint32_t, std::milli> rel_time) {
+  k().spend((uint64_t)rel_time.count() * 1000000ULL);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::ConditionVariable::wait() {
+  Board *self = Kernel::thread();
+  waiters.push_back(self);
+  mtx.unlock();
+  k().block();
+  mtx.lock();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::ConditionVariable::notify_one() {
+  if (!waiters.empty()) {
+    k().wake(waiters.front(), k().now());
+    waiters.erase(waiters.begin());
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::ConditionVariable::notify_all() {
+  for (auto w : waiters) {
+    k().wake(w, k().now());
+  }
+  waiters.clear();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void rtos::ThisThread::yield() { call_cost(); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+osThreadId_t rtos::ThisThread::get_id() { return (osThreadId_t)Kernel::thread(); }
+
+/* ##################################################################### */
+/*                             BOOTLOADER                                */
+/* ##################################################################### */
+
+void goBootloader() { throw Halt(); }
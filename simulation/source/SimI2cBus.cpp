@@ -0,0 +1,75 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimI2cBus.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Simulated I2C bus shared by the Controller (master) and by
+                the expansions (slaves)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "SimI2cBus.h"
+
+namespace sim {
+
+I2cBus &I2cBus::get() {
+  static I2cBus bus;
+  return bus;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void I2cBus::setClock(uint32_t freq) {
+  if (freq > 0) {
+    bit_ns = 1000000000ULL / freq;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint64_t I2cBus::bitTime() const {
+  return (bit_ns_override != 0) ? bit_ns_override : bit_ns;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Board *I2cBus::find(uint8_t address) {
+  uint64_t bit = bitTime();
+  if (bit * wiring_max_clock < 1000000000ULL) {
+    return nullptr;
+  }
+  for (auto b : Kernel::get().getBoards()) {
+    if (b->i2c.begun && b->i2c.slave && !b->i2c.mute &&
+        b->i2c.address == address &&
+        bit * b->i2c.max_clock >= 1000000000ULL) {
+      return b;
+    }
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void I2cBus::count(size_t n, bool nack) {
+  transfers++;
+  bytes += n;
+  busy_ns += frameTime(n);
+  if (nack) {
+    nacks++;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void I2cBus::resetCounters() {
+  transfers = 0;
+  bytes = 0;
+  nacks = 0;
+  busy_ns = 0;
+}
+
+} // namespace sim
@@ -0,0 +1,74 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimI2cBus.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Simulated I2C bus shared by the Controller (master) and by
+                the expansions (slaves)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Timing model:
+                - every byte takes 9 bit times, plus 2 bit times for start and
+                  stop condition
+                - the onReceive / onRequest callback of the slave is called
+                  as an interrupt of the slave board, the master is stalled
+                  (clock stretching) until the interrupt is handled plus the
+                  i2c_processing_ns of the slave board
+                - an address nobody answers to is NACKed after the address
+                  byte (endTransmission returns 2, requestFrom returns 0),
+                  the same happens when the clock is higher than the one
+                  the slave or the wiring can follow
+                - a slave writing less bytes than requested answers 0xFF for
+                  the missing ones                                            */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_I2C_BUS_H
+#define SIM_I2C_BUS_H
+
+#include "SimKernel.h"
+
+/* Arduino default I2C clock (100 kHz) */
+#define SIM_I2C_DEFAULT_BIT_ns 10000
+
+namespace sim {
+
+class I2cBus {
+public:
+  static I2cBus &get();
+
+  /* bit time set by the master with Wire.setClock() */
+  void setClock(uint32_t freq);
+  /* when different from 0 it is used instead of the bit time set by the
+     master (to simulate different bus speeds without touching the code) */
+  uint64_t bit_ns_override = 0;
+  uint64_t bitTime() const;
+  /* highest clock the wiring carries */
+  uint32_t wiring_max_clock = 1000000;
+  /* time on the wire of a frame of n bytes (address byte included) */
+  uint64_t frameTime(size_t n) const { return (9 * n + 2) * bitTime(); }
+
+  /* slave with the given address (nullptr if nobody answers, also when the
+     clock is too high for it) */
+  Board *find(uint8_t address);
+
+  /* ---- bus usage counters ---- */
+  /* transfers started by the master (write or read) */
+  uint64_t transfers = 0;
+  /* bytes on the wire, address bytes included */
+  uint64_t bytes = 0;
+  /* transfers whose address has not been acknowledged */
+  uint64_t nacks = 0;
+  /* time the bus has been busy (nano seconds) */
+  uint64_t busy_ns = 0;
+  void count(size_t n, bool nack);
+  void resetCounters();
+
+private:
+  uint64_t bit_ns = SIM_I2C_DEFAULT_BIT_ns;
+};
+
+} // namespace sim
+
+#endif
@@ -0,0 +1,461 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimKernel.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Implementation of the virtual time kernel
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "SimKernel.h"
+#include "Arduino.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+namespace sim {
+
+static thread_local Board *cur_board = nullptr;
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Board::Board(const std::string &n) : name(n) {
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  memset(adc, 0, sizeof(adc));
+  for (int i = 0; i < SIM_PIN_NUM; i++) {
+    /* outputs are HIGH at reset so that active low signals (chip select,
+       reset...) are not asserted */
+    pins[i].out = 1;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Board::addSpiDevice(int cs_pin, SpiDevice *dev) {
+  spi_devices[cs_pin] = dev;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+SpiDevice *Board::selectedSpiDevice() {
+  for (auto &d : spi_devices) {
+    if (pins[d.first].out == 0) {
+      return d.second;
+    }
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Board::onPinWrite(int pin, std::function<void(int)> fnc) {
+  pin_listeners[pin].push_back(fnc);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Board::notifyPinWrite(int pin, int value) {
+  auto it = pin_listeners.find(pin);
+  if (it != pin_listeners.end()) {
+    for (auto &f : it->second) {
+      f(value);
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Kernel &Kernel::get() {
+  static Kernel k;
+  return k;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Board *Kernel::current() {
+  if (cur_board != nullptr && cur_board->owner != nullptr) {
+    return cur_board->owner;
+  }
+  return cur_board;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Board *Kernel::thread() { return cur_board; }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::add(Board *b) {
+  std::unique_lock<std::mutex> lk(mtx);
+  b->id = (int)boards.size();
+  boards.push_back(b);
+  if (b->id == 0) {
+    cur_board = b;
+    running = b;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::start() {
+  std::unique_lock<std::mutex> lk(mtx);
+  stopping = false;
+  for (size_t i = 1; i < boards.size(); i++) {
+    boards[i]->wake = now_ns;
+    boards[i]->th = std::thread(&Kernel::thread_main, this, boards[i]);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::stop() {
+  {
+    std::unique_lock<std::mutex> lk(mtx);
+    stopping = true;
+    for (auto b : boards) {
+      b->cv.notify_all();
+    }
+  }
+  for (auto b : boards) {
+    if (b->th.joinable()) {
+      b->th.join();
+    }
+  }
+  std::unique_lock<std::mutex> lk(mtx);
+  /* threads started by the firmwares belong to the kernel */
+  for (auto b : boards) {
+    if (b->owner != nullptr) {
+      delete b;
+    }
+  }
+  boards.clear();
+  nets.clear();
+  running = nullptr;
+  cur_board = nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::thread_main(Board *b) {
+  cur_board = b;
+  try {
+    {
+      std::unique_lock<std::mutex> lk(mtx);
+      b->cv.wait(lk, [&] { return running == b || stopping; });
+      if (stopping) {
+        throw Stop();
+      }
+    }
+    if (b->owner != nullptr) {
+      b->setup();
+      std::unique_lock<std::mutex> lk(mtx);
+      exit_thread(lk, b);
+      return;
+    }
+    for (;;) {
+      try {
+        if (b->setup) {
+          b->setup();
+        }
+        for (;;) {
+          if (b->loop) {
+            b->loop();
+          }
+          spend(b->loop_cost_ns);
+        }
+      } catch (Halt &) {
+        /* the firmware jumped to the bootloader (not simulated): the board
+           does not answer anymore */
+        std::unique_lock<std::mutex> lk(mtx);
+        b->halted++;
+        b->i2c = I2cPort();
+        b->irqs = decltype(b->irqs)();
+        b->lazy_irqs = decltype(b->lazy_irqs)();
+        b->wake = SIM_TIME_FOREVER;
+        reschedule(lk, b);
+      }
+    }
+  } catch (Stop &) {
+  } catch (std::exception &e) {
+    fprintf(stderr, "[SIM] board %s: %s\n", b->name.c_str(), e.what());
+    abort();
+  }
+  std::unique_lock<std::mutex> lk(mtx);
+  b->finished = true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* a thread started with spawn returned: the threads waiting for it are
+   woken up and the CPU is given to the next board without waiting (the
+   calling thread ends) */
+void Kernel::exit_thread(std::unique_lock<std::mutex> &lk, Board *self) {
+  (void)lk;
+  self->finished = true;
+  self->wake = SIM_TIME_FOREVER;
+  for (auto j : self->joiners) {
+    j->wake = now_ns;
+  }
+  self->joiners.clear();
+
+  Board *next = nullptr;
+  uint64_t best = SIM_TIME_FOREVER;
+  for (auto b : boards) {
+    uint64_t t = eff_wake(b);
+    if (t < best) {
+      best = t;
+      next = b;
+    }
+  }
+  if (next == nullptr) {
+    fprintf(stderr, "[SIM] deadlock: all boards are waiting\n");
+    abort();
+  }
+  if (best > now_ns) {
+    now_ns = best;
+  }
+  running = next;
+  next->cv.notify_one();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Board *Kernel::spawn(const std::string &name, std::function<void()> fnc) {
+  std::unique_lock<std::mutex> lk(mtx);
+  Board *owner = Kernel::current();
+  Board *t = new Board((owner != nullptr) ? owner->getName() + "/" + name
+                                          : name);
+  t->owner = owner;
+  t->setup = fnc;
+  t->id = (int)boards.size();
+  t->wake = now_ns;
+  boards.push_back(t);
+  t->th = std::thread(&Kernel::thread_main, this, t);
+  return t;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::join(Board *t) {
+  {
+    std::unique_lock<std::mutex> lk(mtx);
+    while (!t->finished) {
+      t->joiners.push_back(cur_board);
+      sleep_until(lk, cur_board, SIM_TIME_FOREVER);
+    }
+  }
+  /* the thread does not use the kernel anymore */
+  if (t->th.joinable()) {
+    t->th.join();
+  }
+  std::unique_lock<std::mutex> lk(mtx);
+  for (auto it = boards.begin(); it != boards.end(); it++) {
+    if (*it == t) {
+      boards.erase(it);
+      break;
+    }
+  }
+  delete t;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint64_t Kernel::eff_wake(Board *b) const {
+  if (b->finished) {
+    return SIM_TIME_FOREVER;
+  }
+  uint64_t t = b->wake;
+  /* lazy interrupts are not considered: they are executed only when the
+     board runs for another reason */
+  if (b->irq_enabled && !b->in_irq && !b->irqs.empty() &&
+      b->irqs.top().time < t) {
+    t = b->irqs.top().time;
+  }
+  return t;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::deliver_irqs(std::unique_lock<std::mutex> &lk, Board *self) {
+  while (self->irq_enabled && !self->in_irq) {
+    /* the oldest interrupt of the two queues first */
+    auto *q = &self->irqs;
+    if (q->empty() || (!self->lazy_irqs.empty() &&
+                       self->lazy_irqs.top() < q->top())) {
+      q = &self->lazy_irqs;
+    }
+    if (q->empty() || q->top().time > now_ns) {
+      break;
+    }
+    Irq irq = q->top();
+    q->pop();
+    uint64_t saved_wake = self->wake;
+    self->in_irq = true;
+    lk.unlock();
+    irq.fnc();
+    lk.lock();
+    self->in_irq = false;
+    self->wake = saved_wake;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::reschedule(std::unique_lock<std::mutex> &lk, Board *self) {
+  for (;;) {
+    /* the board with the lowest wake up time runs, on equal time the
+       current board goes on (fewer thread switches) then the lowest id */
+    Board *next = self;
+    uint64_t best = eff_wake(self);
+    for (auto b : boards) {
+      uint64_t t = eff_wake(b);
+      if (t < best) {
+        best = t;
+        next = b;
+      }
+    }
+    if (best == SIM_TIME_FOREVER) {
+      fprintf(stderr, "[SIM] deadlock: all boards are waiting\n");
+      abort();
+    }
+    if (best > now_ns) {
+      now_ns = best;
+    }
+    if (next != self) {
+      running = next;
+      next->cv.notify_one();
+      self->cv.wait(lk, [&] { return running == self || stopping; });
+      if (stopping) {
+        throw Stop();
+      }
+    }
+    deliver_irqs(lk, self);
+    if (self->wake <= now_ns) {
+      return;
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::sleep_until(std::unique_lock<std::mutex> &lk, Board *self,
+                         uint64_t t) {
+  self->wake = t;
+  reschedule(lk, self);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::spend(uint64_t ns) {
+  std::unique_lock<std::mutex> lk(mtx);
+  Board *self = cur_board;
+  if (self == nullptr) {
+    /* called outside the simulation (e.g. static constructors) */
+    now_ns += ns;
+    return;
+  }
+  sleep_until(lk, self, now_ns + ns);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::block() {
+  std::unique_lock<std::mutex> lk(mtx);
+  sleep_until(lk, cur_board, SIM_TIME_FOREVER);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::wake(Board *b, uint64_t t) {
+  std::unique_lock<std::mutex> lk(mtx);
+  b->wake = (t < now_ns) ? now_ns : t;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::post(Board *b, uint64_t t, std::function<void()> fnc,
+                  bool lazy) {
+  std::unique_lock<std::mutex> lk(mtx);
+  Irq irq;
+  irq.time = t;
+  irq.seq = irq_seq++;
+  irq.fnc = fnc;
+  if (lazy) {
+    b->lazy_irqs.push(irq);
+  } else {
+    b->irqs.push(irq);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::disableIrq() {
+  std::unique_lock<std::mutex> lk(mtx);
+  if (cur_board != nullptr) {
+    cur_board->irq_enabled = false;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::enableIrq() {
+  std::unique_lock<std::mutex> lk(mtx);
+  if (cur_board != nullptr) {
+    cur_board->irq_enabled = true;
+    deliver_irqs(lk, cur_board);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int Kernel::newNet() {
+  std::unique_lock<std::mutex> lk(mtx);
+  nets.emplace_back();
+  return (int)nets.size() - 1;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::connect(int net, Board *b, int pin) {
+  std::unique_lock<std::mutex> lk(mtx);
+  nets[net].push_back(std::make_pair(b, pin));
+  b->pins[pin].net = net;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* open drain like wire: LOW wins, otherwise HIGH (driven or pull up) */
+int Kernel::readNet(int net) const {
+  for (auto &m : nets[net]) {
+    const Pin &p = m.first->pins[m.second];
+    if (p.mode == SIM_PIN_OUTPUT && p.out == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Kernel::netChanged(int net) {
+  int level = readNet(net);
+  for (auto &m : nets[net]) {
+    auto it = m.first->pin_irqs.find(m.second);
+    if (it == m.first->pin_irqs.end() || it->second.level == level) {
+      continue;
+    }
+    PinIrq &irq = it->second;
+    irq.level = level;
+    if (irq.mode == CHANGE || (irq.mode == FALLING && level == 0) ||
+        (irq.mode == RISING && level == 1)) {
+      post(m.first, now(), irq.fnc);
+    }
+  }
+}
+
+} // namespace sim
@@ -0,0 +1,269 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimKernel.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Virtual time kernel of the host simulation: every board
+                (Controller or expansion) runs its firmware in its own thread
+                but only one board at a time is allowed to run, so that the
+                simulation is deterministic and does not depend on the speed
+                of the host
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The board running is always the one with the lowest wake up
+                time: a board gives the CPU to the others only when it
+                "spends" time (delay, millis, I2C or SPI transfers...)        */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SimPins.h"
+
+#define SIM_TIME_FOREVER UINT64_MAX
+
+/* virtual time spent by the functions used in busy loops (millis, micros,
+   digitalRead...) so that a loop waiting for something always progresses */
+#define SIM_DEFAULT_CALL_COST_ns 1000
+/* virtual time spent by every execution of the firmware loop() */
+#define SIM_DEFAULT_LOOP_COST_ns 5000
+
+namespace sim {
+
+class Board;
+
+/* thrown into the board threads when the simulation is stopped */
+class Stop {};
+/* thrown into the board thread when the firmware jumps to the bootloader */
+class Halt {};
+
+/* an interrupt (or an event of a peripheral) of a board: it is executed in
+   the thread of the board at time "time" */
+class Irq {
+public:
+  uint64_t time;
+  uint64_t seq;
+  std::function<void()> fnc;
+  bool operator>(const Irq &o) const {
+    return (time != o.time) ? (time > o.time) : (seq > o.seq);
+  }
+  bool operator<(const Irq &o) const { return o > *this; }
+};
+
+/* a device connected to the SPI bus of a board, selected by a CS pin */
+class SpiDevice {
+public:
+  virtual ~SpiDevice() {}
+  /* full duplex transfer: buf contains the bytes sent and it is overwritten
+     with the bytes received */
+  virtual void transfer(uint8_t *buf, size_t n) = 0;
+};
+
+/* state of a PWM output as set by the firmware */
+class PwmState {
+public:
+  uint32_t period_us = 0;
+  uint32_t pulse_us = 0;
+  bool running = false;
+};
+
+/* pin change interrupt attached by the firmware (mode is CHANGE, FALLING or
+   RISING, level is the last level seen on the pin) */
+class PinIrq {
+public:
+  int mode = 0;
+  void (*fnc)() = nullptr;
+  int level = 1;
+};
+
+class Pin {
+public:
+  int mode = SIM_PIN_INPUT;
+  int out = 0;
+  /* level read when the pin is an input not connected to a net */
+  int in = 1;
+  /* index of the net the pin is connected to (-1 none) */
+  int net = -1;
+};
+
+/* I2C peripheral of a board (master or slave) */
+class I2cPort {
+public:
+  bool begun = false;
+  bool slave = false;
+  uint8_t address = 0;
+  /* slave: the address is not acknowledged (a dead or hung expansion) */
+  bool mute = false;
+  /* slave: highest clock the slave follows (faster transfers are not
+     acknowledged) */
+  uint32_t max_clock = 1000000;
+  /* slave: the next corrupt frames written to it arrive with a wrong last
+     byte (CRC) */
+  int corrupt = 0;
+  void (*on_receive)(int) = nullptr;
+  void (*on_request)() = nullptr;
+  /* master: bytes to be sent with endTransmission
+     slave: answer written in the onRequest callback */
+  std::vector<uint8_t> tx;
+  uint8_t tx_address = 0;
+  /* bytes that can be read with Wire.read() */
+  std::vector<uint8_t> rx;
+  size_t rx_pos = 0;
+};
+
+class Board {
+public:
+  Board(const std::string &name);
+  virtual ~Board() {}
+
+  const std::string &getName() const { return name; }
+  int getId() const { return id; }
+
+  /* firmware entry points (setup is called once, loop forever) */
+  std::function<void()> setup;
+  std::function<void()> loop;
+
+  /* ---- I/O seen by the firmware ---- */
+  Pin pins[SIM_PIN_NUM];
+  I2cPort i2c;
+  uint8_t eeprom[SIM_EEPROM_DIM];
+  /* key value store (kvstore_global_api.h) of the mbed core */
+  std::map<std::string, std::vector<uint8_t>> kv;
+  std::map<int, PwmState> pwm;
+  /* raw value returned by the MCU ADC for each channel */
+  uint16_t adc[SIM_ADC_CHANNELS];
+
+  void addSpiDevice(int cs_pin, SpiDevice *dev);
+  SpiDevice *selectedSpiDevice();
+  /* called when the firmware writes an output pin */
+  void onPinWrite(int pin, std::function<void(int)> fnc);
+  void notifyPinWrite(int pin, int value);
+  /* pin change interrupts (only for pins connected to a net) */
+  std::map<int, PinIrq> pin_irqs;
+
+  /* ---- timing of the board ---- */
+  /* time spent by the controller waiting for the board to handle an I2C
+     interrupt (the interrupt routine itself does not spend virtual time) */
+  uint64_t i2c_processing_ns = 20000;
+  uint64_t call_cost_ns = SIM_DEFAULT_CALL_COST_ns;
+  uint64_t loop_cost_ns = SIM_DEFAULT_LOOP_COST_ns;
+  /* clock of the SPI transfer in progress (set by SPI.beginTransaction) */
+  uint32_t spi_clock_hz = 4000000;
+  /* millis() and micros() of the board: clock_offset_ns ahead of the
+     virtual time, its oscillator runs clock_ppm parts per million faster
+     since the virtual time clock_drift_ns */
+  int32_t clock_ppm = 0;
+  uint64_t clock_offset_ns = 0;
+  uint64_t clock_drift_ns = 0;
+
+  /* number of times the firmware jumped to the bootloader */
+  int halted = 0;
+
+private:
+  friend class Kernel;
+  std::string name;
+  int id = -1;
+  /* threads started by the firmware (see Kernel::spawn) run on the I/O of
+     their owner board */
+  Board *owner = nullptr;
+  /* threads waiting for this one to finish */
+  std::vector<Board *> joiners;
+  std::thread th;
+  std::condition_variable cv;
+  /* time at which the board wants to run again (FOREVER when blocked) */
+  uint64_t wake = 0;
+  bool irq_enabled = true;
+  bool in_irq = false;
+  bool finished = false;
+  std::priority_queue<Irq, std::vector<Irq>, std::greater<Irq>> irqs;
+  /* lazy interrupts do not wake up a board: they are executed as soon as the
+     board runs again (used for the timer ticks and the ADC scans that would
+     otherwise force a thread switch every milli second) */
+  std::priority_queue<Irq, std::vector<Irq>, std::greater<Irq>> lazy_irqs;
+  std::map<int, SpiDevice *> spi_devices;
+  std::map<int, std::vector<std::function<void(int)>>> pin_listeners;
+};
+
+class Kernel {
+public:
+  static Kernel &get();
+
+  /* the first board added is the one running in the calling thread (the
+     Controller), the others get their own thread when start() is called */
+  void add(Board *b);
+  void start();
+  /* stop all the board threads (must be called by the first board) */
+  void stop();
+
+  /* board running in the calling thread (the owner board for the threads
+     started with spawn) */
+  static Board *current();
+  /* thread running in the calling thread (the board itself or a thread
+     started with spawn) */
+  static Board *thread();
+  /* virtual time in nano seconds */
+  uint64_t now() const { return now_ns; }
+
+  /* the current board spends ns nano seconds */
+  void spend(uint64_t ns);
+  /* the current board waits until someone calls wake() */
+  void block();
+  void wake(Board *b, uint64_t t);
+
+  /* start a new thread of the current board (RTOS thread of the firmware):
+     it runs fnc once and shares the I/O of the board, it is scheduled as
+     the boards are (i.e. as if it had its own CPU core, priorities are not
+     simulated) */
+  Board *spawn(const std::string &name, std::function<void()> fnc);
+  /* wait for a thread started with spawn to finish and release it */
+  void join(Board *t);
+  /* schedule an interrupt on board b at time t */
+  void post(Board *b, uint64_t t, std::function<void()> fnc,
+            bool lazy = false);
+
+  void disableIrq();
+  void enableIrq();
+
+  /* connect pins of different boards to the same wire */
+  int newNet();
+  void connect(int net, Board *b, int pin);
+  int readNet(int net) const;
+  /* the level of net may have changed: post the pin change interrupts of
+     the boards connected to it */
+  void netChanged(int net);
+  const std::vector<Board *> &getBoards() const { return boards; }
+
+private:
+  Kernel() {}
+  void thread_main(Board *b);
+  void sleep_until(std::unique_lock<std::mutex> &lk, Board *self,
+                   uint64_t t);
+  void reschedule(std::unique_lock<std::mutex> &lk, Board *self);
+  void deliver_irqs(std::unique_lock<std::mutex> &lk, Board *self);
+  void exit_thread(std::unique_lock<std::mutex> &lk, Board *self);
+  uint64_t eff_wake(Board *b) const;
+
+  std::mutex mtx;
+  std::vector<Board *> boards;
+  std::vector<std::vector<std::pair<Board *, int>>> nets;
+  Board *running = nullptr;
+  uint64_t now_ns = 0;
+  uint64_t irq_seq = 0;
+  bool stopping = false;
+};
+
+} // namespace sim
+
+#endif
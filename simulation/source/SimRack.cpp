@@ -0,0 +1,279 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimRack.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: A simulated Opta Controller with its chain of expansions
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#include "SimRack.h"
+#include "DigitalCommonCfg.h"
+#include "OptaDigitalCfg.h"
+#include <stdexcept>
+
+/* setup() and loop() of firmwares/Analog/Analog.ino and
+   firmwares/Digital/Digital.ino (renamed at compile time) */
+void opta_analog_setup();
+void opta_analog_loop();
+void opta_digital_setup();
+void opta_digital_loop();
+
+/* ADC channel of the digital inputs */
+static const int digital_in_channel[OPTA_DIGITAL_IN_NUM] = {
+    OPTA_DIGITAL_IN_INDEX_0,  OPTA_DIGITAL_IN_INDEX_1,
+    OPTA_DIGITAL_IN_INDEX_2,  OPTA_DIGITAL_IN_INDEX_3,
+    OPTA_DIGITAL_IN_INDEX_4,  OPTA_DIGITAL_IN_INDEX_5,
+    OPTA_DIGITAL_IN_INDEX_6,  OPTA_DIGITAL_IN_INDEX_7,
+    OPTA_DIGITAL_IN_INDEX_8,  OPTA_DIGITAL_IN_INDEX_9,
+    OPTA_DIGITAL_IN_INDEX_10, OPTA_DIGITAL_IN_INDEX_11,
+    OPTA_DIGITAL_IN_INDEX_12, OPTA_DIGITAL_IN_INDEX_13,
+    OPTA_DIGITAL_IN_INDEX_14, OPTA_DIGITAL_IN_INDEX_15};
+
+/* device and device channel of each Opta Analog channel (same mapping of
+   OptaAnalog::get_add_offset) */
+static const int an_ch_device[] = {0, 0, 1, 1, 1, 1, 0, 0};
+static const int an_ch_offset[] = {1, 0, 0, 1, 2, 3, 2, 3};
+#define SIM_AN_CHANNELS_NUM 8
+
+namespace sim {
+
+Rack::Rack() : ctrl(new Board("controller")) {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Rack::~Rack() { stop(); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int Rack::add(SimExpansion_t type) {
+  if (started) {
+    throw std::logic_error("expansions must be added before start()");
+  }
+  int index = (int)exps.size();
+  std::string name = (type == SIM_EXP_ANALOG) ? "analog" : "digital";
+  Board *b = new Board(name + std::to_string(index));
+  exps.emplace_back(b);
+  types.push_back(type);
+  out_state.push_back(0);
+  out_change.push_back(0);
+
+  if (type == SIM_EXP_ANALOG) {
+    b->setup = opta_analog_setup;
+    b->loop = opta_analog_loop;
+    Ad74412r *d0 = new Ad74412r(b, DIO_RESET_1, LDAC1);
+    Ad74412r *d1 = new Ad74412r(b, DIO_RESET_2, LDAC2);
+    b->addSpiDevice(SPI_CS_1, d0);
+    b->addSpiDevice(SPI_CS_2, d1);
+    devices.emplace_back(d0);
+    devices.emplace_back(d1);
+  } else {
+    b->setup = opta_digital_setup;
+    b->loop = opta_digital_loop;
+    /* the kind of digital expansion is written in the data flash during
+       production */
+    b->eeprom[EXPANSION_TYPE_ADDITIONA_DATA] =
+        (type == SIM_EXP_DIGITAL_SOLID_STATE) ? FLASH_OD_TYPE_STATE_SOLID
+                                              : FLASH_OD_TYPE_MECHANICAL;
+    b->eeprom[EXPANSION_TYPE_ADDITIONA_DATA + 1] = '#';
+    for (int out = 0; out < OPTA_DIGITAL_OUT_NUM; out++) {
+      b->onPinWrite(D0 + out, [this, index, out](int v) {
+        uint8_t mask = (uint8_t)(1 << out);
+        if (((out_state[index] & mask) != 0) != (v != 0)) {
+          out_state[index] ^= mask;
+          out_change[index] = Kernel::get().now();
+        }
+      });
+    }
+    devices.emplace_back(nullptr);
+    devices.emplace_back(nullptr);
+  }
+  return index;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int Rack::addDigital(bool solid_state) {
+  return add(solid_state ? SIM_EXP_DIGITAL_SOLID_STATE
+                         : SIM_EXP_DIGITAL_MECHANICAL);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int Rack::addAnalog() { return add(SIM_EXP_ANALOG); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::start() {
+  if (started) {
+    return;
+  }
+  Kernel &k = Kernel::get();
+  k.add(ctrl.get());
+  for (auto &e : exps) {
+    k.add(e.get());
+  }
+  /* detect chain */
+  Board *prev = ctrl.get();
+  int prev_pin = PG_8;
+  for (auto &e : exps) {
+    int net = k.newNet();
+    k.connect(net, prev, prev_pin);
+    if (prev == ctrl.get()) {
+      k.connect(net, prev, SIM_DETECT_PLUG);
+    }
+    k.connect(net, e.get(), DETECT_IN);
+    prev = e.get();
+    prev_pin = DETECT_OUT;
+  }
+  started = true;
+  k.start();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::stop() {
+  if (started) {
+    Kernel::get().stop();
+    started = false;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Board *Rack::expansion(int i) {
+  if (i >= 0 && i < (int)exps.size()) {
+    return exps[i].get();
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+Ad74412r *Rack::analogDevice(int exp, int dev) {
+  if (exp >= 0 && exp < (int)exps.size() && dev >= 0 &&
+      dev < SIM_AN_DEVICES_NUM) {
+    return devices[exp * SIM_AN_DEVICES_NUM + dev].get();
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::setDigitalInput(int exp, int in, uint16_t raw) {
+  Board *b = expansion(exp);
+  if (b != nullptr && in >= 0 && in < OPTA_DIGITAL_IN_NUM) {
+    b->adc[digital_in_channel[in]] = raw;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Rack::getDigitalOutput(int exp, int out) {
+  Board *b = expansion(exp);
+  if (b != nullptr && out >= 0 && out < OPTA_DIGITAL_OUT_NUM) {
+    return b->pins[D0 + out].mode == SIM_PIN_OUTPUT &&
+           b->pins[D0 + out].out != 0;
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::setAnalogAdc(int exp, int ch, uint16_t code) {
+  if (ch >= 0 && ch < SIM_AN_CHANNELS_NUM) {
+    Ad74412r *d = analogDevice(exp, an_ch_device[ch]);
+    if (d != nullptr) {
+      d->adc_code[an_ch_offset[ch]] = code;
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint16_t Rack::getAnalogDac(int exp, int ch) {
+  if (ch >= 0 && ch < SIM_AN_CHANNELS_NUM) {
+    Ad74412r *d = analogDevice(exp, an_ch_device[ch]);
+    if (d != nullptr) {
+      return d->dacActive(an_ch_offset[ch]);
+    }
+  }
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint64_t Rack::getOutputChangeTime(int exp) {
+  if (exp < 0 || exp >= (int)exps.size()) {
+    return 0;
+  }
+  uint64_t rv = out_change[exp];
+  for (int dev = 0; dev < SIM_AN_DEVICES_NUM; dev++) {
+    Ad74412r *d = analogDevice(exp, dev);
+    if (d != nullptr && d->dac_change > rv) {
+      rv = d->dac_change;
+    }
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::setMute(int exp, bool mute) {
+  Board *b = expansion(exp);
+  if (b != nullptr) {
+    b->i2c.mute = mute;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::corruptFrames(int exp, int n) {
+  Board *b = expansion(exp);
+  if (b != nullptr) {
+    b->i2c.corrupt = n;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::setMaxClock(int exp, uint32_t freq) {
+  Board *b = expansion(exp);
+  if (b != nullptr) {
+    b->i2c.max_clock = freq;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::setWiringMaxClock(uint32_t freq) {
+  I2cBus::get().wiring_max_clock = freq;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::setClockDrift(int exp, int32_t ppm, uint64_t offset_us) {
+  Board *b = expansion(exp);
+  if (b != nullptr) {
+    b->clock_ppm = ppm;
+    b->clock_offset_ns = offset_us * 1000ULL;
+    b->clock_drift_ns = Kernel::get().now();
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Rack::holdDetect(bool low) {
+  Pin &p = ctrl->pins[SIM_DETECT_PLUG];
+  p.mode = SIM_PIN_OUTPUT;
+  p.out = (low) ? 0 : 1;
+  if (p.net >= 0) {
+    Kernel::get().netChanged(p.net);
+  }
+}
+
+} // namespace sim
@@ -0,0 +1,100 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimRack.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: A simulated Opta Controller with its chain of expansions
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The Controller runs in the thread that creates the rack (it
+                is the thread of the application using OptaController), each
+                expansion runs the real expansion firmware in its own thread.
+                Expansions are connected in the order they are added: the
+                DETECT_IN of the first one is connected to the detect pin of
+                the Controller, the DETECT_IN of the others to the
+                DETECT_OUT of the previous one                                */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_RACK_H
+#define SIM_RACK_H
+
+#include "SimAd74412r.h"
+#include "SimI2cBus.h"
+#include "SimKernel.h"
+#include <memory>
+#include <vector>
+
+#define SIM_AN_DEVICES_NUM 2
+
+namespace sim {
+
+typedef enum {
+  SIM_EXP_DIGITAL_MECHANICAL,
+  SIM_EXP_DIGITAL_SOLID_STATE,
+  SIM_EXP_ANALOG
+} SimExpansion_t;
+
+class Rack {
+public:
+  Rack();
+  ~Rack();
+
+  /* expansions must be added before start(), the index returned is the
+     position in the chain (0 is the closest to the Controller) */
+  int addDigital(bool solid_state = false);
+  int addAnalog();
+  void start();
+  void stop();
+
+  Board *controller() { return ctrl.get(); }
+  Board *expansion(int i);
+  int expansionsNum() { return (int)exps.size(); }
+  SimExpansion_t expansionType(int i) { return types[i]; }
+  Ad74412r *analogDevice(int exp, int dev);
+
+  /* ---- I/O of the expansions (i.e. the "field") ---- */
+  /* raw value of the 14 bit ADC of the digital input in */
+  void setDigitalInput(int exp, int in, uint16_t raw);
+  /* state of the digital output out */
+  bool getDigitalOutput(int exp, int out);
+  /* raw code converted by the ADC of the analog channel ch */
+  void setAnalogAdc(int exp, int ch, uint16_t code);
+  /* DAC code active on the analog channel ch */
+  uint16_t getAnalogDac(int exp, int ch);
+  /* virtual time (ns) of the last change of an output of the expansion
+     (digital output or active DAC code), 0 if no output changed yet */
+  uint64_t getOutputChangeTime(int exp);
+
+  /* ---- faults ---- */
+  /* the expansion stops answering on I2C (its firmware keeps running) */
+  void setMute(int exp, bool mute);
+  /* the next n frames written to the expansion are corrupted (it discards
+     them, as a frame with a wrong CRC) */
+  void corruptFrames(int exp, int n);
+  /* highest I2C clock the expansion follows / the wiring carries */
+  void setMaxClock(int exp, uint32_t freq);
+  void setWiringMaxClock(uint32_t freq);
+  /* from now the clock of the expansion is offset_us ahead of the one of
+     the Controller and runs ppm parts per million faster */
+  void setClockDrift(int exp, int32_t ppm, uint64_t offset_us);
+  /* hold the DETECT of the Controller LOW, as an expansion that has just
+     been plugged in does (start() must have been called) */
+  void holdDetect(bool low);
+
+private:
+  int add(SimExpansion_t type);
+  bool started = false;
+  std::unique_ptr<Board> ctrl;
+  std::vector<std::unique_ptr<Board>> exps;
+  std::vector<SimExpansion_t> types;
+  std::vector<std::unique_ptr<Ad74412r>> devices;
+  /* digital outputs of each expansion and time of their last change */
+  std::vector<uint8_t> out_state;
+  std::vector<uint64_t> out_change;
+};
+
+} // namespace sim
+
+#endif
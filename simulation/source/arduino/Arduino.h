@@ -0,0 +1,138 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   Arduino.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Subset of the Arduino API used by the library, implemented
+                on top of the simulation kernel (see SimArduino.cpp)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Every function acts on the board running in the calling
+                thread                                                        */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "SimPins.h"
+
+typedef enum { LOW = 0, HIGH = 1, CHANGE = 2, FALLING = 3, RISING = 4 } PinStatus;
+
+#define INPUT SIM_PIN_INPUT
+#define OUTPUT SIM_PIN_OUTPUT
+#define INPUT_PULLUP SIM_PIN_INPUT_PULLUP
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define __WEAK __attribute__((weak))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(int pin, int mode);
+PinStatus digitalRead(int pin);
+void digitalWrite(int pin, PinStatus value);
+void digitalWrite(int pin, int value);
+
+void noInterrupts();
+void interrupts();
+
+typedef void (*voidFuncPtr)(void);
+#define digitalPinToInterrupt(p) (p)
+/* pin change interrupt (mode is CHANGE, FALLING or RISING) */
+void attachInterrupt(int pin, voidFuncPtr fnc, PinStatus mode);
+void detachInterrupt(int pin);
+
+class String : public std::string {
+public:
+  String() {}
+  String(const char *s) : std::string(s) {}
+  String(const std::string &s) : std::string(s) {}
+  template <typename T,
+            typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+  String(T v, int base = DEC) : std::string(toString(v, base)) {}
+
+  template <typename T> static std::string toString(T v, int base) {
+    std::ostringstream os;
+    if (std::is_integral<T>::value && base == HEX) {
+      os << std::uppercase << std::hex << (long long)v;
+    } else if (std::is_integral<T>::value) {
+      os << (long long)v;
+    } else {
+      os.precision(2);
+      os << std::fixed << (double)v;
+    }
+    return os.str();
+  }
+};
+
+inline String operator+(const String &a, const String &b) {
+  return String(static_cast<const std::string &>(a) +
+                static_cast<const std::string &>(b));
+}
+inline String operator+(const String &a, const char *b) {
+  return String(static_cast<const std::string &>(a) + b);
+}
+inline String operator+(const char *a, const String &b) {
+  return String(std::string(a) + static_cast<const std::string &>(b));
+}
+
+/* Serial prints on the standard output of the host */
+class SimSerial {
+public:
+  void begin(unsigned long) {}
+  void end() {}
+  operator bool() const { return true; }
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() { std::cout.flush(); }
+  size_t write(uint8_t c) {
+    std::cout.put((char)c);
+    return 1;
+  }
+  size_t write(const uint8_t *buf, size_t n) {
+    std::cout.write((const char *)buf, n);
+    return n;
+  }
+  void print(const char *s) { std::cout << s; }
+  void print(const std::string &s) { std::cout << s; }
+  void print(char c) { std::cout << c; }
+  template <typename T,
+            typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+  void print(T v, int base = DEC) {
+    std::cout << String::toString(v, base);
+  }
+  void println() { std::cout << std::endl; }
+  template <typename T> void println(T v) {
+    print(v);
+    println();
+  }
+  template <typename T> void println(T v, int base) {
+    print(v, base);
+    println();
+  }
+};
+
+extern SimSerial Serial;
+
+/* as in the Renesas core the timers and the PWM are always available */
+#include "FspTimer.h"
+#include "pwm.h"
+
+#endif
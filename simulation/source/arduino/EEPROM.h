@@ -0,0 +1,46 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   EEPROM.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: EEPROM (data flash) of the simulated board
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+#include <cstddef>
+#include <cstdint>
+
+class EEPROMClass {
+public:
+  uint8_t read(int idx);
+  void write(int idx, uint8_t val);
+  void update(int idx, uint8_t val) { write(idx, val); }
+  uint16_t length();
+
+  template <typename T> T &get(int idx, T &t) {
+    uint8_t *p = (uint8_t *)&t;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      p[i] = read(idx + (int)i);
+    }
+    return t;
+  }
+
+  template <typename T> const T &put(int idx, const T &t) {
+    const uint8_t *p = (const uint8_t *)&t;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      write(idx + (int)i, p[i]);
+    }
+    return t;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
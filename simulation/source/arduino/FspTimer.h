@@ -0,0 +1,56 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   FspTimer.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Periodic timer of the Renesas core (only the periodic mode is
+                simulated)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_FSP_TIMER_H
+#define SIM_FSP_TIMER_H
+
+#include <cstdint>
+
+typedef enum {
+  TIMER_MODE_PERIODIC,
+  TIMER_MODE_ONE_SHOT,
+  TIMER_MODE_PWM
+} timer_mode_t;
+
+typedef enum { TIMER_EVENT_CYCLE_END } timer_event_t;
+
+typedef struct {
+  void const *p_context;
+  timer_event_t event;
+  uint32_t capture;
+} timer_callback_args_t;
+
+using GPTimerCbk_f = void (*)(timer_callback_args_t *);
+
+class FspTimer {
+public:
+  static int8_t get_available_timer(uint8_t &type, bool force = false);
+  bool begin(timer_mode_t mode, uint8_t type, uint8_t channel, float freq_hz,
+             float duty_perc, GPTimerCbk_f cbk = nullptr, void *ctx = nullptr);
+  bool setup_overflow_irq(uint8_t priority = 12, void (*isr)() = nullptr);
+  bool open();
+  bool start();
+  bool stop();
+  void end();
+
+private:
+  void schedule(uint64_t t);
+  GPTimerCbk_f callback = nullptr;
+  void *context = nullptr;
+  uint64_t period_ns = 0;
+  uint32_t generation = 0;
+  bool running = false;
+};
+
+#endif
@@ -0,0 +1,50 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SPI.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: SPI on top of the simulated devices of the board (the device
+                is selected by its chip select pin)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+class SPISettings {
+public:
+  SPISettings(uint32_t _clock, uint8_t _order, uint8_t _mode)
+      : clock(_clock), order(_order), mode(_mode) {}
+  uint32_t clock;
+  uint8_t order;
+  uint8_t mode;
+};
+
+class SPIClass {
+public:
+  void begin();
+  void end();
+  void beginTransaction(SPISettings settings);
+  void endTransaction();
+  uint8_t transfer(uint8_t data);
+  void transfer(void *buf, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,72 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   SimPins.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Pin numbers of the simulated boards (this replaces the
+                variants of Opta, Opta Digital and Opta Analog)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The numbers do not match the real variants, the same numbers
+                are used by every board                                       */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_PINS_H
+#define SIM_PINS_H
+
+#define SIM_PIN_NUM 64
+#define SIM_EEPROM_DIM 8192
+#define SIM_ADC_CHANNELS 32
+
+/* same values used by Arduino for INPUT, OUTPUT and INPUT_PULLUP */
+#define SIM_PIN_INPUT 0
+#define SIM_PIN_OUTPUT 1
+#define SIM_PIN_INPUT_PULLUP 2
+
+/* Opta Digital: outputs D0..D7, inputs are the analog pins
+   OPTA_DIGITAL_FIRST_ANALOG_IN (14) ... OPTA_DIGITAL_LAST_ANALOG_IN - 1 */
+#define D0 0
+#define D1 1
+#define D2 2
+#define D3 3
+#define D4 4
+#define D5 5
+#define D6 6
+#define D7 7
+#define SIM_FIRST_ANALOG_PIN 14
+#define SIM_LAST_ANALOG_PIN 29
+
+/* Opta Analog: status leds use pins OA_VARIANT_FIST_LED_POS (10) ... 17 */
+#define PWM_0 40
+#define PWM_1 41
+#define PWM_2 42
+#define PWM_3 43
+#define DIO_RESET_1 44
+#define DIO_RESET_2 45
+#define SPI_CS_1 46
+#define SPI_CS_2 47
+#define LDAC1 48
+#define LDAC2 49
+#define DIO_RTD_SWITCH_1 50
+#define DIO_RTD_SWITCH_2 51
+
+/* common to expansions */
+#define OPTA_LED_RED 52
+#define OPTA_LED_BLUE 53
+#define OPTA_LED_GREEN 54
+#define LED_RGB_ON LOW
+#define LED_RGB_OFF HIGH
+#define DETECT_IN 55
+#define DETECT_OUT 56
+
+/* Opta (Controller) */
+#define PG_8 57
+#define LED_RESET 58
+
+/* simulation only: pin of the Controller board connected to its DETECT net
+   used by the rack to pull it LOW (as a new expansion does) */
+#define SIM_DETECT_PLUG 59
+
+#endif
@@ -0,0 +1,46 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   Wire.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Wire (I2C) on top of the simulated bus (see SimI2cBus.h)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       There is only one Wire object: it uses the I2C port of the
+                board running in the calling thread                           */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class TwoWire {
+public:
+  /* master */
+  void begin();
+  /* slave */
+  void begin(uint8_t address);
+  void end();
+  void setClock(uint32_t freq);
+
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool stopBit = true);
+  size_t requestFrom(uint8_t address, size_t len, bool stopBit = true);
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t len);
+  int available();
+  int read();
+  int peek();
+
+  void onReceive(void (*cbk)(int));
+  void onRequest(void (*cbk)(void));
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,131 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   analog.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Subset of the Renesas core / FSP ADC API used by Opta Digital
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       A scan takes SIM_ADC_CHANNEL_CONVERSION_ns for each channel
+                of the scan mask, at the end of the scan the values are
+                copied from the board (Board::adc) and the callback is called
+                (continuous scan restarts until R_ADC_ScanStop)               */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_ANALOG_H
+#define SIM_ANALOG_H
+
+#include <array>
+#include <cstdint>
+
+#include "Arduino.h"
+
+#define SIM_ADC_CHANNEL_CONVERSION_ns 1000
+
+typedef int fsp_err_t;
+#define FSP_SUCCESS 0
+#define FSP_ERR_NOT_OPEN 1
+
+typedef void adc_ctrl_t;
+typedef int adc_channel_t;
+
+typedef enum {
+  ADC_EVENT_SCAN_COMPLETE,
+  ADC_EVENT_SCAN_COMPLETE_GROUP_B,
+  ADC_EVENT_CALIBRATION_COMPLETE
+} adc_event_t;
+
+typedef enum {
+  ADC_MODE_SINGLE_SCAN,
+  ADC_MODE_GROUP_SCAN,
+  ADC_MODE_CONTINUOUS_SCAN
+} adc_mode_t;
+
+typedef enum {
+  ADC_RESOLUTION_12_BIT,
+  ADC_RESOLUTION_10_BIT,
+  ADC_RESOLUTION_8_BIT,
+  ADC_RESOLUTION_14_BIT
+} adc_resolution_t;
+
+typedef enum {
+  ADC_VREF_CONTROL_AVCC0_AVSS0,
+  ADC_VREF_CONTROL_VREFH0_AVSS0
+} adc_vref_control_t;
+
+typedef struct {
+  uint16_t unit;
+  adc_event_t event;
+  void const *p_context;
+} adc_callback_args_t;
+
+typedef struct {
+  adc_vref_control_t adc_vref_control;
+} adc_extended_cfg_t;
+
+typedef struct {
+  uint16_t unit;
+  adc_mode_t mode;
+  adc_resolution_t resolution;
+  void (*p_callback)(adc_callback_args_t *);
+  void const *p_context;
+  void const *p_extend;
+  uint8_t scan_end_ipl;
+} adc_cfg_t;
+
+typedef struct {
+  uint32_t scan_mask;
+  uint32_t scan_mask_group_b;
+} adc_channel_cfg_t;
+
+typedef struct {
+  adc_cfg_t const *p_cfg;
+  uint32_t scan_mask;
+  bool opened;
+  bool scanning;
+  uint32_t generation;
+  uint16_t results[SIM_ADC_CHANNELS];
+} adc_instance_ctrl_t;
+
+using ADCCbk_f = void (*)(adc_callback_args_t *);
+
+class ADC_Container {
+public:
+  ADC_Container(uint8_t unit, ADCCbk_f cbk, void *ctx = nullptr);
+  bool is_initialized;
+  adc_instance_ctrl_t ctrl;
+  adc_extended_cfg_t cfg_extend;
+  adc_cfg_t cfg;
+  adc_channel_cfg_t channel_cfg;
+};
+
+fsp_err_t R_ADC_Open(adc_ctrl_t *const p_ctrl, adc_cfg_t const *const p_cfg);
+fsp_err_t R_ADC_ScanCfg(adc_ctrl_t *const p_ctrl,
+                        void const *const p_channel_cfg);
+fsp_err_t R_ADC_ScanStart(adc_ctrl_t *const p_ctrl);
+fsp_err_t R_ADC_ScanStop(adc_ctrl_t *const p_ctrl);
+fsp_err_t R_ADC_Read(adc_ctrl_t *const p_ctrl, adc_channel_t const reg_id,
+                     uint16_t *const p_data);
+fsp_err_t R_ADC_Close(adc_ctrl_t *const p_ctrl);
+
+class IRQManager {
+public:
+  static IRQManager &getInstance();
+  bool addADCScanEnd(ADC_Container *adc, void (*fnc)() = nullptr);
+};
+
+/* pin configuration: the analog pins SIM_FIRST_ANALOG_PIN ...
+   SIM_LAST_ANALOG_PIN are connected to the ADC channels listed in
+   SimArduino.cpp */
+typedef enum { PIN_CFG_REQ_ADC } PinCfgReq_t;
+#define SIM_PIN_CFG_ADC 0x100
+#define GET_CHANNEL(x) ((x) & 0xFF)
+#define IOPORT_CFG_ANALOG_ENABLE 0x8000
+
+std::array<uint16_t, 3> getPinCfgs(int pin, PinCfgReq_t req);
+int digitalPinToBspPin(int pin);
+void pinPeripheral(int bsp_pin, uint32_t cfg);
+
+#endif
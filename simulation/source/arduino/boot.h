@@ -0,0 +1,20 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   boot.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Jump to bootloader of the expansions
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The bootloader is not simulated: the board stops running and
+                does not answer on I2C anymore                                */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_BOOT_H
+#define SIM_BOOT_H
+
+void goBootloader();
+
+#endif
@@ -0,0 +1,29 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   kvstore_global_api.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240701
+   DESCRIPTION: Key value store of the mbed core (internal flash) of the
+                simulated board
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The data are kept in memory for the life of the board         */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_KVSTORE_GLOBAL_API_H
+#define SIM_KVSTORE_GLOBAL_API_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define MBED_SUCCESS 0
+#define MBED_ERROR_ITEM_NOT_FOUND (-311)
+
+int kv_set(const char *key, const void *buffer, size_t size, uint32_t flags);
+int kv_get(const char *key, void *buffer, size_t buffer_size,
+           size_t *actual_size);
+int kv_remove(const char *key);
+
+#endif
@@ -0,0 +1,113 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   mbed.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240620
+   DESCRIPTION: RTOS API of the mbed core (Opta Controller) used by the
+                library: threads, mutexes, condition variables and sleep
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Threads run on the simulation kernel (virtual time), thread
+                priorities are accepted but not simulated                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_MBED_H
+#define SIM_MBED_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+typedef enum {
+  osPriorityIdle = 1,
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40,
+  osPriorityRealtime = 48
+} osPriority;
+
+typedef int32_t osStatus;
+#define osOK 0
+#define osError -1
+#define osErrorResource -3
+
+#define OS_STACK_SIZE 4096
+
+typedef void *osThreadId_t;
+/* priority of a thread started with rtos::Thread (osPriorityNormal for the
+ * main thread of the board) */
+osPriority osThreadGetPriority(osThreadId_t id);
+
+namespace sim {
+class Board;
+}
+
+namespace mbed {
+
+template <typename F> using Callback = std::function<F>;
+
+template <typename T, typename M> Callback<void()> callback(T *obj, M method) {
+  return [obj, method]() { (obj->*method)(); };
+}
+
+} // namespace mbed
+
+namespace rtos {
+
+class Thread {
+public:
+  Thread(osPriority priority = osPriorityNormal,
+         uint32_t stack_size = OS_STACK_SIZE, unsigned char *stack_mem = nullptr,
+         const char *name = nullptr);
+  ~Thread();
+  osStatus start(mbed::Callback<void()> task);
+  osStatus join();
+  osPriority get_priority() const { return priority; }
+
+private:
+  osPriority priority;
+  const char *name;
+  sim::Board *th = nullptr;
+};
+
+/* recursive as the mbed one */
+class Mutex {
+public:
+  void lock();
+  bool trylock();
+  void unlock();
+
+private:
+  friend class ConditionVariable;
+  sim::Board *owner = nullptr;
+  int count = 0;
+  std::vector<sim::Board *> waiters;
+};
+
+/* the mutex must be locked (once) by the thread calling wait() */
+class ConditionVariable {
+public:
+  ConditionVariable(Mutex &m) : mtx(m) {}
+  void wait();
+  void notify_one();
+  void notify_all();
+
+private:
+  Mutex &mtx;
+  std::vector<sim::Board *> waiters;
+};
+
+namespace ThisThread {
+void sleep_for(std::chrono::duration<uint32_t, std::milli> rel_time);
+void yield();
+osThreadId_t get_id();
+} // namespace ThisThread
+
+} // namespace rtos
+
+#endif
@@ -0,0 +1,34 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   pwm.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: PwmOut of the Renesas core: the period and the pulse set by
+                the firmware are stored into the board (PwmState)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_PWM_H
+#define SIM_PWM_H
+
+#include <cstdint>
+
+class PwmOut {
+public:
+  PwmOut(int pinNumber) : pin(pinNumber) {}
+  bool begin();
+  void end();
+  bool period_us(uint32_t us);
+  bool pulseWidth_us(uint32_t us);
+  void suspend();
+  void resume();
+
+private:
+  int pin;
+};
+
+#endif
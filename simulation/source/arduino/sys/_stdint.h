@@ -0,0 +1,19 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   _stdint.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Replaces the newlib header included by the library
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef SIM_SYS_STDINT_H
+#define SIM_SYS_STDINT_H
+
+#include <stdint.h>
+
+#endif
@@ -0,0 +1,487 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   bench.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240618
+   DESCRIPTION: Throughput / latency benchmark of the expansion protocol on
+                the simulated rack
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Every operation of ExpansionOperations.h supported by the
+                expansions in the rack is executed n times through the
+                public API of the library, then a full rack scan (all inputs
+                read, outputs flushed) is executed n times.
+                For each of them the benchmark reports (simulated time):
+                - operations per second (back to back)
+                - p50 / p99 latency of a single operation
+                - bytes on the wire and I2C transfers per operation
+                - communication errors (timeouts, CRC, protocol)
+                The exit code is not 0 if any error happens, if the rack is
+                not discovered correctly or if a regression is found against
+                a baseline (-B option)                                        */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+#include "SimRack.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <unistd.h>
+
+using namespace sim;
+
+#define BENCH_DEFAULT_ITERATIONS 100
+#define BENCH_DEFAULT_RACK "da"
+/* p99 can grow of this percentage before being a regression */
+#define BENCH_DEFAULT_TOLERANCE 10
+/* flash area used for the WRITE_FLASH / READ_FLASH operations (outside the
+   production data) */
+#define BENCH_FLASH_ADDRESS 0x0100
+#define BENCH_FLASH_DIM 16
+
+class Result {
+public:
+  std::string exp;
+  std::string op;
+  int n = 0;
+  double ops_per_s = 0;
+  double p50_us = 0;
+  double p99_us = 0;
+  double bytes_per_op = 0;
+  double transfers_per_op = 0;
+  uint32_t errors = 0;
+};
+
+static std::vector<Result> results;
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static uint32_t comm_errors() {
+  uint32_t rv = 0;
+  for (int i = 0; i < OptaController.getExpansionNum(); i++) {
+    const ExpansionMetrics *m = OptaController.getMetrics(i);
+    if (m != nullptr) {
+      rv += m->total.timeouts + m->total.crc_errors +
+            m->total.protocol_errors;
+    }
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static double percentile(std::vector<uint64_t> &v, int p) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  return (double)v[(v.size() - 1) * p / 100] / 1000.0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* execute op n times (it receives the iteration number) */
+static void measure(const std::string &exp, const std::string &op, int n,
+                    std::function<void(int)> fnc) {
+  I2cBus &bus = I2cBus::get();
+  Kernel &k = Kernel::get();
+  std::vector<uint64_t> lat;
+  lat.reserve(n);
+
+  bus.resetCounters();
+  uint32_t err = comm_errors();
+  uint64_t start = k.now();
+  for (int i = 0; i < n; i++) {
+    uint64_t t = k.now();
+    fnc(i);
+    lat.push_back(k.now() - t);
+  }
+  uint64_t total = k.now() - start;
+
+  Result r;
+  r.exp = exp;
+  r.op = op;
+  r.n = n;
+  r.ops_per_s = (total > 0) ? (double)n * 1e9 / (double)total : 0;
+  r.p50_us = percentile(lat, 50);
+  r.p99_us = percentile(lat, 99);
+  r.bytes_per_op = (double)bus.bytes / n;
+  r.transfers_per_op = (double)bus.transfers / n;
+  r.errors = comm_errors() - err;
+  results.push_back(r);
+
+  printf("%-4s %-26s %6d %10.1f %10.1f %10.1f %9.1f %7.2f %6u\n",
+         r.exp.c_str(), r.op.c_str(), r.n, r.ops_per_s, r.p50_us, r.p99_us,
+         r.bytes_per_op, r.transfers_per_op, r.errors);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* operations supported by all the expansions */
+static void bench_common(const std::string &name, int device, int n) {
+  Expansion *e = OptaController.getExpansionPtr(device);
+  /* the message itself: getFwVersion() uses the version cached by IDENTIFY */
+  measure(name, "GET_VERSION", n, [&](int) { e->execute(GET_VERSION); });
+  measure(name, "GET_COMMIT_READY", n,
+          [&](int) { e->execute(GET_COMMIT_READY); });
+  /* the base class gives access to the generic flash messages */
+  Expansion flash(e->getIndex(), e->getType(), e->getI2CAddress(),
+                  &OptaController);
+  measure(name, "WRITE_FLASH", n, [&](int i) {
+    flash.write(ADD_FLASH_ADDRESS, (unsigned int)BENCH_FLASH_ADDRESS);
+    flash.write(ADD_FLASH_DIM, (unsigned int)BENCH_FLASH_DIM);
+    for (int j = 0; j < BENCH_FLASH_DIM; j++) {
+      flash.write(ADD_FLASH_0 + j, (unsigned int)((i + j) & 0xFF));
+    }
+    flash.execute(WRITE_FLASH);
+  });
+  measure(name, "READ_FLASH", n, [&](int) {
+    flash.write(ADD_FLASH_ADDRESS, (unsigned int)BENCH_FLASH_ADDRESS);
+    flash.write(ADD_FLASH_DIM, (unsigned int)BENCH_FLASH_DIM);
+    flash.execute(READ_FLASH);
+  });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void bench_digital(const std::string &name, int device, int n) {
+  DigitalExpansion d = OptaController.getExpansion(device);
+  bench_common(name, device, n);
+  measure(name, "SET_DIGITAL_OUTPUT", n, [&](int i) {
+    d.digitalWrite(i % OPTA_DIGITAL_OUT_NUM, (i & 1) ? LOW : HIGH, true);
+  });
+  measure(name, "GET_DIGITAL_INPUT", n,
+          [&](int) { d.updateDigitalInputs(); });
+  measure(name, "GET_SINGLE_ANALOG_INPUT", n,
+          [&](int i) { d.analogRead(i % OPTA_DIGITAL_IN_NUM, true); });
+  measure(name, "GET_ALL_ANALOG_INPUT", n,
+          [&](int) { d.updateAnalogInputs(); });
+  measure(name, "SET_DEFAULT_OUTPUT_VALUE", n, [&](int i) {
+    DigitalExpansion::setDefault(OptaController, device, i & 0xFF, 5000);
+  });
+  OptaController.latchInputs();
+  measure(name, "GET_LATCHED_INPUTS", n,
+          [&](int) { d.execute(GET_LATCHED_INPUTS); });
+  measure(name, "STAGE_DIGITAL_OUTPUT", n, [&](int i) {
+    d.digitalWrite(i % OPTA_DIGITAL_OUT_NUM, (i & 1) ? LOW : HIGH, false);
+    d.execute(STAGE_DIGITAL_OUTPUT);
+  });
+  /* the outputs staged above are applied */
+  OptaController.commitOutputs();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void bench_analog(const std::string &name, int device, int n) {
+  AnalogExpansion a = OptaController.getExpansion(device);
+  bench_common(name, device, n);
+
+  /* channel configuration (on the last channel) */
+  measure(name, "BEGIN_CHANNEL_AS_HIGH_IMP", n,
+          [&](int) { a.beginChannelAsHighImpedance(OA_CH_7); });
+  measure(name, "BEGIN_CHANNEL_AS_DI", n,
+          [&](int) { a.beginChannelAsDigitalInput(OA_CH_7); });
+  measure(name, "BEGIN_CHANNEL_AS_RTD", n,
+          [&](int) { a.beginChannelAsRtd(OA_CH_7, true, 1.2f); });
+  measure(name, "BEGIN_CHANNEL_AS_DAC", n,
+          [&](int) { a.beginChannelAsVoltageDac(OA_CH_7); });
+  measure(name, "BEGIN_CHANNEL_AS_ADC", n,
+          [&](int) { a.beginChannelAsVoltageAdc(OA_CH_7); });
+
+  /* one channel for each function for the remaining operations */
+  a.beginChannelAsVoltageAdc(OA_CH_0);
+  a.beginChannelAsVoltageDac(OA_CH_1);
+  a.beginChannelAsDigitalInput(OA_CH_2);
+  a.beginChannelAsRtd(OA_CH_3, true, 1.2f);
+
+  measure(name, "SEND_TIMING", n,
+          [&](int i) { a.beginRtdUpdateTime(1000 + (i & 0xFF)); });
+  measure(name, "GET_SINGLE_ANALOG_INPUT", n,
+          [&](int) { a.getAdc(OA_CH_0, true); });
+  measure(name, "GET_ALL_ANALOG_INPUT", n,
+          [&](int) { a.updateAnalogInputs(); });
+  measure(name, "GET_DIGITAL_INPUT", n,
+          [&](int) { a.updateDigitalInputs(); });
+  measure(name, "GET_RTD", n, [&](int) { a.getRtd(OA_CH_3); });
+  OptaController.latchInputs();
+  measure(name, "GET_LATCHED_INPUTS", n,
+          [&](int) { a.execute(GET_LATCHED_INPUTS); });
+  measure(name, "GET_CHANNEL_FUNCTION", n,
+          [&](int) { a.isChAdc(OA_CH_0, true); });
+  measure(name, "SET_SINGLE_ANALOG_OUTPUT", n,
+          [&](int i) { a.setDac(OA_CH_1, 1000 + (i & 0x3FF), true); });
+  measure(name, "SET_ALL_ANALOG_OUTPUTS", n, [&](int i) {
+    a.setDac(OA_CH_1, 2000 + (i & 0x3FF), false);
+    a.execute(SET_ALL_ANALOG_OUTPUTS);
+  });
+  measure(name, "SET_PWM", n, [&](int i) {
+    a.setPwm(OA_PWM_CH_0, 10000, 1000 + (i & 0xFF));
+  });
+  /* all the pulses change: one channel only would be sent with SET_PWM */
+  measure(name, "SET_ALL_PWM", n, [&](int i) {
+    uint32_t per[OA_PWM_CHANNELS_NUM] = {10000, 10000, 10000, 10000};
+    uint32_t pul[OA_PWM_CHANNELS_NUM];
+    for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+      pul[ch] = (uint32_t)(1000 * (ch + 1) + (i & 0xFF));
+    }
+    a.setAllPwm(per, pul);
+  });
+  measure(name, "SET_LED", n, [&](int i) {
+    if (i & 1) {
+      a.switchLedOff(0, true);
+    } else {
+      a.switchLedOn(0, true);
+    }
+  });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* scan cycle of a PLC: all the inputs read, outputs changed are written */
+static void bench_scan(int n) {
+  int num = OptaController.getExpansionNum();
+  std::vector<std::unique_ptr<DigitalExpansion>> dig;
+  std::vector<std::unique_ptr<AnalogExpansion>> ana;
+  for (int i = 0; i < num; i++) {
+    if (OptaController.getExpansionType(i) == EXPANSION_OPTA_ANALOG) {
+      ana.emplace_back(new AnalogExpansion(OptaController.getExpansion(i)));
+    } else {
+      dig.emplace_back(new DigitalExpansion(OptaController.getExpansion(i)));
+    }
+  }
+  measure("*", "latchInputs()", n,
+          [&](int) { OptaController.latchInputs(); });
+  /* the DAC values staged wait for the main loop of Opta Analog (polled
+     with GET_COMMIT_READY) before the burst of COMMIT OUTPUTS */
+  measure("*", "commitOutputs()", n, [&](int i) {
+    for (auto &d : dig) {
+      d->digitalWrite(0, (i & 1) ? LOW : HIGH, false);
+    }
+    for (auto &a : ana) {
+      a->setDac(OA_CH_1, 3000 + (i & 0x3FF), false);
+    }
+    OptaController.commitOutputs();
+  });
+  measure("*", "SCAN (inputs + flush)", n, [&](int i) {
+    for (auto &d : dig) {
+      d->updateDigitalInputs();
+      d->updateAnalogInputs();
+      d->digitalWrite(0, (i & 1) ? LOW : HIGH, false);
+    }
+    for (auto &a : ana) {
+      a->updateAnalogInputs();
+      a->updateDigitalInputs();
+      a->setDac(OA_CH_1, 3000 + (i & 0x3FF), false);
+    }
+    OptaController.flushOutputs();
+  });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static bool write_csv(const char *file) {
+  std::ofstream f(file);
+  if (!f) {
+    return false;
+  }
+  f << "expansion,operation,n,ops_per_s,p50_us,p99_us,bytes_per_op,"
+       "transfers_per_op,errors\n";
+  for (auto &r : results) {
+    f << r.exp << "," << r.op << "," << r.n << "," << r.ops_per_s << ","
+      << r.p50_us << "," << r.p99_us << "," << r.bytes_per_op << ","
+      << r.transfers_per_op << "," << r.errors << "\n";
+  }
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* regression: more bytes on the wire or p99 latency above tolerance */
+static int check_baseline(const char *file, int tolerance) {
+  std::ifstream f(file);
+  if (!f) {
+    printf("Unable to open baseline %s\n", file);
+    return 1;
+  }
+  std::map<std::string, Result> base;
+  std::string line;
+  std::getline(f, line);
+  while (std::getline(f, line)) {
+    std::stringstream ss(line);
+    std::string field;
+    std::vector<std::string> v;
+    while (std::getline(ss, field, ',')) {
+      v.push_back(field);
+    }
+    if (v.size() < 9) {
+      continue;
+    }
+    Result r;
+    r.p99_us = atof(v[5].c_str());
+    r.bytes_per_op = atof(v[6].c_str());
+    base[v[0] + "," + v[1]] = r;
+  }
+
+  int regressions = 0;
+  for (auto &r : results) {
+    auto it = base.find(r.exp + "," + r.op);
+    if (it == base.end()) {
+      continue;
+    }
+    if (r.bytes_per_op > it->second.bytes_per_op + 0.01) {
+      printf("REGRESSION %s %s: %.1f bytes/op (baseline %.1f)\n",
+             r.exp.c_str(), r.op.c_str(), r.bytes_per_op,
+             it->second.bytes_per_op);
+      regressions++;
+    }
+    if (r.p99_us > it->second.p99_us * (100 + tolerance) / 100.0) {
+      printf("REGRESSION %s %s: p99 %.1f us (baseline %.1f)\n",
+             r.exp.c_str(), r.op.c_str(), r.p99_us, it->second.p99_us);
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void usage(const char *name) {
+  printf("Usage: %s [options]\n", name);
+  printf("  -r <rack>   expansions from the closest to the Controller:\n");
+  printf("              d digital mechanical, s digital solid state, "
+         "a analog (default %s)\n",
+         BENCH_DEFAULT_RACK);
+  printf("  -n <num>    iterations of each operation (default %d)\n",
+         BENCH_DEFAULT_ITERATIONS);
+  printf("  -b <ns>     I2C bit time in ns (default: clock set by the "
+         "Controller)\n");
+  printf("  -p <us>     time spent by the expansions to handle an I2C "
+         "interrupt\n");
+  printf("  -c <file>   write the results in a csv file\n");
+  printf("  -B <file>   compare with a baseline csv file\n");
+  printf("  -t <perc>   p99 tolerance against the baseline (default %d%%)\n",
+         BENCH_DEFAULT_TOLERANCE);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int main(int argc, char *argv[]) {
+  std::string rack_cfg = BENCH_DEFAULT_RACK;
+  int n = BENCH_DEFAULT_ITERATIONS;
+  long bit_ns = 0;
+  long proc_us = -1;
+  const char *csv = nullptr;
+  const char *baseline = nullptr;
+  int tolerance = BENCH_DEFAULT_TOLERANCE;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:n:b:p:c:B:t:h")) != -1) {
+    switch (opt) {
+    case 'r':
+      rack_cfg = optarg;
+      break;
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 'b':
+      bit_ns = atol(optarg);
+      break;
+    case 'p':
+      proc_us = atol(optarg);
+      break;
+    case 'c':
+      csv = optarg;
+      break;
+    case 'B':
+      baseline = optarg;
+      break;
+    case 't':
+      tolerance = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return (opt == 'h') ? 0 : 1;
+    }
+  }
+  if (n <= 0 || rack_cfg.empty() ||
+      rack_cfg.size() > OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Rack rack;
+  for (char c : rack_cfg) {
+    if (c == 'd') {
+      rack.addDigital();
+    } else if (c == 's') {
+      rack.addDigital(true);
+    } else if (c == 'a') {
+      rack.addAnalog();
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (bit_ns > 0) {
+    I2cBus::get().bit_ns_override = bit_ns;
+  }
+  if (proc_us >= 0) {
+    for (int i = 0; i < rack.expansionsNum(); i++) {
+      rack.expansion(i)->i2c_processing_ns = proc_us * 1000;
+    }
+  }
+  rack.start();
+
+  uint64_t t = Kernel::get().now();
+  OptaController.begin();
+  printf("Rack \"%s\": discovery %.1f ms, I2C bit time %lu ns, expansion "
+         "processing %lu us\n\n",
+         rack_cfg.c_str(), (Kernel::get().now() - t) / 1e6,
+         (unsigned long)I2cBus::get().bitTime(),
+         (unsigned long)(rack.expansion(0)->i2c_processing_ns / 1000));
+
+  int failures = 0;
+  if (OptaController.getExpansionNum() != rack.expansionsNum()) {
+    printf("FAIL: %d expansions found, %d expected\n",
+           OptaController.getExpansionNum(), rack.expansionsNum());
+    rack.stop();
+    return 1;
+  }
+
+  printf("%-4s %-26s %6s %10s %10s %10s %9s %7s %6s\n", "exp", "operation",
+         "n", "ops/s", "p50[us]", "p99[us]", "bytes/op", "i2c/op", "errors");
+  OptaController.resetMetrics();
+  for (int i = 0; i < OptaController.getExpansionNum(); i++) {
+    std::string name = std::to_string(i);
+    if (OptaController.getExpansionType(i) == EXPANSION_OPTA_ANALOG) {
+      bench_analog(name + "A", i, n);
+    } else {
+      bench_digital(name + "D", i, n);
+    }
+  }
+  bench_scan(n);
+
+  for (auto &r : results) {
+    if (r.errors > 0) {
+      failures++;
+    }
+  }
+  if (csv != nullptr && !write_csv(csv)) {
+    printf("Unable to write %s\n", csv);
+    failures++;
+  }
+  if (baseline != nullptr) {
+    failures += check_baseline(baseline, tolerance);
+  }
+  printf("\n%s\n", (failures == 0) ? "PASS" : "FAIL");
+  rack.stop();
+  return (failures == 0) ? 0 : 1;
+}
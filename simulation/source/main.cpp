@@ -0,0 +1,816 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   main.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240617
+   DESCRIPTION: Simulated rack (Controller + Opta Digital + Opta Analog):
+                discovers the expansions and exercises some I/O (also from
+                more RTOS threads)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Exit code is 0 if all the checks pass                        */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+#include "SimRack.h"
+#include <cstdio>
+
+using namespace sim;
+
+static int errors = 0;
+
+static void check(bool cond, const char *what) {
+  printf("[%s] %s\n", cond ? " OK " : "FAIL", what);
+  if (!cond) {
+    errors++;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int main(int argc, char *argv[]) {
+  (void)argc;
+  (void)argv;
+  Rack rack;
+  int dig = rack.addDigital();
+  int ana = rack.addAnalog();
+  rack.start();
+
+  OptaController.begin();
+  printf("Expansions found after %lu ms of simulated time\n", millis());
+
+  check(OptaController.getExpansionNum() == 2, "2 expansions discovered");
+  /* the address assignment polls the expansions instead of waiting fixed
+     delays: the reset of the expansions (1 s) dominates */
+  check(millis() < OPTA_CONTROLLER_SETUP_INIT_DELAY, "discovery time");
+  check(OptaController.getExpansionType(dig) == EXPANSION_OPTA_DIGITAL_MEC,
+        "expansion 0 is a Digital Mechanical");
+  check(OptaController.getExpansionType(ana) == EXPANSION_OPTA_ANALOG,
+        "expansion 1 is an Analog");
+
+  for (int i = 0; i < OptaController.getExpansionNum(); i++) {
+    uint8_t M = 0, m = 0, r = 0;
+    bool ok = OptaController.getFwVersion(i, M, m, r);
+    printf("Expansion %d address 0x%02X FW %d.%d.%d\n", i,
+           OptaController.getExpansionI2Caddress(i), M, m, r);
+    check(ok, "FW version read");
+  }
+
+  /* IDENTIFY during the discovery: the FW version is cached */
+  const ExpansionInfo *di = OptaController.getInfo(dig);
+  const ExpansionInfo *ai = OptaController.getInfo(ana);
+  check(di != nullptr && ai != nullptr, "identify: expansions identified");
+  check(di != nullptr && std::string(di->product) == OPTA_DIGITAL_MECH_DESCRIPTION &&
+            di->protocol == OPTA_BLUE_PROTOCOL_VERSION,
+        "identify: product and protocol version");
+  check(di != nullptr && di->hasCapability(OPTA_CAPABILITY_GET_OUTPUTS) &&
+            ai != nullptr && !ai->hasCapability(OPTA_CAPABILITY_GET_OUTPUTS),
+        "identify: capabilities");
+  uint32_t id_tr = OptaController.getMetrics(dig)->total.transactions;
+  uint8_t id_M = 0, id_m = 0, id_r = 0;
+  OptaController.getFwVersion(dig, id_M, id_m, id_r);
+  Expansion *id_exp = OptaController.getExpansionPtr(dig);
+  id_exp->getFwVersion(id_M, id_m, id_r);
+  check(OptaController.getMetrics(dig)->total.transactions == id_tr,
+        "identify: FW version without I2C transactions");
+  uint32_t ana_hash = (ai != nullptr) ? ai->cfg_hash : 0;
+
+  /* Opta Digital: inputs and outputs */
+  DigitalExpansion d = OptaController.getExpansion(dig);
+  check((bool)d, "Digital expansion object");
+  rack.setDigitalInput(dig, 3, 0x3FFF);
+  delay(10);
+  check(d.digitalRead(3, true) == HIGH, "digital input 3 HIGH");
+  check(d.digitalRead(4, false) == LOW, "digital input 4 LOW");
+  d.digitalWrite(2, HIGH, true);
+  delay(10);
+  check(rack.getDigitalOutput(dig, 2), "digital output 2 set");
+  check(!rack.getDigitalOutput(dig, 1), "digital output 1 not set");
+
+  /* Opta Analog: DAC and ADC */
+  AnalogExpansion a = OptaController.getExpansion(ana);
+  check((bool)a, "Analog expansion object");
+  a.beginChannelAsVoltageDac(0);
+  a.beginChannelAsVoltageAdc(2);
+  delay(500);
+  a.setDac(0, 4000);
+  delay(500);
+  check(rack.getAnalogDac(ana, 0) == 4000, "DAC channel 0 set to 4000");
+  rack.setAnalogAdc(ana, 2, 12345);
+  delay(500);
+  check(a.getAdc(2, true) == 12345, "ADC channel 2 reads 12345");
+  check(OptaController.identifyExpansion(ana) &&
+            OptaController.getInfo(ana)->cfg_hash != ana_hash,
+        "identify: configuration hash changed");
+
+  /* background I/O thread: from now on only the process image is used */
+  ProcessImage &pi = OptaController.getProcessImage();
+  check(pi.begin(10), "I/O thread started (10 ms scan cycle)");
+  rack.setDigitalInput(dig, 5, 0x3FFF);
+  rack.setAnalogAdc(ana, 2, 23456);
+  pi.digitalWrite(dig, 6, HIGH);
+  pi.setDac(ana, 0, 2000);
+  delay(500);
+  check(pi.digitalRead(dig, 5) == HIGH, "process image: digital input 5 HIGH");
+  check(pi.analogRead(ana, 2) == 23456, "process image: ADC channel 2 23456");
+  check(rack.getDigitalOutput(dig, 6), "process image: digital output 6 set");
+  check(rack.getAnalogDac(ana, 0) == 2000, "process image: DAC channel 0 2000");
+  InputImage img;
+  check(pi.getInputs(dig, img) && img.valid, "process image: inputs valid");
+  check(pi.getCycles() >= 45, "process image: scan cycles executed");
+  pi.end();
+  check(!pi.isRunning(), "I/O thread stopped");
+  printf("Scan cycles %u overruns %u max cycle %u us\n", pi.getCycles(),
+         pi.getOverruns(), pi.getMaxCycleUs());
+
+  /* Controller used at the same time by a fast control thread (Opta
+     Digital) and a slow diagnostics thread (Opta Analog) */
+  static int control_err = 0;
+  static int diag_err = 0;
+  rtos::Thread control(osPriorityHigh, OS_STACK_SIZE, nullptr, "control");
+  rtos::Thread diag(osPriorityLow, OS_STACK_SIZE, nullptr, "diag");
+  OptaController.getBusArbiter().resetStats();
+  control.start([&d]() {
+    for (int i = 0; i < 200; i++) {
+      d.digitalWrite(i % OPTA_DIGITAL_OUT_NUM, (i & 1) ? HIGH : LOW, true);
+      if (d.digitalRead(5, true) != HIGH || d.digitalRead(4, false) != LOW) {
+        control_err++;
+      }
+      rtos::ThisThread::sleep_for(std::chrono::milliseconds(2));
+    }
+  });
+  diag.start([&a]() {
+    for (int i = 0; i < 50; i++) {
+      uint8_t M = 0, m = 0, r = 0;
+      if (!a.getFwVersion(M, m, r) || a.getAdc(2, true) != 23456) {
+        diag_err++;
+      }
+      rtos::ThisThread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+  control.join();
+  diag.join();
+  check(control_err == 0, "threads: control thread I/O consistent");
+  check(diag_err == 0, "threads: diagnostics thread reads consistent");
+  check(rack.getDigitalOutput(dig, 7) && !rack.getDigitalOutput(dig, 6),
+        "threads: last outputs written by the control thread");
+  printf("Bus contentions %u max wait %u us\n",
+         OptaController.getBusArbiter().getContentions(),
+         OptaController.getBusArbiter().getMaxWaitUs());
+  check(OptaController.getBusArbiter().getContentions() > 0,
+        "threads: bus shared by the two threads");
+
+  /* scheduler: a high priority thread reading the flash (bulk class, budget
+     of 5 frames every 100 ms) does not delay the DAC set points written by
+     a low priority thread */
+  BusArbiter &arb = OptaController.getBusArbiter();
+  arb.resetStats();
+  arb.setBudget(OPTA_BUS_CLASS_BULK, 5);
+  static volatile bool bulk_run = true;
+  rtos::Thread bulk(osPriorityHigh, OS_STACK_SIZE, nullptr, "bulk");
+  rtos::Thread outputs(osPriorityLow, OS_STACK_SIZE, nullptr, "outputs");
+  unsigned long sched_start = millis();
+  bulk.start([&d]() {
+    while (bulk_run) {
+      uint8_t buf[32];
+      uint8_t len = sizeof(buf);
+      uint16_t add = 0;
+      d.getFlashData(buf, len, add);
+    }
+  });
+  outputs.start([&a]() {
+    for (int i = 0; i < 100; i++) {
+      a.setDac(0, 1000 + i);
+      rtos::ThisThread::sleep_for(std::chrono::milliseconds(3));
+    }
+  });
+  outputs.join();
+  bulk_run = false;
+  bulk.join();
+  unsigned long sched_ms = millis() - sched_start;
+  /* the Analog firmware applies the DAC values in its loop */
+  delay(500);
+  const BusClassStats *out_st = arb.getClassStats(OPTA_BUS_CLASS_OUTPUTS);
+  const BusClassStats *bulk_st = arb.getClassStats(OPTA_BUS_CLASS_BULK);
+  printf("Outputs: %u frames max wait %u us, bulk: %u frames throttled %u "
+         "in %lu ms\n", out_st->frames, out_st->max_wait_us, bulk_st->frames,
+         bulk_st->throttled, sched_ms);
+  check(rack.getAnalogDac(ana, 0) == 1099, "scheduler: last DAC set point");
+  check(out_st->frames >= 100, "scheduler: output frames classified");
+  check(out_st->max_wait_us < 2000, "scheduler: outputs wait at most a frame");
+  check(bulk_st->throttled > 0, "scheduler: bulk class throttled");
+  /* budget periods are not aligned with the start of the test */
+  check(bulk_st->frames <= 5 * (sched_ms / OPTA_BUS_BUDGET_PERIOD_MS + 2),
+        "scheduler: bulk class within its budget");
+  arb.setBudget(OPTA_BUS_CLASS_BULK, 0);
+
+  /* polling groups executed by update(): digital inputs every 5 ms, analog
+     inputs every 50 ms */
+  static int ana_polls = 0;
+  PollScheduler &poll = OptaController.getPolling();
+  int fast = poll.addGroup(5);
+  int slow = poll.addGroup(50, [](int) { ana_polls++; });
+  check(fast >= 0 && slow >= 0, "polling: groups added");
+  check(poll.addItem(fast, dig, GET_DIGITAL_INPUT), "polling: digital item");
+  check(poll.addItem(slow, ana, GET_ALL_ANALOG_INPUT), "polling: analog item");
+  rack.setDigitalInput(dig, 7, 0x3FFF);
+  rack.setAnalogAdc(ana, 2, 3456);
+  unsigned long poll_start = millis();
+  while (millis() - poll_start < 1000) {
+    OptaController.update();
+    delay(1);
+  }
+  const PollGroup *fg = poll.getGroup(fast);
+  const PollGroup *sg = poll.getGroup(slow);
+  printf("Polling 5 ms: %u runs %u overruns max jitter %u us, 50 ms: %u runs "
+         "%u overruns max jitter %u us\n", fg->runs, fg->overruns,
+         fg->max_jitter_us, sg->runs, sg->overruns, sg->max_jitter_us);
+  check(fg->runs >= 190 && fg->runs <= 201, "polling: 5 ms group rate");
+  check(sg->runs >= 19 && sg->runs <= 21, "polling: 50 ms group rate");
+  check(ana_polls == (int)sg->runs, "polling: group callback");
+  check(fg->errors == 0 && sg->errors == 0, "polling: no errors");
+  check(fg->max_jitter_us < 5000, "polling: jitter below the period");
+  DigitalExpansion pd = OptaController.getExpansion(dig);
+  AnalogExpansion pa = OptaController.getExpansion(ana);
+  check(pd.digitalRead(7, false) == HIGH, "polling: digital input 7 read");
+  check(pa.getAdc(2, false) == 3456, "polling: ADC channel 2 read");
+  /* update() not called for 20 ms: 3 releases of the fast group missed */
+  poll.resetStats();
+  OptaController.update();
+  delay(22);
+  OptaController.update();
+  check(fg->overruns >= 3, "polling: overruns detected");
+  poll.removeGroup(fast);
+  poll.removeGroup(slow);
+  check(poll.getGroup(fast) == nullptr, "polling: group removed");
+
+  /* adaptive answer timeouts: a mute expansion is detected in a few ms */
+  const AnswerTimeout *at =
+      OptaController.getAnswerTimeout(dig, OPTA_BUS_CLASS_INPUTS);
+  check(at != nullptr && at->samples >= OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_SAMPLES,
+        "timeout: round trip times measured");
+  uint32_t to_us = at->getTimeoutUs();
+  printf("Digital inputs: rtt %u us dev %u us timeout %u us\n", at->mean_us,
+         at->dev_us, to_us);
+  check(to_us < OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT * 1000 / 5,
+        "timeout: adapted to the round trip time");
+  OptaController.setRetries(0);
+  rack.setMute(dig, true);
+  unsigned long to_start = micros();
+  unsigned int to_rv = d.execute(GET_DIGITAL_INPUT);
+  unsigned long to_elapsed = micros() - to_start;
+  printf("Mute expansion detected in %lu us\n", to_elapsed);
+  check(to_rv == EXECUTE_ERR_I2C_COMM, "timeout: mute expansion fails");
+  check(to_elapsed < to_us + 1000, "timeout: failure detected quickly");
+  check(at->getTimeoutUs() == 2 * to_us, "timeout: doubled after a failure");
+  rack.setMute(dig, false);
+  check(d.execute(GET_DIGITAL_INPUT) == EXECUTE_OK, "timeout: expansion back");
+  check(at->failures == 0, "timeout: back to the measured timeout");
+  OptaController.setAdaptiveTimeouts(false);
+  rack.setMute(dig, true);
+  to_start = micros();
+  d.execute(GET_DIGITAL_INPUT);
+  to_elapsed = micros() - to_start;
+  check(to_elapsed >= OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT * 1000,
+        "timeout: fixed timeout when disabled");
+  rack.setMute(dig, false);
+  OptaController.setAdaptiveTimeouts(true);
+  OptaController.setRetries(OPTA_CONTROLLER_RETRIES);
+
+  /* expansion health: a mute expansion goes offline, the other one is not
+     slowed down, the mute one is probed and comes back when it answers */
+  static int health_changes = 0;
+  OptaController.setHealthChangeCb([](int, int) { health_changes++; });
+  const ExpansionHealth *hd = OptaController.getHealth(dig);
+  for (int i = 0; i < OPTA_CONTROLLER_HEALTHY_AFTER; i++) {
+    d.execute(GET_DIGITAL_INPUT);
+  }
+  check(hd->state == OPTA_EXPANSION_HEALTHY, "health: digital healthy");
+  health_changes = 0;
+  static int comm_failures = 0;
+  OptaController.setFailedCommCb([](int, int) { comm_failures++; });
+  rack.setMute(dig, true);
+  for (int i = 0; i < OPTA_CONTROLLER_OFFLINE_AFTER; i++) {
+    d.execute(GET_DIGITAL_INPUT);
+  }
+  check(hd->state == OPTA_EXPANSION_OFFLINE, "health: mute expansion offline");
+  check(comm_failures == OPTA_CONTROLLER_OFFLINE_AFTER,
+        "health: one failure callback per message (not per retry)");
+  OptaController.setFailedCommCb(nullptr);
+  unsigned long h_start = micros();
+  for (int i = 0; i < 20; i++) {
+    d.execute(GET_DIGITAL_INPUT);
+    a.execute(GET_ALL_ANALOG_INPUT);
+  }
+  unsigned long h_elapsed = micros() - h_start;
+  const AnswerTimeout *at_ana =
+      OptaController.getAnswerTimeout(ana, OPTA_BUS_CLASS_INPUTS);
+  printf("20 scans with an offline expansion in %lu us (analog rtt %u us)\n",
+         h_elapsed, at_ana->mean_us);
+  check(hd->fast_fails >= 20, "health: offline expansion fails at once");
+  check(h_elapsed < 20 * 2 * at_ana->mean_us,
+        "health: offline expansion does not slow down the scan");
+  unsigned long h_probe = millis();
+  while (millis() - h_probe < 1000) {
+    OptaController.update();
+    delay(1);
+  }
+  printf("Probe interval after 1 s offline: %u ms\n", hd->probe_interval);
+  check(hd->state == OPTA_EXPANSION_OFFLINE && hd->probe_interval >= 400,
+        "health: probe backoff");
+  rack.setMute(dig, false);
+  h_probe = millis();
+  while (hd->state == OPTA_EXPANSION_OFFLINE &&
+         millis() - h_probe < 2 * OPTA_CONTROLLER_PROBE_MAX_MS) {
+    OptaController.update();
+    delay(1);
+  }
+  printf("Expansion back after %lu ms\n", millis() - h_probe);
+  check(hd->state == OPTA_EXPANSION_DEGRADED, "health: probe brings it back");
+  for (int i = 0; i < OPTA_CONTROLLER_HEALTHY_AFTER; i++) {
+    d.execute(GET_DIGITAL_INPUT);
+  }
+  check(hd->state == OPTA_EXPANSION_HEALTHY, "health: healthy again");
+  check(health_changes == 4, "health: state change callback");
+  check(hd->offline_count == 1, "health: offline counted");
+  OptaController.setHealthChangeCb(nullptr);
+
+  /* hot plug: update() does not block while DETECT is HIGH and starts the
+     address assignment as soon as DETECT has been LOW for the debounce time
+     (held LOW for 100 ms, as by an expansion just plugged in) */
+  unsigned long hp_max_us = 0;
+  unsigned long hp_start = millis();
+  while (millis() - hp_start < 200) {
+    unsigned long t = micros();
+    OptaController.update();
+    if (micros() - t > hp_max_us) {
+      hp_max_us = micros() - t;
+    }
+    delay(1);
+  }
+  check(hp_max_us < 1000, "hot plug: update() does not block");
+  Kernel::get().post(rack.controller(), Kernel::get().now() + 100000000ULL,
+                     [&rack]() { rack.holdDetect(false); });
+  rack.holdDetect(true);
+  hp_start = millis();
+  unsigned long hp_react = 0;
+  while (hp_react == 0 && millis() - hp_start < 2 * OPTA_CONTROLLER_UPDATE_RATE) {
+    unsigned long t = millis();
+    OptaController.update();
+    if (millis() - t > OPTA_CONTROLLER_SETUP_INIT_DELAY) {
+      hp_react = t - hp_start;
+    }
+    delay(1);
+  }
+  printf("Hot plug detected after %lu ms\n", hp_react);
+  check(hp_react > 0 && hp_react < 100, "hot plug: fast reaction");
+  check(OptaController.getExpansionNum() == 2, "hot plug: expansions found");
+  DigitalExpansion hd2 = OptaController.getExpansion(dig);
+  rack.setDigitalInput(dig, 1, 0x3FFF);
+  delay(10);
+  check(hd2.digitalRead(1, true) == HIGH, "hot plug: digital expansion works");
+
+  /* fast boot: restart of the Controller with the expansions still powered,
+     the saved topology is verified without address assignment */
+  const Topology &topo = OptaController.getTopology();
+  check(topo.num == 2 && topo.exp[dig].type == EXPANSION_OPTA_DIGITAL_MEC &&
+            topo.exp[ana].type == EXPANSION_OPTA_ANALOG,
+        "fast boot: topology saved");
+  unsigned long fb_start = millis();
+  OptaController.begin();
+  unsigned long fb_time = millis() - fb_start;
+  printf("Fast boot in %lu ms\n", fb_time);
+  check(OptaController.getExpansionNum() == 2, "fast boot: expansions found");
+  DigitalExpansion fd = OptaController.getExpansion(dig);
+  rack.setDigitalInput(dig, 5, 0x3FFF);
+  delay(10);
+  check(fd.digitalRead(5, true) == HIGH, "fast boot: digital expansion works");
+
+  /* a saved topology different from the expansions attached (here a wrong
+     type) falls back to the address assignment */
+  Topology wrong = topo;
+  wrong.exp[ana].type = EXPANSION_OPTA_DIGITAL_STS;
+  wrong.save();
+  fb_start = millis();
+  OptaController.begin();
+  unsigned long full_time = millis() - fb_start;
+  printf("Boot with a wrong topology in %lu ms\n", full_time);
+  /* both perform the start up of the expansions (e.g. configuration of the
+     analog channels), only the full boot resets the expansions */
+  check(fb_time + OPTA_CONTROLLER_RESET_SETTLE_TIME < full_time,
+        "fast boot: no address assignment");
+  check(OptaController.getExpansionNum() == 2 &&
+            OptaController.getTopology().exp[ana].type ==
+                EXPANSION_OPTA_ANALOG,
+        "fast boot: topology saved again");
+  AnalogExpansion fa = OptaController.getExpansion(ana);
+  check((bool)fa, "fast boot: analog expansion after mismatch");
+
+  /* warm restart: the outputs are not touched by begin() and they are read
+     back into the new expansion objects, so that writing another output
+     does not change them */
+  DigitalExpansion wd = OptaController.getExpansion(dig);
+  wd.digitalWrite(4, HIGH, true);
+  AnalogExpansion wa = OptaController.getExpansion(ana);
+  wa.beginChannelAsVoltageDac(0);
+  delay(500);
+  wa.setDac(0, 1200);
+  delay(500);
+  check(rack.getDigitalOutput(dig, 4), "warm restart: output 4 set");
+  unsigned long warm_start_ms = millis();
+  OptaController.begin();
+  warm_start_ms = millis() - warm_start_ms;
+  check(rack.getDigitalOutput(dig, 4), "warm restart: output 4 kept");
+  DigitalExpansion wd2 = OptaController.getExpansion(dig);
+  check(wd2.digitalOutRead(4) == HIGH, "warm restart: outputs read back");
+  AnalogExpansion wa2 = OptaController.getExpansion(ana);
+  check(rack.getAnalogDac(ana, 0) == 1200 && wa2.isChVoltageDac(0) &&
+            wa2.isChHighImpedance(1),
+        "warm restart: analog channels read back");
+  check(warm_start_ms < OPTA_CONTROLLER_DELAY_EXPANSION_RESET,
+        "warm restart: expansions not set up again");
+  wd2.digitalWrite(1, HIGH, true);
+  delay(10);
+  check(rack.getDigitalOutput(dig, 1) && rack.getDigitalOutput(dig, 4),
+        "warm restart: no glitch on the outputs");
+
+  /* features: agreed with each expansion at begin(), without a feature the
+     previous messages are used (here no read back of the outputs: the
+     expansions are set up again) */
+  check(OptaController.hasFeature(dig, OPTA_CAPABILITY_GET_OUTPUTS) &&
+            !OptaController.hasFeature(ana, OPTA_CAPABILITY_GET_OUTPUTS),
+        "features: read back of the outputs agreed");
+  OptaController.setFeatures(0);
+  OptaController.begin();
+  check(!OptaController.hasFeature(dig, OPTA_CAPABILITY_GET_OUTPUTS) &&
+            OptaController.getInfo(dig) != nullptr,
+        "features: not enabled by the Controller");
+  DigitalExpansion nd = OptaController.getExpansion(dig);
+  nd.digitalWrite(7, HIGH, true);
+  delay(10);
+  check(rack.getDigitalOutput(dig, 7), "features: fallback works");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES);
+  OptaController.begin();
+  check(OptaController.hasFeature(dig, OPTA_CAPABILITY_GET_OUTPUTS),
+        "features: agreed again");
+
+  /* bus clock: Fast-mode Plus when all the expansions enabled it and answer
+     at 1 MHz, back to Fast-mode on errors */
+  check(OptaController.getClock() == OPTA_I2C_FAST_PLUS_CLOCK &&
+            sim::I2cBus::get().bitTime() == 1000,
+        "clock: Fast-mode Plus");
+  unsigned long fp_start = micros();
+  OptaController.identifyExpansion(ana);
+  unsigned long fp_time = micros() - fp_start;
+  OptaController.setMaxClock(OPTA_I2C_FAST_CLOCK);
+  OptaController.begin();
+  fp_start = micros();
+  OptaController.identifyExpansion(ana);
+  unsigned long fm_time = micros() - fp_start;
+  printf("       IDENTIFY: %lu us at 1 MHz, %lu us at 400 kHz\n", fp_time,
+         fm_time);
+  check(OptaController.getClock() == OPTA_I2C_FAST_CLOCK && fp_time < fm_time,
+        "clock: limited by setMaxClock(), Fast-mode Plus is faster");
+  OptaController.setMaxClock(OPTA_CONTROLLER_MAX_CLOCK);
+  rack.setMaxClock(ana, OPTA_I2C_FAST_CLOCK);
+  uint32_t fallbacks = OptaController.getClockFallbacks();
+  OptaController.begin();
+  check(OptaController.getClock() == OPTA_I2C_FAST_CLOCK &&
+            OptaController.getClockFallbacks() == fallbacks + 1 &&
+            OptaController.getInfo(ana) != nullptr,
+        "clock: Fast-mode when an expansion does not answer at 1 MHz");
+  rack.setMaxClock(ana, 1000000);
+  OptaController.begin();
+  DigitalExpansion cd = OptaController.getExpansion(dig);
+  rack.setWiringMaxClock(OPTA_I2C_FAST_CLOCK);
+  for (int i = 0; i < 10 && OptaController.getClock() != OPTA_I2C_FAST_CLOCK;
+       i++) {
+    cd.digitalRead(0, true);
+  }
+  check(OptaController.getClock() == OPTA_I2C_FAST_CLOCK &&
+            OptaController.getClockFallbacks() == fallbacks + 2,
+        "clock: Fast-mode after bus errors");
+  rack.setDigitalInput(dig, 6, 0x3FFF);
+  delay(OPTA_CONTROLLER_PROBE_MIN_MS + 10);
+  bool cd_ok = false;
+  for (int i = 0; i < 5 && !cd_ok; i++) {
+    cd_ok = (cd.digitalRead(6, true) == HIGH);
+  }
+  check(cd_ok, "clock: expansion back in Fast-mode");
+  rack.setWiringMaxClock(1000000);
+  OptaController.begin();
+  check(OptaController.getClock() == OPTA_I2C_FAST_PLUS_CLOCK,
+        "clock: Fast-mode Plus again at begin()");
+
+  /* large frames and fragmented transfers: bulk flash access in a few
+     frames, expansions without them use the 32 bytes messages */
+  check(OptaController.getFrameDim(dig) == OPTA_I2C_LARGE_BUFFER_DIM &&
+            OptaController.hasFeature(dig, OPTA_CAPABILITY_TRANSFER),
+        "transfer: large frames agreed");
+  uint8_t blk[200], blk_rd[200];
+  for (int i = 0; i < 200; i++) {
+    blk[i] = (uint8_t)(i * 7 + 3);
+  }
+  DigitalExpansion bd = OptaController.getExpansion(dig);
+  uint32_t tr_start = OptaController.getMetrics(dig)->total.transactions;
+  bool blk_ok = bd.writeFlash(0x1000, blk, 200) == EXECUTE_OK &&
+                bd.readFlash(0x1000, blk_rd, 200) == EXECUTE_OK &&
+                memcmp(blk, blk_rd, 200) == 0;
+  uint32_t tr_large = OptaController.getMetrics(dig)->total.transactions -
+                      tr_start;
+  /* the flash is written by the main loop of the expansion: the result of
+     the write is asked once more */
+  check(blk_ok && tr_large <= 6, "transfer: 200 bytes written and read back");
+  uint8_t old_blk[MAX_FLASH_DATA];
+  uint8_t old_dim = MAX_FLASH_DATA;
+  uint16_t old_add = 0x1000 + 64;
+  bd.getFlashData(old_blk, old_dim, old_add);
+  check(memcmp(old_blk, blk + 64, MAX_FLASH_DATA) == 0,
+        "transfer: same data with the 32 bytes message");
+  check(OptaController.transfer(dig, ARG_GET_VERSION, nullptr, 0) ==
+            -TRANSFER_ERR_UNSUPPORTED,
+        "transfer: message not supported");
+  /* the id of the transfers is kept for each expansion: a transfer to
+     another expansion in between is not a repetition of the previous one */
+  AnalogExpansion ba = OptaController.getExpansion(ana);
+  uint8_t blk_a[16];
+  tr_start = OptaController.getMetrics(dig)->total.transactions;
+  blk_ok = bd.readFlash(0x1000, blk_rd, 16) == EXECUTE_OK;
+  uint32_t tr_first = OptaController.getMetrics(dig)->total.transactions -
+                      tr_start;
+  blk_ok = blk_ok && ba.readFlash(0x1000, blk_a, 16) == EXECUTE_OK;
+  tr_start = OptaController.getMetrics(dig)->total.transactions;
+  blk_ok = blk_ok && bd.readFlash(0x1000 + 16, blk_rd, 16) == EXECUTE_OK &&
+           memcmp(blk + 16, blk_rd, 16) == 0;
+  uint32_t tr_second = OptaController.getMetrics(dig)->total.transactions -
+                       tr_start;
+  check(OptaController.hasFeature(ana, OPTA_CAPABILITY_TRANSFER) && blk_ok &&
+            tr_second == tr_first,
+        "transfer: id kept for each expansion");
+  /* a corrupted fragment: the transfer is sent again with the same id, the
+     retry is not taken for the transfer completed before it */
+  blk_ok = bd.readFlash(0x1000, blk_rd, 16) == EXECUTE_OK;
+  /* all the attempts of send(): the whole transfer is sent again */
+  rack.corruptFrames(dig, OPTA_CONTROLLER_RETRIES + 1);
+  blk_ok = blk_ok && bd.readFlash(0x1000 + 16, blk_rd, 16) == EXECUTE_OK &&
+           memcmp(blk + 16, blk_rd, 16) == 0;
+  /* the first fragment of a write: the expansion answers a missing
+     fragment */
+  rack.corruptFrames(dig, 1);
+  blk_ok = blk_ok && bd.writeFlash(0x1000, blk, 200) == EXECUTE_OK &&
+           bd.readFlash(0x1000, blk_rd, 200) == EXECUTE_OK &&
+           memcmp(blk, blk_rd, 200) == 0;
+  check(blk_ok, "transfer: retry after a corrupted fragment");
+
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES &
+                             ~OPTA_CAPABILITY_LARGE_FRAMES);
+  OptaController.begin();
+  bd = OptaController.getExpansion(dig);
+  for (int i = 0; i < 200; i++) {
+    blk[i] = (uint8_t)(255 - i);
+  }
+  tr_start = OptaController.getMetrics(dig)->total.transactions;
+  blk_ok = bd.writeFlash(0x1000, blk, 200) == EXECUTE_OK &&
+           bd.readFlash(0x1000, blk_rd, 200) == EXECUTE_OK &&
+           memcmp(blk, blk_rd, 200) == 0;
+  uint32_t tr_frag = OptaController.getMetrics(dig)->total.transactions -
+                     tr_start;
+  check(OptaController.getFrameDim(dig) == OPTA_I2C_BUFFER_DIM && blk_ok,
+        "transfer: fragments of 48 bytes frames");
+
+  OptaController.setFeatures(OPTA_CAPABILITY_GET_OUTPUTS);
+  OptaController.begin();
+  bd = OptaController.getExpansion(dig);
+  for (int i = 0; i < 200; i++) {
+    blk[i] = (uint8_t)(i ^ 0x5A);
+  }
+  tr_start = OptaController.getMetrics(dig)->total.transactions;
+  blk_ok = bd.writeFlash(0x1003, blk, 200) == EXECUTE_OK &&
+           bd.readFlash(0x1003, blk_rd, 200) == EXECUTE_OK &&
+           memcmp(blk, blk_rd, 200) == 0;
+  uint32_t tr_msg = OptaController.getMetrics(dig)->total.transactions -
+                    tr_start;
+  printf("       200 bytes written and read: %u frames (large), %u "
+         "(fragments), %u (32 bytes messages)\n",
+         (unsigned)tr_large, (unsigned)tr_frag, (unsigned)tr_msg);
+  check(blk_ok && tr_large < tr_frag && tr_frag < tr_msg,
+        "transfer: fallback to the 32 bytes messages");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES);
+  OptaController.begin();
+
+  /* streaming flash access: a calibration table of 1000 bytes */
+  static uint8_t table[1000], table_rd[1000];
+  for (int i = 0; i < 1000; i++) {
+    table[i] = (uint8_t)((i * 31) ^ (i >> 3));
+  }
+  bd = OptaController.getExpansion(dig);
+  unsigned long st_start = millis();
+  bool st_ok = bd.writeFlash(0x1010, table, 1000) == EXECUTE_OK;
+  unsigned long st_wr = millis() - st_start;
+  st_start = micros();
+  tr_start = OptaController.getMetrics(dig)->total.transactions;
+  st_ok = st_ok && bd.readFlash(0x1010, table_rd, 1000) == EXECUTE_OK &&
+          memcmp(table, table_rd, 1000) == 0;
+  unsigned long st_rd = micros() - st_start;
+  uint32_t st_frames = OptaController.getMetrics(dig)->total.transactions -
+                       tr_start;
+  OptaController.setFeatures(OPTA_CAPABILITY_GET_OUTPUTS);
+  OptaController.begin();
+  bd = OptaController.getExpansion(dig);
+  memset(table_rd, 0, sizeof(table_rd));
+  st_start = micros();
+  tr_start = OptaController.getMetrics(dig)->total.transactions;
+  bool st_old = bd.readFlash(0x1010, table_rd, 1000) == EXECUTE_OK &&
+                memcmp(table, table_rd, 1000) == 0;
+  unsigned long st_rd_old = micros() - st_start;
+  uint32_t st_frames_old =
+      OptaController.getMetrics(dig)->total.transactions - tr_start;
+  printf("       1000 bytes: written in %lu ms, read in %lu us / %u frames "
+         "(32 bytes messages: %lu us / %u frames)\n",
+         st_wr, st_rd, (unsigned)st_frames, st_rd_old,
+         (unsigned)st_frames_old);
+  check(st_ok && st_old && st_frames * 2 < st_frames_old,
+        "streaming flash: 1000 bytes in blocks");
+  check(bd.readFlash(0xFF00, table_rd, 0x200) == EXECUTE_ERR_SINTAX,
+        "streaming flash: out of the address space");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES);
+  OptaController.begin();
+
+  /* synchronized inputs: LATCH INPUTS to all the expansions in one burst,
+     then the snapshots are collected (changes after the latch are seen only
+     at the next one) */
+  check(OptaController.hasFeature(dig, OPTA_CAPABILITY_LATCH) &&
+            OptaController.hasFeature(ana, OPTA_CAPABILITY_LATCH),
+        "latch: agreed with both expansions");
+  DigitalExpansion ld = OptaController.getExpansion(dig);
+  AnalogExpansion la = OptaController.getExpansion(ana);
+  la.beginChannelAsVoltageAdc(2);
+  rack.setDigitalInput(dig, 2, 0x3FFF);
+  rack.setAnalogAdc(ana, 2, 1111);
+  delay(500);
+  unsigned long l_start = micros();
+  OptaController.latchInputs();
+  unsigned long l_time = micros() - l_start;
+  rack.setDigitalInput(dig, 2, 0);
+  rack.setAnalogAdc(ana, 2, 2222);
+  delay(500);
+  bool l_ok = ld.execute(GET_LATCHED_INPUTS) == EXECUTE_OK &&
+              la.execute(GET_LATCHED_INPUTS) == EXECUTE_OK;
+  check(l_ok && ld.digitalRead(2, false) == HIGH && la.getAdc(2, false) == 1111,
+        "latch: inputs of the snapshot");
+  l_start = micros();
+  l_ok = ld.execute(GET_DIGITAL_INPUT) == EXECUTE_OK &&
+         ld.execute(GET_ALL_ANALOG_INPUT) == EXECUTE_OK &&
+         la.execute(GET_DIGITAL_INPUT) == EXECUTE_OK &&
+         la.execute(GET_ALL_ANALOG_INPUT) == EXECUTE_OK;
+  unsigned long seq_time = micros() - l_start;
+  check(l_ok && ld.digitalRead(2, false) == LOW && la.getAdc(2, false) == 2222,
+        "latch: inputs read without latch changed");
+  printf("       inputs sampled within %lu us (%lu us reading one expansion "
+         "after the other)\n",
+         l_time, seq_time);
+  check(l_time * 4 < seq_time, "latch: inputs sampled at the same time");
+  rack.setDigitalInput(dig, 2, 0x3FFF);
+  rack.setAnalogAdc(ana, 2, 3333);
+  delay(500);
+  check(OptaController.readInputs() &&
+            DigitalExpansion(OptaController.getExpansion(dig))
+                    .digitalRead(2, false) == HIGH &&
+            AnalogExpansion(OptaController.getExpansion(ana))
+                    .getAdc(2, false) == 3333,
+        "latch: readInputs()");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES & ~OPTA_CAPABILITY_LATCH);
+  OptaController.begin();
+  AnalogExpansion(OptaController.getExpansion(ana)).beginChannelAsVoltageAdc(2);
+  rack.setDigitalInput(dig, 2, 0);
+  rack.setAnalogAdc(ana, 2, 4444);
+  delay(500);
+  check(OptaController.readInputs() &&
+            DigitalExpansion(OptaController.getExpansion(dig))
+                    .digitalRead(2, false) == LOW &&
+            AnalogExpansion(OptaController.getExpansion(ana))
+                    .getAdc(2, false) == 4444,
+        "latch: readInputs() without LATCH INPUTS");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES);
+  OptaController.begin();
+
+  /* synchronized outputs: staged on all the expansions, then applied by one
+     burst of COMMIT OUTPUTS (DAC outputs through the LDAC pins) */
+  check(OptaController.hasFeature(dig, OPTA_CAPABILITY_COMMIT) &&
+            OptaController.hasFeature(ana, OPTA_CAPABILITY_COMMIT),
+        "commit: agreed with both expansions");
+  DigitalExpansion od = OptaController.getExpansion(dig);
+  AnalogExpansion oa = OptaController.getExpansion(ana);
+  oa.beginChannelAsVoltageDac(0);
+  delay(500);
+  od.digitalWrite(5, HIGH, false);
+  oa.setDac(0, 1500, false);
+  bool c_ok = OptaController.commitOutputs();
+  delay(500);
+  uint64_t c_dig = rack.getOutputChangeTime(dig);
+  uint64_t c_ana = rack.getOutputChangeTime(ana);
+  unsigned long c_skew =
+      (unsigned long)(((c_dig > c_ana) ? c_dig - c_ana : c_ana - c_dig) / 1000);
+  check(c_ok && rack.getDigitalOutput(dig, 5) &&
+            rack.getAnalogDac(ana, 0) == 1500,
+        "commit: outputs applied");
+  od.digitalWrite(5, LOW, false);
+  oa.setDac(0, 2500, false);
+  c_ok = OptaController.flushOutputs();
+  delay(500);
+  c_dig = rack.getOutputChangeTime(dig);
+  c_ana = rack.getOutputChangeTime(ana);
+  unsigned long seq_skew =
+      (unsigned long)(((c_dig > c_ana) ? c_dig - c_ana : c_ana - c_dig) / 1000);
+  check(c_ok && !rack.getDigitalOutput(dig, 5) &&
+            rack.getAnalogDac(ana, 0) == 2500,
+        "commit: outputs flushed");
+  printf("       outputs applied within %lu us (%lu us flushing one expansion "
+         "after the other)\n",
+         c_skew, seq_skew);
+  check(c_skew < 1000 && c_skew * 4 < seq_skew,
+        "commit: outputs applied at the same time");
+  /* staged values do not change the outputs until the commit */
+  od.digitalWrite(5, HIGH, false);
+  check(od.stageOutputs() == EXECUTE_OK, "commit: digital outputs staged");
+  delay(100);
+  check(!rack.getDigitalOutput(dig, 5), "commit: staged outputs not applied");
+  check(OptaController.commitOutputs(), "commit: nothing left to stage");
+  delay(100);
+  check(rack.getDigitalOutput(dig, 5), "commit: staged outputs applied");
+  /* a lost COMMIT OUTPUTS is reported: the outputs stay staged until the
+     next commit */
+  od.digitalWrite(5, LOW, false);
+  bool c_lost = od.stageOutputs() == EXECUTE_OK;
+  rack.setMute(dig, true);
+  c_lost = c_lost && !OptaController.applyStagedOutputs() &&
+           OptaController.isCommitFailed(dig) &&
+           !OptaController.isCommitFailed(ana);
+  rack.setMute(dig, false);
+  delay(100);
+  c_lost = c_lost && rack.getDigitalOutput(dig, 5);
+  c_lost = c_lost && OptaController.commitOutputs() &&
+           !OptaController.isCommitFailed(dig);
+  delay(100);
+  check(c_lost && !rack.getDigitalOutput(dig, 5),
+        "commit: lost COMMIT OUTPUTS reported");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES & ~OPTA_CAPABILITY_COMMIT);
+  OptaController.begin();
+  od = OptaController.getExpansion(dig);
+  oa = OptaController.getExpansion(ana);
+  oa.beginChannelAsVoltageDac(0);
+  delay(500);
+  od.digitalWrite(5, LOW, false);
+  oa.setDac(0, 3500, false);
+  c_ok = OptaController.commitOutputs();
+  delay(500);
+  check(c_ok && !rack.getDigitalOutput(dig, 5) &&
+            rack.getAnalogDac(ana, 0) == 3500,
+        "commit: outputs applied without COMMIT OUTPUTS");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES);
+  OptaController.begin();
+
+  /* time sync: the clocks of the expansions drift from the one of the
+     Controller, the latched inputs are timestamped with the Controller time
+     (the drift is corrected between two syncs) */
+  check(OptaController.hasFeature(dig, OPTA_CAPABILITY_TIME) &&
+            OptaController.hasFeature(ana, OPTA_CAPABILITY_TIME),
+        "time: agreed with both expansions");
+  rack.setClockDrift(dig, 500, 3700000);
+  rack.setClockDrift(ana, -300, 1200000);
+  for (int i = 0; i < 3; i++) {
+    OptaController.syncTime();
+    delay(1000);
+  }
+  OptaController.syncTime();
+  delay(5000);
+  DigitalExpansion td = OptaController.getExpansion(dig);
+  AnalogExpansion ta = OptaController.getExpansion(ana);
+  unsigned long t_latch = micros();
+  OptaController.latchInputs();
+  bool t_ok = td.execute(GET_LATCHED_INPUTS) == EXECUTE_OK &&
+              ta.execute(GET_LATCHED_INPUTS) == EXECUTE_OK;
+  long t_dig = (long)(int32_t)(td.getSampleTime() - (uint32_t)t_latch);
+  long t_ana = (long)(int32_t)(ta.getSampleTime() - (uint32_t)t_latch);
+  printf("       latch time error %ld us (digital), %ld us (analog), "
+         "%d us without drift correction\n",
+         t_dig, t_ana, 500 * 5);
+  check(t_ok && labs(t_dig) < 200 && labs(t_ana) < 200,
+        "time: inputs timestamped with the Controller time");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES & ~OPTA_CAPABILITY_TIME);
+  OptaController.begin();
+  t_latch = micros();
+  t_ok = OptaController.readInputs();
+  uint32_t t_read = DigitalExpansion(OptaController.getExpansion(dig))
+                        .getSampleTime();
+  check(t_ok && (uint32_t)(t_read - t_latch) <= (uint32_t)(micros() - t_latch),
+        "time: inputs without TIME timestamped when received");
+  OptaController.setFeatures(OPTA_CONTROLLER_FEATURES);
+  OptaController.begin();
+
+  printf("Simulated time %lu ms, %d errors\n", millis(), errors);
+  rack.stop();
+  return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,482 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   msgbench.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240619
+   DESCRIPTION: Micro benchmark of the Controller side message encoding and
+                decoding (CPU cost of a transaction, no I2C involved)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Covered functions:
+                - the helpers of OptaMsgCommon.cpp
+                - OptaCrc8::calc / verify
+                - every msg_* / parse_* pair of Expansion, DigitalExpansion
+                  and AnalogExpansion (the answers are prepared in the rx
+                  buffer of the Controller as the expansion would do)
+                For each function the benchmark reports ns per call and heap
+                allocations per call (wall clock time of the host, useful
+                to compare the results over time on the same machine).
+                The exit code is not 0 if a message can't be prepared or an
+                answer is not accepted                                        */
+/* -------------------------------------------------------------------------- */
+
+#include "OptaBlue.h"
+#include "OptaCrc.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace Opta;
+
+/* minimum time spent on each function */
+#define MSGBENCH_DEFAULT_TIME_MS 200
+#define MSGBENCH_FIRST_BATCH 64
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*  HEAP ALLOCATIONS COUNTER                                             */
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static uint64_t allocations = 0;
+
+void *operator new(std::size_t n) {
+  allocations++;
+  void *p = std::malloc(n ? n : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](std::size_t n) { return operator new(n); }
+
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept {
+  allocations++;
+  return std::malloc(n ? n : 1);
+}
+
+void *operator new[](std::size_t n, const std::nothrow_t &t) noexcept {
+  return operator new(n, t);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*  BENCHMARK                                                            */
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+class Result {
+public:
+  std::string name;
+  uint64_t n = 0;
+  double ns_per_op = 0;
+  double allocs_per_op = 0;
+};
+
+static std::vector<Result> results;
+static uint64_t min_time_ns = (uint64_t)MSGBENCH_DEFAULT_TIME_MS * 1000000;
+static std::string filter;
+static int failures = 0;
+/* return values are accumulated here so that calls can't be optimized out */
+static volatile uint32_t sink = 0;
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* fnc returns a value != 0 on success, the first call is used as sanity
+   check (and warm up: registers are created in the maps), then the batch
+   is doubled until the minimum time is reached */
+static void measure(const std::string &name, std::function<uint32_t()> fnc) {
+  if (!filter.empty() && name.find(filter) == std::string::npos) {
+    return;
+  }
+  if (fnc() == 0) {
+    printf("%-36s FAILED\n", name.c_str());
+    failures++;
+    return;
+  }
+
+  uint64_t n = MSGBENCH_FIRST_BATCH;
+  uint64_t elapsed = 0;
+  uint64_t allocs = 0;
+  while (true) {
+    uint32_t acc = 0;
+    uint64_t a = allocations;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < n; i++) {
+      acc += fnc();
+    }
+    elapsed = now_ns() - start;
+    allocs = allocations - a;
+    sink = sink + acc;
+    if (elapsed >= min_time_ns) {
+      break;
+    }
+    n *= 2;
+  }
+
+  Result r;
+  r.name = name;
+  r.n = n;
+  r.ns_per_op = (double)elapsed / (double)n;
+  r.allocs_per_op = (double)allocs / (double)n;
+  results.push_back(r);
+  printf("%-36s %12llu %10.1f %10.2f\n", r.name.c_str(),
+         (unsigned long long)r.n, r.ns_per_op, r.allocs_per_op);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* prepare in the rx buffer of the Controller the answer sent by the
+   expansion (payload is left as it is) */
+static void answer_get(uint8_t arg, uint8_t len) {
+  prepareGetAns(OptaController.getRxBuffer(), arg, len);
+}
+
+static void answer_set(uint8_t arg, uint8_t len) {
+  prepareSetAns(OptaController.getRxBuffer(), arg, len);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*  OptaMsgCommon and OptaCrc8                                           */
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void bench_common_helpers() {
+  uint8_t buf[OPTA_I2C_BUFFER_DIM];
+  for (int i = 0; i < OPTA_I2C_BUFFER_DIM; i++) {
+    buf[i] = (uint8_t)(i * 7 + 3);
+  }
+  /* longest and shortest frames of the protocol */
+  const uint8_t big = OPTA_I2C_BUFFER_DIM - BP_HEADER_DIM - 1;
+  const uint8_t small = 0;
+
+  measure("OptaCrc8::calc(header)", [&]() -> uint32_t {
+    return OptaCrc8::calc(buf, BP_HEADER_DIM, 0) + 1;
+  });
+  measure("OptaCrc8::calc(47 bytes)", [&]() -> uint32_t {
+    return OptaCrc8::calc(buf, OPTA_I2C_BUFFER_DIM - 1, 0) + 1;
+  });
+  measure("addCrc(47 bytes)", [&]() -> uint32_t {
+    return addCrc(buf, OPTA_I2C_BUFFER_DIM - 1);
+  });
+  measure("getExpectedAnsLen",
+          [&]() -> uint32_t { return getExpectedAnsLen(big); });
+
+  measure("prepareSetMsg(empty)",
+          [&]() -> uint32_t { return prepareSetMsg(buf, 1, small); });
+  measure("prepareSetMsg(full)",
+          [&]() -> uint32_t { return prepareSetMsg(buf, 1, big); });
+  measure("prepareGetMsg(empty)",
+          [&]() -> uint32_t { return prepareGetMsg(buf, 1, small); });
+  measure("prepareGetMsg(full)",
+          [&]() -> uint32_t { return prepareGetMsg(buf, 1, big); });
+  measure("prepareSetAns(empty)",
+          [&]() -> uint32_t { return prepareSetAns(buf, 1, small); });
+  measure("prepareGetAns(full)",
+          [&]() -> uint32_t { return prepareGetAns(buf, 1, big); });
+
+  prepareSetMsg(buf, 1, big);
+  measure("checkSetMsgReceived(full)",
+          [&]() -> uint32_t { return checkSetMsgReceived(buf, 1, big); });
+  prepareGetMsg(buf, 1, big);
+  measure("checkGetMsgReceived(full)",
+          [&]() -> uint32_t { return checkGetMsgReceived(buf, 1, big); });
+  prepareSetAns(buf, 1, small);
+  measure("checkAnsSetReceived(empty)",
+          [&]() -> uint32_t { return checkAnsSetReceived(buf, 1, small); });
+  prepareGetAns(buf, 1, big);
+  measure("checkAnsGetReceived(full)",
+          [&]() -> uint32_t { return checkAnsGetReceived(buf, 1, big); });
+  /* wrong argument: the message is discarded before the CRC is computed */
+  measure("checkAnsGetReceived(wrong arg)", [&]() -> uint32_t {
+    return !checkAnsGetReceived(buf, 2, big);
+  });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/*  Expansion messages                                                   */
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* msg_* and parse_* functions are protected, these classes only give access
+   to them */
+class BenchExpansion : public Expansion {
+public:
+  BenchExpansion() : Expansion(0, EXPANSION_NOT_VALID, 0, &OptaController) {}
+  using Expansion::iregs;
+  using Expansion::msg_get_fw_version;
+  using Expansion::msg_get_flash;
+  using Expansion::msg_set_flash;
+  using Expansion::parse_ans_get_flash;
+  using Expansion::parse_ans_get_version;
+};
+
+class BenchDigital : public DigitalExpansion {
+public:
+  BenchDigital() {
+    setIndex(0);
+    setCtrl(&OptaController);
+  }
+  using DigitalExpansion::iregs;
+  using DigitalExpansion::msg_get_ai;
+  using DigitalExpansion::msg_get_all_ai;
+  using DigitalExpansion::msg_get_di;
+  using DigitalExpansion::msg_set_di;
+  using DigitalExpansion::parse_ans_get_ai;
+  using DigitalExpansion::parse_ans_get_all_ai;
+  using DigitalExpansion::parse_ans_get_di;
+  using DigitalExpansion::parse_ans_set_di;
+};
+
+class BenchAnalog : public AnalogExpansion {
+public:
+  BenchAnalog() {
+    setIndex(0);
+    setCtrl(&OptaController);
+  }
+  using AnalogExpansion::fregs;
+  using AnalogExpansion::iregs;
+  using AnalogExpansion::msg_begin_adc;
+  using AnalogExpansion::msg_begin_dac;
+  using AnalogExpansion::msg_begin_di;
+  using AnalogExpansion::msg_begin_high_imp;
+  using AnalogExpansion::msg_begin_rtd;
+  using AnalogExpansion::msg_get_adc;
+  using AnalogExpansion::msg_get_all_ai;
+  using AnalogExpansion::msg_get_ch_function;
+  using AnalogExpansion::msg_get_di;
+  using AnalogExpansion::msg_get_rtd;
+  using AnalogExpansion::msg_send_time;
+  using AnalogExpansion::msg_set_all_dac;
+  using AnalogExpansion::msg_set_all_pwm;
+  using AnalogExpansion::msg_set_dac;
+  using AnalogExpansion::msg_set_led;
+  using AnalogExpansion::msg_set_pwm;
+  using AnalogExpansion::parse_ans_get_adc;
+  using AnalogExpansion::parse_ans_get_all_ai;
+  using AnalogExpansion::parse_ans_get_di;
+  using AnalogExpansion::parse_ans_get_rtd;
+  using AnalogExpansion::parse_get_ch_function;
+  using AnalogExpansion::parse_oa_ack;
+};
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void bench_expansion() {
+  BenchExpansion e;
+  e.iregs[ADD_FLASH_ADDRESS] = 0x0100;
+  e.iregs[ADD_FLASH_DIM] = MAX_FLASH_DATA;
+  for (int i = 0; i < MAX_FLASH_DATA; i++) {
+    e.iregs[ADD_FLASH_0 + i] = i;
+  }
+
+  measure("msg_get_fw_version", [&]() -> uint32_t {
+    return e.msg_get_fw_version();
+  });
+  answer_get(ANS_ARG_GET_VERSION, ANS_LEN_GET_VERSION);
+  measure("parse_ans_get_version", [&]() -> uint32_t {
+    return e.parse_ans_get_version();
+  });
+
+  measure("msg_set_flash", [&]() -> uint32_t { return e.msg_set_flash(); });
+  measure("msg_get_flash", [&]() -> uint32_t { return e.msg_get_flash(); });
+  OptaController.getRxBuffer()[ANS_GET_DATA_DIMENSION_POS] = MAX_FLASH_DATA;
+  answer_get(ANS_ARG_GET_DATA_FROM_FLASH, ANS_LEN_GET_DATA_FROM_FLASH);
+  measure("parse_ans_get_flash", [&]() -> uint32_t {
+    return e.parse_ans_get_flash();
+  });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void bench_digital() {
+  BenchDigital d;
+  d.iregs[ADD_DIGITAL_OUTPUT] = 0x55;
+  d.iregs[CTRL_ADD_EXPANSION_PIN] = 3;
+
+  measure("OD msg_set_di", [&]() -> uint32_t { return d.msg_set_di(); });
+  answer_set(ANS_ARG_OD_SET_DIGITAL_OUTPUTS, ANS_LEN_OD_SET_DIGITAL_OUTPUTS);
+  measure("OD parse_ans_set_di",
+          [&]() -> uint32_t { return d.parse_ans_set_di(); });
+
+  measure("OD msg_get_di", [&]() -> uint32_t { return d.msg_get_di(); });
+  answer_get(ANS_ARG_OD_GET_DIGITAL_INPUTS, ANS_LEN_OD_GET_DIGITAL_INPUTS);
+  measure("OD parse_ans_get_di",
+          [&]() -> uint32_t { return d.parse_ans_get_di(); });
+
+  measure("OD msg_get_ai", [&]() -> uint32_t { return d.msg_get_ai(); });
+  answer_get(ANS_ARG_OD_GET_ANALOG_INPUT, ANS_LEN_OD_GET_ANALOG_INPUT);
+  measure("OD parse_ans_get_ai",
+          [&]() -> uint32_t { return d.parse_ans_get_ai(); });
+
+  measure("OD msg_get_all_ai",
+          [&]() -> uint32_t { return d.msg_get_all_ai(); });
+  answer_get(ANS_ARG_OD_GET_ALL_ANALOG_INPUTS,
+             ANS_LEN_OD_GET_ALL_ANALOG_INPUTS);
+  measure("OD parse_ans_get_all_ai",
+          [&]() -> uint32_t { return d.parse_ans_get_all_ai(); });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void bench_analog() {
+  BenchAnalog a;
+  a.iregs[ADD_OA_PIN] = 2;
+  /* ADC */
+  a.iregs[ADD_OA_ADC_TYPE] = OA_VOLTAGE_ADC;
+  a.iregs[ADD_OA_ADC_USE_PULL_DOWN] = OA_ENABLE;
+  a.iregs[ADD_OA_ADC_USE_REJECTION] = OA_DISABLE;
+  a.iregs[ADD_OA_ADC_USE_DIAGNOSTIC] = OA_DISABLE;
+  a.iregs[ADD_OA_ADC_MOVE_AVERAGE] = 0;
+  /* DI */
+  a.iregs[ADD_OA_DI_USE_FILTER] = OA_ENABLE;
+  a.iregs[ADD_OA_DI_INVERT] = OA_DISABLE;
+  a.iregs[ADD_OA_DI_SINK_CURRENT] = 1;
+  a.iregs[ADD_OA_DI_DEB_TIME] = 0x10;
+  a.iregs[ADD_OA_DI_SIMPLE_DEB] = OA_DISABLE;
+  a.iregs[ADD_OA_DI_SCALE_TH_WITH_VCC] = OA_DISABLE;
+  a.iregs[ADD_OA_DI_THRESHOLD] = 0x10;
+  /* DAC */
+  a.iregs[ADD_OA_DAC_TYPE] = OA_VOLTAGE_DAC;
+  a.iregs[ADD_OA_DAC_LIMIT_CURRENT] = OA_ENABLE;
+  a.iregs[ADD_OA_DAC_USE_SLEW] = OA_DISABLE;
+  a.iregs[ADD_OA_DAC_SLEW_RATE] = 0;
+  a.iregs[BASE_OA_DAC_ADDRESS + 2] = 4000;
+  a.iregs[ADD_UPDATE_ANALOG_OUTPUT] = 1;
+  /* RTD */
+  a.iregs[ADD_OA_RTD_USE_3_WIRES] = OA_ENABLE;
+  a.fregs[ADD_OA_RTD_CURRENT] = 1.2f;
+  a.iregs[ADD_OA_RTD_TIME] = 1000;
+  /* PWM and LED (pin 2 is used as PWM channel 2) */
+  a.iregs[ADD_OA_PWM_MASK] = OA_PWM_ALL_CH_MASK;
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    a.iregs[BASE_OA_PWM_ADDRESS + ch] = 10000;
+    a.iregs[BASE_OA_PWM_ADDRESS + ch + OA_PWM_CHANNELS_NUM] = 5000;
+  }
+  a.iregs[ADD_OA_LED_VALUE] = 0xA5;
+
+  /* all the set messages are answered with the same ack */
+  measure("OA msg_begin_adc", [&]() -> uint32_t { return a.msg_begin_adc(); });
+  measure("OA msg_begin_di", [&]() -> uint32_t { return a.msg_begin_di(); });
+  measure("OA msg_begin_dac", [&]() -> uint32_t { return a.msg_begin_dac(); });
+  measure("OA msg_begin_rtd", [&]() -> uint32_t { return a.msg_begin_rtd(); });
+  measure("OA msg_begin_high_imp",
+          [&]() -> uint32_t { return a.msg_begin_high_imp(); });
+  measure("OA msg_send_time", [&]() -> uint32_t { return a.msg_send_time(); });
+  measure("OA msg_set_dac", [&]() -> uint32_t { return a.msg_set_dac(); });
+  measure("OA msg_set_all_dac",
+          [&]() -> uint32_t { return a.msg_set_all_dac(); });
+  measure("OA msg_set_pwm", [&]() -> uint32_t { return a.msg_set_pwm(); });
+  measure("OA msg_set_all_pwm",
+          [&]() -> uint32_t { return a.msg_set_all_pwm(); });
+  measure("OA msg_set_led", [&]() -> uint32_t { return a.msg_set_led(); });
+  answer_set(ANS_ARG_OA_ACK, ANS_LEN_OA_ACK);
+  measure("OA parse_oa_ack", [&]() -> uint32_t { return a.parse_oa_ack(); });
+
+  measure("OA msg_get_adc", [&]() -> uint32_t { return a.msg_get_adc(); });
+  answer_get(ANS_ARG_OA_GET_ADC, ANS_LEN_OA_GET_ADC);
+  measure("OA parse_ans_get_adc",
+          [&]() -> uint32_t { return a.parse_ans_get_adc(); });
+
+  measure("OA msg_get_all_ai",
+          [&]() -> uint32_t { return a.msg_get_all_ai(); });
+  answer_get(ANS_ARG_OA_GET_ALL_ADC, ANS_LEN_OA_GET_ALL_ADC);
+  measure("OA parse_ans_get_all_ai",
+          [&]() -> uint32_t { return a.parse_ans_get_all_ai(); });
+
+  measure("OA msg_get_rtd", [&]() -> uint32_t { return a.msg_get_rtd(); });
+  answer_get(ANS_ARG_OA_GET_RTD, ANS_LEN_OA_GET_RTD);
+  measure("OA parse_ans_get_rtd",
+          [&]() -> uint32_t { return a.parse_ans_get_rtd(); });
+
+  measure("OA msg_get_di", [&]() -> uint32_t { return a.msg_get_di(); });
+  answer_get(ANS_ARG_OA_GET_DI, ANS_LEN_OA_GET_DI);
+  measure("OA parse_ans_get_di",
+          [&]() -> uint32_t { return a.parse_ans_get_di(); });
+
+  measure("OA msg_get_ch_function",
+          [&]() -> uint32_t { return a.msg_get_ch_function(); });
+  answer_get(ANS_GET_CHANNEL_FUNCTION, LEN_ANS_GET_CHANNEL_FUNCTION);
+  measure("OA parse_get_ch_function",
+          [&]() -> uint32_t { return a.parse_get_ch_function(); });
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static bool write_csv(const std::string &fn) {
+  std::ofstream f(fn);
+  if (!f.is_open()) {
+    return false;
+  }
+  f << "function,n,ns_per_op,allocs_per_op\n";
+  for (auto &r : results) {
+    f << r.name << "," << r.n << "," << r.ns_per_op << "," << r.allocs_per_op
+      << "\n";
+  }
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static void usage(const char *name) {
+  printf("Usage: %s [-t <ms per function>] [-f <filter>] [-c <csv output>]\n",
+         name);
+  printf("  -t minimum time spent on each function (default %d ms)\n",
+         MSGBENCH_DEFAULT_TIME_MS);
+  printf("  -f run only the functions whose name contains <filter>\n");
+  printf("  -c write the results into a csv file\n");
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int main(int argc, char **argv) {
+  std::string csv;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:f:c:h")) != -1) {
+    switch (opt) {
+    case 't':
+      min_time_ns = (uint64_t)strtoul(optarg, nullptr, 10) * 1000000;
+      break;
+    case 'f':
+      filter = optarg;
+      break;
+    case 'c':
+      csv = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%-36s %12s %10s %10s\n", "function", "n", "ns/op", "allocs/op");
+  bench_common_helpers();
+  bench_expansion();
+  bench_digital();
+  bench_analog();
+
+  if (!csv.empty() && !write_csv(csv)) {
+    printf("Unable to write %s\n", csv.c_str());
+    return 1;
+  }
+
+  printf("%s\n", (failures == 0) ? "PASS" : "FAIL");
+  return (failures == 0) ? 0 : 1;
+}
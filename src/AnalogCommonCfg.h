@@ -90,6 +90,12 @@ typedef enum {
 
 #define OA_FIRST_PWM_CH 8
 #define OA_LAST_PWM_CH 11
+/* mask selecting all the PWM channels (bit 0 is OA_PWM_CH_0) */
+#define OA_PWM_ALL_CH_MASK 0x0F
+
+/* first Opta Analog FW version able to handle the SET ALL PWM message
+ * (major << 16 | minor << 8 | release) */
+#define OA_FW_VERSION_SET_ALL_PWM ((0 << 16) | (1 << 8) | 15)
 
 #define OA_MAX_DAC_VALUE 8191
 
@@ -18,6 +18,14 @@
 namespace Opta {
 
 OaChannelCfg AnalogExpansion::cfgs[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+uint8_t AnalogExpansion::dac_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
+    0, 0, 0, 0, 0};
+uint8_t AnalogExpansion::pwm_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
+    0, 0, 0, 0, 0};
+bool AnalogExpansion::led_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
+    false, false, false, false, false};
+int8_t AnalogExpansion::set_all_pwm_support[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
+    -1, -1, -1, -1, -1};
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
@@ -65,6 +73,15 @@ AnalogExpansion::AnalogExpansion(Expansion &other) {
   }
 }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+void AnalogExpansion::clearDirty(uint8_t device) {
+  if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    dac_dirty[device] = 0;
+    pwm_dirty[device] = 0;
+    led_dirty[device] = false;
+  }
+}
+
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 void AnalogExpansion::startUp(Controller *ptr) {
 
@@ -73,6 +90,10 @@ void AnalogExpansion::startUp(Controller *ptr) {
   }
 
   for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+    /* the expansion at this index may have changed: FW version has to be
+     * read again */
+    set_all_pwm_support[i] = -1;
+    clearDirty(i);
     AnalogExpansion exp = ptr->getExpansion(i);
     if (exp) {
       if(AnalogExpansion::cfgs[i].isExpansionUsed()) {
@@ -517,11 +538,15 @@ bool AnalogExpansion::rtd_registers_defined() {
 }
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-void AnalogExpansion::setPwm(uint8_t ch, uint32_t period, uint32_t pulse) {
+void AnalogExpansion::setPwm(uint8_t ch, uint32_t period, uint32_t pulse,
+                             bool update /* = true */) {
   /* sanity checks to verify input function parameter */
   if (ch < OA_FIRST_PWM_CH || ch > OA_LAST_PWM_CH) {
     return;
   }
+  if (index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return;
+  }
   /* period == 0 must "pass" because is the condition to stop the PWM*/
   if (period != 0) {
     if (pulse >= period) {
@@ -533,20 +558,43 @@ void AnalogExpansion::setPwm(uint8_t ch, uint32_t period, uint32_t pulse) {
   uint32_t per_add = BASE_OA_PWM_ADDRESS + iregs[ADD_OA_PIN];
   uint32_t pul_add =
       BASE_OA_PWM_ADDRESS + iregs[ADD_OA_PIN] + OA_PWM_CHANNELS_NUM;
+  bool sent = addressExist(per_add) && addressExist(pul_add);
 
-  /* if the address is not defined --> the value has never been sent
-   * to the expansion => send it*/
-  if (!addressExist(per_add) || !addressExist(pul_add) || iregs[ADD_SET_DEFAULT_VALUE_FLAG] == 1) {
+  if (iregs[ADD_SET_DEFAULT_VALUE_FLAG] == 1) {
+    /* default values are always sent immediately and must not overwrite
+     * the output values held by the registers */
+    unsigned int out_period = (sent) ? iregs[per_add] : 0;
+    unsigned int out_pulse = (sent) ? iregs[pul_add] : 0;
     iregs[per_add] = period;
     iregs[pul_add] = pulse;
     execute(SET_PWM);
+    if (sent) {
+      iregs[per_add] = out_period;
+      iregs[pul_add] = out_pulse;
+    } else {
+      iregs.erase(per_add);
+      iregs.erase(pul_add);
+    }
+    if (ctrl != nullptr) {
+      ctrl->updateRegs(*this);
+    }
+    return;
   }
-  /* if the address is defined and the value different to the one held
-   * by the correspondent register => send it */
-  else if (period != iregs[per_add] || pulse != iregs[pul_add]) {
+
+  /* if the address is not defined --> the value has never been sent
+   * to the expansion, if the value is different to the one held
+   * by the correspondent register --> it has changed: in both cases the
+   * channel must be sent */
+  if (!sent || period != iregs[per_add] || pulse != iregs[pul_add]) {
     iregs[per_add] = period;
     iregs[pul_add] = pulse;
-    execute(SET_PWM);
+    pwm_dirty[index] |= (1 << iregs[ADD_OA_PIN]);
+  }
+
+  if (update) {
+    flush_pwm();
+  } else if (ctrl != nullptr) {
+    ctrl->updateRegs(*this);
   }
 }
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
@@ -556,6 +604,109 @@ void AnalogExpansion::setDefaultPwm(uint8_t ch, uint32_t period, uint32_t pulse)
   setPwm(ch, period, pulse);
 }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void AnalogExpansion::setAllPwm(const uint32_t *period, const uint32_t *pulse,
+                                uint8_t mask /*= OA_PWM_ALL_CH_MASK*/,
+                                bool update /*= true*/) {
+  if (period == nullptr || pulse == nullptr ||
+      index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return;
+  }
+
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    if (!(mask & (1 << ch))) {
+      continue;
+    }
+    /* same check performed by setPwm on each channel */
+    if (period[ch] != 0 && pulse[ch] >= period[ch]) {
+      continue;
+    }
+    uint32_t per_add = BASE_OA_PWM_ADDRESS + ch;
+    uint32_t pul_add = BASE_OA_PWM_ADDRESS + ch + OA_PWM_CHANNELS_NUM;
+    if (!addressExist(per_add) || !addressExist(pul_add) ||
+        period[ch] != iregs[per_add] || pulse[ch] != iregs[pul_add]) {
+      iregs[per_add] = period[ch];
+      iregs[pul_add] = pulse[ch];
+      pwm_dirty[index] |= (1 << ch);
+    }
+  }
+
+  if (update) {
+    flush_pwm();
+  } else if (ctrl != nullptr) {
+    ctrl->updateRegs(*this);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void AnalogExpansion::setAllDefaultPwm(const uint32_t *period,
+                                       const uint32_t *pulse,
+                                       uint8_t mask /*= OA_PWM_ALL_CH_MASK*/) {
+  if (period == nullptr || pulse == nullptr) {
+    return;
+  }
+
+  if (!set_all_pwm_supported()) {
+    for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+      if (mask & (1 << ch)) {
+        setDefaultPwm(ch + OA_FIRST_PWM_CH, period[ch], pulse[ch]);
+      }
+    }
+    return;
+  }
+
+  /* default values must not overwrite the output values held by the
+   * registers: they are saved here and put back once the message is sent */
+  std::map<unsigned int, unsigned int> out_regs = iregs;
+  uint8_t valid = 0;
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    if (!(mask & (1 << ch))) {
+      continue;
+    }
+    if (period[ch] != 0 && pulse[ch] >= period[ch]) {
+      continue;
+    }
+    iregs[BASE_OA_PWM_ADDRESS + ch] = period[ch];
+    iregs[BASE_OA_PWM_ADDRESS + ch + OA_PWM_CHANNELS_NUM] = pulse[ch];
+    valid |= (1 << ch);
+  }
+
+  if (valid) {
+    iregs[ADD_OA_PWM_MASK] = valid;
+    iregs[ADD_SET_DEFAULT_VALUE_FLAG] = 1;
+    execute(SET_ALL_PWM);
+  }
+
+  iregs = out_regs;
+  if (ctrl != nullptr) {
+    ctrl->updateRegs(*this);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* SET ALL PWM message is available from FW OA_FW_VERSION_SET_ALL_PWM,
+ * the FW version is read only once per expansion */
+bool AnalogExpansion::set_all_pwm_supported() {
+  if (index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return false;
+  }
+  if (set_all_pwm_support[index] < 0) {
+    uint8_t major = 0;
+    uint8_t minor = 0;
+    uint8_t release = 0;
+    if (!getFwVersion(major, minor, release)) {
+      /* do not remember the failure: try again next time */
+      return false;
+    }
+    uint32_t fw = ((uint32_t)major << 16) | ((uint32_t)minor << 8) | release;
+    set_all_pwm_support[index] = (fw >= OA_FW_VERSION_SET_ALL_PWM) ? 1 : 0;
+  }
+  return (set_all_pwm_support[index] == 1);
+}
+
 
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
@@ -666,6 +817,98 @@ uint8_t AnalogExpansion::msg_set_pwm() {
   }
   return 0;
 }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t AnalogExpansion::msg_set_all_pwm() {
+  if (ctrl == nullptr || index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM ||
+      !addressExist(ADD_OA_PWM_MASK)) {
+    return 0;
+  }
+
+  uint8_t mask = iregs[ADD_OA_PWM_MASK] & OA_PWM_ALL_CH_MASK;
+  uint8_t msg_argument = ARG_OA_SET_ALL_PWM;
+  uint8_t ch_argument = ARG_OA_SET_PWM;
+  uint32_t offset_backup = OFFSET_PWM_CONFIG;
+
+  if (iregs[ADD_SET_DEFAULT_VALUE_FLAG] == 1) {
+    iregs[ADD_SET_DEFAULT_VALUE_FLAG] = 0;
+    msg_argument = ARG_OA_SET_ALL_PWM_DEFAULT;
+    ch_argument = ARD_OA_SET_DEFAULT_PWM;
+    offset_backup = OFFSET_PWM_DEFAULT_VALUE;
+  }
+
+  /* configuration backup is kept as one SET PWM message per channel so that
+   * it can be restored also on expansions with older FW */
+  uint8_t ch_msg[OPTA_I2C_BUFFER_DIM];
+
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    uint32_t per_add = BASE_OA_PWM_ADDRESS + ch;
+    uint32_t pul_add = BASE_OA_PWM_ADDRESS + ch + OA_PWM_CHANNELS_NUM;
+    uint32_t period = 0;
+    uint32_t pulse = 0;
+    if ((mask & (1 << ch)) && addressExist(per_add) && addressExist(pul_add)) {
+      period = iregs[per_add];
+      pulse = iregs[pul_add];
+    } else {
+      mask &= ~(1 << ch);
+    }
+
+    uint8_t pos = OA_SET_ALL_PWM_FIRST_CH_POS + ch * OA_SET_ALL_PWM_CH_DIM;
+    for (int i = 0; i < 4; i++) {
+      ctrl->setTx((uint8_t)((period >> (8 * i)) & 0xFF),
+                  pos + OA_SET_ALL_PWM_PERIOD_OFFSET + i);
+      ctrl->setTx((uint8_t)((pulse >> (8 * i)) & 0xFF),
+                  pos + OA_SET_ALL_PWM_PULSE_OFFSET + i);
+    }
+
+    if (mask & (1 << ch)) {
+      ch_msg[OA_CH_RTD_CHANNEL_POS] = ch;
+      for (int i = 0; i < 4; i++) {
+        ch_msg[OA_SET_PWM_PERIOD_POS + i] = (uint8_t)((period >> (8 * i)) & 0xFF);
+        ch_msg[OA_SET_PWM_PULSE_POS + i] = (uint8_t)((pulse >> (8 * i)) & 0xFF);
+      }
+      uint8_t len = prepareSetMsg(ch_msg, ch_argument, LEN_OA_SET_PWM);
+      cfgs[index].backup(ch_msg, ch + offset_backup, len);
+    }
+  }
+
+  ctrl->setTx(mask, OA_SET_ALL_PWM_MASK_POS);
+  return prepareSetMsg(ctrl->getTxBuffer(), msg_argument, LEN_OA_SET_ALL_PWM);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* send all the PWM channels changed since the last time they were sent */
+unsigned int AnalogExpansion::flush_pwm() {
+  unsigned int rv = EXECUTE_OK;
+  if (index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  uint8_t dirty = pwm_dirty[index];
+  /* more than one channel changed: use a single message if the expansion
+   * supports it */
+  if ((dirty & (dirty - 1)) != 0 && set_all_pwm_supported()) {
+    iregs[ADD_OA_PWM_MASK] = dirty;
+    rv = execute(SET_ALL_PWM);
+    if (rv == EXECUTE_OK) {
+      pwm_dirty[index] &= ~dirty;
+    }
+    return rv;
+  }
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    if (pwm_dirty[index] & (1 << ch)) {
+      iregs[ADD_OA_PIN] = ch;
+      unsigned int err = execute(SET_PWM);
+      if (err == EXECUTE_OK) {
+        pwm_dirty[index] &= ~(1 << ch);
+      } else if (rv == EXECUTE_OK) {
+        rv = err;
+      }
+    }
+  }
+  return rv;
+}
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 uint16_t AnalogExpansion::getAdc(uint8_t ch, bool update /* true */) {
@@ -756,26 +999,87 @@ float AnalogExpansion::pinCurrent(uint8_t ch, bool update /*= true*/) {
 
 void AnalogExpansion::setDac(uint8_t ch, uint16_t value,
                              bool update /* = true*/) {
-  if (ch < OA_AN_CHANNELS_NUM) {
-    iregs[ADD_OA_PIN] = ch;
+  if (ch < OA_AN_CHANNELS_NUM && index < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
     if (value > 8191) {
       value = 8191;
     }
-    /* if the address is not defined --> the value has never been sent
-     * to the expansion => send it*/
-    iregs[BASE_OA_DAC_ADDRESS + ch] = value;
-    iregs[ADD_UPDATE_ANALOG_OUTPUT] = (update) ? 1 : 0;
-    unsigned int err = 1;
-    uint8_t t = 0;
-    do {
-      err = execute(SET_SINGLE_ANALOG_OUTPUT);
-      if(err) {
-        delay(5);
+
+    if (iregs[ADD_SET_DEFAULT_VALUE_FLAG] == 1) {
+      /* default values are always sent immediately and must not overwrite
+       * the output value held by the register */
+      unsigned int out_value = iregs[BASE_OA_DAC_ADDRESS + ch];
+      iregs[ADD_OA_PIN] = ch;
+      iregs[BASE_OA_DAC_ADDRESS + ch] = value;
+      iregs[ADD_UPDATE_ANALOG_OUTPUT] = 0;
+      unsigned int err = 1;
+      uint8_t t = 0;
+      do {
+        err = execute(SET_SINGLE_ANALOG_OUTPUT);
+        if(err) {
+          delay(5);
+          /* the flag is reset while the message is prepared */
+          iregs[ADD_SET_DEFAULT_VALUE_FLAG] = 1;
+        }
+        t++;
+      } while(err != EXECUTE_OK && t < 3);
+      iregs[ADD_SET_DEFAULT_VALUE_FLAG] = 0;
+      iregs[BASE_OA_DAC_ADDRESS + ch] = out_value;
+      if (ctrl != nullptr) {
+        ctrl->updateRegs(*this);
       }
-      t++;
-    } while(err != EXECUTE_OK && t < 3);
+      return;
+    }
+
+    if (iregs[BASE_OA_DAC_ADDRESS + ch] != value) {
+      iregs[BASE_OA_DAC_ADDRESS + ch] = value;
+      dac_dirty[index] |= (1 << ch);
+    }
+
+    if (update) {
+      /* an immediate update is always sent (even if the value did not
+       * change) and it also applies all the DAC values still pending */
+      dac_dirty[index] |= (1 << ch);
+      flush_dac();
+    } else if (ctrl != nullptr) {
+      ctrl->updateRegs(*this);
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* send all the DAC values changed since the last time they were sent, the
+ * last message sent asks the expansion to apply all the new DAC values at
+ * once (so that no additional SET_ALL_ANALOG_OUTPUTS is needed), unless
+ * apply is false (values applied by COMMIT OUTPUTS) */
+unsigned int AnalogExpansion::flush_dac(bool apply) {
+  unsigned int rv = EXECUTE_OK;
+  if (index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+    if (dac_dirty[index] & (1 << ch)) {
+      iregs[ADD_OA_PIN] = ch;
+      bool last = ((dac_dirty[index] >> (ch + 1)) == 0);
+      iregs[ADD_UPDATE_ANALOG_OUTPUT] = (last && apply) ? 1 : 0;
+      unsigned int err = 1;
+      uint8_t t = 0;
+      do {
+        err = execute(SET_SINGLE_ANALOG_OUTPUT);
+        if(err) {
+          delay(5);
+        }
+        t++;
+      } while(err != EXECUTE_OK && t < 3);
 
+      if (err == EXECUTE_OK) {
+        dac_dirty[index] &= ~(1 << ch);
+      } else if (rv == EXECUTE_OK) {
+        rv = err;
+      }
+    }
   }
+  return rv;
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
@@ -871,7 +1175,62 @@ uint8_t AnalogExpansion::msg_set_all_dac() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-void AnalogExpansion::updateAnalogOutputs() { execute(SET_ALL_ANALOG_OUTPUTS); }
+void AnalogExpansion::updateAnalogOutputs() {
+  if (index < OPTA_CONTROLLER_MAX_EXPANSION_NUM && dac_dirty[index] != 0) {
+    /* the last DAC value sent also applies all the DAC outputs */
+    flush_dac();
+  } else {
+    execute(SET_ALL_ANALOG_OUTPUTS);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int AnalogExpansion::flushOutputs() { return flush_outputs(true); }
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int AnalogExpansion::stageOutputs() {
+  /* older firmware: the outputs are applied at once */
+  if (ctrl == nullptr || !ctrl->hasFeature(index, OPTA_CAPABILITY_COMMIT)) {
+    return flushOutputs();
+  }
+  bool staged = (index < OPTA_CONTROLLER_MAX_EXPANSION_NUM &&
+                 dac_dirty[index] != 0);
+  unsigned int rv = flush_outputs(false);
+  /* the DAC values are written in the DAC registers by the main loop of the
+     expansion: the commit must not come before */
+  if (staged && rv == EXECUTE_OK) {
+    rv = wait_commit_ready();
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* PWM and LED have no latch: they are always applied at once */
+unsigned int AnalogExpansion::flush_outputs(bool apply_dac) {
+  if (index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  unsigned int rv = EXECUTE_OK;
+  unsigned int err = EXECUTE_OK;
+  if (dac_dirty[index] != 0) {
+    rv = flush_dac(apply_dac);
+  }
+  if (pwm_dirty[index] != 0) {
+    err = flush_pwm();
+    rv = (rv == EXECUTE_OK) ? err : rv;
+  }
+  if (led_dirty[index]) {
+    err = execute(SET_LED);
+    if (err == EXECUTE_OK) {
+      led_dirty[index] = false;
+    }
+    rv = (rv == EXECUTE_OK) ? err : rv;
+  }
+  return rv;
+}
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 void AnalogExpansion::pinVoltage(uint8_t ch, float voltage,
@@ -945,6 +1304,8 @@ void AnalogExpansion::switchLedOn(uint8_t pin, bool update /* = true */) {
     write(BASE_OA_LED_ADDRESS + pin, 1);
     if (update) {
       updateLeds();
+    } else if (ctrl != nullptr) {
+      ctrl->updateRegs(*this);
     }
   }
 }
@@ -956,6 +1317,8 @@ void AnalogExpansion::switchLedOff(uint8_t pin, bool update /* = true */) {
     write(BASE_OA_LED_ADDRESS + pin, 0);
     if (update) {
       updateLeds();
+    } else if (ctrl != nullptr) {
+      ctrl->updateRegs(*this);
     }
   }
 }
@@ -963,8 +1326,10 @@ void AnalogExpansion::switchLedOff(uint8_t pin, bool update /* = true */) {
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 void AnalogExpansion::updateLeds() {
-  /*uint32_t err =*/execute(SET_LED);
-  /*Serial.println("SET LED RESULT = " + String(err));*/
+  uint32_t err = execute(SET_LED);
+  if (err == EXECUTE_OK && index < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    led_dirty[index] = false;
+  }
 }
 
 
@@ -996,6 +1361,104 @@ CfgFun_t AnalogExpansion::get_channel_function(uint8_t ch) {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+unsigned int AnalogExpansion::resume() {
+  if (index >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  /* the start up function is not called: FW version has to be read again */
+  set_all_pwm_support[index] = -1;
+  for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+    iregs[ADD_OA_PIN] = ch;
+    unsigned int err = execute(GET_CHANNEL_FUNCTION);
+    if (err != EXECUTE_OK) {
+      return err;
+    }
+    if (iregs[ADD_OA_PIN_OUTPUT] != (unsigned int)ch ||
+        !resume_channel(ch, (CfgFun_t)iregs[ADD_CH_FUNCTION])) {
+      return EXECUTE_ERR_PROTOCOL;
+    }
+  }
+  return EXECUTE_OK;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* the configuration kept for the channel ch is used if it has the function
+   f, otherwise the configuration message is built (not sent) again with the
+   default parameters */
+bool AnalogExpansion::resume_channel(uint8_t ch, CfgFun_t f) {
+  bool rv = true;
+  iregs[ADD_OA_PIN] = ch;
+  switch (f) {
+  case CH_FUNC_HIGH_IMPEDENCE:
+    if (!cfgs[index].isHighImpedanceCh(ch)) {
+      rv = (msg_begin_high_imp() > 0);
+    }
+    break;
+  case CH_FUNC_VOLTAGE_OUTPUT:
+  case CH_FUNC_CURRENT_OUTPUT:
+    if (f == CH_FUNC_VOLTAGE_OUTPUT && cfgs[index].isVoltageDacCh(ch)) {
+      break;
+    }
+    if (f == CH_FUNC_CURRENT_OUTPUT && cfgs[index].isCurrentDacCh(ch)) {
+      break;
+    }
+    iregs[ADD_OA_DAC_TYPE] =
+        (f == CH_FUNC_VOLTAGE_OUTPUT) ? OA_VOLTAGE_DAC : OA_CURRENT_DAC;
+    iregs[ADD_OA_DAC_LIMIT_CURRENT] =
+        (f == CH_FUNC_VOLTAGE_OUTPUT) ? OA_ENABLE : OA_DISABLE;
+    iregs[ADD_OA_DAC_USE_SLEW] = OA_DISABLE;
+    iregs[ADD_OA_DAC_SLEW_RATE] = OA_SLEW_RATE_0;
+    rv = (msg_begin_dac() > 0);
+    iregs.erase(ADD_OA_DAC_TYPE);
+    iregs.erase(ADD_OA_DAC_LIMIT_CURRENT);
+    iregs.erase(ADD_OA_DAC_USE_SLEW);
+    iregs.erase(ADD_OA_DAC_SLEW_RATE);
+    break;
+  case CH_FUNC_VOLTAGE_INPUT:
+  case CH_FUNC_CURRENT_INPUT_EXT_POWER:
+    if (f == CH_FUNC_VOLTAGE_INPUT && cfgs[index].isVoltageAdcCh(ch)) {
+      break;
+    }
+    if (f == CH_FUNC_CURRENT_INPUT_EXT_POWER &&
+        cfgs[index].isCurrentAdcCh(ch)) {
+      break;
+    }
+    iregs[ADD_OA_ADC_TYPE] =
+        (f == CH_FUNC_VOLTAGE_INPUT) ? OA_VOLTAGE_ADC : OA_CURRENT_ADC;
+    iregs[ADD_OA_ADC_USE_PULL_DOWN] =
+        (f == CH_FUNC_VOLTAGE_INPUT) ? OA_ENABLE : OA_DISABLE;
+    iregs[ADD_OA_ADC_USE_REJECTION] = OA_ENABLE;
+    iregs[ADD_OA_ADC_USE_DIAGNOSTIC] = OA_DISABLE;
+    iregs[ADD_OA_ADC_MOVE_AVERAGE] = 0;
+    iregs[ADD_FLAG_ADD_ADC_ON_CHANNEL] = 0;
+    rv = (msg_begin_adc() > 0);
+    iregs.erase(ADD_OA_ADC_TYPE);
+    iregs.erase(ADD_OA_ADC_USE_PULL_DOWN);
+    iregs.erase(ADD_OA_ADC_USE_REJECTION);
+    iregs.erase(ADD_OA_ADC_USE_DIAGNOSTIC);
+    iregs.erase(ADD_OA_ADC_MOVE_AVERAGE);
+    break;
+  case CH_FUNC_DIGITAL_INPUT:
+    rv = cfgs[index].isDigitalInputCh(ch);
+    break;
+  case CH_FUNC_RESISTANCE_MEASUREMENT:
+    rv = cfgs[index].isRtdCh(ch) && !cfgs[index].isRtd3WiresCh(ch);
+    break;
+  case CH_FUNC_RESISTANCE_MEASUREMENT_3_WIRES:
+    rv = cfgs[index].isRtd3WiresCh(ch);
+    break;
+  default:
+    /* the parameters of these functions cannot be guessed */
+    rv = false;
+    break;
+  }
+  iregs.erase(ADD_OA_PIN);
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 bool AnalogExpansion::parse_get_ch_function() {
   
 
@@ -1103,6 +1566,36 @@ bool AnalogExpansion::parse_ans_get_all_ai() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+uint8_t AnalogExpansion::msg_get_latched() {
+  return prepareGetMsg(ctrl->getTxBuffer(), ARG_GET_LATCHED_INPUTS,
+                       LEN_GET_LATCHED_INPUTS);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool AnalogExpansion::parse_ans_get_latched() {
+  if (checkAnsGetReceived(ctrl->getRxBuffer(), ANS_ARG_GET_LATCHED_INPUTS,
+                          ANS_LEN_OA_GET_LATCHED_INPUTS +
+                          latched_time_len())) {
+    /* snapshot of an older latch if LATCH INPUTS got lost */
+    latched = (ctrl->getRx(ANS_LATCHED_ID_POS) == ctrl->getLatchId());
+    if (latched) {
+      iregs[ADD_OA_DI_VALUE] = ctrl->getRx(ANS_OA_LATCHED_DI_POS);
+      const int s = ANS_OA_LATCHED_ADC_POS;
+      for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+        iregs[BASE_OA_ADC_ADDRESS + ch] = ctrl->getRx(s + 2 * ch);
+        iregs[BASE_OA_ADC_ADDRESS + ch] +=
+            ((uint16_t)ctrl->getRx(s + 2 * ch + 1) << 8);
+      }
+      set_sample_time(ANS_OA_LATCHED_TIME_POS);
+    }
+    return true;
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 uint8_t AnalogExpansion::msg_get_di() {
   return prepareGetMsg(ctrl->getTxBuffer(), ARG_OA_GET_DI, LEN_OA_GET_DI);
 }
@@ -1197,6 +1690,10 @@ unsigned int AnalogExpansion::execute(uint32_t what) {
       I2C_TRANSACTION(msg_set_pwm,
                       parse_oa_ack, getExpectedAnsLen(ANS_LEN_OA_ACK));
       break;
+    case SET_ALL_PWM:
+      I2C_TRANSACTION(msg_set_all_pwm,
+                      parse_oa_ack, getExpectedAnsLen(ANS_LEN_OA_ACK));
+      break;
     case GET_SINGLE_ANALOG_INPUT:
       I2C_TRANSACTION(msg_get_adc,
                       parse_ans_get_adc,
@@ -1229,6 +1726,27 @@ unsigned int AnalogExpansion::execute(uint32_t what) {
                       parse_ans_get_all_ai,
                       getExpectedAnsLen(ANS_LEN_OA_GET_ALL_ADC));
       break;
+    case GET_LATCHED_INPUTS:
+      latched = false;
+      if (ctrl->hasFeature(index, OPTA_CAPABILITY_LATCH)) {
+        I2C_TRANSACTION(msg_get_latched,
+                        parse_ans_get_latched,
+                        getExpectedAnsLen(ANS_LEN_OA_GET_LATCHED_INPUTS +
+                                          latched_time_len()));
+      }
+      /* no snapshot (older firmware or latch lost): inputs read now */
+      if (i2c_rv == EXECUTE_OK && !latched) {
+        I2C_TRANSACTION(msg_get_di,
+                        parse_ans_get_di,
+                        getExpectedAnsLen(ANS_LEN_OA_GET_DI));
+        if (i2c_rv == EXECUTE_OK) {
+          I2C_TRANSACTION(msg_get_all_ai,
+                          parse_ans_get_all_ai,
+                          getExpectedAnsLen(ANS_LEN_OA_GET_ALL_ADC));
+        }
+        set_sample_time(-1);
+      }
+      break;
     case SET_ALL_ANALOG_OUTPUTS:
       I2C_TRANSACTION(msg_set_all_dac,
                       parse_oa_ack, getExpectedAnsLen(ANS_LEN_OA_ACK));
@@ -1273,11 +1791,16 @@ void AnalogExpansion::write(unsigned int address, unsigned int value) {
   if (address >= ADD_OA_LED_PIN_0 && address <= ADD_OA_LED_PIN_7) {
     int pin = address - BASE_OA_LED_ADDRESS;
     if (pin < OA_LED_NUM) {
+      unsigned int prev = iregs[ADD_OA_LED_VALUE];
       if (value == 0) {
         iregs[ADD_OA_LED_VALUE] &= ~(1 << pin);
       } else {
         iregs[ADD_OA_LED_VALUE] |= (1 << pin);
       }
+      if (prev != iregs[ADD_OA_LED_VALUE] && 
+          index < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+        led_dirty[index] = true;
+      }
     }
   }
   return Expansion::write(address, value);
@@ -234,8 +234,20 @@ public:
    * (OA_PWM_CH_3)
    */
   /* Set period and pulse in micro seconds for the channel ch 
-     valid channels are from OA_PWM_CH_0 to OA_PWM_CH_3 */
-  void setPwm(uint8_t ch, uint32_t period, uint32_t pulse);
+     valid channels are from OA_PWM_CH_0 to OA_PWM_CH_3 
+     if update is false the new values are only stored locally and sent
+     (only if they changed) by flushOutputs() or Controller::flushOutputs() */
+  void setPwm(uint8_t ch, uint32_t period, uint32_t pulse, bool update = true);
+
+  /* Set period and pulse in micro seconds of all the PWM channels selected
+     by mask (bit 0 is OA_PWM_CH_0 ... bit 3 is OA_PWM_CH_3) using a single
+     message, period and pulse arrays hold OA_PWM_CHANNELS_NUM values (index
+     0 is OA_PWM_CH_0)
+     The expansion applies all the channels at the same time
+     if update is false the values are only stored locally (as for setPwm)
+     Expansions with an old FW receive one message per channel */
+  void setAllPwm(const uint32_t *period, const uint32_t *pulse,
+                 uint8_t mask = OA_PWM_ALL_CH_MASK, bool update = true);
 
   /* Get period in micro seconds for the channel ch 
      valid channels are from OA_PWM_CH_0 to OA_PWM_CH_3 
@@ -290,7 +302,12 @@ public:
      Value is intended in milli Ampere
    */
   float pinCurrent(uint8_t ch, bool update = true);
-  /* set dac converter bits of channels ch (if ch is configured as DAC) */
+  /* set dac converter bits of channels ch (if ch is configured as DAC) 
+     if update is true the value is immediately sent to the expansion and
+     applied (together with all the other DAC values set with update false)
+     if update is false the value is only stored locally: it will be sent
+     (only if changed) by updateAnalogOutputs(), flushOutputs() or 
+     Controller::flushOutputs() */
   void setDac(uint8_t ch, uint16_t value, bool update = true);
   /* set the dac as Volts (range 0-11V) if ch is configured as voltage DAC */
   void pinVoltage(uint8_t ch, float voltage, bool update = true);
@@ -299,6 +316,8 @@ public:
   void pinCurrent(uint8_t ch, float current, bool update = true);
   /* get RTD value as Ohms */
   float getRtd(uint8_t ch);
+  /* if update is false the LED status is sent by updateLeds(), flushOutputs()
+     or Controller::flushOutputs() */
   void switchLedOn(uint8_t pin, bool update = true);
   void switchLedOff(uint8_t pin, bool update = true);
   void updateLeds();
@@ -334,6 +353,9 @@ public:
   bool setDefaultPinCurrent(uint8_t ch, float current);
   
   void setDefaultPwm(uint8_t ch, uint32_t period, uint32_t pulse);
+  /* same as setAllPwm but for the default PWM values used after timeout */
+  void setAllDefaultPwm(const uint32_t *period, const uint32_t *pulse,
+                        uint8_t mask = OA_PWM_ALL_CH_MASK);
 
   static void setTimeoutForDefaultValues(Controller &ctrl, uint8_t device, uint16_t timeout_ms);
   /* by using setDefaultDac you set the default DAC value for the channel ch 
@@ -355,8 +377,29 @@ public:
 
   void updateDigitalInputs();
   void updateAnalogInputs();
+  /* send the DAC values changed with update false and apply all of them at
+     once (if no DAC value changed all the DAC outputs are applied anyway) */
   void updateAnalogOutputs();
 
+  /* send to the expansion only the outputs (DAC, PWM and LED) that have been
+     changed with update false since the last time they were sent
+     DAC values are applied all together with the last DAC message
+     if nothing changed no I2C transaction is performed 
+     returns EXECUTE_OK or the first error met */
+  unsigned int flushOutputs() override;
+  /* as flushOutputs() but the DAC values are only staged on the expansion
+     and applied by Controller::commitOutputs() (PWM and LED are applied at
+     once, as all the outputs if the expansion does not support
+     OPTA_CAPABILITY_COMMIT) */
+  unsigned int stageOutputs() override;
+
+  /* read the function of the channels from the expansion (warm restart of
+   * the Controller) and rebuild the configuration of the channels not known
+   * with the parameters of the beginChannelAs* functions
+   * channels that cannot be rebuilt (RTD, digital input, loop powered)
+   * return an error: the expansion is then set up again */
+  unsigned int resume() override;
+
   unsigned int execute(uint32_t what) override;
   void write(unsigned int address, unsigned int value) override;
   bool read(unsigned int address, unsigned int &value) override;
@@ -368,6 +411,9 @@ public:
    * discovered by the controller, the controller itself will call
    * this function as a callback set up correctly the expansion */
   static void startUp(Controller *ptr);
+  /* forget the outputs not yet sent to the expansion at index device (a
+   * different expansion may be there after a discovery) */
+  static void clearDirty(uint8_t device);
 
   void setProductData(uint8_t *data, uint8_t len);
 
@@ -411,6 +457,18 @@ public:
 protected:
   bool verify_address(unsigned int add) override;
   static OaChannelCfg cfgs[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* outputs changed but not yet sent to the expansion (bit mask of channels
+     for DAC and PWM) */
+  static uint8_t dac_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  static uint8_t pwm_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  static bool led_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  unsigned int flush_dac(bool apply = true);
+  unsigned int flush_outputs(bool apply_dac);
+  unsigned int flush_pwm();
+  /* -1 FW version not yet known, 0 SET ALL PWM message not supported, 1
+     supported */
+  static int8_t set_all_pwm_support[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  bool set_all_pwm_supported();
 
   uint8_t msg_begin_adc();
   uint8_t msg_begin_di();
@@ -425,6 +483,7 @@ protected:
   bool rtd_registers_defined();
 
   uint8_t msg_set_pwm();
+  uint8_t msg_set_all_pwm();
   uint8_t msg_get_adc();
   bool parse_ans_get_adc();
   uint8_t msg_set_dac();
@@ -440,8 +499,11 @@ protected:
 
   uint8_t msg_get_all_ai();
   bool parse_ans_get_all_ai();
+  uint8_t msg_get_latched();
+  bool parse_ans_get_latched();
 
   CfgFun_t get_channel_function(uint8_t ch);
+  bool resume_channel(uint8_t ch, CfgFun_t f);
 
 
 };
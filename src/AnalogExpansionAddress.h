@@ -23,6 +23,7 @@
 
 #define ADD_CH_FUNCTION (ANALOG_EXPANSION_ADDRESS + 4)
 #define ADD_OA_PIN_OUTPUT (ANALOG_EXPANSION_ADDRESS + 5)
+#define ADD_OA_PWM_MASK (ANALOG_EXPANSION_ADDRESS + 6)
 
 #define BASE_OA_ADD_BEGIN_FUNCTION (ANALOG_EXPANSION_ADDRESS + 10)
 #define ADD_OA_ADC_TYPE (BASE_OA_ADD_BEGIN_FUNCTION + 0)
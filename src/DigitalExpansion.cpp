@@ -79,6 +79,9 @@ uint16_t DigitalExpansion::timeouts[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
 uint8_t DigitalExpansion::last_expansion_output[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
     0, 0, 0, 0, 0};
 
+bool DigitalExpansion::output_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM] = {
+    false, false, false, false, false};
+
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 /* This function is called every time an assign address process is finished
    If the assign address process is due to a Controller reset the static 
@@ -92,6 +95,7 @@ void DigitalExpansion::startUp(Controller *ptr) {
     return;
   }
   for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+    clearDirty(i);
     DigitalExpansion exp = ptr->getExpansion(i);
     if (exp) {
       /* send timeout and default value */
@@ -114,17 +118,27 @@ void DigitalExpansion::startUp(Controller *ptr) {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+void DigitalExpansion::clearDirty(uint8_t device) {
+  if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    output_dirty[device] = false;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 void DigitalExpansion::setDefault(Controller &ptr, uint8_t device,
                                   uint8_t bit_mask, uint16_t timeout) {
   if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
     DigitalExpansion::defaults[device] = bit_mask;
     DigitalExpansion::timeouts[device] = timeout;
+    ptr.beginTransaction();
     uint8_t tx_bytes = DigitalExpansion::msgDefault(&ptr, device);
     if (tx_bytes) {
       ptr.send(ptr.getExpansionI2Caddress(device), device,
                ptr.getExpansionType(device), tx_bytes,
                getExpectedAnsLen(ANS_LEN_OD_SET_DIGITAL_OUTPUTS));
     }
+    ptr.endTransaction();
   }
 }
 
@@ -204,6 +218,34 @@ bool DigitalExpansion::parse_ans_set_di() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+uint8_t DigitalExpansion::msg_stage_do() {
+  if (ctrl != nullptr) {
+    /* restored as well when a reassign address process happens (the commit
+       is sent right after the stage) */
+    if (getIndex() < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+      last_expansion_output[getIndex()] = iregs[ADD_DIGITAL_OUTPUT];
+    }
+
+    ctrl->setTx(iregs[ADD_DIGITAL_OUTPUT], BP_PAYLOAD_START_POS);
+    return prepareSetMsg(ctrl->getTxBuffer(), ARG_OD_STAGE_DIGITAL_OUTPUTS,
+                         LEN_OD_STAGE_DIGITAL_OUTPUTS);
+  }
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool DigitalExpansion::parse_ans_stage_do() {
+  if (ctrl != nullptr) {
+    return checkAnsSetReceived(ctrl->getRxBuffer(),
+                               ANS_ARG_OD_STAGE_DIGITAL_OUTPUTS,
+                               ANS_LEN_OD_STAGE_DIGITAL_OUTPUTS);
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 /* get digital input */
 uint8_t DigitalExpansion::msg_get_di() {
   if (ctrl != nullptr) {
@@ -226,6 +268,34 @@ bool DigitalExpansion::parse_ans_get_di() {
   return false;
 }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/* get digital outputs */
+uint8_t DigitalExpansion::msg_get_do() {
+  if (ctrl != nullptr) {
+    return prepareGetMsg(ctrl->getTxBuffer(), ARG_OD_GET_DIGITAL_OUTPUTS,
+                         LEN_OD_GET_DIGITAL_OUTPUTS);
+  }
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+bool DigitalExpansion::parse_ans_get_do() {
+  if (ctrl != nullptr) {
+    if (checkAnsGetReceived(ctrl->getRxBuffer(),
+                            ANS_ARG_OD_GET_DIGITAL_OUTPUTS,
+                            ANS_LEN_OD_GET_DIGITAL_OUTPUTS)) {
+      iregs[ADD_DIGITAL_OUTPUT] = ctrl->getRx(BP_PAYLOAD_START_POS);
+      if (getIndex() < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+        last_expansion_output[getIndex()] = iregs[ADD_DIGITAL_OUTPUT];
+        output_dirty[getIndex()] = false;
+      }
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 /* msg get analog input */
 uint8_t DigitalExpansion::msg_get_ai() {
@@ -286,6 +356,44 @@ bool DigitalExpansion::parse_ans_get_all_ai() {
   return false;
 }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+/* msg get latched inputs */
+uint8_t DigitalExpansion::msg_get_latched() {
+  if (ctrl != nullptr) {
+    return prepareGetMsg(ctrl->getTxBuffer(), ARG_GET_LATCHED_INPUTS,
+                         LEN_GET_LATCHED_INPUTS);
+  }
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+bool DigitalExpansion::parse_ans_get_latched() {
+  if (ctrl != nullptr) {
+    if (checkAnsGetReceived(ctrl->getRxBuffer(), ANS_ARG_GET_LATCHED_INPUTS,
+                            ANS_LEN_OD_GET_LATCHED_INPUTS +
+                            latched_time_len())) {
+      /* snapshot of an older latch if LATCH INPUTS got lost */
+      latched = (ctrl->getRx(ANS_LATCHED_ID_POS) == ctrl->getLatchId());
+      if (latched) {
+        iregs[ADD_DIGITAL_INPUT] = ctrl->getRx(ANS_OD_LATCHED_DIN_POS);
+        iregs[ADD_DIGITAL_INPUT] +=
+            (ctrl->getRx(ANS_OD_LATCHED_DIN_POS + 1) << 8);
+        for (int i = 0, j = 0; i < ANALOG_IN_NUM; i++, j += 2) {
+          iregs[ANALOG_IN_FIRST_REG + i] =
+              ctrl->getRx(ANS_OD_LATCHED_AIN_POS + j);
+          iregs[ANALOG_IN_FIRST_REG + i] +=
+              (ctrl->getRx(ANS_OD_LATCHED_AIN_POS + j + 1) << 8);
+        }
+        set_sample_time(ANS_OD_LATCHED_TIME_POS);
+      }
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 uint8_t DigitalExpansion::msg_set_default_values() {
   if (ctrl != nullptr) {
     ctrl->setTx(iregs[CTRL_ADD_EXPANSION_PIN], BP_PAYLOAD_START_POS);
@@ -309,12 +417,24 @@ unsigned int DigitalExpansion::execute(uint32_t what) {
                       getExpectedAnsLen(ANS_LEN_OD_SET_DIGITAL_OUTPUTS));
       break;
     /* ------------------------------------------------------------------- */
+    case STAGE_DIGITAL_OUTPUT:
+      I2C_TRANSACTION(DigitalExpansion::msg_stage_do,
+                      DigitalExpansion::parse_ans_stage_do,
+                      getExpectedAnsLen(ANS_LEN_OD_STAGE_DIGITAL_OUTPUTS));
+      break;
+    /* ------------------------------------------------------------------- */
     case GET_DIGITAL_INPUT:
       I2C_TRANSACTION(DigitalExpansion::msg_get_di,
                       DigitalExpansion::parse_ans_get_di,
                       getExpectedAnsLen(ANS_LEN_OD_GET_DIGITAL_INPUTS));
       break;
     /* ------------------------------------------------------------------- */
+    case GET_DIGITAL_OUTPUT:
+      I2C_TRANSACTION(DigitalExpansion::msg_get_do,
+                      DigitalExpansion::parse_ans_get_do,
+                      getExpectedAnsLen(ANS_LEN_OD_GET_DIGITAL_OUTPUTS));
+      break;
+    /* ------------------------------------------------------------------- */
     case GET_SINGLE_ANALOG_INPUT:
       I2C_TRANSACTION(DigitalExpansion::msg_get_ai,
                       DigitalExpansion::parse_ans_get_ai,
@@ -326,6 +446,28 @@ unsigned int DigitalExpansion::execute(uint32_t what) {
                       DigitalExpansion::parse_ans_get_all_ai,
                       getExpectedAnsLen(ANS_LEN_OD_GET_ALL_ANALOG_INPUTS));
       break;
+    /* ------------------------------------------------------------------- */
+    case GET_LATCHED_INPUTS:
+      latched = false;
+      if (ctrl->hasFeature(index, OPTA_CAPABILITY_LATCH)) {
+        I2C_TRANSACTION(DigitalExpansion::msg_get_latched,
+                        DigitalExpansion::parse_ans_get_latched,
+                        getExpectedAnsLen(ANS_LEN_OD_GET_LATCHED_INPUTS +
+                                          latched_time_len()));
+      }
+      /* no snapshot (older firmware or latch lost): inputs read now */
+      if (i2c_rv == EXECUTE_OK && !latched) {
+        I2C_TRANSACTION(DigitalExpansion::msg_get_di,
+                        DigitalExpansion::parse_ans_get_di,
+                        getExpectedAnsLen(ANS_LEN_OD_GET_DIGITAL_INPUTS));
+        if (i2c_rv == EXECUTE_OK) {
+          I2C_TRANSACTION(DigitalExpansion::msg_get_all_ai,
+                          DigitalExpansion::parse_ans_get_all_ai,
+                          getExpectedAnsLen(ANS_LEN_OD_GET_ALL_ANALOG_INPUTS));
+        }
+        set_sample_time(-1);
+      }
+      break;
     default:
       i2c_rv = Expansion::execute(what);
       break;
@@ -341,14 +483,22 @@ unsigned int DigitalExpansion::execute(uint32_t what) {
 void DigitalExpansion::digitalWrite(int pin, PinStatus st,
                                     bool update /*= false*/) {
   if (pin >= 0 && pin <= DIGITAL_OUT_NUM) {
+    unsigned int prev = iregs[ADD_DIGITAL_OUTPUT];
     if (st == HIGH) {
       iregs[ADD_DIGITAL_OUTPUT] |= (1 << pin);
     } else {
       iregs[ADD_DIGITAL_OUTPUT] &= ~(1 << pin);
     }
 
+    if (prev != iregs[ADD_DIGITAL_OUTPUT] &&
+        getIndex() < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+      output_dirty[getIndex()] = true;
+    }
+
     if (update) {
       updateDigitalOutputs();
+    } else if (ctrl != nullptr) {
+      ctrl->updateRegs(*this);
     }
   }
 }
@@ -410,7 +560,58 @@ void DigitalExpansion::updateAnalogInputs() { execute(GET_ALL_ANALOG_INPUT); }
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 void DigitalExpansion::updateDigitalOutputs() {
-  /*uint8_t err = */ execute(SET_DIGITAL_OUTPUT);
+  uint8_t err = execute(SET_DIGITAL_OUTPUT);
+  if (err == EXECUTE_OK && getIndex() < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    output_dirty[getIndex()] = false;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int DigitalExpansion::flushOutputs() {
+  if (getIndex() >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  if (!output_dirty[getIndex()]) {
+    return EXECUTE_OK;
+  }
+  unsigned int err = execute(SET_DIGITAL_OUTPUT);
+  if (err == EXECUTE_OK) {
+    output_dirty[getIndex()] = false;
+  }
+  return err;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int DigitalExpansion::stageOutputs() {
+  /* older firmware: the outputs are applied at once */
+  if (ctrl == nullptr ||
+      !ctrl->hasFeature(getIndex(), OPTA_CAPABILITY_COMMIT)) {
+    return flushOutputs();
+  }
+  if (getIndex() >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  if (!output_dirty[getIndex()]) {
+    return EXECUTE_OK;
+  }
+  unsigned int err = execute(STAGE_DIGITAL_OUTPUT);
+  if (err == EXECUTE_OK) {
+    output_dirty[getIndex()] = false;
+  }
+  return err;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int DigitalExpansion::resume() {
+  /* older firmware: the outputs cannot be read back */
+  if (ctrl == nullptr ||
+      !ctrl->hasFeature(getIndex(), OPTA_CAPABILITY_GET_OUTPUTS)) {
+    return EXECUTE_ERR_PROTOCOL;
+  }
+  return execute(GET_DIGITAL_OUTPUT);
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
@@ -447,6 +648,7 @@ void DigitalExpansion::write(unsigned int address, unsigned int value) {
   } else if (address >= ADD_DIGITAL_0_OUTPUT &&
              address <= ADD_DIGITAL_7_OUTPUT) {
     int pin = address - DIGITAL_EXPANSION_ADDRESS - BASE_ADD_DIGITAL_OUTPUT;
+    unsigned int prev = iregs[ADD_DIGITAL_OUTPUT];
     if (value == 0) {
       /* reset PIN */
       iregs[ADD_DIGITAL_OUTPUT] &= ~(1 << pin);
@@ -454,6 +656,10 @@ void DigitalExpansion::write(unsigned int address, unsigned int value) {
       /* set PIN */
       iregs[ADD_DIGITAL_OUTPUT] |= (1 << pin);
     }
+    if (prev != iregs[ADD_DIGITAL_OUTPUT] &&
+        getIndex() < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+      output_dirty[getIndex()] = true;
+    }
     return;
   }
   return Expansion::write(address, value);
@@ -40,9 +40,15 @@ protected:
   /* set digital input */
   uint8_t msg_set_di();
   bool parse_ans_set_di();
+  /* stage digital outputs (applied by COMMIT OUTPUTS) */
+  uint8_t msg_stage_do();
+  bool parse_ans_stage_do();
   /* get digital input */
   uint8_t msg_get_di();
   bool parse_ans_get_di();
+  /* get digital outputs */
+  uint8_t msg_get_do();
+  bool parse_ans_get_do();
   /* msg get analog input */
   uint8_t msg_get_ai();
   bool parse_ans_get_ai();
@@ -52,10 +58,15 @@ protected:
   /* msg get all analog input */
   uint8_t msg_get_all_ai();
   bool parse_ans_get_all_ai();
+  /* msg get latched inputs */
+  uint8_t msg_get_latched();
+  bool parse_ans_get_latched();
 
   static uint16_t timeouts[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
   static uint8_t defaults[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
   static uint8_t last_expansion_output[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* digital outputs changed but not yet sent to the expansion */
+  static bool output_dirty[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
 
 public:
   DigitalExpansion();
@@ -113,6 +124,20 @@ public:
    * we update the actual value with this function)*/
   void updateDigitalOutputs();
 
+  /* send the digital outputs to the expansion only if they changed since the
+   * last time they were sent (no I2C transaction is performed otherwise)
+   * returns EXECUTE_OK or the error met */
+  unsigned int flushOutputs() override;
+
+  /* as flushOutputs() but the outputs are only staged on the expansion and
+   * applied by Controller::commitOutputs() (sent at once if the expansion
+   * does not support OPTA_CAPABILITY_COMMIT) */
+  unsigned int stageOutputs() override;
+
+  /* read the digital outputs from the expansion (warm restart of the
+   * Controller) */
+  unsigned int resume() override;
+
   void setProductData(uint8_t *data, uint8_t len);
   void setIsMechanical();
   void setIsStateSolid();
@@ -121,6 +146,9 @@ public:
   bool read(unsigned int address, unsigned int &value) override;
   static uint8_t msgDefault(Controller *ptr, uint8_t device);
   static void startUp(Controller *ptr);
+  /* forget the outputs not yet sent to the expansion at index device (a
+   * different expansion may be there after a discovery) */
+  static void clearDirty(uint8_t device);
   static void setDefault(Controller &ptr, uint8_t device, uint8_t bit_mask,
                          uint16_t timeout);
   static uint8_t calcDefault(bool p0, bool p1, bool p2, bool p3, bool p4,
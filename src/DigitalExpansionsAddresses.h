@@ -108,6 +108,8 @@
   (DIGITAL_EXPANSION_ADDRESS + BASE_ADD_ANALOG_IN + 15)
 
 #define MAX_FLASH_DATA 32
+/* addresses of the data flash are 16 bits */
+#define OPTA_FLASH_ADDRESS_SPACE 0x10000UL
 #define BASE_ADD_FLASH_DATA 60
 #define ADD_FLASH_0 (DIGITAL_EXPANSION_ADDRESS + BASE_ADD_FLASH_DATA + 0)
 
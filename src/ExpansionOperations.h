@@ -43,6 +43,13 @@
 #define SET_ALL_ANALOG_OUTPUTS 19
 #define BEGIN_CHANNEL_AS_HIGH_IMP 20
 #define GET_CHANNEL_FUNCTION 21
+#define SET_ALL_PWM 22
+#define GET_DIGITAL_OUTPUT 23 // Digital
+/* inputs latched by Controller::latchInputs() */
+#define GET_LATCHED_INPUTS 24 // Digital, Analog
+/* outputs applied by Controller::commitOutputs() */
+#define STAGE_DIGITAL_OUTPUT 25 // Digital
+#define GET_COMMIT_READY 26
 
 
 #endif
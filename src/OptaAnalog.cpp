@@ -149,6 +149,29 @@ void OptaAnalog::updatePwm(uint8_t ch) {
   pwm[ch].pulse_us = pwm[ch].set_pulse_us;
 }
 
+/* -------------------------------------------------------------------------- */
+void OptaAnalog::updatePwm() {
+/* ------------------------------------------------------------------------ */
+
+  /* pending values are written by the I2C receive handler: they are copied
+   * with interrupts disabled so that a SET ALL PWM message is never applied
+   * only in part */
+  noInterrupts();
+  uint8_t mask = pwm_pending_mask;
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    if (mask & (1 << ch)) {
+      pwm[ch].set_period_us = pwm_period_pending[ch];
+      pwm[ch].set_pulse_us = pwm_pulse_pending[ch];
+    }
+  }
+  pwm_pending_mask = 0;
+  interrupts();
+
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    updatePwm(ch);
+  }
+}
+
 /* -------------------------------------------------------------------------- */
 void OptaAnalog::updatePwmWithDefault(uint8_t ch) {
 /* ------------------------------------------------------------------------ */
@@ -313,8 +336,8 @@ void OptaAnalog::begin() {
 #ifdef DEBUG_UPDATE_FW
 /* used to recognize sw version with led blinking during fw update tests*/
 void OptaAnalog::debug_with_leds() {
-  static unsigned long start = millis();
-  static bool status = true;
+  static OPTA_PER_MCU unsigned long start = millis();
+  static OPTA_PER_MCU bool status = true;
 
   if (millis() - start > 2000) {
     start = millis();
@@ -377,7 +400,7 @@ void OptaAnalog::update() {
   }
   Module::update();
 
-  static unsigned long last_rtd_update = millis();
+  static OPTA_PER_MCU unsigned long last_rtd_update = millis();
   if (millis() - last_rtd_update > rtd_update_time) {
     last_rtd_update = millis();
     updateRtd();
@@ -390,9 +413,7 @@ void OptaAnalog::update() {
     }
   }
   else {
-    for (int i = 0; i < OA_PWM_CHANNELS_NUM; i++) {
-      updatePwm(i);
-    }
+    updatePwm();
   }
   Module::update();
 
@@ -1381,6 +1402,17 @@ void OptaAnalog::toggle_ldac() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+/* same as toggle_ldac() without waiting (used in the I2C interrupt): the
+   DAC_CODE registers are copied in the DAC_ACTIVE ones on the falling edge */
+void OptaAnalog::pulse_ldac() {
+  digitalWrite(LDAC1, LOW);
+  digitalWrite(LDAC2, LOW);
+  digitalWrite(LDAC1, HIGH);
+  digitalWrite(LDAC2, HIGH);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 void OptaAnalog::reset_dac_value(uint8_t ch) {
   if (ch < OA_AN_CHANNELS_NUM) {
     write_reg(OA_REG_DAC_CODE, 0, ch);
@@ -2174,15 +2206,7 @@ bool OptaAnalog::parse_get_all_adc_value() {
 
     const int s = ANS_OA_ADC_GET_ALL_VALUE_POS;
     for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
-
-      uint16_t value = 0;
-      if (adc[ch].mov_average_req > 0) {
-        value = (uint16_t)adc[ch].average;
-
-      } else {
-        value = adc[ch].conversion;
-      }
-
+      uint16_t value = adc_value(ch);
       tx_buffer[s + 2 * ch] = (uint8_t)(value & 0xFF);
       tx_buffer[s + 2 * ch + 1] = (uint8_t)((value & 0xFF00) >> 8);
     }
@@ -2195,6 +2219,30 @@ bool OptaAnalog::parse_get_all_adc_value() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+uint16_t OptaAnalog::adc_value(uint8_t ch) {
+  if (adc[ch].mov_average_req > 0) {
+    return (uint16_t)adc[ch].average;
+  }
+  return adc[ch].conversion;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int OptaAnalog::latch_inputs(uint8_t *buf, int max) {
+  if (max < ANS_LEN_OA_GET_DI + ANS_LEN_OA_GET_ALL_ADC) {
+    return 0;
+  }
+  buf[0] = digital_ins;
+  for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+    uint16_t value = adc_value(ch);
+    buf[ANS_LEN_OA_GET_DI + 2 * ch] = (uint8_t)(value & 0xFF);
+    buf[ANS_LEN_OA_GET_DI + 2 * ch + 1] = (uint8_t)((value & 0xFF00) >> 8);
+  }
+  return ANS_LEN_OA_GET_DI + ANS_LEN_OA_GET_ALL_ADC;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 bool OptaAnalog::parse_set_pwm_value() {
   bool rv = false;
   uint8_t ch = rx_buffer[OA_SET_PWM_CHANNEL_POS];
@@ -2213,6 +2261,9 @@ bool OptaAnalog::parse_set_pwm_value() {
 
   if (checkSetMsgReceived(rx_buffer, ARG_OA_SET_PWM, LEN_OA_SET_PWM)) {
     if(ch >= OA_PWM_CHANNELS_NUM) { return true; }
+    /* a SET ALL PWM still pending is older: it must not overwrite this
+       value of the channel */
+    pwm_pending_mask &= ~(1 << ch);
     /* setting present PWM values */
     configurePwmPeriod(ch, period);
     configurePwmPulse(ch, pulse);
@@ -2234,6 +2285,52 @@ bool OptaAnalog::parse_set_pwm_value() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+bool OptaAnalog::parse_set_all_pwm_value() {
+  bool is_default = false;
+  if (checkSetMsgReceived(rx_buffer, ARG_OA_SET_ALL_PWM, LEN_OA_SET_ALL_PWM)) {
+    is_default = false;
+  }
+  else if (checkSetMsgReceived(rx_buffer, ARG_OA_SET_ALL_PWM_DEFAULT,
+                               LEN_OA_SET_ALL_PWM)) {
+    is_default = true;
+  }
+  else {
+    return false;
+  }
+
+  uint8_t mask = rx_buffer[OA_SET_ALL_PWM_MASK_POS] & OA_PWM_ALL_CH_MASK;
+  for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+    if (!(mask & (1 << ch))) {
+      continue;
+    }
+    uint8_t pos = OA_SET_ALL_PWM_FIRST_CH_POS + ch * OA_SET_ALL_PWM_CH_DIM;
+    uint32_t period = 0;
+    uint32_t pulse = 0;
+    for (int i = 0; i < 4; i++) {
+      period |= ((uint32_t)rx_buffer[pos + OA_SET_ALL_PWM_PERIOD_OFFSET + i])
+                << (8 * i);
+      pulse |= ((uint32_t)rx_buffer[pos + OA_SET_ALL_PWM_PULSE_OFFSET + i])
+               << (8 * i);
+    }
+    if (is_default) {
+      pwm_period_defaults[ch] = period;
+      pwm_pulse_defaults[ch] = pulse;
+    }
+    else {
+      pwm_period_pending[ch] = period;
+      pwm_pulse_pending[ch] = pulse;
+    }
+  }
+  if (!is_default) {
+    pwm_pending_mask |= mask;
+  }
+
+  prepareSetAns(tx_buffer, ANS_ARG_OA_ACK, ANS_LEN_OA_ACK);
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 bool OptaAnalog::parse_get_di_value() {
   if (checkGetMsgReceived(rx_buffer, ARG_OA_GET_DI,LEN_OA_GET_DI)) {
     tx_buffer[ANS_OA_GET_DI_VALUE_POS] = digital_ins;
@@ -2342,6 +2439,11 @@ int OptaAnalog::parse_rx() {
   } else if (parse_set_pwm_value()) {
 #if defined DEBUG_SERIAL && defined DEBUG_ANALOG_PARSE_MESSAGE
     Serial.println("set PWM value");
+#endif
+    rv = getExpectedAnsLen(ANS_LEN_OA_ACK);
+  } else if (parse_set_all_pwm_value()) {
+#if defined DEBUG_SERIAL && defined DEBUG_ANALOG_PARSE_MESSAGE
+    Serial.println("set all PWM values");
 #endif
     rv = getExpectedAnsLen(ANS_LEN_OA_ACK);
   } else if (parse_setup_rtd_channel()) {
@@ -2511,6 +2613,42 @@ uint8_t OptaAnalog::getMajorFw() { return FW_VERSION_MAJOR; }
 uint8_t OptaAnalog::getMinorFw() { return FW_VERSION_MINOR; }
 uint8_t OptaAnalog::getReleaseFw() { return FW_VERSION_RELEASE; }
 
+uint16_t OptaAnalog::getCapabilities() {
+  return Module::getCapabilities() | OPTA_CAPABILITY_LATCH |
+         OPTA_CAPABILITY_COMMIT;
+}
+
+/* the DAC values staged (SET DAC without update) are written in the DAC_CODE
+   registers by update(): if all of them are already there the DAC outputs
+   are applied at once, otherwise update() applies them as soon as the last
+   one is written */
+void OptaAnalog::commit_outputs() {
+  if (are_all_dac_updated()) {
+    pulse_ldac();
+  } else {
+    update_dac_using_LDAC = true;
+  }
+}
+
+/* all the DAC values staged have been written in the DAC_CODE registers */
+bool OptaAnalog::commit_ready() { return are_all_dac_updated(); }
+
+/* functions of the channels, default values of the outputs and RTD update
+   time */
+uint32_t OptaAnalog::getConfigHash() {
+  uint32_t h = OPTA_MODULE_CFG_HASH_INIT;
+  h = hashConfig(h, output_fun, sizeof(output_fun));
+  for (int i = 0; i < OA_AN_CHANNELS_NUM; i++) {
+    uint16_t d = dac_defaults[i];
+    h = hashConfig(h, &d, sizeof(d));
+  }
+  for (int i = 0; i < OA_PWM_CHANNELS_NUM; i++) {
+    uint32_t p[2] = {pwm_period_defaults[i], pwm_pulse_defaults[i]};
+    h = hashConfig(h, p, sizeof(p));
+  }
+  return hashConfig(h, &rtd_update_time, sizeof(rtd_update_time));
+}
+
 std::string OptaAnalog::getProduct() {
   std::string rv(OPTA_ANALOG_DESCRIPTION);
   return rv;
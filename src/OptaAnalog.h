@@ -66,6 +66,11 @@ private:
   volatile uint16_t dac_defaults[OA_AN_CHANNELS_NUM];
   volatile uint32_t pwm_period_defaults[OA_PWM_CHANNELS_NUM];
   volatile uint32_t pwm_pulse_defaults[OA_PWM_CHANNELS_NUM];
+  /* values received with SET ALL PWM, they are moved into pwm[] all
+     together by updatePwm() */
+  volatile uint32_t pwm_period_pending[OA_PWM_CHANNELS_NUM];
+  volatile uint32_t pwm_pulse_pending[OA_PWM_CHANNELS_NUM];
+  volatile uint8_t pwm_pending_mask = 0;
   volatile bool dac_value_updated[OA_AN_CHANNELS_NUM];
   volatile uint16_t dac_values[OA_AN_CHANNELS_NUM];
 
@@ -172,12 +177,21 @@ private:
   bool parse_set_all_dac_value();
   bool parse_get_di_value();
   bool parse_set_pwm_value();
+  bool parse_set_all_pwm_value();
   bool parse_get_rtd_value();
   bool parse_set_rtd_update_rate();
   bool parse_set_led();
   bool parse_get_channel_func();
+  /* DI value and ADC value of all the channels (LATCH INPUTS) */
+  int latch_inputs(uint8_t *buf, int max) override;
+  /* apply the DAC values staged (COMMIT OUTPUTS) */
+  void commit_outputs() override;
+  bool commit_ready() override;
+  /* value answered for the ADC channel ch (moving average if enabled) */
+  uint16_t adc_value(uint8_t ch);
 
   void toggle_ldac();
+  void pulse_ldac();
 
   void reset_dac_value(uint8_t ch);
 
@@ -198,6 +212,8 @@ public:
   uint8_t getMinorFw();
   uint8_t getReleaseFw();
   std::string getProduct();
+  uint16_t getCapabilities() override;
+  uint32_t getConfigHash() override;
   void goInBootloaderMode();
   void readFromFlash(uint16_t add, uint8_t *buffer, uint8_t dim);
   void writeInFlash(uint16_t add, uint8_t *buffer, uint8_t dim);
@@ -356,6 +372,9 @@ public:
   /* update PWM, if is not active the Pwm is automatically
    * started */
   void updatePwm(uint8_t ch);
+  /* apply the values received with SET ALL PWM and update all the PWMs in
+   * the same pass */
+  void updatePwm();
   void updatePwmWithDefault(uint8_t ch);
   /* suspend the PWM */
   void suspendPwm(uint8_t ch);
@@ -16,7 +16,7 @@
 
 #define FW_VERSION_MAJOR 0
 #define FW_VERSION_MINOR 1
-#define FW_VERSION_RELEASE 14
+#define FW_VERSION_RELEASE 15
 
 
 #define OPTA_ANALOG_WATCHTDOG_TIME_ms 0xFFFF
@@ -143,6 +143,15 @@
 #define ANS_LEN_OA_GET_DI 0x01
 #define ANS_OA_GET_DI_VALUE_POS 0x03
 
+/* ANSWER from expansion: get latched inputs (see OptaModuleProtocol.h), latch
+   id, DI value and ADC value of all the channels (2 bytes each, LSB first) */
+#define ANS_LEN_OA_GET_LATCHED_INPUTS                                          \
+  (1 + ANS_LEN_OA_GET_DI + ANS_LEN_OA_GET_ALL_ADC)
+#define ANS_OA_LATCHED_DI_POS (BP_HEADER_DIM + 1)
+#define ANS_OA_LATCHED_ADC_POS (ANS_OA_LATCHED_DI_POS + ANS_LEN_OA_GET_DI)
+/* time the inputs were latched at (only with OPTA_CAPABILITY_TIME) */
+#define ANS_OA_LATCHED_TIME_POS (BP_HEADER_DIM + ANS_LEN_OA_GET_LATCHED_INPUTS)
+
 /* #################### */
 /* PWM related messages */
 /* #################### */
@@ -155,6 +164,20 @@
 #define OA_SET_PWM_PERIOD_POS 0x04
 #define OA_SET_PWM_PULSE_POS 0x08
 
+/* REQUEST from controller: set PWM period and pulse of all the channels at
+ * once - argument 0x23 */
+#define ARG_OA_SET_ALL_PWM 0x23
+#define ARG_OA_SET_ALL_PWM_DEFAULT 0x43
+// payload is 33 bytes:
+// - channel mask (1 byte) only channels with the bit set are changed
+// - for each channel from 0 to 3 period (4 bytes) and pulse (4 bytes)
+#define LEN_OA_SET_ALL_PWM 0x21
+#define OA_SET_ALL_PWM_MASK_POS 0x03
+#define OA_SET_ALL_PWM_FIRST_CH_POS 0x04
+#define OA_SET_ALL_PWM_CH_DIM 0x08
+#define OA_SET_ALL_PWM_PERIOD_OFFSET 0x00
+#define OA_SET_ALL_PWM_PULSE_OFFSET 0x04
+
 /* #################### */
 /* GPO related messages */
 /* #################### */
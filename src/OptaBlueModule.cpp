@@ -30,12 +30,12 @@
 #define DETECT_OUT 0
 #endif
 
-Module *OptaExpansion = nullptr;
+OPTA_PER_MCU Module *OptaExpansion = nullptr;
 
-TwoWire *Module::expWire = nullptr;
+OPTA_PER_MCU TwoWire *Module::expWire = nullptr;
 
 /* 20240515_moved_I2C_reset moved reset I2C to main */
-volatile bool reset_I2C_bus = false;
+OPTA_PER_MCU volatile bool reset_I2C_bus = false;
 
 #define NACK_ANSWER_LEN (2)
 static uint8_t nack_answer[NACK_ANSWER_LEN] = {0xFA, 0xFE};
@@ -52,7 +52,7 @@ void receive_event(int n) {
 
   if (OptaExpansion != nullptr && Module::expWire != nullptr) {
     OptaExpansion->setRxNum(0);
-    for (int i = 0; i < n && i < OPTA_I2C_BUFFER_DIM; i++) {
+    for (int i = 0; i < n && i < OPTA_I2C_LARGE_BUFFER_DIM; i++) {
       int r = Module::expWire->read();
 
 #if defined DEBUG_SERIAL && defined DEBUG_RX_MODULE_ENABLE
@@ -109,14 +109,14 @@ void request_event() {
 
 /* set the tx_buffer @ position pos with value v */
 void Module::tx(uint8_t v, int pos) {
-  if (pos >= 0 && pos < OPTA_I2C_BUFFER_DIM) {
+  if (pos >= 0 && pos < OPTA_I2C_LARGE_BUFFER_DIM) {
     tx_buffer[pos] = v;
   }
 }
 
 /* get value of tx_buffer @ position pos */
 uint8_t Module::tx(int pos) {
-  if (pos >= 0 && pos < OPTA_I2C_BUFFER_DIM) {
+  if (pos >= 0 && pos < OPTA_I2C_LARGE_BUFFER_DIM) {
     return tx_buffer[pos];
   }
   return 0;
@@ -124,7 +124,7 @@ uint8_t Module::tx(int pos) {
 
 /* get value of rx buffer @ position pos */
 uint8_t Module::rx(int pos) {
-  if (pos >= 0 && pos < OPTA_I2C_BUFFER_DIM) {
+  if (pos >= 0 && pos < OPTA_I2C_LARGE_BUFFER_DIM) {
     return rx_buffer[pos];
   }
   return 0;
@@ -132,7 +132,7 @@ uint8_t Module::rx(int pos) {
 
 /* set rx_buffer @ position pos with value v */
 void Module::rx(uint8_t v, int pos) {
-  if (pos >= 0 && pos < OPTA_I2C_BUFFER_DIM) {
+  if (pos >= 0 && pos < OPTA_I2C_LARGE_BUFFER_DIM) {
     rx_buffer[pos] = v;
   }
 }
@@ -142,9 +142,9 @@ void Module::setRxNum(uint8_t n) { rx_num = n; }
 /* get the number of bytes received into the rx_buffer */
 uint8_t Module::getRxNum() { return rx_num; }
 /* set the number of bytes to be transmitted in the tx_buffer */
-void Module::setTxNum(int8_t n) { tx_num = n; }
+void Module::setTxNum(int n) { tx_num = n; }
 /* get the number of bytes to be transmitted in the tx_buffer */
-int8_t Module::getTxNum() { return tx_num; }
+int Module::getTxNum() { return tx_num; }
 /* returns the pointer to the tx buffer */
 uint8_t *Module::txPrt() { return tx_buffer; }
 
@@ -161,6 +161,10 @@ void Module::reset() {
   #endif
 
   setStatusLedWaitingForAddress();
+  /* the Controller negotiates the features again after the address */
+  features = 0;
+  fast_plus = false;
+  latch_num = 0;
   /* put address to invalid */
   wire_i2c_address = OPTA_DEFAULT_SLAVE_I2C_ADDRESS;
   rx_i2c_address = OPTA_DEFAULT_SLAVE_I2C_ADDRESS; 
@@ -261,6 +265,11 @@ void Module::update() {
   }
 
   updatePinStatus();
+  updateClock();
+
+  if (transfer_queued) {
+    execute_transfer();
+  }
 
   if (reset_required) {
     reset();
@@ -276,7 +285,7 @@ void Module::update() {
   }
 
 #if defined DEBUG_SERIAL && defined DEBUG_EXPANSION_PRINT_ADDRESS
-  static unsigned long int start = millis();
+  static OPTA_PER_MCU unsigned long int start = millis();
 
   if (millis() - start > 1000) {
     start = millis();
@@ -353,6 +362,422 @@ int Module::prepare_ans_get_product() {
   int rv = prepareGetAns(tx_buffer, ANS_ARG_GET_PRODUCT_TYPE,ANS_LEN_GET_PRODUCT_TYPE);
   return rv;
 }
+/* ------------------------------------------------------------------------ */
+bool Module::parse_identify() {
+  /* ---------------------------------------------------------------------- */
+  if (checkGetMsgReceived(rx_buffer, ARG_IDENTIFY, LEN_IDENTIFY)) {
+    return true;
+  }
+  return false;
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::prepare_ans_identify() {
+  /* ---------------------------------------------------------------------- */
+  std::string pr(getProduct());
+  memset(tx_buffer, 0x0, OPTA_I2C_BUFFER_DIM);
+  tx_buffer[IDENTIFY_TYPE_POS] = expansion_type;
+  tx_buffer[IDENTIFY_FW_MAJOR_POS] = getMajorFw();
+  tx_buffer[IDENTIFY_FW_MINOR_POS] = getMinorFw();
+  tx_buffer[IDENTIFY_FW_RELEASE_POS] = getReleaseFw();
+  tx_buffer[IDENTIFY_PROTOCOL_POS] = OPTA_BLUE_PROTOCOL_VERSION;
+  uint16_t cap = getCapabilities();
+  tx_buffer[IDENTIFY_CAPABILITIES_POS] = (uint8_t)cap;
+  tx_buffer[IDENTIFY_CAPABILITIES_POS + 1] = (uint8_t)(cap >> 8);
+  uint32_t hash = getConfigHash();
+  for (int i = 0; i < 4; i++) {
+    tx_buffer[IDENTIFY_CFG_HASH_POS + i] = (uint8_t)(hash >> (8 * i));
+  }
+  unsigned int size = 0;
+  for (; size < pr.size() && size < IDENTIFY_PRODUCT_DIM; size++) {
+    tx_buffer[IDENTIFY_PRODUCT_POS + size] = pr[size];
+  }
+  tx_buffer[IDENTIFY_PRODUCT_SIZE_POS] = size;
+  return prepareGetAns(tx_buffer, ANS_ARG_IDENTIFY, ANS_LEN_IDENTIFY);
+}
+
+/* ------------------------------------------------------------------------ */
+void Module::updateClock() {
+  /* ---------------------------------------------------------------------- */
+  /* the timing of the I2C is changed here and not in the rx callback: the
+     Controller raises the clock only some time after SET FEATURES */
+  bool fp = isFeatureEnabled(OPTA_CAPABILITY_FAST_PLUS);
+  if (fp != fast_plus && Module::expWire != nullptr) {
+    Module::expWire->setClock((fp) ? OPTA_I2C_FAST_PLUS_CLOCK
+                                   : OPTA_I2C_FAST_CLOCK);
+    fast_plus = fp;
+  }
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_set_features() {
+  /* ---------------------------------------------------------------------- */
+  if (checkSetMsgReceived(rx_buffer, ARG_SET_FEATURES, LEN_SET_FEATURES)) {
+    uint16_t req = rx_buffer[SET_FEATURES_POS] |
+                   (rx_buffer[SET_FEATURES_POS + 1] << 8);
+    features = req & getCapabilities();
+    return true;
+  }
+  return false;
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::prepare_ans_set_features() {
+  /* ---------------------------------------------------------------------- */
+  tx_buffer[ANS_SET_FEATURES_POS] = (uint8_t)features;
+  tx_buffer[ANS_SET_FEATURES_POS + 1] = (uint8_t)(features >> 8);
+  return prepareSetAns(tx_buffer, ANS_ARG_SET_FEATURES, ANS_LEN_SET_FEATURES);
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_transfer() {
+  /* ---------------------------------------------------------------------- */
+  uint8_t len = rx_buffer[BP_LEN_POS];
+  if (len < LEN_TRANSFER_MIN ||
+      len + BP_HEADER_DIM >= OPTA_I2C_LARGE_BUFFER_DIM ||
+      !checkSetMsgReceived(rx_buffer, ARG_TRANSFER, len)) {
+    return false;
+  }
+  uint8_t arg = rx_buffer[TRANSFER_ARG_POS];
+  uint8_t seq = rx_buffer[TRANSFER_SEQ_POS];
+  uint8_t flags = rx_buffer[TRANSFER_FLAGS_POS];
+  uint8_t id = flags & TRANSFER_FLAG_ID;
+  uint16_t dim = len - LEN_TRANSFER_MIN;
+
+  /* the CRC of the frame: a repetition is the same last fragment */
+  uint8_t crc = rx_buffer[BP_HEADER_DIM + len];
+
+  if ((flags & TRANSFER_FLAG_LAST) && transfer_done && id == transfer_id &&
+      arg == transfer_arg && (uint8_t)(seq + 1) == transfer_seq &&
+      crc == transfer_last_crc) {
+    /* last fragment sent again: answer again */
+    return true;
+  }
+  if (transfer_queued) {
+    /* the buffer is in use by update() */
+    return (flags & TRANSFER_FLAG_LAST) != 0;
+  }
+  if (flags & TRANSFER_FLAG_FIRST) {
+    transfer_arg = arg;
+    transfer_id = id;
+    transfer_seq = 0;
+    transfer_dim = 0;
+    transfer_ans_dim = 0;
+    transfer_status = TRANSFER_OK;
+    transfer_done = false;
+  }
+  if (transfer_done) {
+    /* fragment of a transfer whose first fragment got lost */
+    transfer_status = TRANSFER_ERR_SEQUENCE;
+  } else if (transfer_status == TRANSFER_OK) {
+    if (seq != transfer_seq || arg != transfer_arg || id != transfer_id) {
+      transfer_status = TRANSFER_ERR_SEQUENCE;
+    } else if (transfer_dim + dim > OPTA_TRANSFER_MAX_DIM) {
+      transfer_status = TRANSFER_ERR_OVERFLOW;
+    } else {
+      memcpy(transfer_buffer + transfer_dim, rx_buffer + TRANSFER_DATA_POS,
+             dim);
+      transfer_dim += dim;
+      transfer_seq++;
+    }
+  }
+  if (!(flags & TRANSFER_FLAG_LAST)) {
+    return false;
+  }
+  transfer_last_crc = crc;
+  if (!transfer_done && transfer_status == TRANSFER_OK) {
+    transfer_rx_crc = OptaCrc8::calc(transfer_buffer, transfer_dim, 0);
+    if (transfer_arg == ARG_SAVE_IN_DATA_FLASH) {
+      /* several flash blocks are written and read back: too long for the
+         I2C receive callback */
+      transfer_status = TRANSFER_BUSY;
+      transfer_queued = true;
+    } else {
+      execute_transfer();
+    }
+  }
+  transfer_done = true;
+  return true;
+}
+
+/* ------------------------------------------------------------------------ */
+void Module::execute_transfer() {
+  /* ---------------------------------------------------------------------- */
+  /* the answer is written over the payload */
+  int rv = parse_transfer(transfer_arg, transfer_buffer, transfer_dim,
+                          OPTA_TRANSFER_MAX_DIM);
+  if (rv >= 0) {
+    transfer_ans_dim = (uint16_t)rv;
+    transfer_ans_crc = OptaCrc8::calc(transfer_buffer, transfer_ans_dim, 0);
+  }
+  /* the status last: it makes the answer valid */
+  transfer_status = (rv < 0) ? (uint8_t)(-rv) : TRANSFER_OK;
+  transfer_queued = false;
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::prepare_ans_transfer() {
+  /* ---------------------------------------------------------------------- */
+  tx_buffer[ANS_TRANSFER_ARG_POS] = transfer_arg;
+  tx_buffer[ANS_TRANSFER_STATUS_POS] = transfer_status;
+  tx_buffer[ANS_TRANSFER_RX_DIM_POS] = (uint8_t)transfer_dim;
+  tx_buffer[ANS_TRANSFER_RX_DIM_POS + 1] = (uint8_t)(transfer_dim >> 8);
+  tx_buffer[ANS_TRANSFER_ANS_DIM_POS] = (uint8_t)transfer_ans_dim;
+  tx_buffer[ANS_TRANSFER_ANS_DIM_POS + 1] = (uint8_t)(transfer_ans_dim >> 8);
+  tx_buffer[ANS_TRANSFER_RX_CRC_POS] = transfer_rx_crc;
+  tx_buffer[ANS_TRANSFER_ANS_CRC_POS] = transfer_ans_crc;
+  return prepareSetAns(tx_buffer, ANS_ARG_TRANSFER, ANS_LEN_TRANSFER);
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_transfer_ans() {
+  /* ---------------------------------------------------------------------- */
+  return checkGetMsgReceived(rx_buffer, ARG_TRANSFER_ANS, LEN_TRANSFER_ANS);
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::prepare_ans_transfer_ans() {
+  /* ---------------------------------------------------------------------- */
+  uint8_t seq = rx_buffer[TRANSFER_ANS_SEQ_POS];
+  uint16_t dim = rx_buffer[TRANSFER_ANS_DIM_POS];
+  uint32_t offset = (uint32_t)seq * dim;
+  if (!transfer_done || transfer_status != TRANSFER_OK || dim == 0 ||
+      dim + ANS_LEN_TRANSFER_ANS_MIN + BP_HEADER_DIM >=
+          OPTA_I2C_LARGE_BUFFER_DIM ||
+      offset >= transfer_ans_dim) {
+    return -1;
+  }
+  if (offset + dim >= transfer_ans_dim) {
+    dim = transfer_ans_dim - offset;
+    tx_buffer[ANS_TRANSFER_ANS_FLAGS_POS] = TRANSFER_FLAG_LAST;
+  } else {
+    tx_buffer[ANS_TRANSFER_ANS_FLAGS_POS] = 0;
+  }
+  tx_buffer[ANS_TRANSFER_ANS_SEQ_POS] = seq;
+  memcpy(tx_buffer + ANS_TRANSFER_ANS_DATA_POS, transfer_buffer + offset, dim);
+  return prepareGetAns(tx_buffer, ANS_ARG_TRANSFER_ANS,
+                       ANS_LEN_TRANSFER_ANS_MIN + dim);
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_latch_inputs() {
+  /* ---------------------------------------------------------------------- */
+  if (checkSetMsgReceived(rx_buffer, ARG_LATCH_INPUTS, LEN_LATCH_INPUTS)) {
+    if (isFeatureEnabled(OPTA_CAPABILITY_LATCH)) {
+      uint32_t t = getTime();
+      latch_buffer[ANS_LATCHED_ID_POS] = rx_buffer[LATCH_INPUTS_ID_POS];
+      int n = latch_inputs(latch_buffer + ANS_LATCHED_INPUTS_POS,
+                           OPTA_I2C_BUFFER_DIM - ANS_LATCHED_INPUTS_POS - 1 -
+                               ANS_LEN_LATCHED_TIME);
+      n += add_latch_time(latch_buffer + ANS_LATCHED_INPUTS_POS + n, t);
+      latch_num = prepareGetAns(latch_buffer, ANS_ARG_GET_LATCHED_INPUTS,
+                                ANS_LEN_GET_LATCHED_INPUTS_MIN + n);
+    }
+    return true;
+  }
+  return false;
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_get_latched_inputs() {
+  /* ---------------------------------------------------------------------- */
+  return checkGetMsgReceived(rx_buffer, ARG_GET_LATCHED_INPUTS,
+                             LEN_GET_LATCHED_INPUTS);
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::prepare_ans_get_latched_inputs() {
+  /* ---------------------------------------------------------------------- */
+  if (latch_num == 0) {
+    /* nothing latched yet: current inputs with latch id 0 (same dimension,
+       the Controller sees the id and reads the inputs again) */
+    uint32_t t = getTime();
+    tx_buffer[ANS_LATCHED_ID_POS] = 0;
+    int n = latch_inputs(tx_buffer + ANS_LATCHED_INPUTS_POS,
+                         OPTA_I2C_BUFFER_DIM - ANS_LATCHED_INPUTS_POS - 1 -
+                             ANS_LEN_LATCHED_TIME);
+    n += add_latch_time(tx_buffer + ANS_LATCHED_INPUTS_POS + n, t);
+    return prepareGetAns(tx_buffer, ANS_ARG_GET_LATCHED_INPUTS,
+                         ANS_LEN_GET_LATCHED_INPUTS_MIN + n);
+  }
+  /* the snapshot is kept until the next LATCH INPUTS (answered again if the
+     Controller retries) */
+  memcpy(tx_buffer, latch_buffer, latch_num);
+  return latch_num;
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_commit_outputs() {
+  /* ---------------------------------------------------------------------- */
+  if (checkSetMsgReceived(rx_buffer, ARG_COMMIT_OUTPUTS, LEN_COMMIT_OUTPUTS)) {
+    if (isFeatureEnabled(OPTA_CAPABILITY_COMMIT)) {
+      commit_outputs();
+    }
+    return true;
+  }
+  return false;
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_commit_ready() {
+  /* ---------------------------------------------------------------------- */
+  return checkGetMsgReceived(rx_buffer, ARG_COMMIT_READY, LEN_COMMIT_READY);
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::prepare_ans_commit_ready() {
+  /* ---------------------------------------------------------------------- */
+  tx_buffer[ANS_COMMIT_READY_POS] = (commit_ready()) ? 1 : 0;
+  return prepareGetAns(tx_buffer, ANS_ARG_COMMIT_READY, ANS_LEN_COMMIT_READY);
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::add_latch_time(uint8_t *buf, uint32_t t) {
+  /* ---------------------------------------------------------------------- */
+  if (!isFeatureEnabled(OPTA_CAPABILITY_TIME)) {
+    return 0;
+  }
+  for (int i = 0; i < ANS_LEN_LATCHED_TIME; i++) {
+    buf[i] = (uint8_t)(t >> (8 * i));
+  }
+  return ANS_LEN_LATCHED_TIME;
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::parse_time_sync() {
+  /* ---------------------------------------------------------------------- */
+  if (checkSetMsgReceived(rx_buffer, ARG_TIME_SYNC, LEN_TIME_SYNC)) {
+    if (isFeatureEnabled(OPTA_CAPABILITY_TIME)) {
+      uint32_t local_us = micros();
+      uint32_t ctrl_us = 0;
+      for (int i = 0; i < LEN_TIME_SYNC; i++) {
+        ctrl_us |= ((uint32_t)rx_buffer[TIME_SYNC_TIME_POS + i] << (8 * i));
+      }
+      sync_time(ctrl_us, local_us);
+    }
+    return true;
+  }
+  return false;
+}
+
+/* ------------------------------------------------------------------------ */
+void Module::sync_time(uint32_t ctrl_us, uint32_t local_us) {
+  /* ---------------------------------------------------------------------- */
+  if (!time_synced) {
+    drift_ctrl_us = ctrl_us;
+    drift_local_us = local_us;
+  } else {
+    /* frequent syncs only correct the offset: the drift is measured over at
+       least OPTA_MODULE_TIME_MIN_SYNC_US */
+    uint32_t dl = local_us - drift_local_us;
+    if (dl >= OPTA_MODULE_TIME_MIN_SYNC_US) {
+      int32_t err = (int32_t)(ctrl_us - drift_ctrl_us - dl);
+      int64_t ppb = ((int64_t)err * 1000000000LL) / (int64_t)dl;
+      if (ppb <= OPTA_MODULE_TIME_MAX_DRIFT_PPB &&
+          ppb >= -OPTA_MODULE_TIME_MAX_DRIFT_PPB) {
+        drift_ppb = (int32_t)ppb;
+      }
+      drift_ctrl_us = ctrl_us;
+      drift_local_us = local_us;
+    }
+  }
+  sync_ctrl_us = ctrl_us;
+  sync_local_us = local_us;
+  time_synced = true;
+}
+
+/* ------------------------------------------------------------------------ */
+uint32_t Module::time_at(uint32_t local_us) {
+  /* ---------------------------------------------------------------------- */
+  uint32_t dl = local_us - sync_local_us;
+  int64_t corr = ((int64_t)dl * drift_ppb) / 1000000000LL;
+  return sync_ctrl_us + dl + (int32_t)corr;
+}
+
+/* ------------------------------------------------------------------------ */
+uint32_t Module::getTime() {
+  /* ---------------------------------------------------------------------- */
+  if (!time_synced) {
+    return 0;
+  }
+  uint32_t t = time_at(micros());
+  /* 0 means not synchronized */
+  return (t == 0) ? 1 : t;
+}
+
+/* ------------------------------------------------------------------------ */
+int Module::parse_transfer(uint8_t arg, uint8_t *buf, uint16_t dim,
+                           uint16_t max) {
+  /* ---------------------------------------------------------------------- */
+  if (arg == ARG_SAVE_IN_DATA_FLASH) {
+    if (dim < 2) {
+      return -TRANSFER_ERR_ARGUMENT;
+    }
+    if (!write_flash_block(buf[0] | (buf[1] << 8), buf + 2, dim - 2)) {
+      return -TRANSFER_ERR_VERIFY;
+    }
+    return 0;
+  } else if (arg == ARG_GET_DATA_FROM_FLASH) {
+    if (dim != 4) {
+      return -TRANSFER_ERR_ARGUMENT;
+    }
+    uint16_t add = buf[0] | (buf[1] << 8);
+    uint16_t n = buf[2] | (buf[3] << 8);
+    if (n > max) {
+      return -TRANSFER_ERR_OVERFLOW;
+    }
+    read_flash_block(add, buf, n);
+    return n;
+  }
+  return -TRANSFER_ERR_UNSUPPORTED;
+}
+
+/* ------------------------------------------------------------------------ */
+bool Module::write_flash_block(uint16_t add, const uint8_t *buf,
+                               uint16_t dim) {
+  /* ---------------------------------------------------------------------- */
+  /* writeInFlash() always writes a whole block: the last partial block is
+     read first */
+  uint8_t block[OPTA_MODULE_FLASH_BLOCK_DIM];
+  for (uint16_t i = 0; i < dim; i += OPTA_MODULE_FLASH_BLOCK_DIM) {
+    uint16_t n = (dim - i > OPTA_MODULE_FLASH_BLOCK_DIM)
+                     ? OPTA_MODULE_FLASH_BLOCK_DIM
+                     : dim - i;
+    if (n < OPTA_MODULE_FLASH_BLOCK_DIM) {
+      readFromFlash(add + i, block, OPTA_MODULE_FLASH_BLOCK_DIM);
+    }
+    memcpy(block, buf + i, n);
+    writeInFlash(add + i, block, OPTA_MODULE_FLASH_BLOCK_DIM);
+    readFromFlash(add + i, block, n);
+    if (memcmp(block, buf + i, n) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* ------------------------------------------------------------------------ */
+void Module::read_flash_block(uint16_t add, uint8_t *buf, uint16_t dim) {
+  /* ---------------------------------------------------------------------- */
+  for (uint16_t i = 0; i < dim; i += OPTA_MODULE_FLASH_BLOCK_DIM) {
+    uint16_t n = (dim - i > OPTA_MODULE_FLASH_BLOCK_DIM)
+                     ? OPTA_MODULE_FLASH_BLOCK_DIM
+                     : dim - i;
+    readFromFlash(add + i, buf + i, n);
+  }
+}
+
+/* ------------------------------------------------------------------------ */
+uint32_t Module::hashConfig(uint32_t h, const void *data, size_t n) {
+  /* ---------------------------------------------------------------------- */
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
 /* ------------------------------------------------------------------------ */
 int Module::prepare_ans_get_version() {
   /* ---------------------------------------------------------------------- */
@@ -459,6 +884,34 @@ int Module::parse_rx() {
   } else if (parse_get_product()) {
     int rv = prepare_ans_get_product();
     return rv;
+  } else if (parse_identify()) {
+    int rv = prepare_ans_identify();
+    return rv;
+  } else if (parse_set_features()) {
+    int rv = prepare_ans_set_features();
+    return rv;
+  } else if (parse_transfer()) {
+    /* answer only to the last fragment */
+    int rv = prepare_ans_transfer();
+    return rv;
+  } else if (parse_transfer_ans()) {
+    int rv = prepare_ans_transfer_ans();
+    return rv;
+  } else if (parse_latch_inputs()) {
+    /* no answer: the Controller goes on with the next expansion */
+    return 0;
+  } else if (parse_get_latched_inputs()) {
+    int rv = prepare_ans_get_latched_inputs();
+    return rv;
+  } else if (parse_commit_outputs()) {
+    /* no answer: the Controller goes on with the next expansion */
+    return 0;
+  } else if (parse_commit_ready()) {
+    int rv = prepare_ans_commit_ready();
+    return rv;
+  } else if (parse_time_sync()) {
+    /* no answer: the Controller goes on with the next expansion */
+    return 0;
   }
 
   return -1;
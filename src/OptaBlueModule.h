@@ -39,6 +39,19 @@
 
 #define WAIT_FOR_REBOOT 500
 
+/* bytes written by writeInFlash() */
+#define OPTA_MODULE_FLASH_BLOCK_DIM 32
+
+/* initial value of the configuration hash (FNV-1a) */
+#define OPTA_MODULE_CFG_HASH_INIT 2166136261UL
+
+/* the drift of the clock is measured between TIME SYNC messages at least
+   OPTA_MODULE_TIME_MIN_SYNC_US apart (the latency of the interrupt is small
+   compared to it), drifts over OPTA_MODULE_TIME_MAX_DRIFT_PPB (e.g. the
+   Controller has been reset) are discarded */
+#define OPTA_MODULE_TIME_MIN_SYNC_US 500000
+#define OPTA_MODULE_TIME_MAX_DRIFT_PPB 50000000
+
 class Module {
 public:
   Module();
@@ -54,6 +67,22 @@ public:
   virtual uint8_t getMinorFw() = 0;
   virtual uint8_t getReleaseFw() = 0;
   virtual std::string getProduct() = 0;
+  /* capabilities (OPTA_CAPABILITY_ bitmask) and hash of the current
+   * configuration answered to the IDENTIFY message */
+  virtual uint16_t getCapabilities() {
+    return OPTA_CAPABILITY_FAST_PLUS | OPTA_CAPABILITY_TRANSFER |
+           OPTA_CAPABILITY_LARGE_FRAMES | OPTA_CAPABILITY_TIME;
+  }
+  virtual uint32_t getConfigHash() { return OPTA_MODULE_CFG_HASH_INIT; }
+  /* optional features enabled by the Controller (OPTA_CAPABILITY_ bitmask,
+   * always a subset of getCapabilities()) */
+  bool isFeatureEnabled(uint16_t f) { return ((features & f) == f); }
+  /* time of the Controller (its micros()) distributed by TIME SYNC and
+   * corrected for the drift of the clock of the expansion, 0 if the time has
+   * not been synchronized yet */
+  uint32_t getTime();
+  /* add n bytes of data to the configuration hash h */
+  static uint32_t hashConfig(uint32_t h, const void *data, size_t n);
   virtual void goInBootloaderMode() = 0;
   virtual void readFromFlash(uint16_t add, uint8_t *buffer, uint8_t dim) = 0;
   virtual void writeInFlash(uint16_t add, uint8_t *buffer, uint8_t dim) = 0;
@@ -63,7 +92,7 @@ public:
   virtual void setStatusLedWaitingForAddress() = 0;
   virtual void setStatusLedHasAddress() = 0;
 
-  static TwoWire *expWire;
+  static OPTA_PER_MCU TwoWire *expWire;
 
   /* set the tx_buffer @ position pos with value v */
   void tx(uint8_t v, int pos);
@@ -78,9 +107,9 @@ public:
   /* get the number of bytes received into the rx_buffer */
   uint8_t getRxNum();
   /* set the number of bytes to be transmitted in the tx_buffer */
-  void setTxNum(int8_t n);
+  void setTxNum(int n);
   /* get the number of bytes to be transmitted in the tx_buffer */
-  int8_t getTxNum();
+  int getTxNum();
   /* returns the pointer to the tx buffer */
   uint8_t *txPrt();
 
@@ -96,7 +125,22 @@ public:
   bool parse_set_flash();
   bool parse_get_flash();
   bool parse_get_product();
+  bool parse_identify();
+  bool parse_set_features();
+  bool parse_transfer();
+  bool parse_transfer_ans();
+  bool parse_latch_inputs();
+  bool parse_get_latched_inputs();
+  bool parse_commit_outputs();
+  bool parse_commit_ready();
+  bool parse_time_sync();
   int prepare_ans_get_product();
+  int prepare_ans_identify();
+  int prepare_ans_set_features();
+  int prepare_ans_transfer();
+  int prepare_ans_transfer_ans();
+  int prepare_ans_get_latched_inputs();
+  int prepare_ans_commit_ready();
   int prepare_ans_get_address_and_type();
   int prepare_ans_get_version();
   int prepare_ans_reboot();
@@ -115,6 +159,10 @@ protected:
   #endif
   
   int expansion_type;
+  uint16_t features = 0;
+  /* I2C timing set for Fast-mode Plus */
+  bool fast_plus = false;
+  void updateClock();
   unsigned long int reboot_sent;
   int detect_in;
   int detect_out;
@@ -133,12 +181,75 @@ protected:
 
   void setAddress(uint8_t add);
   /* this variable need to be set in every constructor of the derived class */
-  uint8_t rx_buffer[OPTA_I2C_BUFFER_DIM];
-  uint8_t tx_buffer[OPTA_I2C_BUFFER_DIM];
-  int8_t tx_num;
+  uint8_t rx_buffer[OPTA_I2C_LARGE_BUFFER_DIM];
+  uint8_t tx_buffer[OPTA_I2C_LARGE_BUFFER_DIM];
+  int tx_num;
   uint16_t flash_add;
   uint8_t flash_dim;
 
+  /* fragmented transfer: payload received (then the answer) */
+  uint8_t transfer_buffer[OPTA_TRANSFER_MAX_DIM];
+  uint16_t transfer_dim = 0;
+  uint16_t transfer_ans_dim = 0;
+  uint8_t transfer_arg = 0;
+  uint8_t transfer_seq = 0;
+  uint8_t transfer_id = 0;
+  volatile uint8_t transfer_status = TRANSFER_OK;
+  uint8_t transfer_rx_crc = 0;
+  uint8_t transfer_ans_crc = 0;
+  /* CRC of the frame of the last fragment */
+  uint8_t transfer_last_crc = 0;
+  bool transfer_done = false;
+  /* the flash writes received are executed by update() (not in the I2C
+     receive callback): TRANSFER_BUSY is answered meanwhile */
+  volatile bool transfer_queued = false;
+  void execute_transfer();
+  /* execute the message arg whose payload (dim bytes) has been transferred
+     in buf, the answer (at most max bytes) is written in buf: return the
+     dimension of the answer or -TRANSFER_ERR_ (derived classes call this
+     for the messages they do not handle) */
+  virtual int parse_transfer(uint8_t arg, uint8_t *buf, uint16_t dim,
+                             uint16_t max);
+  /* data flash access of any dimension (in blocks of 32 bytes), the data
+     written are read back: false if different */
+  bool write_flash_block(uint16_t add, const uint8_t *buf, uint16_t dim);
+  void read_flash_block(uint16_t add, uint8_t *buf, uint16_t dim);
+
+  /* snapshot of the inputs taken at LATCH INPUTS: the whole answer to GET
+     LATCHED INPUTS (CRC included) is prepared when the inputs are latched */
+  uint8_t latch_buffer[OPTA_I2C_BUFFER_DIM];
+  int latch_num = 0;
+  /* write the current value of the inputs in buf (at most max bytes) and
+     return the number of bytes written (expansions that support
+     OPTA_CAPABILITY_LATCH override this and getCapabilities()) */
+  virtual int latch_inputs(uint8_t *buf, int max) {
+    (void)buf;
+    (void)max;
+    return 0;
+  }
+  /* apply the outputs staged since the last COMMIT OUTPUTS (called in the
+     I2C interrupt, expansions that support OPTA_CAPABILITY_COMMIT override
+     this and getCapabilities()) */
+  virtual void commit_outputs() {}
+  /* true if the outputs staged can be applied at once by commit_outputs() */
+  virtual bool commit_ready() { return true; }
+
+  /* TIME SYNC: Controller time and local micros() of the last sync and of
+     the sync the drift is measured from, drift of the local clock (parts per
+     billion, positive if it is slower than the Controller one) */
+  bool time_synced = false;
+  uint32_t sync_ctrl_us = 0;
+  uint32_t sync_local_us = 0;
+  uint32_t drift_ctrl_us = 0;
+  uint32_t drift_local_us = 0;
+  int32_t drift_ppb = 0;
+  void sync_time(uint32_t ctrl_us, uint32_t local_us);
+  /* Controller time at local time local_us */
+  uint32_t time_at(uint32_t local_us);
+  /* append the latch time to the inputs in buf (if OPTA_CAPABILITY_TIME is
+     enabled), return the number of bytes written */
+  int add_latch_time(uint8_t *buf, uint32_t t);
+
   volatile bool set_address_msg_received;
   /* USE this in custom expansion to know when the address of the expansion
      has been set */
@@ -151,7 +262,7 @@ protected:
   }
 };
 
-extern Module *OptaExpansion;
+extern OPTA_PER_MCU Module *OptaExpansion;
 
 #endif
 #endif
@@ -29,6 +29,10 @@ typedef union float_union {
 /* MAX Dimension of the I2C buffer for transmission and reception both for
  * controller and Expansions */
 #define OPTA_I2C_BUFFER_DIM 48
+/* frames up to OPTA_I2C_LARGE_BUFFER_DIM bytes are used only with the
+ * expansions that enabled OPTA_CAPABILITY_LARGE_FRAMES (the buffers are
+ * allocated with this dimension) */
+#define OPTA_I2C_LARGE_BUFFER_DIM 128
 
 #define OPTA_CONTROLLER_MAX_EXPANSION_NUM 5
 /* the first addressed assigned to a MODULE */
@@ -39,4 +43,13 @@ typedef union float_union {
 
 #define OPTA_DEFAULT_SLAVE_I2C_ADDRESS 0x0A
 #define OPTA_CONTROLLER_CUSTOM_MIN_TYPE 100
+
+/* In the host simulation (see simulation/) several expansion firmwares run in
+ * the same process, one thread per MCU: the globals of the firmware must be
+ * per thread */
+#ifdef OPTA_BLUE_SIMULATION
+#define OPTA_PER_MCU thread_local
+#else
+#define OPTA_PER_MCU
+#endif
 #endif
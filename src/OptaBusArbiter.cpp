@@ -0,0 +1,267 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaBusArbiter.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240624
+   DESCRIPTION: Per-transaction buffers and bus arbiter of the Controller
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Without the RTOS (no ARDUINO_OPTA) there is only one thread:
+                the default buffers are always used and the bus is never
+                contended                                                     */
+/* -------------------------------------------------------------------------- */
+
+#if defined(ARDUINO_OPTA) || defined(OPTA_PINS)
+#include "OptaBusArbiter.h"
+#include "Arduino.h"
+#include <chrono>
+#include <cstring>
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+TransactionCtx::TransactionCtx()
+    : rx_num(0), tr_class(OPTA_BUS_CLASS_AUTO), owner(nullptr), depth(0) {
+  memset(tx_buffer, 0, sizeof(tx_buffer));
+  memset(rx_buffer, 0, sizeof(rx_buffer));
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+BusArbiter::BusArbiter()
+    :
+#if defined(ARDUINO_OPTA)
+      ctx_free(mtx), bus_free(mtx),
+#endif
+      bus_owner(nullptr), bus_depth(0), next_seq(0), period_start(0),
+      contentions(0), max_wait_us(0) {
+  /* no allocation when threads start waiting */
+  waiters.reserve(OPTA_BUS_TR_CTX_NUM * 2);
+  for (int i = 0; i < OPTA_BUS_CLASS_NUM; i++) {
+    budget[i] = 0;
+    used[i] = 0;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void *BusArbiter::self() {
+#if defined(ARDUINO_OPTA)
+  return (void *)rtos::ThisThread::get_id();
+#else
+  return nullptr;
+#endif
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+TransactionCtx *BusArbiter::ctx() {
+#if defined(ARDUINO_OPTA)
+  /* a slot is assigned to a thread and released only by that thread: the
+     slots of the other threads can be read without locking */
+  void *me = self();
+  for (int i = 0; i < OPTA_BUS_TR_CTX_NUM; i++) {
+    if (ctxs[i].owner == me) {
+      return &ctxs[i];
+    }
+  }
+#endif
+  return &def_ctx;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusArbiter::beginTransaction(uint8_t cls) {
+#if defined(ARDUINO_OPTA)
+  void *me = self();
+  mtx.lock();
+  TransactionCtx *c = ctx();
+  if (c != &def_ctx) {
+    c->depth++;
+    mtx.unlock();
+    return;
+  }
+  for (;;) {
+    for (int i = 0; i < OPTA_BUS_TR_CTX_NUM; i++) {
+      if (ctxs[i].owner == nullptr) {
+        ctxs[i].owner = me;
+        ctxs[i].depth = 1;
+        ctxs[i].tr_class = cls;
+        mtx.unlock();
+        return;
+      }
+    }
+    ctx_free.wait();
+  }
+#else
+  (void)cls;
+#endif
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusArbiter::endTransaction() {
+#if defined(ARDUINO_OPTA)
+  mtx.lock();
+  TransactionCtx *c = ctx();
+  if (c != &def_ctx && --c->depth == 0) {
+    c->owner = nullptr;
+    ctx_free.notify_all();
+  }
+  mtx.unlock();
+#endif
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* true if the waiter seq is the one that gets the bus when released */
+bool BusArbiter::is_next(uint32_t seq) {
+  const Waiter *best = nullptr;
+  for (const Waiter &w : waiters) {
+    if (best == nullptr || w.cls < best->cls ||
+        (w.cls == best->cls &&
+         (w.priority > best->priority ||
+          (w.priority == best->priority &&
+           (int32_t)(w.seq - best->seq) < 0)))) {
+      best = &w;
+    }
+  }
+  return (best != nullptr && best->seq == seq);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+#if defined(ARDUINO_OPTA)
+/* count a frame of class cls in the current budget period, if the budget is
+   used up wait for the next period (called with the mutex locked, it is
+   released while waiting) */
+void BusArbiter::use_budget(uint8_t cls) {
+  bool throttled = false;
+  for (;;) {
+    unsigned long now = millis();
+    if (now - period_start >= OPTA_BUS_BUDGET_PERIOD_MS) {
+      period_start = now;
+      for (int i = 0; i < OPTA_BUS_CLASS_NUM; i++) {
+        used[i] = 0;
+      }
+    }
+    if (budget[cls] == 0 || used[cls] < budget[cls]) {
+      used[cls]++;
+      return;
+    }
+    if (!throttled) {
+      stats[cls].throttled++;
+      throttled = true;
+    }
+    uint32_t left = OPTA_BUS_BUDGET_PERIOD_MS - (now - period_start);
+    mtx.unlock();
+    rtos::ThisThread::sleep_for(std::chrono::milliseconds(left));
+    mtx.lock();
+  }
+}
+#endif
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusArbiter::lock(uint8_t cls) {
+  if (cls >= OPTA_BUS_CLASS_NUM) {
+    cls = OPTA_BUS_CLASS_DIAGNOSTIC;
+  }
+#if defined(ARDUINO_OPTA)
+  void *me = self();
+  int priority = (int)osThreadGetPriority(rtos::ThisThread::get_id());
+  mtx.lock();
+  if (bus_owner == me) {
+    bus_depth++;
+    mtx.unlock();
+    return;
+  }
+  use_budget(cls);
+  stats[cls].frames++;
+  if (bus_owner != nullptr || !waiters.empty()) {
+    unsigned long start = micros();
+    Waiter w;
+    w.cls = cls;
+    w.priority = priority;
+    w.seq = next_seq++;
+    waiters.push_back(w);
+    while (bus_owner != nullptr || !is_next(w.seq)) {
+      bus_free.wait();
+    }
+    for (auto it = waiters.begin(); it != waiters.end(); it++) {
+      if (it->seq == w.seq) {
+        waiters.erase(it);
+        break;
+      }
+    }
+    uint32_t wait_us = (uint32_t)(micros() - start);
+    contentions++;
+    stats[cls].contentions++;
+    if (wait_us > max_wait_us) {
+      max_wait_us = wait_us;
+    }
+    if (wait_us > stats[cls].max_wait_us) {
+      stats[cls].max_wait_us = wait_us;
+    }
+  }
+  bus_owner = me;
+  bus_depth = 1;
+  mtx.unlock();
+#else
+  stats[cls].frames++;
+#endif
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusArbiter::unlock() {
+#if defined(ARDUINO_OPTA)
+  mtx.lock();
+  if (bus_owner == self() && --bus_depth == 0) {
+    bus_owner = nullptr;
+    if (!waiters.empty()) {
+      bus_free.notify_all();
+    }
+  }
+  mtx.unlock();
+#endif
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusArbiter::setBudget(uint8_t cls, uint16_t frames) {
+  if (cls < OPTA_BUS_CLASS_NUM) {
+    budget[cls] = frames;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint16_t BusArbiter::getBudget(uint8_t cls) const {
+  if (cls < OPTA_BUS_CLASS_NUM) {
+    return budget[cls];
+  }
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const BusClassStats *BusArbiter::getClassStats(uint8_t cls) const {
+  if (cls < OPTA_BUS_CLASS_NUM) {
+    return &stats[cls];
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusArbiter::resetStats() {
+  contentions = 0;
+  max_wait_us = 0;
+  for (int i = 0; i < OPTA_BUS_CLASS_NUM; i++) {
+    stats[i].reset();
+  }
+}
+
+#endif
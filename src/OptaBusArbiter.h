@@ -0,0 +1,163 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaBusArbiter.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240624
+   DESCRIPTION: Support for the use of the Controller from more RTOS threads:
+                per-transaction tx/rx buffers (each thread prepares, sends
+                and parses its messages in its own buffers) and bus arbiter
+                (one frame at a time on I2C, frames are scheduled by class
+                and thread priority, each class can have a rate budget)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The bus is held only for a request and its answer: delays,
+                retries and parsing of the answers are done without it.
+                Two threads must not use the same expansion at the same time
+                (the expansion object holds the state of the expansion)     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_BUS_ARBITER_H
+#define OPTA_BUS_ARBITER_H
+
+#include "OptaBluePrintCfg.h"
+#include <cstdint>
+#include <vector>
+
+#if defined(ARDUINO_OPTA)
+#include "mbed.h"
+#endif
+
+/* number of threads that can have a transaction in progress at the same time
+ * (a thread beginning a transaction when all the buffers are in use waits
+ * until one is released) */
+#define OPTA_BUS_TR_CTX_NUM 4
+
+/* classes of the transactions, from the highest priority: when the bus is
+ * released it goes to the waiting frame of the highest class (then of the
+ * thread with the highest priority), so a frame of the outputs class waits
+ * at most for the frame in progress */
+#define OPTA_BUS_CLASS_OUTPUTS 0
+#define OPTA_BUS_CLASS_INPUTS 1
+#define OPTA_BUS_CLASS_DIAGNOSTIC 2
+#define OPTA_BUS_CLASS_BULK 3
+#define OPTA_BUS_CLASS_NUM 4
+/* the Controller classifies the frame from its message argument */
+#define OPTA_BUS_CLASS_AUTO 255
+
+/* the rate budget of a class is the number of frames it can send in each
+ * period of OPTA_BUS_BUDGET_PERIOD_MS (0 = unlimited, the default) */
+#define OPTA_BUS_BUDGET_PERIOD_MS 100
+
+/* statistics of the frames of a class */
+class BusClassStats {
+public:
+  BusClassStats() { reset(); }
+  void reset() {
+    frames = 0;
+    contentions = 0;
+    throttled = 0;
+    max_wait_us = 0;
+  }
+  uint32_t frames;
+  /* frames that had to wait for the bus */
+  uint32_t contentions;
+  /* frames delayed to the next period because the budget was used up */
+  uint32_t throttled;
+  /* maximum wait for the bus (budget delays not included) */
+  uint32_t max_wait_us;
+};
+
+/* buffers of a transaction (message sent and answer received) */
+class TransactionCtx {
+public:
+  TransactionCtx();
+
+  uint8_t tx_buffer[OPTA_I2C_LARGE_BUFFER_DIM];
+  uint8_t rx_buffer[OPTA_I2C_LARGE_BUFFER_DIM];
+  /* number of bytes received */
+  uint8_t rx_num;
+  /* class of all the frames of the transaction (OPTA_BUS_CLASS_AUTO: each
+   * frame is classified by the Controller) */
+  uint8_t tr_class;
+  /* thread using the buffers (nullptr if free) and number of nested
+   * beginTransaction() of that thread */
+  void *owner;
+  uint8_t depth;
+};
+
+class BusArbiter {
+public:
+  BusArbiter();
+
+  /* ---- transaction buffers ---- */
+
+  /* the calling thread gets its own buffers until endTransaction() (calls
+   * can be nested, the same buffers and class of the outermost call are
+   * used) */
+  void beginTransaction(uint8_t cls = OPTA_BUS_CLASS_AUTO);
+  void endTransaction();
+  /* buffers of the transaction of the calling thread (the default buffers
+   * if the thread has no transaction in progress) */
+  TransactionCtx *ctx();
+
+  /* ---- bus ---- */
+
+  /* wait for the exclusive use of the bus for a frame of class cls: if the
+   * budget of the class is used up the frame waits for the next period,
+   * then the bus is given to the waiting frame of the highest class, of the
+   * thread with the highest priority, FIFO otherwise; calls can be nested
+   * (only the outermost one is counted) */
+  void lock(uint8_t cls = OPTA_BUS_CLASS_DIAGNOSTIC);
+  void unlock();
+
+  /* rate budget of class cls (frames for each OPTA_BUS_BUDGET_PERIOD_MS,
+   * 0 = unlimited) */
+  void setBudget(uint8_t cls, uint16_t frames);
+  uint16_t getBudget(uint8_t cls) const;
+
+  /* number of times a frame had to wait for the bus and maximum wait (all
+   * the classes) */
+  uint32_t getContentions() const { return contentions; }
+  uint32_t getMaxWaitUs() const { return max_wait_us; }
+  /* statistics of class cls (nullptr if cls is not valid) */
+  const BusClassStats *getClassStats(uint8_t cls) const;
+  void resetStats();
+
+private:
+  class Waiter {
+  public:
+    uint8_t cls;
+    int priority;
+    uint32_t seq;
+  };
+
+  static void *self();
+  bool is_next(uint32_t seq);
+  void use_budget(uint8_t cls);
+
+  TransactionCtx def_ctx;
+  TransactionCtx ctxs[OPTA_BUS_TR_CTX_NUM];
+#if defined(ARDUINO_OPTA)
+  /* protects the buffers assignment and the bus state (held only for a few
+   * instructions, never during I2C transactions) */
+  rtos::Mutex mtx;
+  rtos::ConditionVariable ctx_free;
+  rtos::ConditionVariable bus_free;
+#endif
+  void *bus_owner;
+  uint8_t bus_depth;
+  std::vector<Waiter> waiters;
+  uint32_t next_seq;
+
+  uint16_t budget[OPTA_BUS_CLASS_NUM];
+  uint16_t used[OPTA_BUS_CLASS_NUM];
+  unsigned long period_start;
+
+  uint32_t contentions;
+  uint32_t max_wait_us;
+  BusClassStats stats[OPTA_BUS_CLASS_NUM];
+};
+
+#endif
@@ -0,0 +1,111 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaBusTrace.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240612
+   DESCRIPTION: Implementation of the RAM ring buffer of the I2C frames
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+#if defined(ARDUINO_OPTA) || defined(OPTA_PINS)
+#include "OptaBusTrace.h"
+#include <cstring>
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+BusTrace::BusTrace() : head(0), num(0), overwritten(0), enabled(false) {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusTrace::clear() {
+  head = 0;
+  num = 0;
+  overwritten = 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusTrace::record(uint32_t time_us, uint8_t address, uint8_t device,
+                      uint8_t direction, uint8_t outcome, const uint8_t *data,
+                      uint8_t len) {
+  if (!enabled) {
+    return;
+  }
+  if (len > OPTA_I2C_BUFFER_DIM) {
+    len = OPTA_I2C_BUFFER_DIM;
+  }
+
+  BusTraceFrame &f = frames[head];
+  f.time_us = time_us;
+  f.address = address;
+  f.device = device;
+  f.direction = direction;
+  f.outcome = outcome;
+  f.len = (data != nullptr) ? len : 0;
+  if (f.len > 0) {
+    memcpy(f.data, data, f.len);
+  }
+
+  head = (head + 1 >= OPTA_BUS_TRACE_DEPTH) ? 0 : head + 1;
+  if (num < OPTA_BUS_TRACE_DEPTH) {
+    num++;
+  } else {
+    overwritten++;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const BusTraceFrame *BusTrace::get(uint16_t i) const {
+  if (i >= num) {
+    return nullptr;
+  }
+  /* the oldest frame is num positions before head */
+  uint16_t pos = (head + OPTA_BUS_TRACE_DEPTH - num + i) % OPTA_BUS_TRACE_DEPTH;
+  return &frames[pos];
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void BusTrace::dump(BusTraceWrite_f f) {
+  if (f == nullptr) {
+    return;
+  }
+  bool was_enabled = enabled;
+  enabled = false;
+
+  uint8_t h[OPTA_BUS_TRACE_HEADER_DIM];
+  memcpy(h, OPTA_BUS_TRACE_MAGIC, OPTA_BUS_TRACE_MAGIC_DIM);
+  h[4] = OPTA_BUS_TRACE_VERSION;
+  h[5] = (uint8_t)(num & 0xFF);
+  h[6] = (uint8_t)((num >> 8) & 0xFF);
+  for (int i = 0; i < 4; i++) {
+    h[7 + i] = (uint8_t)((overwritten >> (8 * i)) & 0xFF);
+  }
+  f(h, OPTA_BUS_TRACE_HEADER_DIM);
+
+  for (uint16_t i = 0; i < num; i++) {
+    const BusTraceFrame *fr = get(i);
+    uint8_t fh[OPTA_BUS_TRACE_FRAME_HEADER_DIM];
+    for (int k = 0; k < 4; k++) {
+      fh[k] = (uint8_t)((fr->time_us >> (8 * k)) & 0xFF);
+    }
+    fh[4] = fr->address;
+    fh[5] = fr->device;
+    fh[6] = fr->direction;
+    fh[7] = fr->outcome;
+    fh[8] = fr->len;
+    f(fh, OPTA_BUS_TRACE_FRAME_HEADER_DIM);
+    if (fr->len > 0) {
+      f(fr->data, fr->len);
+    }
+  }
+
+  clear();
+  enabled = was_enabled;
+}
+
+#endif
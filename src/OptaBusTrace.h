@@ -0,0 +1,108 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaBusTrace.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240612
+   DESCRIPTION: RAM ring buffer where the Controller records the frames sent
+                to and received from the expansions (binary, no Serial
+                printing) and binary format used to dump it
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       This file does not depend on Arduino so that it can be used
+                by the host tool that decodes the dump (traceDecoder)         */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_BUS_TRACE_H
+#define OPTA_BUS_TRACE_H
+
+#include "OptaBluePrintCfg.h"
+#include <cstddef>
+#include <cstdint>
+
+/* number of frames held by the ring buffer (the oldest are overwritten) */
+#ifndef OPTA_BUS_TRACE_DEPTH
+#define OPTA_BUS_TRACE_DEPTH 64
+#endif
+
+/* frame direction */
+#define OPTA_BUS_TRACE_TX 0x00
+#define OPTA_BUS_TRACE_RX 0x01
+
+/* frame outcome
+   TX: the value returned by Wire.endTransmission() (0 is success)
+   RX: OK or TIMEOUT (the frame holds the bytes received before timeout) */
+#define OPTA_BUS_TRACE_OK 0x00
+#define OPTA_BUS_TRACE_TIMEOUT 0xFF
+
+/* ---------------------------- DUMP FORMAT ---------------------------------
+   header:
+     magic "OBTR" (4 bytes)
+     version (1 byte)
+     number of frames that follow (2 bytes) - LSB first
+     number of frames overwritten before the dump (4 bytes) - LSB first
+   then for each frame, from the oldest:
+     timestamp in micro seconds (4 bytes) - LSB first
+     I2C address (1 byte)
+     expansion index (1 byte) 255 if not known
+     direction (1 byte) OPTA_BUS_TRACE_TX or OPTA_BUS_TRACE_RX
+     outcome (1 byte)
+     length (1 byte)
+     frame bytes (length bytes)
+   ------------------------------------------------------------------------ */
+#define OPTA_BUS_TRACE_MAGIC "OBTR"
+#define OPTA_BUS_TRACE_MAGIC_DIM 4
+#define OPTA_BUS_TRACE_VERSION 0x01
+#define OPTA_BUS_TRACE_HEADER_DIM 11
+#define OPTA_BUS_TRACE_FRAME_HEADER_DIM 9
+
+class BusTraceFrame {
+public:
+  uint32_t time_us;
+  uint8_t address;
+  uint8_t device;
+  uint8_t direction;
+  uint8_t outcome;
+  uint8_t len;
+  uint8_t data[OPTA_I2C_BUFFER_DIM];
+};
+
+/* function used to write the dump (for example to Serial) */
+using BusTraceWrite_f = void (*)(const uint8_t *data, size_t len);
+
+class BusTrace {
+public:
+  BusTrace();
+
+  /* the trace is disabled by default (recording costs a copy of the frame) */
+  void enable(bool en) { enabled = en; }
+  bool isEnabled() const { return enabled; }
+  /* remove all the frames */
+  void clear();
+
+  void record(uint32_t time_us, uint8_t address, uint8_t device,
+              uint8_t direction, uint8_t outcome, const uint8_t *data,
+              uint8_t len);
+
+  /* number of frames available */
+  uint16_t size() const { return num; }
+  /* number of frames overwritten since the last clear() */
+  uint32_t lost() const { return overwritten; }
+  /* i-th frame available, 0 is the oldest (nullptr if i >= size()) */
+  const BusTraceFrame *get(uint16_t i) const;
+
+  /* write all the frames using the dump format (see above) and clear the
+   * trace, recording is suspended while dumping */
+  void dump(BusTraceWrite_f f);
+
+private:
+  BusTraceFrame frames[OPTA_BUS_TRACE_DEPTH];
+  /* position of the next frame to be written */
+  uint16_t head;
+  uint16_t num;
+  uint32_t overwritten;
+  bool enabled;
+};
+
+#endif
@@ -62,6 +62,10 @@ public:
   void enableStartUpCallback() {
     startUpFuncCalled = false;
   }
+  /* the expansions of this type are already set up (warm restart) */
+  void disableStartUpCallback() {
+    startUpFuncCalled = true;
+  }
   void callStartUp(Controller *p) {
     if(startUpFuncCalled == false) {
       startUp(p);
@@ -82,13 +86,27 @@ int ExpType::next_expansion_type = EXPANSION_CUSTOM + 20;
 
 /* CONSTRUCTOR */
 Controller::Controller()
-    : rx_buffer{0}, tx_buffer{0}, rx_num(0),
-      tmp_address(OPTA_CONTROLLER_FIRST_TEMPORARY_ADDRESS), tmp_num_of_exp(0),
+    : tmp_address(OPTA_CONTROLLER_FIRST_TEMPORARY_ADDRESS), tmp_num_of_exp(0),
       address(OPTA_CONTROLLER_FIRST_AVAILABLE_ADDRESS), num_of_exp(0),
+      last_tr_device(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER),
+      last_tr_crc_err(false), adaptive_timeouts(true),
+      ctrl_features(OPTA_CONTROLLER_FEATURES),
+      max_clock(OPTA_CONTROLLER_MAX_CLOCK), bus_clock(OPTA_I2C_FAST_CLOCK),
+      clock_frames(0), clock_errors(0), clock_fallbacks(0), latch_id(0),
+      time_sync_ms(0), retries(OPTA_CONTROLLER_RETRIES),
+      health_change(nullptr), trace_device(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER),
+      trace_address(0), polling(this), fast_boot(true), warm_start(true),
+#if defined(ARDUINO_OPTA)
+      pimage(this),
+#endif
       failed_i2c_comm(nullptr) {
   init_exp_type_list();      
   for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
     expansions[i] = nullptr;
+    last_tr_failed[i] = false;
+    last_tr_arg[i] = 0;
+    transfer_id[i] = 0;
+    commit_failed[i] = false;
   }
 }
 
@@ -201,24 +219,68 @@ uint8_t Controller::send(int add, int device, unsigned int type, int n, int r) {
   if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM && type != EXPANSION_NOT_VALID) {
     if (type == exp_type[device] && add == exp_add[device]) {
       if (n > 0) {
-
-#ifdef DEBUG_CONTROLLER_I2C_MSG
-        Serial.print("CTRL TX: ");
-        for (int i = 0; i < n; i++) {
-          Serial.print(tx_buffer[i], HEX);
-          Serial.print(" ");
+        /* offline expansions are not waited for, only probed from time to
+           time */
+        if (!health[device].canSend(millis())) {
+          health[device].fast_fails++;
+          return SEND_RESULT_EXPANSION_OFFLINE;
         }
-        Serial.println();
-#endif
-        _send(add, n, r);
-
-        if (r > 0) {
-          if (wait_for_device_answer(device, r, OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT)) {
-            return SEND_RESULT_OK;
+        uint8_t rv = SEND_RESULT_OK;
+        uint8_t cls = bus.ctx()->tr_class;
+        if (cls == OPTA_BUS_CLASS_AUTO) {
+          cls = bus_class(type, bus.ctx()->tx_buffer[BP_ARG_POS]);
+        }
+        AnswerTimeout &at = ans_timeout[device][cls];
+        /* a probe of an offline expansion is never retried (a frame without
+           answer is retried only if not acknowledged) */
+        uint8_t attempts = (health[device].state != OPTA_EXPANSION_OFFLINE)
+                               ? 1 + retries
+                               : 1;
+        bool failed = false;
+        for (uint8_t i = 0; i < attempts; i++) {
+          uint32_t timeout_us = (adaptive_timeouts)
+                                    ? at.getTimeoutUs()
+                                    : OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT * 1000;
+          /* the bus is held only for the frame (request and answer) */
+          bus.lock(cls);
+          unsigned long start = micros();
+          trace_device = device;
+          bool acked = _send(add, n, r);
+          trace_device = OPTA_BLUE_UNDEFINED_DEVICE_NUMBER;
+
+          rv = SEND_RESULT_OK;
+          if (r > 0 && !read_answer(device, r)) {
+            rv = SEND_RESULT_COMM_TIMEOUT;
+          } else if (r == 0 && !acked) {
+            rv = SEND_RESULT_COMM_TIMEOUT;
+          }
+          uint32_t latency_us = (uint32_t)(micros() - start);
+          if (r > 0) {
+            at.update(latency_us, rv == SEND_RESULT_OK);
+          }
+          update_metrics(device, n, r, latency_us, rv);
+          failed = (rv != SEND_RESULT_OK || last_tr_crc_err);
+          if (r > 0) {
+            count_clock_error(failed);
           }
-          return SEND_RESULT_COMM_TIMEOUT;
+          bus.unlock();
+          if (!failed) {
+            break;
+          }
+          /* the timeout of a missing answer is waited for with the bus
+             released: it delays only this thread */
+          if (rv == SEND_RESULT_COMM_TIMEOUT && r > 0) {
+            wait_until(timeout_us, start);
+          }
+        }
+        if (r > 0) {
+          update_health(device, !failed);
+        }
+        /* once per message, after the last attempt */
+        if (rv == SEND_RESULT_COMM_TIMEOUT && failed_i2c_comm != nullptr) {
+          failed_i2c_comm(device, bus.ctx()->tx_buffer[BP_ARG_POS]);
         }
-        return SEND_RESULT_OK;
+        return rv;
       }
       return SEND_RESULT_NO_DATA_TO_TRANSMIT;
     }
@@ -230,8 +292,184 @@ uint8_t Controller::send(int add, int device, unsigned int type, int n, int r) {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+/* scheduling class of a message with argument arg sent to an expansion of
+   type type (messages of custom expansions are diagnostic unless the
+   transaction has a class) */
+uint8_t Controller::bus_class(unsigned int type, uint8_t arg) {
+  if (type == EXPANSION_OPTA_DIGITAL_MEC || type == EXPANSION_OPTA_DIGITAL_STS) {
+    switch (arg) {
+    case ARG_OD_SET_DIGITAL_OUTPUTS:
+    case ARG_OD_STAGE_DIGITAL_OUTPUTS:
+      return OPTA_BUS_CLASS_OUTPUTS;
+    case ARG_OD_GET_DIGITAL_INPUTS:
+    case ARG_OD_GET_ANALOG_INPUT:
+    case ARG_OD_GET_ALL_ANALOG_INPUTS:
+      return OPTA_BUS_CLASS_INPUTS;
+    }
+  } else if (type == EXPANSION_OPTA_ANALOG) {
+    switch (arg) {
+    case ARG_OA_SET_DAC:
+    case ARG_OA_SET_ALL_DAC:
+    case ARG_OA_SET_PWM:
+    case ARG_OA_SET_ALL_PWM:
+    case ARG_OA_SET_GPO:
+    case ARG_OA_SET_LED:
+      return OPTA_BUS_CLASS_OUTPUTS;
+    case ARG_OA_GET_ADC:
+    case ARG_OA_GET_ALL_ADC:
+    case ARG_OA_GET_RTD:
+    case ARG_OA_GET_DI:
+      return OPTA_BUS_CLASS_INPUTS;
+    }
+  }
+  if (arg == ARG_LATCH_INPUTS || arg == ARG_GET_LATCHED_INPUTS ||
+      arg == ARG_TIME_SYNC) {
+    return OPTA_BUS_CLASS_INPUTS;
+  }
+  if (arg == ARG_COMMIT_OUTPUTS) {
+    return OPTA_BUS_CLASS_OUTPUTS;
+  }
+  if (arg == ARG_SAVE_IN_DATA_FLASH || arg == ARG_GET_DATA_FROM_FLASH ||
+      arg == ARG_TRANSFER || arg == ARG_TRANSFER_ANS) {
+    return OPTA_BUS_CLASS_BULK;
+  }
+  return OPTA_BUS_CLASS_DIAGNOSTIC;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* update the counters of the expansion device after a transaction:
+   n bytes sent, r bytes requested, result is one of the SEND_RESULT_ codes */
+void Controller::update_metrics(uint8_t device, int n, int r,
+                                uint32_t latency_us, uint8_t result) {
+  TransactionCtx *tr = bus.ctx();
+  static const uint32_t limits[OPTA_METRICS_LATENCY_BUCKETS] =
+      OPTA_METRICS_LATENCY_LIMITS;
+
+  uint8_t arg = tr->tx_buffer[BP_ARG_POS];
+  bool timeout = (result == SEND_RESULT_COMM_TIMEOUT);
+  bool crc_err = false;
+#ifdef BP_USE_CRC
+  if (!timeout && r > 1) {
+    crc_err = !OptaCrc8::verify(tr->rx_buffer[r - 1], tr->rx_buffer, r - 1);
+  }
+#endif
+  bool retry = last_tr_failed[device] && last_tr_arg[device] == arg;
+
+  uint8_t bucket = 0;
+  while (bucket < OPTA_METRICS_LATENCY_BUCKETS - 1 &&
+         latency_us >= limits[bucket]) {
+    bucket++;
+  }
+
+  BusCounters *counters[2] = {&metrics[device].total,
+                              metrics[device].useArg(arg)};
+  for (int i = 0; i < 2; i++) {
+    BusCounters *c = counters[i];
+    c->transactions++;
+    c->bytes_tx += n;
+    c->bytes_rx += (r > 0) ? tr->rx_num : 0;
+    c->timeouts += (timeout) ? 1 : 0;
+    c->crc_errors += (crc_err) ? 1 : 0;
+    c->retries += (retry) ? 1 : 0;
+    c->latency_us_total += latency_us;
+    if (latency_us > c->latency_us_max) {
+      c->latency_us_max = latency_us;
+    }
+    c->latency[bucket]++;
+  }
+
+  last_tr_failed[device] = timeout || crc_err;
+  last_tr_arg[device] = arg;
+  last_tr_device = device;
+  last_tr_crc_err = crc_err;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::notifyProtocolError(uint8_t i) {
+  /* answers with a wrong CRC have already been counted as CRC errors */
+  if (i != last_tr_device || i >= OPTA_CONTROLLER_MAX_EXPANSION_NUM ||
+      last_tr_crc_err) {
+    return;
+  }
+  metrics[i].total.protocol_errors++;
+  metrics[i].useArg(last_tr_arg[i])->protocol_errors++;
+  last_tr_failed[i] = true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const ExpansionMetrics *Controller::getMetrics(uint8_t i) {
+  if (i < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return &metrics[i];
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::resetMetrics() {
+  for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+    resetMetrics(i);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::resetMetrics(uint8_t i) {
+  if (i < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    metrics[i].reset();
+    last_tr_failed[i] = false;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::update_health(uint8_t device, bool ok) {
+  if (health[device].update(ok, millis()) && health_change != nullptr) {
+    health_change(device, health[device].state);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* send a probe (get product type) to the offline expansions whose probe
+   time has come */
+void Controller::probe_offline() {
+  for (int i = 0; i < num_of_exp; i++) {
+    if (health[i].isProbeDue(millis())) {
+      beginTransaction(OPTA_BUS_CLASS_DIAGNOSTIC);
+      send(exp_add[i], i, exp_type[i], msg_get_product_type(),
+           getExpectedAnsLen(ANS_LEN_GET_PRODUCT_TYPE));
+      endTransaction();
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const ExpansionHealth *Controller::getHealth(uint8_t i) {
+  if (i < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return &health[i];
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const AnswerTimeout *Controller::getAnswerTimeout(uint8_t i, uint8_t cls) {
+  if (i < OPTA_CONTROLLER_MAX_EXPANSION_NUM && cls < OPTA_BUS_CLASS_NUM) {
+    return &ans_timeout[i][cls];
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 void Controller::setTx(uint8_t value, uint8_t pos) {
-  if (pos < OPTA_I2C_BUFFER_DIM) {
+  uint8_t *tx_buffer = getTxBuffer();
+  if (pos < OPTA_I2C_LARGE_BUFFER_DIM) {
     tx_buffer[pos] = value;
   }
 }
@@ -239,7 +477,8 @@ void Controller::setTx(uint8_t value, uint8_t pos) {
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 uint8_t Controller::getRx(uint8_t pos) {
-  if (pos < OPTA_I2C_BUFFER_DIM) {
+  uint8_t *rx_buffer = getRxBuffer();
+  if (pos < OPTA_I2C_LARGE_BUFFER_DIM) {
     return rx_buffer[pos];
   }
   return 0;
@@ -321,12 +560,29 @@ void Controller::begin() {
 #endif
   /* initalize the controller detect pin as a input pullup */
   pinMode(OPTA_CONTROLLER_DETECT_PIN, INPUT_PULLUP);
+  /* the edges of the detect pin are timestamped by an interrupt, so that
+     the debounce does not need to sample the pin */
+  detect_edge_ms = millis();
+  detect_event = false;
+  attachInterrupt(OPTA_CONTROLLER_DETECT_PIN, detect_isr, CHANGE);
   /* initialize the controller as I2C MASTER */
   Wire.begin();
-  Wire.setClock(400000);
+  set_clock(OPTA_I2C_FAST_CLOCK);
 
+  /* expansions unchanged since the last address assignment: nothing to do */
+  if (fast_begin()) {
+    return;
+  }
+
+  bus.lock();
   _send(OPTA_CONTROLLER_FIRST_AVAILABLE_ADDRESS, msg_opta_reset(), 0);
-  delay(OPTA_CONTROLLER_SETUP_INIT_DELAY);
+  bus.unlock();
+  /* expansions waiting for an address pull the detect pin LOW */
+  unsigned long start = millis();
+  while (digitalRead(OPTA_CONTROLLER_DETECT_PIN) == HIGH &&
+         millis() - start < OPTA_CONTROLLER_SETUP_INIT_DELAY) {
+    delay(OPTA_CONTROLLER_READY_POLL_TIME);
+  }
   checkForExpansions();
 }
 
@@ -348,6 +604,13 @@ int Controller::analogReadOpta(uint8_t device, uint8_t pin,
 // REVISED
 bool Controller::getFwVersion(uint8_t device, uint8_t &major, uint8_t &minor,
                               uint8_t &release) {
+  /* answered by IDENTIFY during the discovery */
+  if (device < num_of_exp && info[device].valid) {
+    major = info[device].fw_major;
+    minor = info[device].fw_minor;
+    release = info[device].fw_release;
+    return true;
+  }
   Expansion *ptr = getExpansionPtr(device);
   if (ptr != nullptr) {
     return ptr->getFwVersion(major, minor, release);
@@ -374,25 +637,33 @@ PinStatus Controller::digitalReadOpta(uint8_t device, uint8_t pin,
 
 bool Controller::rebootExpansion(uint8_t device) {
   if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    beginTransaction();
+    bus.lock();
     _send(exp_add[device], msg_opta_reboot(), getExpectedAnsLen(ANS_LEN_REBOOT));
-
-    if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER, 
-                               getExpectedAnsLen(ANS_LEN_REBOOT), 
-                               OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT)) {
-      if (parse_opta_reboot()) {
-        delay(OPTA_CONTROLLER_DELAY_AFTER_REBOOT);
-        return true;
-      }
+    bool answered = wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER,
+                                           getExpectedAnsLen(ANS_LEN_REBOOT),
+                                           OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT * 1000,
+                                           micros());
+    bus.unlock();
+
+    bool rebooted = false;
+    if (answered) {
+      rebooted = parse_opta_reboot();
     } else {
 #ifdef DEBUG_COMM_TIMEOUT
       Serial.println("ERR C");
       for (int i = 0; i < ANS_REBOOT_LEN_CRC; i++) {
-        Serial.print(rx_buffer[i], HEX);
+        Serial.print(getRxBuffer()[i], HEX);
         Serial.print(" ");
       }
       Serial.println();
 #endif
     }
+    endTransaction();
+    if (rebooted) {
+      delay(OPTA_CONTROLLER_DELAY_AFTER_REBOOT);
+      return true;
+    }
   }
   delay(OPTA_CONTROLLER_DELAY_AFTER_REBOOT);
   return false;
@@ -480,65 +751,207 @@ void Controller::update() {
   }
 #endif
 
+  /* the address assignment starts when the detect pin goes LOW (an
+     expansion has been plugged in or reset) and stays LOW for the debounce
+     time; the pin is also checked every OPTA_CONTROLLER_UPDATE_RATE in case
+     an edge has been missed */
   static unsigned long int start = millis();
-  if (millis() - start > OPTA_CONTROLLER_UPDATE_RATE) {
+  bool poll = (millis() - start > OPTA_CONTROLLER_UPDATE_RATE);
+  if (poll) {
     start = millis();
-
+  }
+  if ((detect_event || poll) &&
+      millis() - detect_edge_ms >= OPTA_CONTROLLER_DEBOUNCE_LOW_TIME *
+                                       OPTA_CONTROLLER_DEBOUNCE_LOW_NUMBER) {
+    detect_event = false;
     checkForExpansions();
   }
+
+  if (millis() - time_sync_ms >= OPTA_CONTROLLER_TIME_SYNC_MS) {
+    syncTime();
+  }
+  probe_offline();
+  polling.run();
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-/* this function checks the status of the detect pin and debounce it for LOW
-   status i.e. it returns true if the PIN is low and remains LOW for a
-   certain time */
-bool Controller::is_detect_low() {
-  PinStatus detect_st = digitalRead(OPTA_CONTROLLER_DETECT_PIN);
+bool Controller::flushOutputs() {
+  bool rv = true;
+  for (int i = 0; i < num_of_exp; i++) {
+    Expansion *exp = getExpansionPtr(i);
+    if (exp != nullptr) {
+      if (exp->flushOutputs() != EXECUTE_OK) {
+        rv = false;
+      }
+    }
+  }
+  return rv;
+}
 
-  if (detect_st == LOW) {
-    int num = 0;
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-    while (detect_st == LOW && num < OPTA_CONTROLLER_DEBOUNCE_LOW_NUMBER) {
-      detect_st = digitalRead(OPTA_CONTROLLER_DETECT_PIN);
-      if (detect_st == HIGH) {
-        break;
+bool Controller::commitOutputs() {
+  bool rv = true;
+  beginTransaction(OPTA_BUS_CLASS_OUTPUTS);
+  for (int i = 0; i < num_of_exp; i++) {
+    Expansion *exp = getExpansionPtr(i);
+    if (exp != nullptr) {
+      if (exp->stageOutputs() != EXECUTE_OK) {
+        rv = false;
+      }
+    }
+  }
+  if (!applyStagedOutputs()) {
+    rv = false;
+  }
+  endTransaction();
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Controller::applyStagedOutputs() {
+  bool rv = true;
+  beginTransaction(OPTA_BUS_CLASS_OUTPUTS);
+  /* held for the whole burst: no frame of other threads between the
+     commits (send() locks it again for each frame) */
+  bus.lock(OPTA_BUS_CLASS_OUTPUTS);
+  for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+    commit_failed[i] = false;
+    if (i < num_of_exp && hasFeature(i, OPTA_CAPABILITY_COMMIT)) {
+      uint8_t n = prepareSetMsg(getTxBuffer(), ARG_COMMIT_OUTPUTS,
+                                LEN_COMMIT_OUTPUTS);
+      if (send(exp_add[i], i, exp_type[i], n, 0) != SEND_RESULT_OK) {
+        commit_failed[i] = true;
+        rv = false;
       }
-      delay(OPTA_CONTROLLER_DEBOUNCE_LOW_TIME);
-      num++;
     }
   }
+  bus.unlock();
+  endTransaction();
+  return rv;
+}
 
-  return (detect_st == LOW);
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::latchInputs() {
+  if (++latch_id == 0) {
+    latch_id = 1;
+  }
+  beginTransaction(OPTA_BUS_CLASS_INPUTS);
+  /* held for the whole burst: no frame of other threads between the
+     latches (send() locks it again for each frame) */
+  bus.lock(OPTA_BUS_CLASS_INPUTS);
+  for (int i = 0; i < num_of_exp; i++) {
+    if (hasFeature(i, OPTA_CAPABILITY_LATCH)) {
+      setTx(latch_id, LATCH_INPUTS_ID_POS);
+      uint8_t n = prepareSetMsg(getTxBuffer(), ARG_LATCH_INPUTS,
+                                LEN_LATCH_INPUTS);
+      send(exp_add[i], i, exp_type[i], n, 0);
+    }
+  }
+  bus.unlock();
+  endTransaction();
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-/* this function checks the status of the detect pin and debounce it for LOW
-   status i.e. it returns true if the PIN is low and remains LOW for a
-   certain time */
-bool Controller::is_detect_high() {
-  PinStatus detect_st = digitalRead(OPTA_CONTROLLER_DETECT_PIN);
+void Controller::syncTime() {
+  time_sync_ms = millis();
+  beginTransaction(OPTA_BUS_CLASS_INPUTS);
+  bus.lock(OPTA_BUS_CLASS_INPUTS);
+  for (int i = 0; i < num_of_exp; i++) {
+    if (hasFeature(i, OPTA_CAPABILITY_TIME)) {
+      /* the expansion takes its time when the frame ends: the time sent is
+         the one at the end of the frame (address, header, time and CRC, 9
+         clock cycles each) */
+      uint32_t frame = 1 + BP_HEADER_DIM + LEN_TIME_SYNC + 1;
+      uint32_t t = (uint32_t)micros() + (frame * 9 * 1000000UL) / bus_clock;
+      for (int j = 0; j < LEN_TIME_SYNC; j++) {
+        setTx((uint8_t)(t >> (8 * j)), TIME_SYNC_TIME_POS + j);
+      }
+      uint8_t n = prepareSetMsg(getTxBuffer(), ARG_TIME_SYNC, LEN_TIME_SYNC);
+      send(exp_add[i], i, exp_type[i], n, 0);
+    }
+  }
+  bus.unlock();
+  endTransaction();
+}
 
-  if (detect_st == HIGH) {
-    int num = 0;
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-    while (detect_st == HIGH && num < OPTA_CONTROLLER_DEBOUNCE_UP_NUMBER) {
-      detect_st = digitalRead(OPTA_CONTROLLER_DETECT_PIN);
-      if (detect_st == LOW) {
-        break;
+bool Controller::readInputs() {
+  latchInputs();
+  bool rv = true;
+  for (int i = 0; i < num_of_exp; i++) {
+    Expansion *exp = getExpansionPtr(i);
+    if (exp != nullptr) {
+      unsigned int err = exp->execute(GET_LATCHED_INPUTS);
+      /* custom expansions have nothing to read */
+      if (err != EXECUTE_OK && err != EXECUTE_ERR_UNSUPPORTED) {
+        rv = false;
       }
-      delay(OPTA_CONTROLLER_DEBOUNCE_UP_TIME);
-      num++;
     }
   }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+volatile bool Controller::detect_event = false;
+volatile unsigned long Controller::detect_edge_ms = 0;
 
-  return (detect_st == HIGH);
+/* interrupt of the detect pin: only the time of the edge is recorded */
+void Controller::detect_isr() {
+  detect_edge_ms = millis();
+  detect_event = true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* true if the detect pin is at level st and has not changed for debounce_ms:
+   it waits only for the part of the debounce time not yet elapsed since the
+   last edge (no wait at all if the pin is stable) */
+bool Controller::is_detect_stable(PinStatus st, unsigned long debounce_ms) {
+  for (;;) {
+    if (digitalRead(OPTA_CONTROLLER_DETECT_PIN) != st) {
+      return false;
+    }
+    if (millis() - detect_edge_ms >= debounce_ms) {
+      return true;
+    }
+    delay(1);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* this function checks the status of the detect pin and debounce it for LOW
+   status i.e. it returns true if the PIN is low and remains LOW for a
+   certain time */
+bool Controller::is_detect_low() {
+  return is_detect_stable(LOW, OPTA_CONTROLLER_DEBOUNCE_LOW_TIME *
+                                   OPTA_CONTROLLER_DEBOUNCE_LOW_NUMBER);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* this function checks the status of the detect pin and debounce it for HIGH
+   status i.e. it returns true if the PIN is high and remains HIGH for a
+   certain time */
+bool Controller::is_detect_high() {
+  return is_detect_stable(HIGH, OPTA_CONTROLLER_DEBOUNCE_UP_TIME *
+                                    OPTA_CONTROLLER_DEBOUNCE_UP_NUMBER);
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 void Controller::assign_custom_type_and_call_start_up() {
+   /* the start up functions of the expansions send their messages in the
+      same transaction (bus held until all expansions are set up) */
+   beginTransaction();
+   bus.lock();
    /* safe to call this in the registerCustomExpansion function because:
       - if the Controller.begin() function has been called then num_of_exp is
         different from 0
@@ -546,10 +959,16 @@ void Controller::assign_custom_type_and_call_start_up() {
    for (int i = 0; i < num_of_exp; i++) {
       /* assign to expansion in position i a custom expansion type (if custom 
          expansion has been registered */
-      if (exp_type[i] >= OPTA_CONTROLLER_CUSTOM_MIN_TYPE || exp_type[i] == EXPANSION_NOT_VALID) {
+      if ((exp_type[i] >= OPTA_CONTROLLER_CUSTOM_MIN_TYPE || exp_type[i] == EXPANSION_NOT_VALID) &&
+          info[i].valid) {
+        /* product already answered by IDENTIFY */
+        int t = getExpansionType(std::string(info[i].product));
+        exp_type[i] = (t == -1) ? EXPANSION_NOT_VALID : t;
+      }
+      else if (exp_type[i] >= OPTA_CONTROLLER_CUSTOM_MIN_TYPE || exp_type[i] == EXPANSION_NOT_VALID) {
         _send(exp_add[i], msg_get_product_type(), getExpectedAnsLen(ANS_LEN_GET_PRODUCT_TYPE));
         if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER,
-                                   getExpectedAnsLen(ANS_LEN_GET_PRODUCT_TYPE), OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT)) {
+                                   getExpectedAnsLen(ANS_LEN_GET_PRODUCT_TYPE), OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT * 1000, micros())) {
           /* return expansion not valid if product is not found*/
           exp_type[i] = parse_get_product();
           #if defined DEBUG_SERIAL && defined DEBUG_ASSIGN_ADDRESS_CONTROLLER
@@ -570,6 +989,8 @@ void Controller::assign_custom_type_and_call_start_up() {
          }
       }
    }
+   bus.unlock();
+   endTransaction();
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
@@ -582,6 +1003,11 @@ void Controller::checkForExpansions() {
     return;
   }
 
+  /* the assign address process uses the bus exclusively (expansions without
+     address answer to the default address) */
+  beginTransaction();
+  bus.lock();
+
   bool enter_while = is_detect_low();
   /* PAY ATTENTION:
      The condition to ENTER into the while loop is that the DETECT pin is
@@ -598,13 +1024,23 @@ void Controller::checkForExpansions() {
   /* INITIALIZING ALL VARIABLE USED THEN IN THE FOLLOWING while loop WHERE
      ADDRESS are assigned */
   if (enter_while) {
-    
+    /* expansions without address have the default I2C timing */
+    set_clock(OPTA_I2C_FAST_CLOCK);
+
     for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
       tmp_exp_add[i] = 0;
       tmp_exp_type[i] = 0;
     }
     num_of_exp = 0;
     tmp_num_of_exp = 0;
+    /* round trip times and health belong to the previous expansions */
+    for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+      for (int c = 0; c < OPTA_BUS_CLASS_NUM; c++) {
+        ans_timeout[i][c].reset();
+      }
+      health[i].reset();
+      info[i].reset();
+    }
     /* the tmp_address is incremented automatically when an answer for the
        request get address and type is correctly received */
     tmp_address = OPTA_CONTROLLER_FIRST_TEMPORARY_ADDRESS;
@@ -617,7 +1053,12 @@ void Controller::checkForExpansions() {
       _send(i, msg_opta_reset(), 0);
     }
 
-    delay(OPTA_CONTROLLER_SETUP_INIT_DELAY);
+    /* the last expansion of the chain answers to the default address when
+       all the expansions have been reset */
+    delay(OPTA_CONTROLLER_RESET_SETTLE_TIME);
+    wait_for_ready(OPTA_DEFAULT_SLAVE_I2C_ADDRESS,
+                   OPTA_CONTROLLER_SETUP_INIT_DELAY -
+                       OPTA_CONTROLLER_RESET_SETTLE_TIME);
   }
   
   /* #################################
@@ -639,7 +1080,8 @@ void Controller::checkForExpansions() {
      * %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%% */
     temporary_address_sent = tmp_address;
     _send(OPTA_DEFAULT_SLAVE_I2C_ADDRESS, msg_set_address(tmp_address), 0);
-    delay(OPTA_CONTROLLER_DELAY_AFTER_SET_ADDRESS);
+    /* the expansion answers as soon as it uses the new address */
+    wait_for_ready(tmp_address, OPTA_CONTROLLER_DELAY_AFTER_SET_ADDRESS);
     
     uint8_t attempts = 3;
     /* exit with break upon correct answer received */
@@ -659,7 +1101,7 @@ void Controller::checkForExpansions() {
 
       /*  3. RECEIVING ANSWER */
 
-      if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER, getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE), OPTA_CONTROLLER_TIMEOUT_FOR_SETUP_MESSAGE)) {
+      if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER, getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE), OPTA_CONTROLLER_TIMEOUT_FOR_SETUP_MESSAGE * 1000, micros())) {
         /* when the address is correcly received as answer to the previous the
           parse_address_and_type function increase in a circular way
           tmp_num_of_exp so that tmp_exp_add array is filled in a circular way */
@@ -668,14 +1110,13 @@ void Controller::checkForExpansions() {
           delay(5);
           _send(tmp_address, msg_confirm_rx_address(),0);
           #endif
-          delay(10);
           #if defined DEBUG_SERIAL && defined DEBUG_ASSIGN_ADDRESS_CONTROLLER
           Serial.println("        GOT IT! ");
           #endif
           break;
         } 
         else {
-          delay(20);
+          delay(OPTA_CONTROLLER_READY_POLL_TIME);
         }
        
       }
@@ -683,7 +1124,7 @@ void Controller::checkForExpansions() {
         #if defined DEBUG_SERIAL && defined DEBUG_ASSIGN_ADDRESS_CONTROLLER
         Serial.println("          TIMEOUT ");
         #endif 
-        delay(20);
+        delay(OPTA_CONTROLLER_READY_POLL_TIME);
       }
       attempts--;
     }
@@ -764,7 +1205,7 @@ void Controller::checkForExpansions() {
     #endif
     _send(tmp_exp_add[tmp_num_of_exp], msg_set_address(address), 0);
 
-    delay(OPTA_CONTROLLER_DELAY_AFTER_SET_ADDRESS);
+    wait_for_ready(address, OPTA_CONTROLLER_DELAY_AFTER_SET_ADDRESS);
 
     _send(address, msg_get_address_and_type(), getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE));
 
@@ -775,7 +1216,7 @@ void Controller::checkForExpansions() {
       after 3 failed attemps the address is skipped and then the
       tmp_num_of_exp is decreased in the else branch */
 
-      if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER, getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE), OPTA_CONTROLLER_TIMEOUT_FOR_SETUP_MESSAGE)) {
+      if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER, getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE), OPTA_CONTROLLER_TIMEOUT_FOR_SETUP_MESSAGE * 1000, micros())) {
         if (parse_address_and_type(address)) {
           remain_in_while_loop = (tmp_num_of_exp != initial_value);
         }
@@ -792,8 +1233,40 @@ void Controller::checkForExpansions() {
       }
     } while (tmp_exp_add[tmp_num_of_exp] != 0 && remain_in_while_loop);
 
-    /* give some time to analog to reset Analog Devices */
-    delay(OPTA_CONTROLLER_DELAY_EXPANSION_RESET);
+    /* each expansion must answer to its final address; the answer comes
+       from the I2C interrupt, not from the main loop: Opta Analog resets the
+       Analog Devices in its main loop once the address is final, so it is
+       always given the whole OPTA_CONTROLLER_DELAY_EXPANSION_RESET */
+    unsigned long ready_start = millis();
+    bool analog = false;
+    for (int i = 0; i < num_of_exp; i++) {
+      unsigned long elapsed = millis() - ready_start;
+      if (elapsed < OPTA_CONTROLLER_DELAY_EXPANSION_RESET) {
+        wait_for_ready(exp_add[i], OPTA_CONTROLLER_DELAY_EXPANSION_RESET - elapsed);
+      }
+      if (exp_type[i] == EXPANSION_OPTA_ANALOG) {
+        analog = true;
+      }
+    }
+    unsigned long ready_elapsed = millis() - ready_start;
+    if (analog && ready_elapsed < OPTA_CONTROLLER_DELAY_EXPANSION_RESET) {
+      delay(OPTA_CONTROLLER_DELAY_EXPANSION_RESET - ready_elapsed);
+    }
+
+    /* one IDENTIFY per expansion: product of the custom expansions and
+       firmware version without other messages */
+    identify_expansions();
+    select_clock();
+    syncTime();
+
+    /* topology to be saved: the type answered by the expansions (before
+       the custom types are assigned) */
+    Topology found;
+    found.num = num_of_exp;
+    for (int i = 0; i < num_of_exp; i++) {
+      found.exp[i].address = exp_add[i];
+      found.exp[i].type = exp_type[i];
+    }
 
     /* reset the start up callback flag so that the callback can be called again*/
     for(unsigned int i = 0; i < exp_type_list.size(); i++) {
@@ -822,6 +1295,10 @@ void Controller::checkForExpansions() {
       }
     }    
 
+    if (enter_while) {
+      save_topology(found);
+    }
+
 #if defined DEBUG_SERIAL && defined DEBUG_ASSIGN_ADDRESS_CONTROLLER
     Serial.println();
     Serial.println("[LOG]: ***** REASSING ADDRESSES FINISHED ***** ");
@@ -845,16 +1322,428 @@ void Controller::checkForExpansions() {
       }
     }
 #endif
-   
+    bus.unlock();
+    endTransaction();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* verify the saved topology: each expansion must answer at its address with
+   the same type and no expansion must answer at the next address, return
+   true if the expansions are set up without address assignment */
+bool Controller::fast_begin() {
+  if (!fast_boot || !topology.load() || topology.num == 0 ||
+      digitalRead(OPTA_CONTROLLER_DETECT_PIN) == LOW) {
+    return false;
+  }
+
+  beginTransaction();
+  bus.lock();
+  uint8_t *rx_buffer = getRxBuffer();
+  bool match = true;
+  for (int i = 0; i < topology.num && match; i++) {
+    match = wait_for_ready(topology.exp[i].address,
+                           OPTA_CONTROLLER_FAST_BOOT_TIMEOUT) &&
+            rx_buffer[BP_PAYLOAD_START_POS] == topology.exp[i].address &&
+            rx_buffer[BP_PAYLOAD_START_POS + 1] == topology.exp[i].type;
+  }
+  if (match && topology.num < OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    match = !wait_for_ready(topology.exp[topology.num - 1].address + 1,
+                            OPTA_CONTROLLER_FAST_BOOT_TIMEOUT);
+  }
+
+  if (match) {
+    num_of_exp = topology.num;
+    for (int i = 0; i < num_of_exp; i++) {
+      exp_add[i] = topology.exp[i].address;
+      exp_type[i] = topology.exp[i].type;
+    }
+    for (int i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+      for (int c = 0; c < OPTA_BUS_CLASS_NUM; c++) {
+        ans_timeout[i][c].reset();
+      }
+      health[i].reset();
+      info[i].reset();
+      DigitalExpansion::clearDirty(i);
+      AnalogExpansion::clearDirty(i);
+      if (expansions[i] != nullptr) {
+        delete expansions[i];
+        expansions[i] = nullptr;
+      }
+    }
+    identify_expansions();
+    select_clock();
+    syncTime();
+    /* warm restart: the expansions keep outputs and configuration, the
+       start up functions (that set them to the defaults) are not called and
+       the state of the expansions is read back instead; if an expansion
+       cannot be read back (e.g. old firmware) all are set up again */
+    for (unsigned int i = 0; i < exp_type_list.size(); i++) {
+      if (warm_start) {
+        exp_type_list[i].disableStartUpCallback();
+      } else {
+        exp_type_list[i].enableStartUpCallback();
+      }
+    }
+    assign_custom_type_and_call_start_up();
+    if (warm_start && !resume_expansions()) {
+      for (unsigned int i = 0; i < exp_type_list.size(); i++) {
+        exp_type_list[i].enableStartUpCallback();
+      }
+      assign_custom_type_and_call_start_up();
+    }
+  }
+  bus.unlock();
+  endTransaction();
+  return match;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* send IDENTIFY to the expansion i (bus already locked), the answer is kept
+   in info[i] */
+bool Controller::identify(uint8_t i) {
+  info[i].reset();
+  unsigned long start = micros();
+  _send(exp_add[i], msg_identify(), getExpectedAnsLen(ANS_LEN_IDENTIFY));
+  if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER,
+                             getExpectedAnsLen(ANS_LEN_IDENTIFY),
+                             OPTA_CONTROLLER_IDENTIFY_TIMEOUT * 1000, start) &&
+      parse_identify(i)) {
+    negotiate_features(i);
+    return true;
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* enable the optional features supported by both the Controller and the
+   expansion i (identified), the expansion answers with the ones enabled:
+   features not agreed are never used (the previous messages are used) */
+bool Controller::negotiate_features(uint8_t i) {
+  info[i].features = 0;
+  uint16_t f = info[i].capabilities & ctrl_features;
+  if (info[i].protocol < 1) {
+    return false;
+  }
+  unsigned long start = micros();
+  _send(exp_add[i], msg_set_features(f),
+        getExpectedAnsLen(ANS_LEN_SET_FEATURES));
+  if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER,
+                             getExpectedAnsLen(ANS_LEN_SET_FEATURES),
+                             OPTA_CONTROLLER_IDENTIFY_TIMEOUT * 1000, start)) {
+    uint8_t *rx_buffer = getRxBuffer();
+    if (checkAnsSetReceived(rx_buffer, ANS_ARG_SET_FEATURES,
+                            ANS_LEN_SET_FEATURES)) {
+      /* never more than what has been asked */
+      info[i].features = f & (rx_buffer[ANS_SET_FEATURES_POS] |
+                              (rx_buffer[ANS_SET_FEATURES_POS + 1] << 8));
+      return true;
+    }
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::set_clock(uint32_t freq) {
+  Wire.setClock(freq);
+  bus_clock = freq;
+  clock_frames = 0;
+  clock_errors = 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* Fast-mode Plus if the wiring allows it and all the expansions enabled it,
+   then each expansion must answer to IDENTIFY at the new clock or the bus
+   goes back to Fast-mode (bus already locked) */
+void Controller::select_clock() {
+  bool fast_plus = (max_clock >= OPTA_I2C_FAST_PLUS_CLOCK && num_of_exp > 0);
+  for (int i = 0; i < num_of_exp && fast_plus; i++) {
+    fast_plus = info[i].hasFeature(OPTA_CAPABILITY_FAST_PLUS);
+  }
+  if (!fast_plus) {
+    set_clock(OPTA_I2C_FAST_CLOCK);
+    return;
+  }
+
+  delay(OPTA_CONTROLLER_FAST_PLUS_DELAY);
+  set_clock(OPTA_I2C_FAST_PLUS_CLOCK);
+  uint8_t *rx_buffer = getRxBuffer();
+  for (int i = 0; i < num_of_exp; i++) {
+    unsigned long start = micros();
+    _send(exp_add[i], msg_identify(), getExpectedAnsLen(ANS_LEN_IDENTIFY));
+    if (!wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER,
+                                getExpectedAnsLen(ANS_LEN_IDENTIFY),
+                                OPTA_CONTROLLER_IDENTIFY_TIMEOUT * 1000,
+                                start) ||
+        !checkAnsGetReceived(rx_buffer, ANS_ARG_IDENTIFY, ANS_LEN_IDENTIFY)) {
+      /* the Fast-mode Plus timing of the expansions also works in
+         Fast-mode: they are not told */
+      set_clock(OPTA_I2C_FAST_CLOCK);
+      clock_fallbacks++;
+      return;
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* error rate of the frames sent in Fast-mode Plus (bus locked) */
+void Controller::count_clock_error(bool failed) {
+  if (bus_clock <= OPTA_I2C_FAST_CLOCK) {
+    return;
+  }
+  clock_frames++;
+  if (failed) {
+    clock_errors++;
+  }
+  if (clock_errors >= OPTA_CONTROLLER_CLOCK_MAX_ERRORS) {
+    set_clock(OPTA_I2C_FAST_CLOCK);
+    clock_fallbacks++;
+  } else if (clock_frames >= OPTA_CONTROLLER_CLOCK_ERR_WINDOW) {
+    clock_frames = 0;
+    clock_errors = 0;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t Controller::getFrameDim(uint8_t i) {
+  if (hasFeature(i, OPTA_CAPABILITY_LARGE_FRAMES)) {
+    return OPTA_I2C_LARGE_BUFFER_DIM;
+  }
+  return OPTA_I2C_BUFFER_DIM;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int Controller::transfer(uint8_t i, uint8_t arg, const uint8_t *data,
+                         uint16_t n, uint8_t *ans, uint16_t max) {
+  return transfer(i, arg, nullptr, 0, data, n, ans, max);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int Controller::transfer(uint8_t i, uint8_t arg, const uint8_t *head,
+                         uint8_t head_n, const uint8_t *data, uint16_t n,
+                         uint8_t *ans, uint16_t max) {
+  if (!hasFeature(i, OPTA_CAPABILITY_TRANSFER)) {
+    return -TRANSFER_ERR_NOT_SUPPORTED;
+  }
+  if (head_n + n > OPTA_TRANSFER_MAX_DIM) {
+    return -TRANSFER_ERR_OVERFLOW;
+  }
+  beginTransaction(OPTA_BUS_CLASS_BULK);
+  /* a new transfer: its attempts keep the same id (a retry is not taken
+     for the transfer completed before it) */
+  transfer_id[i] += TRANSFER_ID_STEP;
+  int rv = -TRANSFER_ERR_COMM;
+  for (int r = 0; r <= OPTA_CONTROLLER_TRANSFER_RETRIES; r++) {
+    rv = transfer_once(i, arg, head, head_n, data, n, ans, max);
+    /* only a lost or corrupted fragment is worth sending again */
+    if (rv != -TRANSFER_ERR_SEQUENCE && rv != -TRANSFER_ERR_COMM &&
+        rv != -TRANSFER_ERR_CRC) {
+      break;
+    }
+  }
+  endTransaction();
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* the fragments are sent without waiting for an answer, only the last one
+   is answered (bytes received, dimension of the answer and their CRC) */
+int Controller::transfer_once(uint8_t i, uint8_t arg, const uint8_t *head,
+                              uint8_t head_n, const uint8_t *data, uint16_t n,
+                              uint8_t *ans, uint16_t max) {
+  uint8_t *tx_buffer = getTxBuffer();
+  uint8_t *rx_buffer = getRxBuffer();
+  uint8_t frame = getFrameDim(i);
+
+  /* request: head and data as one payload */
+  uint8_t crc = OptaCrc8::calc(data, n, OptaCrc8::calc(head, head_n, 0));
+  n += head_n;
+  uint16_t k = frame - BP_HEADER_DIM - LEN_TRANSFER_MIN - 1;
+  uint16_t sent = 0;
+  uint8_t seq = 0;
+  uint8_t len = 0;
+  do {
+    uint16_t d = (n - sent > k) ? k : n - sent;
+    bool last = (sent + d >= n);
+    tx_buffer[TRANSFER_ARG_POS] = arg;
+    tx_buffer[TRANSFER_SEQ_POS] = seq;
+    tx_buffer[TRANSFER_FLAGS_POS] = transfer_id[i] |
+                                    ((seq == 0) ? TRANSFER_FLAG_FIRST : 0) |
+                                    ((last) ? TRANSFER_FLAG_LAST : 0);
+    for (uint16_t j = 0; j < d; j++) {
+      uint16_t pos = sent + j;
+      tx_buffer[TRANSFER_DATA_POS + j] =
+          (pos < head_n) ? head[pos] : data[pos - head_n];
+    }
+    len = prepareSetMsg(tx_buffer, ARG_TRANSFER, LEN_TRANSFER_MIN + d);
+    if (send(exp_add[i], i, exp_type[i], len,
+             (last) ? getExpectedAnsLen(ANS_LEN_TRANSFER) : 0) !=
+        SEND_RESULT_OK) {
+      return -TRANSFER_ERR_COMM;
+    }
+    sent += d;
+    seq++;
+  } while (sent < n);
+
+  /* executed by the main loop of the expansion: the last fragment (still in
+     tx_buffer) sent again is answered with the result when ready */
+  unsigned long start = millis();
+  for (;;) {
+    if (!checkAnsSetReceived(rx_buffer, ANS_ARG_TRANSFER, ANS_LEN_TRANSFER) ||
+        rx_buffer[ANS_TRANSFER_ARG_POS] != arg) {
+      notifyProtocolError(i);
+      return -TRANSFER_ERR_COMM;
+    }
+    if (rx_buffer[ANS_TRANSFER_STATUS_POS] != TRANSFER_BUSY) {
+      break;
+    }
+    if (millis() - start >= OPTA_CONTROLLER_TRANSFER_BUSY_MS) {
+      return -TRANSFER_ERR_COMM;
+    }
+    delay(OPTA_CONTROLLER_TRANSFER_POLL_MS);
+    if (send(exp_add[i], i, exp_type[i], len,
+             getExpectedAnsLen(ANS_LEN_TRANSFER)) != SEND_RESULT_OK) {
+      return -TRANSFER_ERR_COMM;
+    }
+  }
+  if (rx_buffer[ANS_TRANSFER_STATUS_POS] != TRANSFER_OK) {
+    return -(int)rx_buffer[ANS_TRANSFER_STATUS_POS];
+  }
+  uint16_t received = rx_buffer[ANS_TRANSFER_RX_DIM_POS] |
+                      (rx_buffer[ANS_TRANSFER_RX_DIM_POS + 1] << 8);
+  uint16_t ans_dim = rx_buffer[ANS_TRANSFER_ANS_DIM_POS] |
+                     (rx_buffer[ANS_TRANSFER_ANS_DIM_POS + 1] << 8);
+  if (received != n) {
+    return -TRANSFER_ERR_SEQUENCE;
+  }
+  if (rx_buffer[ANS_TRANSFER_RX_CRC_POS] != crc) {
+    return -TRANSFER_ERR_CRC;
+  }
+  crc = rx_buffer[ANS_TRANSFER_ANS_CRC_POS];
+  if (ans_dim > max || (ans_dim > 0 && ans == nullptr)) {
+    return -TRANSFER_ERR_OVERFLOW;
+  }
+
+  /* answer */
+  k = frame - BP_HEADER_DIM - ANS_LEN_TRANSFER_ANS_MIN - 1;
+  uint16_t got = 0;
+  for (seq = 0; got < ans_dim; seq++) {
+    uint16_t d = (ans_dim - got > k) ? k : ans_dim - got;
+    tx_buffer[TRANSFER_ANS_SEQ_POS] = seq;
+    tx_buffer[TRANSFER_ANS_DIM_POS] = (uint8_t)k;
+    uint8_t len = prepareGetMsg(tx_buffer, ARG_TRANSFER_ANS, LEN_TRANSFER_ANS);
+    if (send(exp_add[i], i, exp_type[i], len,
+             getExpectedAnsLen(ANS_LEN_TRANSFER_ANS_MIN + d)) !=
+        SEND_RESULT_OK) {
+      return -TRANSFER_ERR_COMM;
+    }
+    if (!checkAnsGetReceived(rx_buffer, ANS_ARG_TRANSFER_ANS,
+                             ANS_LEN_TRANSFER_ANS_MIN + d) ||
+        rx_buffer[ANS_TRANSFER_ANS_SEQ_POS] != seq) {
+      notifyProtocolError(i);
+      return -TRANSFER_ERR_COMM;
+    }
+    memcpy(ans + got, rx_buffer + ANS_TRANSFER_ANS_DATA_POS, d);
+    got += d;
+  }
+  if (ans_dim > 0 && OptaCrc8::calc(ans, ans_dim, 0) != crc) {
+    return -TRANSFER_ERR_CRC;
+  }
+  return ans_dim;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Controller::hasFeature(uint8_t i, uint16_t f) {
+  return (i < num_of_exp && info[i].hasFeature(f));
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::identify_expansions() {
+  for (int i = 0; i < num_of_exp; i++) {
+    identify(i);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Controller::identifyExpansion(uint8_t i) {
+  if (i >= num_of_exp) {
+    return false;
+  }
+  beginTransaction(OPTA_BUS_CLASS_DIAGNOSTIC);
+  bus.lock(OPTA_BUS_CLASS_DIAGNOSTIC);
+  bool rv = identify(i);
+  bus.unlock();
+  endTransaction();
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const ExpansionInfo *Controller::getInfo(uint8_t i) {
+  if (i < num_of_exp && info[i].valid) {
+    return &info[i];
+  }
+  return nullptr;
 }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* read back the state of all the expansions (warm restart), return false if
+   at least one expansion could not be read */
+bool Controller::resume_expansions() {
+  bool rv = true;
+  for (int i = 0; i < num_of_exp; i++) {
+    Expansion *exp = getExpansionPtr(i);
+    if (exp != nullptr && exp->resume() != EXECUTE_OK) {
+      rv = false;
+    }
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* complete the topology t with the firmware versions and save it if
+   different from the last one (no flash write when nothing changed) */
+void Controller::save_topology(const Topology &t) {
+  Topology found = t;
+  for (int i = 0; i < found.num; i++) {
+    getFwVersion(i, found.exp[i].fw_major, found.exp[i].fw_minor,
+                 found.exp[i].fw_release);
+  }
+  Topology saved;
+  if (fast_boot && (!saved.load() || saved != found)) {
+    found.save();
+  }
+  topology = found;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 void Controller::setFailedCommCb(CommErr_f f) { failed_i2c_comm = f; }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Controller::setHealthChangeCb(HealthChange_f f) { health_change = f; }
+
 /* #################################################################### */
 /* -------------- message preparation functions ---------------------- */
 /* #################################################################### */
 
 uint8_t Controller::msg_opta_reboot() {
+  uint8_t *tx_buffer = getTxBuffer();
   tx_buffer[REBOOT_1_POS] = REBOOT_1_VALUE;
   tx_buffer[REBOOT_2_POS] = REBOOT_2_VALUE;
   return prepareSetMsg(tx_buffer, ARG_REBOOT, LEN_REBOOT);
@@ -864,6 +1753,7 @@ uint8_t Controller::msg_opta_reboot() {
 
 /* prepare the message in the tx buffer to get opta digital analog in */
 uint8_t Controller::msg_opta_reset() {
+  uint8_t *tx_buffer = getTxBuffer();
   tx_buffer[BP_PAYLOAD_START_POS] = CONTROLLER_RESET_CODE;
   return prepareSetMsg(tx_buffer, ARG_CONTROLLER_RESET, LEN_CONTROLLER_RESET);
 }
@@ -872,6 +1762,7 @@ uint8_t Controller::msg_opta_reset() {
 
 /* prepare the message in the tx buffer to set an address to an expansion */
 uint8_t Controller::msg_set_address(uint8_t add) {
+  uint8_t *tx_buffer = getTxBuffer();
   tx_buffer[BP_PAYLOAD_START_POS] = add; /* the value to be set */
   return prepareSetMsg(tx_buffer, ARG_ADDRESS, LEN_ADDRESS);
 }
@@ -879,6 +1770,7 @@ uint8_t Controller::msg_set_address(uint8_t add) {
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
  #ifdef USE_CONFIRM_RX_MESSAGE
 uint8_t Controller::msg_confirm_rx_address() {
+  uint8_t *tx_buffer = getTxBuffer();
   tx_buffer[CONFIRM_ADDRESS_FIRST_POS] = CONFIRM_ADDRESS_FIRST_VALUE; 
   tx_buffer[CONFIRM_ADDRESS_SECOND_POS] = CONFIRM_ADDRESS_SECOND_VALUE; 
 
@@ -892,7 +1784,22 @@ uint8_t Controller::msg_confirm_rx_address() {
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 uint8_t Controller::msg_get_product_type() {
-  return prepareGetMsg(tx_buffer, ARG_GET_PRODUCT_TYPE, LEN_GET_PRODUCT_TYPE);
+  return prepareGetMsg(getTxBuffer(), ARG_GET_PRODUCT_TYPE, LEN_GET_PRODUCT_TYPE);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t Controller::msg_identify() {
+  return prepareGetMsg(getTxBuffer(), ARG_IDENTIFY, LEN_IDENTIFY);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t Controller::msg_set_features(uint16_t f) {
+  uint8_t *tx_buffer = getTxBuffer();
+  tx_buffer[SET_FEATURES_POS] = (uint8_t)f;
+  tx_buffer[SET_FEATURES_POS + 1] = (uint8_t)(f >> 8);
+  return prepareSetMsg(tx_buffer, ARG_SET_FEATURES, LEN_SET_FEATURES);
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
@@ -900,7 +1807,7 @@ uint8_t Controller::msg_get_product_type() {
 /* prepare the message in the tx buffer to get address and type from
  * expansion*/
 uint8_t Controller::msg_get_address_and_type() {
-  return prepareGetMsg(tx_buffer, ARG_ADDRESS_AND_TYPE, LEN_ADDRESS_AND_TYPE);
+  return prepareGetMsg(getTxBuffer(), ARG_ADDRESS_AND_TYPE, LEN_ADDRESS_AND_TYPE);
 }
 
 /* #######################################################################
@@ -911,11 +1818,14 @@ uint8_t Controller::msg_get_address_and_type() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-void Controller::resetRxBuffer() { memset(rx_buffer, 0, OPTA_I2C_BUFFER_DIM); }
+void Controller::resetRxBuffer() {
+  memset(getRxBuffer(), 0, OPTA_I2C_LARGE_BUFFER_DIM);
+}
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
 int Controller::parse_get_product() {
+  uint8_t *rx_buffer = getRxBuffer();
   int rv = EXPANSION_NOT_VALID;
 
   if (checkAnsGetReceived(rx_buffer, 
@@ -930,7 +1840,39 @@ int Controller::parse_get_product() {
   return (rv == -1) ? EXPANSION_NOT_VALID : rv;
 }
 
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Controller::parse_identify(uint8_t i) {
+  uint8_t *rx_buffer = getRxBuffer();
+  if (!checkAnsGetReceived(rx_buffer, ANS_ARG_IDENTIFY, ANS_LEN_IDENTIFY)) {
+    return false;
+  }
+  ExpansionInfo &in = info[i];
+  in.type = rx_buffer[IDENTIFY_TYPE_POS];
+  in.fw_major = rx_buffer[IDENTIFY_FW_MAJOR_POS];
+  in.fw_minor = rx_buffer[IDENTIFY_FW_MINOR_POS];
+  in.fw_release = rx_buffer[IDENTIFY_FW_RELEASE_POS];
+  in.protocol = rx_buffer[IDENTIFY_PROTOCOL_POS];
+  in.capabilities = rx_buffer[IDENTIFY_CAPABILITIES_POS] |
+                    (rx_buffer[IDENTIFY_CAPABILITIES_POS + 1] << 8);
+  in.cfg_hash = 0;
+  for (int k = 3; k >= 0; k--) {
+    in.cfg_hash = (in.cfg_hash << 8) | rx_buffer[IDENTIFY_CFG_HASH_POS + k];
+  }
+  uint8_t size = rx_buffer[IDENTIFY_PRODUCT_SIZE_POS];
+  if (size > IDENTIFY_PRODUCT_DIM) {
+    size = IDENTIFY_PRODUCT_DIM;
+  }
+  memcpy(in.product, rx_buffer + IDENTIFY_PRODUCT_POS, size);
+  in.product[size] = 0;
+  in.valid = true;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 bool Controller::parse_opta_reboot() {
+  uint8_t *rx_buffer = getRxBuffer();
   if (checkAnsSetReceived(rx_buffer, ANS_ARG_REBOOT, ANS_LEN_REBOOT)) {
 
     if (rx_buffer[ANS_REBOOT_CODE_POS] == ANS_REBOOT_CODE) {
@@ -963,6 +1905,7 @@ bool Controller::parse_opta_reboot() {
 
 /* parse the answer to the message get address and type from the slave */
 bool Controller::parse_address_and_type(int slave_address) {
+  uint8_t *rx_buffer = getRxBuffer();
   if (checkAnsGetReceived(rx_buffer, ANS_ARG_ADDRESS_AND_TYPE,
                           ANS_LEN_ADDRESS_AND_TYPE)) {
 #if defined DEBUG_SERIAL && defined DEBUG_MSG_PARSE_ADDRESS_AND_TYPE
@@ -1022,87 +1965,111 @@ bool Controller::parse_address_and_type(int slave_address) {
 
 /* send to address add n bytes from tx_buffer
    if r is > 0 then it issues a request from the slave for r bytes */
-void Controller::_send(int add, int n, int r) {
-#if defined DEBUG_SERIAL && defined DEBUG_TX_CONTROLLER_ENABLE
-  Serial.print("- TX to device 0x");
-  Serial.print(add, HEX);
-#endif
+/* false if the expansion did not acknowledge the frame */
+bool Controller::_send(int add, int n, int r) {
+  uint8_t *tx_buffer = getTxBuffer();
+  if (n > OPTA_I2C_LARGE_BUFFER_DIM) {
+    n = OPTA_I2C_LARGE_BUFFER_DIM;
+  }
 
   Wire.beginTransmission(add);
-
-/* Send */
-#if defined DEBUG_SERIAL && defined DEBUG_TX_CONTROLLER_ENABLE
-  Serial.print(" bytes: ");
-#endif
-
-  for (int i = 0; i < n && i < OPTA_I2C_BUFFER_DIM; i++) {
-
-#if defined DEBUG_SERIAL && defined DEBUG_TX_CONTROLLER_ENABLE
-    Serial.print("0x");
-    Serial.print(tx_buffer[i], HEX);
-    Serial.print(" ");
-#endif
-
+  for (int i = 0; i < n; i++) {
     Wire.write(tx_buffer[i]);
   }
+  uint8_t err = Wire.endTransmission();
 
-  Wire.endTransmission();
-
-#if defined DEBUG_SERIAL && defined DEBUG_TX_CONTROLLER_ENABLE
-  Serial.println();
-#endif
+  /* frames are recorded into the RAM trace instead of being printed
+   * on Serial (printing changes bus timing) */
+  trace_address = add;
+  trace.record(micros(), add, trace_device, OPTA_BUS_TRACE_TX, err,
+               tx_buffer, n);
 
   /* Request */
   if (r > 0) {
-#if defined DEBUG_SERIAL && defined DEBUG_TX_CONTROLLER_ENABLE
-    Serial.print("-> REQUESTED ");
-    Serial.print(r);
-    Serial.println(" bytes");
-#endif
     Wire.requestFrom(add, r);
-  } else {
-#if defined DEBUG_SERIAL && defined DEBUG_TX_CONTROLLER_ENABLE
-    Serial.println();
-#endif
   }
+  return (err == 0);
 }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-/* when an answer is requested from expansion this function wait for an
-   answer and put it into the rx buffer
-   return true if an answer is available */
-bool Controller::wait_for_device_answer(uint8_t device, uint8_t wait_for, uint16_t timeout) {
+/* Wire.requestFrom() returns when the answer has been received (or the
+   expansion did not acknowledge): no byte can arrive after it, the bytes
+   available are the whole answer */
+bool Controller::read_answer(uint8_t device, uint8_t wait_for) {
+  TransactionCtx *tr = bus.ctx();
   uint8_t rx = 0;
-  unsigned long int start = millis();
-  while (millis() - start < timeout &&
-         rx < wait_for) {
-    while (Wire.available()) {
-      uint8_t rec = Wire.read();
-      if (rx < OPTA_I2C_BUFFER_DIM) {
-        rx_buffer[rx++] = rec;
-      }
+  while (Wire.available()) {
+    uint8_t rec = Wire.read();
+    if (rx < OPTA_I2C_LARGE_BUFFER_DIM) {
+      tr->rx_buffer[rx++] = rec;
     }
   }
+  tr->rx_num = rx;
 
-  rx_num = rx;
+  trace.record(micros(), trace_address, device, OPTA_BUS_TRACE_RX,
+               (tr->rx_num == wait_for) ? OPTA_BUS_TRACE_OK : OPTA_BUS_TRACE_TIMEOUT,
+               tr->rx_buffer, tr->rx_num);
 
-  if (rx_num == wait_for) {
-    return true;
-  } else {
+  if (tr->rx_num != wait_for) {
 #ifdef DEBUG_COMM_TIMEOUT
     Serial.println("COMMUNICATION TIMEOUT");
     Serial.println("wait_for " + String(wait_for));
-    Serial.println("rx_num " + String(rx_num));
+    Serial.println("tr->rx_num " + String(tr->rx_num));
 #endif
+    return false;
   }
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
-  /* call callback function if nothing has been received */
-  if (failed_i2c_comm != nullptr &&
-      device < OPTA_BLUE_UNDEFINED_DEVICE_NUMBER) {
-    failed_i2c_comm(device, tx_buffer[BP_ARG_POS]);
+void Controller::wait_until(uint32_t timeout_us, unsigned long start) {
+  uint32_t elapsed = (uint32_t)(micros() - start);
+  if (elapsed < timeout_us) {
+    uint32_t left = timeout_us - elapsed;
+    delay(left / 1000);
+    delayMicroseconds(left % 1000);
   }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+/* when an answer is requested from expansion this function reads it into
+   the rx buffer, if it is not complete the function returns only after the
+   timeout (used while the bus is owned, e.g. during the address assignment)
+   return true if an answer is available */
+bool Controller::wait_for_device_answer(uint8_t device, uint8_t wait_for,
+                                        uint32_t timeout_us,
+                                        unsigned long start) {
+  if (read_answer(device, wait_for)) {
+    return true;
+  }
+  wait_until(timeout_us, start);
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* readiness of the expansion at address add (used during the address
+   assignment instead of fixed delays): "get address and type" is sent every
+   OPTA_CONTROLLER_READY_POLL_TIME ms until the expansion answers or
+   timeout_ms expires, return true if the expansion answered */
+bool Controller::wait_for_ready(uint8_t add, uint16_t timeout_ms) {
+  unsigned long start = millis();
+  do {
+    unsigned long poll_start = micros();
+    _send(add, msg_get_address_and_type(),
+          getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE));
+    if (wait_for_device_answer(OPTA_BLUE_UNDEFINED_DEVICE_NUMBER,
+                               getExpectedAnsLen(ANS_LEN_ADDRESS_AND_TYPE),
+                               OPTA_CONTROLLER_READY_POLL_TIME * 1000,
+                               poll_start) &&
+        checkAnsGetReceived(getRxBuffer(), ANS_ARG_ADDRESS_AND_TYPE,
+                            ANS_LEN_ADDRESS_AND_TYPE)) {
+      return true;
+    }
+  } while (millis() - start < timeout_ms);
   return false;
 }
 
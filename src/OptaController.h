@@ -17,9 +17,17 @@
 #include "DigitalCommonCfg.h"
 #include "OptaBluePrintCfg.h"
 #include "OptaControllerCfg.h"
+#include "OptaBusArbiter.h"
+#include "OptaBusTrace.h"
+#include "OptaControllerMetrics.h"
 #include "OptaCrc.h"
 #include "OptaExpansion.h"
+#include "OptaExpansionHealth.h"
+#include "OptaExpansionInfo.h"
 #include "OptaMsgCommon.h"
+#include "OptaPollGroup.h"
+#include "OptaProcessImage.h"
+#include "OptaTopology.h"
 #include "Wire.h"
 #include "sys/_stdint.h"
 
@@ -33,12 +41,23 @@
 #define SEND_RESULT_WRONG_EXPANSION_ATTRIBUTES 2
 #define SEND_RESULT_NO_DATA_TO_TRANSMIT 3
 #define SEND_RESULT_COMM_TIMEOUT 4
+/* the expansion is offline, the message has not been sent */
+#define SEND_RESULT_EXPANSION_OFFLINE 5
+
+/* errors of transfer() found by the Controller (the other errors are the
+   TRANSFER_ERR_ answered by the expansion) */
+#define TRANSFER_ERR_COMM 0x10
+#define TRANSFER_ERR_NOT_SUPPORTED 0x11
+/* the CRC of the whole block does not match */
+#define TRANSFER_ERR_CRC 0x12
 
 using namespace Opta;
 
 class Controller;
 
 using CommErr_f = void (*)(int device, int code);
+/* state is one of OPTA_EXPANSION_HEALTHY, _DEGRADED, _OFFLINE */
+using HealthChange_f = void (*)(int device, int state);
 using makeExpansion_f = Expansion *(*)();
 using startUp_f = void (*)(Controller *);
 
@@ -67,11 +86,60 @@ public:
 
   /* initialize the controller it perform the assign address process */
   void begin();
+  /* to be called in the loop: hot plug of the expansions and polling groups */
   void update();
   /* performs the actual assign address process it has to be called periodically
    * in the loop to support hot-plug expansion attachment */
   void checkForExpansions();
 
+  /* single commit point for the outputs of all the expansions: send only the
+   * outputs (DAC, PWM, LED, digital outputs) changed with update set to
+   * false since the last time they were sent, using the minimum number of
+   * messages; if nothing changed no I2C transaction is performed at all
+   * returns false if the outputs of at least one expansion could not be sent
+   * (they will be sent again at the next call) */
+  bool flushOutputs();
+  /* as flushOutputs() but the outputs of all the expansions change at the
+   * same time: the outputs changed are staged on each expansion, then
+   * COMMIT OUTPUTS is sent to all the expansions in a single burst and each
+   * expansion applies the staged values at once (DAC outputs through the
+   * LDAC pins); expansions that do not support OPTA_CAPABILITY_COMMIT get
+   * their outputs applied when they are sent
+   * returns false if the outputs of at least one expansion could not be
+   * staged or committed (they stay staged on the expansion until the next
+   * commit) */
+  bool commitOutputs();
+  /* send COMMIT OUTPUTS to all the expansions in a single burst (the bus is
+   * not released in between and no answer is waited for): each expansion
+   * applies the outputs staged with Expansion::stageOutputs()
+   * returns false if COMMIT OUTPUTS could not be sent to at least one
+   * expansion (see isCommitFailed()) */
+  bool applyStagedOutputs();
+  /* COMMIT OUTPUTS of the last applyStagedOutputs() not sent to expansion
+   * i: its staged outputs have not been applied */
+  bool isCommitFailed(uint8_t i) {
+    return (i < OPTA_CONTROLLER_MAX_EXPANSION_NUM && commit_failed[i]);
+  }
+  /* single sampling point for the inputs of all the expansions: the inputs
+   * are latched at the same time by latchInputs(), then each expansion is
+   * read with GET_LATCHED_INPUTS (digital and analog inputs in one message,
+   * the answer is ready before it is asked for); expansions that do not
+   * support OPTA_CAPABILITY_LATCH are read with the usual messages
+   * returns false if the inputs of at least one expansion could not be read */
+  bool readInputs();
+  /* send LATCH INPUTS to all the expansions in a single burst (the bus is
+   * not released in between and no answer is waited for): each expansion
+   * keeps a snapshot of its inputs until the next latch */
+  void latchInputs();
+  /* id of the last latch (answered back with the snapshot) */
+  uint8_t getLatchId() { return latch_id; }
+  /* send TIME SYNC with the current micros() to all the expansions that
+   * enabled OPTA_CAPABILITY_TIME in a single burst: their clocks follow the
+   * one of the Controller (offset and drift) and the latched inputs are
+   * timestamped with it (Expansion::getSampleTime()); called by update()
+   * every OPTA_CONTROLLER_TIME_SYNC_MS ms and after the discovery */
+  void syncTime();
+
   /* ----------------------------------------------------------- */
 
   /* return the number of expansion discovered */
@@ -80,8 +148,30 @@ public:
   uint8_t getExpansionType(uint8_t i);
   /* return the I2C address of the expansion */
   uint8_t getExpansionI2Caddress(uint8_t i);
+  /* no I2C transaction if the expansion has been identified */
   bool getFwVersion(uint8_t i, uint8_t &major, uint8_t &minor,
                     uint8_t &release);
+  /* identity of the expansion i answered to the IDENTIFY message sent
+   * during the discovery (nullptr if i is not valid or the expansion has
+   * not been identified, e.g. older firmware) */
+  const ExpansionInfo *getInfo(uint8_t i);
+  /* send IDENTIFY again (e.g. to get the new configuration hash) */
+  bool identifyExpansion(uint8_t i);
+  /* optional features of the protocol the Controller may use
+   * (OPTA_CAPABILITY_ bitmask, default OPTA_CONTROLLER_FEATURES), they are
+   * negotiated with each expansion at the next discovery or begin() */
+  void setFeatures(uint16_t f) { ctrl_features = f; }
+  uint16_t getFeatures() { return ctrl_features; }
+  /* true if feature f has been agreed with the expansion i */
+  bool hasFeature(uint8_t i, uint16_t f);
+  /* highest I2C clock the wiring allows (default OPTA_CONTROLLER_MAX_CLOCK),
+   * OPTA_I2C_FAST_CLOCK to never use Fast-mode Plus; used from the next
+   * begin() or discovery */
+  void setMaxClock(uint32_t freq) { max_clock = freq; }
+  /* I2C clock in use */
+  uint32_t getClock() { return bus_clock; }
+  /* times the clock went back to Fast-mode because of bus errors */
+  uint32_t getClockFallbacks() { return clock_fallbacks; }
   int getExpansionType(std::string pr);
   /* ----------------------------------------------------------- */
 
@@ -96,18 +186,124 @@ public:
    * send n bytes from the tx_buffer
    * wait for r bytes as answer from the device */
   uint8_t send(int add, int device, unsigned int type, int n, int r);
-  uint8_t *getTxBuffer() { return tx_buffer; }
-  uint8_t *getRxBuffer() { return rx_buffer; }
+  /* tx and rx buffers are the ones of the transaction of the calling thread
+   * (see beginTransaction()) */
+  uint8_t *getTxBuffer() { return bus.ctx()->tx_buffer; }
+  uint8_t *getRxBuffer() { return bus.ctx()->rx_buffer; }
   void resetRxBuffer();
   void setTx(uint8_t value, uint8_t pos);
   uint8_t getRx(uint8_t pos);
-  int getLastTxArgument() { return tx_buffer[BP_ARG_POS]; }
+  int getLastTxArgument() { return bus.ctx()->tx_buffer[BP_ARG_POS]; }
+  /* largest frame that can be sent to the expansion i (larger than
+   * OPTA_I2C_BUFFER_DIM if OPTA_CAPABILITY_LARGE_FRAMES has been agreed) */
+  uint8_t getFrameDim(uint8_t i);
+  /* fragmented transfer to the expansion i (OPTA_CAPABILITY_TRANSFER): the
+   * message arg with n bytes of payload is sent in fragments as large as
+   * the frames allow, then its answer (at most max bytes) is read into ans;
+   * returns the dimension of the answer or -TRANSFER_ERR_ */
+  int transfer(uint8_t i, uint8_t arg, const uint8_t *data, uint16_t n,
+               uint8_t *ans = nullptr, uint16_t max = 0);
+  /* the same with a payload made of head (head_n bytes) followed by data,
+   * so that data are sent straight from the buffer of the caller */
+  int transfer(uint8_t i, uint8_t arg, const uint8_t *head, uint8_t head_n,
+               const uint8_t *data, uint16_t n, uint8_t *ans = nullptr,
+               uint16_t max = 0);
+
+  /* ----------------------------------------------------------- */
+  /* use of the Controller from more RTOS threads: a thread that prepares
+   * messages with getTxBuffer()/setTx() and sends them with send() has to do
+   * it between beginTransaction() and endTransaction() to use its own buffers
+   * (all the functions of the expansions already do it); the bus is given to
+   * one frame at a time by class (outputs, inputs, diagnostic, bulk: each
+   * frame is classified from its message unless the transaction is begun
+   * with a class, e.g. OPTA_BUS_CLASS_BULK for a diagnostic thread that
+   * must never delay the control I/O) then by thread priority.
+   * Rate budgets of the classes: getBusArbiter().setBudget() */
+  void beginTransaction(uint8_t cls = OPTA_BUS_CLASS_AUTO) {
+    bus.beginTransaction(cls);
+  }
+  void endTransaction() { bus.endTransaction(); }
+  BusArbiter &getBusArbiter() { return bus; }
 
   /* ----------------------------------------------------------- */
 
   bool rebootExpansion(uint8_t i);
   void setFailedCommCb(CommErr_f f);
 
+  /* ----------------------------------------------------------- */
+  /* I2C transaction metrics of the expansion i: counters and latency
+   * histograms of all the messages sent with send(), total and for each
+   * message argument (nullptr if i is not a valid expansion index) */
+  const ExpansionMetrics *getMetrics(uint8_t i);
+  /* reset the metrics of all the expansions */
+  void resetMetrics();
+  /* reset the metrics of the expansion i */
+  void resetMetrics(uint8_t i);
+  /* used by expansions to signal that the last answer received from
+   * expansion i could not be parsed */
+  void notifyProtocolError(uint8_t i);
+
+  /* ----------------------------------------------------------- */
+  /* answer timeouts derived from the round trip times measured for each
+   * expansion and class of messages (OPTA_BUS_CLASS_), so that an expansion
+   * not answering is detected in a few ms (see OptaControllerCfg.h);
+   * if disabled OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT is always used */
+  void setAdaptiveTimeouts(bool en) { adaptive_timeouts = en; }
+  /* nullptr if i or cls are not valid */
+  const AnswerTimeout *getAnswerTimeout(uint8_t i, uint8_t cls);
+
+  /* ----------------------------------------------------------- */
+  /* health of the expansion i (nullptr if i is not valid): messages to an
+   * offline expansion fail at once (SEND_RESULT_EXPANSION_OFFLINE) so that
+   * it does not slow down the others, it is probed by update() and by the
+   * messages sent to it with an exponential backoff (see
+   * OptaControllerCfg.h) */
+  const ExpansionHealth *getHealth(uint8_t i);
+  /* number of times a message without answer is sent again */
+  void setRetries(uint8_t n) { retries = n; }
+  /* f is called when the health state of an expansion changes */
+  void setHealthChangeCb(HealthChange_f f);
+
+  /* ----------------------------------------------------------- */
+  /* RAM trace of all the frames sent/received on I2C (disabled by default)
+   * getTrace().enable(true) starts recording, getTrace().dump(f) writes the
+   * frames in binary format (decoded on PC by the traceDecoder tool) */
+  BusTrace &getTrace() { return trace; }
+
+  /* ----------------------------------------------------------- */
+  /* periodic polling groups executed by update(): e.g.
+   * int g = getPolling().addGroup(5);
+   * getPolling().addItem(g, 0, GET_DIGITAL_INPUT);
+   * reads the digital inputs of expansion 0 every 5 ms (see OptaPollGroup.h
+   * for overrun and jitter statistics) */
+  PollScheduler &getPolling() { return polling; }
+
+  /* ----------------------------------------------------------- */
+  /* fast boot (enabled by default): the topology found by the address
+   * assignment is saved in the key value store; begin() verifies it with
+   * one "get address and type" message per expansion and performs the
+   * address assignment only if something changed (e.g. Controller restarted
+   * after a firmware upload with the expansions still powered) */
+  void setFastBoot(bool en) { fast_boot = en; }
+  /* warm restart (enabled by default): when begin() verifies the topology the
+   * expansions are not set up again, their outputs and configuration are
+   * kept (no glitch on the outputs) and the state of the expansions (e.g.
+   * digital outputs) is read back; if disabled the start up functions of the
+   * expansions are called as after the address assignment */
+  void setWarmStart(bool en) { warm_start = en; }
+  /* topology found by the last address assignment (or verified by begin())
+   * with the firmware versions of the expansions */
+  const Topology &getTopology() { return topology; }
+
+#if defined(ARDUINO_OPTA)
+  /* ----------------------------------------------------------- */
+  /* process image of the expansions and background I/O thread:
+   * getProcessImage().begin(period_ms) starts a thread that sends the
+   * outputs and reads the inputs of all the expansions every period_ms, the
+   * application then uses only the process image (see OptaProcessImage.h) */
+  ProcessImage &getProcessImage() { return pimage; }
+#endif
+
   void updateRegs(Expansion &exp);
 
   /* ----------------------------------------------------------------------- */
@@ -137,12 +333,9 @@ private:
   void init_exp_type_list();
   
   std::vector<ExpType> exp_type_list;
-  /* controller receiving buffer */
-  uint8_t rx_buffer[OPTA_I2C_BUFFER_DIM];
-  /* controller transmission buffer */
-  uint8_t tx_buffer[OPTA_I2C_BUFFER_DIM];
-  /* number of bytes received */
-  uint8_t rx_num;
+  /* transaction buffers (tx, rx and number of bytes received) and bus
+   * arbiter */
+  BusArbiter bus;
 
   /* used to set temporary address during assign address process*/
   uint8_t tmp_address;
@@ -164,11 +357,94 @@ private:
   uint8_t exp_type[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
   /* expansions arrays */
   Expansion *expansions[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+
+  /* I2C transaction metrics for each expansion */
+  ExpansionMetrics metrics[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* true if the last transaction with the expansion failed */
+  bool last_tr_failed[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* argument of the last transaction with the expansion */
+  uint8_t last_tr_arg[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* expansion of the last transaction and CRC result of its answer */
+  uint8_t last_tr_device;
+  bool last_tr_crc_err;
+  void update_metrics(uint8_t device, int n, int r, uint32_t latency_us,
+                      uint8_t result);
+
+  /* round trip times and answer timeouts for each expansion and class */
+  AnswerTimeout ans_timeout[OPTA_CONTROLLER_MAX_EXPANSION_NUM]
+                           [OPTA_BUS_CLASS_NUM];
+  bool adaptive_timeouts;
+
+  /* identity of each expansion */
+  ExpansionInfo info[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  uint16_t ctrl_features;
+  bool identify(uint8_t i);
+  bool negotiate_features(uint8_t i);
+  void identify_expansions();
+
+  /* I2C clock */
+  uint32_t max_clock;
+  uint32_t bus_clock;
+  uint8_t clock_frames;
+  uint8_t clock_errors;
+  uint32_t clock_fallbacks;
+  void set_clock(uint32_t freq);
+  void select_clock();
+  void count_clock_error(bool failed);
+
+  /* fragmented transfers (the id changes for each transfer to an expansion) */
+  uint8_t transfer_id[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* latched inputs */
+  uint8_t latch_id;
+  /* COMMIT OUTPUTS not sent by the last applyStagedOutputs() */
+  bool commit_failed[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  /* time of the last TIME SYNC burst (millis()) */
+  unsigned long time_sync_ms;
+  int transfer_once(uint8_t i, uint8_t arg, const uint8_t *head,
+                    uint8_t head_n, const uint8_t *data, uint16_t n,
+                    uint8_t *ans, uint16_t max);
+
+  /* health of each expansion */
+  ExpansionHealth health[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  uint8_t retries;
+  HealthChange_f health_change;
+  void update_health(uint8_t device, bool ok);
+  void probe_offline();
+
+  /* I2C frames trace */
+  BusTrace trace;
+  /* expansion index and address of the frames being recorded */
+  uint8_t trace_device;
+  uint8_t trace_address;
+
+  /* periodic polling groups */
+  PollScheduler polling;
+
+  /* last known topology and fast boot */
+  Topology topology;
+  bool fast_boot;
+  bool warm_start;
+  bool fast_begin();
+  bool resume_expansions();
+  void save_topology(const Topology &t);
+
+#if defined(ARDUINO_OPTA)
+  ProcessImage pimage;
+#endif
   
 
   /* ---------------  generic message handling functions ----------------- */
 
-  bool wait_for_device_answer(uint8_t device, uint8_t wait_for, uint16_t timeout);
+  /* timeout_us is measured from start (micros()) */
+  bool wait_for_device_answer(uint8_t device, uint8_t wait_for,
+                              uint32_t timeout_us, unsigned long start);
+  /* copy the answer received by Wire.requestFrom() into the rx buffer of
+   * the transaction, true if all the wait_for bytes have been received */
+  bool read_answer(uint8_t device, uint8_t wait_for);
+  /* return when timeout_us from start (micros()) have elapsed */
+  void wait_until(uint32_t timeout_us, unsigned long start);
+  static uint8_t bus_class(unsigned int type, uint8_t arg);
+  bool wait_for_ready(uint8_t add, uint16_t timeout_ms);
 
   /* ---------------- message preparation functions ---------------------- */
 
@@ -177,20 +453,28 @@ private:
   uint8_t msg_opta_reset();
   uint8_t msg_opta_reboot();
   uint8_t msg_get_product_type();
+  uint8_t msg_identify();
+  uint8_t msg_set_features(uint16_t f);
   #ifdef USE_CONFIRM_RX_MESSAGE
   uint8_t msg_confirm_rx_address();
   #endif
   /* -------------------- parse message functions ------------------------ */
 
   int parse_get_product();
+  bool parse_identify(uint8_t i);
   bool parse_address_and_type(int slave_address);
   bool parse_opta_reboot();
 
 
-  void _send(int add, int n, int r);
+  bool _send(int add, int n, int r);
 
   bool is_detect_high();
   bool is_detect_low();
+  bool is_detect_stable(PinStatus st, unsigned long debounce_ms);
+  /* set by the interrupt of the detect pin at each edge */
+  static volatile bool detect_event;
+  static volatile unsigned long detect_edge_ms;
+  static void detect_isr();
 
   CommErr_f failed_i2c_comm;
 };
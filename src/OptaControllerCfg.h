@@ -20,10 +20,73 @@
 #define OPTA_CONTROLLER_DETECT_PIN 20
 #endif 
 /* the maximum number of opta expansion that can be attached */
-/* initial delay once the reset command has been sent, it waits for all Modules
- * to perform its own initialization */
+/* maximum initial delay once the reset command has been sent, it waits for
+ * all Modules to perform its own initialization (the address assignment
+ * starts as soon as a Module answers to the default address) */
 #define OPTA_CONTROLLER_SETUP_INIT_DELAY 2000
 
+/* a Module being reset holds its DETECT OUT LOW for 1000 ms
+ * (OPTA_MODULE_DETECT_OUT_LOW_TIME): the Modules are not polled before */
+#define OPTA_CONTROLLER_RESET_SETTLE_TIME 1100
+
+/* during the address assignment the readiness of a Module is polled with a
+ * "get address and type" message every OPTA_CONTROLLER_READY_POLL_TIME ms
+ * (the fixed delays are the maximum waits) */
+#define OPTA_CONTROLLER_READY_POLL_TIME 5
+
+/* fast boot: begin() skips the address assignment if each expansion of the
+ * topology saved at the last address assignment answers at its address
+ * within OPTA_CONTROLLER_FAST_BOOT_TIMEOUT ms with the same type */
+#define OPTA_CONTROLLER_FAST_BOOT_TIMEOUT 10
+
+/* maximum wait for the answer to the IDENTIFY message (expansions with an
+ * older firmware do not answer) */
+#define OPTA_CONTROLLER_IDENTIFY_TIMEOUT 10
+
+/* optional features of the protocol (OPTA_CAPABILITY_ bitmask) the
+ * Controller can use: after IDENTIFY the ones supported also by the
+ * expansion are enabled with SET FEATURES, the other messages are used with
+ * expansions that do not support them (older firmware) */
+#define OPTA_CONTROLLER_FEATURES                                               \
+  (OPTA_CAPABILITY_GET_OUTPUTS | OPTA_CAPABILITY_FAST_PLUS |                   \
+   OPTA_CAPABILITY_TRANSFER | OPTA_CAPABILITY_LARGE_FRAMES |                  \
+   OPTA_CAPABILITY_LATCH | OPTA_CAPABILITY_COMMIT | OPTA_CAPABILITY_TIME)
+
+/* a fragmented transfer with a lost fragment is sent again from the
+ * beginning up to OPTA_CONTROLLER_TRANSFER_RETRIES times */
+#define OPTA_CONTROLLER_TRANSFER_RETRIES 1
+
+/* a transfer answered TRANSFER_BUSY (executed by the main loop of the
+ * expansion, e.g. flash writes) is asked again every
+ * OPTA_CONTROLLER_TRANSFER_POLL_MS ms for at most
+ * OPTA_CONTROLLER_TRANSFER_BUSY_MS ms */
+#define OPTA_CONTROLLER_TRANSFER_POLL_MS 1
+#define OPTA_CONTROLLER_TRANSFER_BUSY_MS 1000
+
+/* before COMMIT OUTPUTS an expansion is asked with COMMIT READY every
+ * OPTA_CONTROLLER_COMMIT_POLL_MS ms until its staged outputs are ready, for
+ * at most OPTA_CONTROLLER_COMMIT_READY_MS ms (the outputs not ready are
+ * applied by the expansion as soon as possible after the commit) */
+#define OPTA_CONTROLLER_COMMIT_POLL_MS 1
+#define OPTA_CONTROLLER_COMMIT_READY_MS 250
+
+/* update() sends TIME SYNC to the expansions that enabled
+ * OPTA_CAPABILITY_TIME every OPTA_CONTROLLER_TIME_SYNC_MS ms (the drift of
+ * the clock of the expansions is corrected between two syncs) */
+#define OPTA_CONTROLLER_TIME_SYNC_MS 1000
+
+/* highest I2C clock allowed by the wiring (setMaxClock()): the bus goes to
+ * Fast-mode Plus only if all the expansions enabled OPTA_CAPABILITY_FAST_PLUS
+ * and answer at the new clock, the expansions change their I2C timing
+ * within OPTA_CONTROLLER_FAST_PLUS_DELAY ms from SET FEATURES */
+#define OPTA_CONTROLLER_MAX_CLOCK OPTA_I2C_FAST_PLUS_CLOCK
+#define OPTA_CONTROLLER_FAST_PLUS_DELAY 2
+/* back to Fast-mode when OPTA_CONTROLLER_CLOCK_MAX_ERRORS frames out of
+ * OPTA_CONTROLLER_CLOCK_ERR_WINDOW fail at Fast-mode Plus (until the next
+ * begin() or discovery) */
+#define OPTA_CONTROLLER_CLOCK_ERR_WINDOW 32
+#define OPTA_CONTROLLER_CLOCK_MAX_ERRORS 6
+
 /* update rate when placed into the main loop */
 #define OPTA_CONTROLLER_UPDATE_RATE 1000
 
@@ -34,6 +97,7 @@
    in order to allow modules to update their interna state */
 #define OPTA_CONTROLLER_DELAY_AFTER_MSG_SENT 2
 
+/* maximum wait for a Module to answer to the address just assigned */
 #define OPTA_CONTROLLER_DELAY_AFTER_SET_ADDRESS 100
 
 /* how much opta controller will wait an answer from a Module
@@ -42,10 +106,34 @@
 
 #define OPTA_CONTROLLER_TIMEOUT_FOR_SETUP_MESSAGE 100
 
+/* adaptive answer timeouts: once OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_SAMPLES
+   answers have been received from an expansion for a class of messages, the
+   timeout is mean + K * deviation of their round trip time (never below
+   OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_MIN_US, never above
+   OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT), doubled after each timeout up to
+   OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_BACKOFF times */
+#define OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_SAMPLES 8
+#define OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_K 4
+#define OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_MIN_US 2000
+#define OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_BACKOFF 2
+
+/* expansion health: a message whose answer is not received (or has a wrong
+   CRC) is sent again up to OPTA_CONTROLLER_RETRIES times; after
+   OPTA_CONTROLLER_OFFLINE_AFTER consecutive failed messages the expansion is
+   offline: messages to it fail at once, except for a probe every
+   OPTA_CONTROLLER_PROBE_MIN_MS (doubled after each failed probe up to
+   OPTA_CONTROLLER_PROBE_MAX_MS); after a failure the expansion is degraded
+   until OPTA_CONTROLLER_HEALTHY_AFTER consecutive messages succeed */
+#define OPTA_CONTROLLER_RETRIES 1
+#define OPTA_CONTROLLER_OFFLINE_AFTER 3
+#define OPTA_CONTROLLER_PROBE_MIN_MS 100
+#define OPTA_CONTROLLER_PROBE_MAX_MS 5000
+#define OPTA_CONTROLLER_HEALTHY_AFTER 10
+
 #define OPTA_CONTROLLER_DELAY_AFTER_REBOOT 600
 
-/* this is the time the controller leaves to expansion to "set up" themselves
- * after a successfully I2C address assignment */
+/* this is the maximum time the controller leaves to expansion to "set up"
+ * themselves after a successfully I2C address assignment */
 #define OPTA_CONTROLLER_DELAY_EXPANSION_RESET 300
 
 /* when DETECT IN goes low it wait OPTA_CONTROLLER_DEBOUNCE_TIME *
@@ -61,7 +149,6 @@
  * DEBUG CONFIGURATION DEFINES
  * -------------------------------------------------------------------------- */
 
-// #define DEBUG_TX_CONTROLLER_ENABLE
 //  #define DEBUG_RX_CONTROLLER_ENABLE
 //  #define DEBUG_PARSE_CONTROLLER_ENABLE
 //  #define DEBUG_PARSE_DIN_CONTROLLER_ENABLE
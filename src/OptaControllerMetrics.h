@@ -0,0 +1,186 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaControllerMetrics.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240610
+   DESCRIPTION: Counters and latency histograms of the I2C transactions
+                performed by the Controller (one set for each expansion and
+                for each message argument sent to the expansion)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_CONTROLLER_METRICS_H
+#define OPTA_CONTROLLER_METRICS_H
+
+#include "OptaControllerCfg.h"
+#include <cstdint>
+#include <stdint.h>
+
+/* number of buckets of the latency histogram */
+#define OPTA_METRICS_LATENCY_BUCKETS 10
+/* upper limit (excluded, in micro seconds) of each latency bucket, the last
+ * bucket holds all the latencies above the previous limit */
+#define OPTA_METRICS_LATENCY_LIMITS                                            \
+  { 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, UINT32_MAX }
+
+/* maximum number of different message arguments tracked for each expansion,
+ * transactions with other arguments are added to the "other" counters */
+#define OPTA_METRICS_ARG_NUM 16
+
+/* counters of a set of I2C transactions */
+class BusCounters {
+public:
+  /* number of transactions (message sent + answer, if requested) */
+  uint32_t transactions;
+  /* bytes sent to the expansion */
+  uint32_t bytes_tx;
+  /* bytes received from the expansion */
+  uint32_t bytes_rx;
+  /* answer not received in time */
+  uint32_t timeouts;
+  /* answer received with a wrong CRC */
+  uint32_t crc_errors;
+  /* answer received with a correct CRC but not the one expected */
+  uint32_t protocol_errors;
+  /* same message sent again to the same expansion after a failure */
+  uint32_t retries;
+  /* sum of all the latencies (to calculate the average) */
+  uint64_t latency_us_total;
+  uint32_t latency_us_max;
+  /* latency histogram (limits defined by OPTA_METRICS_LATENCY_LIMITS) */
+  uint32_t latency[OPTA_METRICS_LATENCY_BUCKETS];
+
+  BusCounters() { reset(); }
+  void reset() {
+    transactions = 0;
+    bytes_tx = 0;
+    bytes_rx = 0;
+    timeouts = 0;
+    crc_errors = 0;
+    protocol_errors = 0;
+    retries = 0;
+    latency_us_total = 0;
+    latency_us_max = 0;
+    for (int i = 0; i < OPTA_METRICS_LATENCY_BUCKETS; i++) {
+      latency[i] = 0;
+    }
+  }
+  /* average latency in micro seconds */
+  uint32_t getAvgLatency() const {
+    if (transactions == 0) {
+      return 0;
+    }
+    return (uint32_t)(latency_us_total / transactions);
+  }
+};
+
+/* counters of an expansion: total and for each message argument */
+class ExpansionMetrics {
+public:
+  BusCounters total;
+  /* message argument of each tracked slot */
+  uint8_t arg[OPTA_METRICS_ARG_NUM];
+  BusCounters per_arg[OPTA_METRICS_ARG_NUM];
+  /* number of slots in use */
+  uint8_t arg_num;
+  /* transactions whose argument did not find a free slot */
+  BusCounters other;
+
+  ExpansionMetrics() { reset(); }
+  void reset() {
+    total.reset();
+    other.reset();
+    arg_num = 0;
+    for (int i = 0; i < OPTA_METRICS_ARG_NUM; i++) {
+      arg[i] = 0;
+      per_arg[i].reset();
+    }
+  }
+  /* return the counters of the message argument a (nullptr if a has never
+   * been sent) */
+  const BusCounters *getArg(uint8_t a) const {
+    for (int i = 0; i < arg_num; i++) {
+      if (arg[i] == a) {
+        return &per_arg[i];
+      }
+    }
+    return nullptr;
+  }
+  /* same as above but allocates a new slot for a if not present */
+  BusCounters *useArg(uint8_t a) {
+    for (int i = 0; i < arg_num; i++) {
+      if (arg[i] == a) {
+        return &per_arg[i];
+      }
+    }
+    if (arg_num < OPTA_METRICS_ARG_NUM) {
+      arg[arg_num] = a;
+      return &per_arg[arg_num++];
+    }
+    return &other;
+  }
+};
+
+/* round trip time of the messages of a class sent to an expansion and
+ * timeout derived from it: mean and mean deviation are moving averages
+ * (gain 1/8 and 1/4, the deviation is used as a cheap estimate of the
+ * standard deviation) */
+class AnswerTimeout {
+public:
+  /* answers used for the estimate */
+  uint32_t samples;
+  uint32_t mean_us;
+  uint32_t dev_us;
+  /* consecutive timeouts (the timeout is doubled for each of them) */
+  uint8_t failures;
+
+  AnswerTimeout() { reset(); }
+  void reset() {
+    samples = 0;
+    mean_us = 0;
+    dev_us = 0;
+    failures = 0;
+  }
+  /* rtt_us is the time from the request to the end of the answer, answered
+   * is false if the answer did not arrive in time */
+  void update(uint32_t rtt_us, bool answered) {
+    if (!answered) {
+      if (failures < OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_BACKOFF) {
+        failures++;
+      }
+      return;
+    }
+    failures = 0;
+    if (samples == 0) {
+      mean_us = rtt_us;
+      dev_us = rtt_us / 2;
+    } else {
+      uint32_t diff = (rtt_us > mean_us) ? rtt_us - mean_us : mean_us - rtt_us;
+      dev_us = (3 * dev_us + diff) / 4;
+      mean_us = (7 * mean_us + rtt_us) / 8;
+    }
+    if (samples < UINT32_MAX) {
+      samples++;
+    }
+  }
+  /* timeout for the next answer (the fixed one until enough answers have
+   * been measured) */
+  uint32_t getTimeoutUs() const {
+    const uint32_t max_us = (uint32_t)OPTA_CONTROLLER_WAIT_REQUEST_TIMEOUT * 1000;
+    if (samples < OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_SAMPLES) {
+      return max_us;
+    }
+    uint32_t t = mean_us + OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_K * dev_us;
+    if (t < OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_MIN_US) {
+      t = OPTA_CONTROLLER_ADAPTIVE_TIMEOUT_MIN_US;
+    }
+    t <<= failures;
+    return (t < max_us) ? t : max_us;
+  }
+};
+
+#endif
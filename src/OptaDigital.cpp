@@ -16,7 +16,7 @@
 #if defined ARDUINO_OPTA_DIGITAL
 #include "OptaDigital.h"
 
-volatile bool OptaDigital::conversion_performed = false;
+OPTA_PER_MCU volatile bool OptaDigital::conversion_performed = false;
 
 /* -------------------------------------------------------------------------- */
 void OptaDigital::adcCb(adc_callback_args_t *p_args) {
@@ -139,6 +139,7 @@ void OptaDigital::reset() {
   /* reset output must be called first otherwise we get some delay from
      module reset and that make the output reset uneffective */
   Module::reset();
+  staged = false;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -245,6 +246,16 @@ bool OptaDigital::parse_set_digital() {
   return false;
 }
 
+/* -------------------------------------------------------------------------- */
+bool OptaDigital::parse_stage_digital() {
+  /* ------------------------------------------------------------------------ */
+  if (checkSetMsgReceived(rx_buffer, ARG_OD_STAGE_DIGITAL_OUTPUTS,
+                          LEN_OD_STAGE_DIGITAL_OUTPUTS)) {
+    return true;
+  }
+  return false;
+}
+
 /* -------------------------------------------------------------------------- */
 bool OptaDigital::parse_get_digital() {
   /* ------------------------------------------------------------------------ */
@@ -254,6 +265,16 @@ bool OptaDigital::parse_get_digital() {
   return false;
 }
 
+/* -------------------------------------------------------------------------- */
+bool OptaDigital::parse_get_digital_outputs() {
+  /* ------------------------------------------------------------------------ */
+  if (checkGetMsgReceived(rx_buffer, ARG_OD_GET_DIGITAL_OUTPUTS,
+                          LEN_OD_GET_DIGITAL_OUTPUTS)) {
+    return true;
+  }
+  return false;
+}
+
 /* -------------------------------------------------------------------------- */
 bool OptaDigital::parse_get_analog() {
   /* ------------------------------------------------------------------------ */
@@ -292,6 +313,20 @@ int OptaDigital::prepare_ans_get_digital() {
   return addCrc(tx_buffer,OPTA_DIGITAL_GET_DIN_BUFFER_DIM - 1);
 }
 
+/* ------------------------------------------------------------------------ */
+int OptaDigital::prepare_ans_get_digital_outputs() {
+  /* ---------------------------------------------------------------------- */
+  uint8_t value = 0;
+  for (int i = 0; i < OPTA_DIGITAL_OUT_NUM; i++) {
+    if (digital_out[i]) {
+      value |= (1 << i);
+    }
+  }
+  tx_buffer[BP_PAYLOAD_START_POS] = value;
+  return prepareGetAns(tx_buffer, ANS_ARG_OD_GET_DIGITAL_OUTPUTS,
+                       ANS_LEN_OD_GET_DIGITAL_OUTPUTS);
+}
+
 /* ------------------------------------------------------------------------- */
 int OptaDigital::prepare_ans_get_analog(int index) {
   /* ----------------------------------------------------------------------- */
@@ -331,6 +366,27 @@ int OptaDigital::prepare_ans_set_digital() {
                        ANS_LEN_OD_SET_DIGITAL_OUTPUTS);
 }
 
+/* ------------------------------------------------------------------------ */
+int OptaDigital::prepare_ans_stage_digital() {
+  /* ---------------------------------------------------------------------- */
+  return prepareSetAns(tx_buffer, ANS_ARG_OD_STAGE_DIGITAL_OUTPUTS,
+                       ANS_LEN_OD_STAGE_DIGITAL_OUTPUTS);
+}
+
+/* ------------------------------------------------------------------------ */
+void OptaDigital::write_outputs(uint8_t value) {
+  /* ---------------------------------------------------------------------- */
+  for (int i = 0; i < OPTA_DIGITAL_OUT_NUM; i++) {
+    if (value & (1 << i)) {
+      digital_out[i] = true;
+      digitalWrite(out_map[i], HIGH);
+    } else {
+      digital_out[i] = false;
+      digitalWrite(out_map[i], LOW);
+    }
+  }
+}
+
 /* --------------------------------------------------------------------------
  */
 /* parse message specific for OPTA digital */
@@ -351,23 +407,23 @@ int OptaDigital::parse_rx() {
   rv = -1;
   /* set digital output */
   if (parse_set_digital()) {
-    uint8_t value = rx_buffer[BP_PAYLOAD_START_POS];
-
-    for (int i = 0; i < OPTA_DIGITAL_OUT_NUM; i++) {
-      if (value & (1 << i)) {
-        digital_out[i] = true;
-        digitalWrite(out_map[i], HIGH);
-      } else {
-        digital_out[i] = false;
-        digitalWrite(out_map[i], LOW);
-      }
-    }
+    write_outputs(rx_buffer[BP_PAYLOAD_START_POS]);
     rv = prepare_ans_set_digital();
   }
+  /* stage digital output (applied by COMMIT OUTPUTS) */
+  else if (parse_stage_digital()) {
+    staged_out = rx_buffer[BP_PAYLOAD_START_POS];
+    staged = true;
+    rv = prepare_ans_stage_digital();
+  }
   /* get digital input */
   else if (parse_get_digital()) {
     rv = prepare_ans_get_digital();
   }
+  /* get digital outputs */
+  else if (parse_get_digital_outputs()) {
+    rv = prepare_ans_get_digital_outputs();
+  }
 /* get all analog input */
 #ifdef OPTA_DIGITAL_ALLOW_ANALOG_USE
   else if (parse_get_all_analog()) {
@@ -402,8 +458,8 @@ int OptaDigital::parse_rx() {
 #ifdef DEBUG_UPDATE_FW
 /* used to recognize sw version with led blinking during fw update tests*/
 void OptaDigital::debug_with_leds() {
-  static unsigned long start = millis();
-  static bool status = true;
+  static OPTA_PER_MCU unsigned long start = millis();
+  static OPTA_PER_MCU bool status = true;
 
   if (millis() - start > 2000) {
     start = millis();
@@ -556,6 +612,41 @@ uint8_t OptaDigital::getMajorFw() { return FW_VERSION_MAJOR; }
 uint8_t OptaDigital::getMinorFw() { return FW_VERSION_MINOR; }
 uint8_t OptaDigital::getReleaseFw() { return FW_VERSION_RELEASE; }
 
+uint16_t OptaDigital::getCapabilities() {
+  return Module::getCapabilities() | OPTA_CAPABILITY_GET_OUTPUTS |
+         OPTA_CAPABILITY_LATCH | OPTA_CAPABILITY_COMMIT;
+}
+
+/* outputs received with STAGE DIGITAL OUTPUTS (nothing to do if no new value
+   has been staged since the last commit) */
+void OptaDigital::commit_outputs() {
+  if (staged) {
+    staged = false;
+    write_outputs(staged_out);
+  }
+}
+
+/* digital inputs and all the analog inputs, as in the answers to GET
+   DIGITAL INPUTS and GET ALL ANALOG INPUTS */
+int OptaDigital::latch_inputs(uint8_t *buf, int max) {
+  const int din = ANS_LEN_OD_GET_DIGITAL_INPUTS;
+  const int ain = ANS_LEN_OD_GET_ALL_ANALOG_INPUTS;
+  if (max < din + ain) {
+    return 0;
+  }
+  memcpy(buf, ans_get_din_buffer + BP_PAYLOAD_START_POS, din);
+  memcpy(buf + din, ans_get_all_ain_buffer + BP_PAYLOAD_START_POS, ain);
+  return din + ain;
+}
+
+/* default values of the outputs and timeout */
+uint32_t OptaDigital::getConfigHash() {
+  uint32_t h = OPTA_MODULE_CFG_HASH_INIT;
+  h = hashConfig(h, default_output, sizeof(default_output));
+  uint16_t t = timer_elapsed_ms;
+  return hashConfig(h, &t, sizeof(t));
+}
+
 std::string OptaDigital::getProduct() {
   if (expansion_type == EXPANSION_DIGITAL_INVALID) {
     std::string rv(OPTA_DIGITAL_DESCRIPTION);
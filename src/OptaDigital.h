@@ -46,6 +46,8 @@ public:
   uint8_t getMinorFw();
   uint8_t getReleaseFw();
   std::string getProduct();
+  uint16_t getCapabilities() override;
+  uint32_t getConfigHash() override;
   void goInBootloaderMode();
   void readFromFlash(uint16_t add, uint8_t *buffer, uint8_t dim);
   void writeInFlash(uint16_t add, uint8_t *buffer, uint8_t dim);
@@ -77,21 +79,28 @@ public:
 
 protected:
   virtual void reset() override;
+  int latch_inputs(uint8_t *buf, int max) override;
+  void commit_outputs() override;
 
 private:
-  static volatile bool conversion_performed;
+  static OPTA_PER_MCU volatile bool conversion_performed;
 
   bool parse_set_digital();
+  bool parse_stage_digital();
   bool parse_get_digital();
+  bool parse_get_digital_outputs();
   bool parse_get_analog();
   bool parse_get_all_analog();
   bool parse_default_and_timeout();
 
   int prepare_ans_get_digital();
+  int prepare_ans_get_digital_outputs();
   int prepare_ans_get_analog(int index);
   int prepare_ans_get_all_analog();
   int prepare_ans_default_and_timeout();
   int prepare_ans_set_digital();
+  int prepare_ans_stage_digital();
+  void write_outputs(uint8_t value);
 
   FspTimer timer;
   void set_up_timer();
@@ -105,6 +114,9 @@ private:
   uint8_t ans_get_all_ain_buffer[OPTA_DIGITAL_GET_ALL_AIN_BUFFER_DIM] = {0};
   uint16_t channel_analog_values[MAX_ADC_CHANNELS] = {0};
   bool digital_out[OPTA_DIGITAL_OUT_NUM] = {false};
+  /* outputs staged by STAGE DIGITAL OUTPUTS, applied by COMMIT OUTPUTS */
+  uint8_t staged_out = 0;
+  bool staged = false;
 
   bool default_output[OPTA_DIGITAL_OUT_NUM] = {false};
 
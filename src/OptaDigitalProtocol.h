@@ -35,6 +35,16 @@
 #define ARG_OD_DEFAULT_AND_TIMEOUT 0x08
 #define LEN_OD_DEFAULT_AND_TIMEOUT 0x03
 
+/* define get opta-digital digital outputs (state of the outputs kept by the
+   expansion, read back by the Controller after a warm restart) */
+#define ARG_OD_GET_DIGITAL_OUTPUTS 0x44
+#define LEN_OD_GET_DIGITAL_OUTPUTS 0x00
+
+/* define stage opta-digital digital outputs (same payload of SET DIGITAL
+   OUTPUTS, the outputs change at the next COMMIT OUTPUTS) */
+#define ARG_OD_STAGE_DIGITAL_OUTPUTS 0x45
+#define LEN_OD_STAGE_DIGITAL_OUTPUTS 0x01
+
 /* answer get opta-digital digital input */
 #define ANS_ARG_OD_GET_DIGITAL_INPUTS ARG_OD_GET_DIGITAL_INPUTS
 #define ANS_LEN_OD_GET_DIGITAL_INPUTS 0x02
@@ -50,10 +60,28 @@
 #define ANS_ARG_OD_DEFAULT_AND_TIMEOUT ARG_OD_DEFAULT_AND_TIMEOUT
 #define ANS_LEN_OD_DEFAULT_AND_TIMEOUT 0
 
+/* answer get opta-digital digital outputs */
+#define ANS_ARG_OD_GET_DIGITAL_OUTPUTS ARG_OD_GET_DIGITAL_OUTPUTS
+#define ANS_LEN_OD_GET_DIGITAL_OUTPUTS 0x01
+
 /* answer get opta-digital set default and timeout */
 #define ANS_ARG_OD_SET_DIGITAL_OUTPUTS ARG_OD_SET_DIGITAL_OUTPUTS
 #define ANS_LEN_OD_SET_DIGITAL_OUTPUTS 0
 
+/* answer stage opta-digital digital outputs */
+#define ANS_ARG_OD_STAGE_DIGITAL_OUTPUTS ARG_OD_STAGE_DIGITAL_OUTPUTS
+#define ANS_LEN_OD_STAGE_DIGITAL_OUTPUTS 0
+
+/* answer get latched inputs (see OptaModuleProtocol.h): latch id, digital
+   inputs (2 bytes, LSB first) and all the analog inputs (2 bytes each) */
+#define ANS_LEN_OD_GET_LATCHED_INPUTS                                          \
+  (1 + ANS_LEN_OD_GET_DIGITAL_INPUTS + ANS_LEN_OD_GET_ALL_ANALOG_INPUTS)
+#define ANS_OD_LATCHED_DIN_POS (BP_HEADER_DIM + 1)
+#define ANS_OD_LATCHED_AIN_POS                                                 \
+  (ANS_OD_LATCHED_DIN_POS + ANS_LEN_OD_GET_DIGITAL_INPUTS)
+/* time the inputs were latched at (only with OPTA_CAPABILITY_TIME) */
+#define ANS_OD_LATCHED_TIME_POS (BP_HEADER_DIM + ANS_LEN_OD_GET_LATCHED_INPUTS)
+
 #define OPTA_DIGITAL_GET_DIN_BUFFER_DIM (ANS_LEN_OD_GET_DIGITAL_INPUTS + BP_HEADER_DIM + 1)
 #define OPTA_DIGITAL_GET_ALL_AIN_BUFFER_DIM (ANS_LEN_OD_GET_ALL_ANALOG_INPUTS + BP_HEADER_DIM  + 1)
 
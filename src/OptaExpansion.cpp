@@ -140,6 +140,12 @@ unsigned int Expansion::execute(uint32_t what) {
                       getExpectedAnsLen(ANS_LEN_GET_VERSION));
 
       break;
+    case GET_COMMIT_READY:
+      commit_ready = false;
+      I2C_TRANSACTION(msg_get_commit_ready,
+                      parse_ans_get_commit_ready,
+                      getExpectedAnsLen(ANS_LEN_COMMIT_READY));
+      break;
 
     default:
       i2c_rv = EXECUTE_ERR_UNSUPPORTED;
@@ -228,6 +234,65 @@ bool Expansion::parse_ans_get_version() {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+uint8_t Expansion::msg_get_commit_ready() {
+  return prepareGetMsg(ctrl->getTxBuffer(), ARG_COMMIT_READY,
+                       LEN_COMMIT_READY);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Expansion::parse_ans_get_commit_ready() {
+  if (checkAnsGetReceived(ctrl->getRxBuffer(), ANS_ARG_COMMIT_READY,
+                          ANS_LEN_COMMIT_READY)) {
+    commit_ready = (ctrl->getRx(ANS_COMMIT_READY_POS) != 0);
+    return true;
+  }
+  return false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int Expansion::wait_commit_ready() {
+  unsigned long start = millis();
+  for (;;) {
+    unsigned int err = execute(GET_COMMIT_READY);
+    if (err != EXECUTE_OK || commit_ready) {
+      return err;
+    }
+    if (millis() - start >= OPTA_CONTROLLER_COMMIT_READY_MS) {
+      /* the commit still applies them, only later */
+      return EXECUTE_OK;
+    }
+    delay(OPTA_CONTROLLER_COMMIT_POLL_MS);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t Expansion::latched_time_len() {
+  if (ctrl != nullptr && ctrl->hasFeature(index, OPTA_CAPABILITY_TIME)) {
+    return ANS_LEN_LATCHED_TIME;
+  }
+  return 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Expansion::set_sample_time(int pos) {
+  uint32_t t = 0;
+  if (pos >= 0 && latched_time_len() > 0) {
+    for (int i = 0; i < ANS_LEN_LATCHED_TIME; i++) {
+      t |= ((uint32_t)ctrl->getRx(pos + i) << (8 * i));
+    }
+  }
+  /* 0: not synchronized yet */
+  if (t == 0) {
+    t = (uint32_t)micros();
+  }
+  iregs[ADD_SAMPLE_TIME] = t;
+}
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 void Expansion::set_flash_data(uint8_t *buf, uint8_t dbuf, uint16_t add) {
   for (int i = 0; i < dbuf && i < MAX_FLASH_DATA; i++) {
     iregs[ADD_FLASH_0 + i] = (int)*(buf + i);
@@ -253,13 +318,119 @@ void Expansion::get_flash_data(uint8_t *buf, uint8_t &dbuf, uint16_t &add) {
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 
+static unsigned int transfer_result(int rv) {
+  if (rv >= 0) {
+    return EXECUTE_OK;
+  } else if (rv == -TRANSFER_ERR_COMM) {
+    return EXECUTE_ERR_I2C_COMM;
+  }
+  return EXECUTE_ERR_PROTOCOL;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int Expansion::writeFlash(uint16_t add, const uint8_t *buf,
+                                   uint16_t dim) {
+  if (ctrl == nullptr) {
+    return EXECUTE_ERR_NO_CONTROLLER;
+  }
+  if ((uint32_t)add + dim > OPTA_FLASH_ADDRESS_SPACE) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  if (ctrl->hasFeature(index, OPTA_CAPABILITY_TRANSFER)) {
+    /* blocks multiple of MAX_FLASH_DATA: the expansion reads before writing
+       only the end of the last block */
+    const uint16_t block = ((OPTA_TRANSFER_MAX_DIM - 2) / MAX_FLASH_DATA) *
+                           MAX_FLASH_DATA;
+    for (uint32_t i = 0; i < dim; i += block) {
+      uint16_t n = (dim - i > block) ? block : dim - i;
+      uint16_t a = add + i;
+      uint8_t head[2] = {(uint8_t)(a & 0xFF), (uint8_t)(a >> 8)};
+      int rv = ctrl->transfer(index, ARG_SAVE_IN_DATA_FLASH, head,
+                              sizeof(head), buf + i, n);
+      if (rv < 0) {
+        return transfer_result(rv);
+      }
+    }
+    return EXECUTE_OK;
+  }
+  /* the expansion always writes MAX_FLASH_DATA bytes: the last partial
+     block is read first */
+  uint8_t block[MAX_FLASH_DATA];
+  for (uint32_t i = 0; i < dim; i += MAX_FLASH_DATA) {
+    uint8_t n = (dim - i > MAX_FLASH_DATA) ? MAX_FLASH_DATA : dim - i;
+    if (n < MAX_FLASH_DATA) {
+      uint8_t d = MAX_FLASH_DATA;
+      uint16_t a = add + i;
+      get_flash_data(block, d, a);
+      if (i2c_rv != EXECUTE_OK) {
+        return i2c_rv;
+      }
+    }
+    memcpy(block, buf + i, n);
+    set_flash_data(block, MAX_FLASH_DATA, add + i);
+    if (i2c_rv != EXECUTE_OK) {
+      return i2c_rv;
+    }
+  }
+  return EXECUTE_OK;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+unsigned int Expansion::readFlash(uint16_t add, uint8_t *buf, uint16_t dim) {
+  if (ctrl == nullptr) {
+    return EXECUTE_ERR_NO_CONTROLLER;
+  }
+  if ((uint32_t)add + dim > OPTA_FLASH_ADDRESS_SPACE) {
+    return EXECUTE_ERR_SINTAX;
+  }
+  if (ctrl->hasFeature(index, OPTA_CAPABILITY_TRANSFER)) {
+    for (uint32_t i = 0; i < dim; i += OPTA_TRANSFER_MAX_DIM) {
+      uint16_t n = (dim - i > OPTA_TRANSFER_MAX_DIM) ? OPTA_TRANSFER_MAX_DIM
+                                                     : dim - i;
+      uint16_t a = add + i;
+      uint8_t msg[4] = {(uint8_t)(a & 0xFF), (uint8_t)(a >> 8),
+                        (uint8_t)(n & 0xFF), (uint8_t)(n >> 8)};
+      int rv = ctrl->transfer(index, ARG_GET_DATA_FROM_FLASH, msg,
+                              sizeof(msg), buf + i, n);
+      if (rv >= 0 && rv != n) {
+        return EXECUTE_ERR_PROTOCOL;
+      } else if (rv < 0) {
+        return transfer_result(rv);
+      }
+    }
+    return EXECUTE_OK;
+  }
+  for (uint32_t i = 0; i < dim; i += MAX_FLASH_DATA) {
+    uint8_t n = (dim - i > MAX_FLASH_DATA) ? MAX_FLASH_DATA : dim - i;
+    uint16_t a = add + i;
+    get_flash_data(buf + i, n, a);
+    if (i2c_rv != EXECUTE_OK) {
+      return i2c_rv;
+    }
+  }
+  return EXECUTE_OK;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
 bool Expansion::verify_address(unsigned int add) { 
   (void)add;
   return false; }
 
 /* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 bool Expansion::getFwVersion(uint8_t &major, uint8_t &minor, uint8_t &release) {
-
+  /* answered by IDENTIFY during the discovery */
+  if (ctrl != nullptr) {
+    const ExpansionInfo *info = ctrl->getInfo(index);
+    if (info != nullptr) {
+      major = info->fw_major;
+      minor = info->fw_minor;
+      release = info->fw_release;
+      return true;
+    }
+  }
   uint8_t err = execute(GET_VERSION);
   if (err == EXECUTE_OK) {
     major = iregs[ADD_VERSION_MAJOR];
@@ -275,20 +446,25 @@ unsigned int Expansion::i2c_transaction(int rx_bytes) {
   
   i2c_rv = EXECUTE_ERR_SINTAX;
   if (prepare_msg && ctrl != nullptr) {
+      /* message and answer in the buffers of the calling thread */
+      ctrl->beginTransaction();
       uint8_t err = ctrl->send(i2c_address, index, type, prepare_msg(), rx_bytes);
       i2c_rv = EXECUTE_ERR_I2C_COMM;
       if (err == SEND_RESULT_OK) {
         if (parse_msg) {
           if (!parse_msg()) {
             i2c_rv = EXECUTE_ERR_PROTOCOL;
+            ctrl->notifyProtocolError(index);
+          } else {
+            i2c_rv = EXECUTE_OK;
           }
-          i2c_rv = EXECUTE_OK;
         }
       } else if (err == SEND_RESULT_COMM_TIMEOUT) {
         if (com_timeout != nullptr) {
           com_timeout(index, ctrl->getLastTxArgument());
         }
       }
+      ctrl->endTransaction();
   }
   return i2c_rv;
 }
@@ -35,6 +35,7 @@
 #define ADD_VERSION_MAJOR 10
 #define ADD_VERSION_MINOR 11
 #define ADD_VERSION_RELEASE 12
+#define ADD_SAMPLE_TIME 13
 
 #define I2C_TRANSACTION(m,p,l)    prepare_msg = [this](){return m();}; \
                                   parse_msg = [this](){return p();};   \
@@ -75,12 +76,36 @@ public:
   bool addressFloatExist(unsigned int address);
   /* returns one of the code defined above */
   virtual unsigned int execute(uint32_t what);
+  /* send to the expansion the outputs changed and not yet transmitted 
+     (expansion without outputs have nothing to flush) */
+  virtual unsigned int flushOutputs() { return EXECUTE_OK; }
+  /* as flushOutputs() but the outputs are only staged on the expansion and
+     applied at the same time on all the expansions by
+     Controller::commitOutputs() */
+  virtual unsigned int stageOutputs() { return flushOutputs(); }
+  /* called by the Controller after a warm restart (expansion not set up
+   * again): read back from the expansion the state it kept (e.g. the
+   * outputs) so that the next updates do not change it
+   * returns EXECUTE_OK or the error met */
+  virtual unsigned int resume() { return EXECUTE_OK; }
 
   virtual void getFlashData(uint8_t *buf, uint8_t &dbuf, uint16_t &add) {
     return get_flash_data(buf, dbuf, add);
   }
+  /* data flash of the expansion, any dimension straight from / to buf: one
+   * fragmented transfer for each block (the largest the transfer allows,
+   * verified with its CRC and, when written, read back by the expansion)
+   * if the expansion supports it, otherwise one message every
+   * MAX_FLASH_DATA bytes
+   * returns EXECUTE_OK or the error met */
+  unsigned int writeFlash(uint16_t add, const uint8_t *buf, uint16_t dim);
+  unsigned int readFlash(uint16_t add, uint8_t *buf, uint16_t dim);
 
   virtual bool getFwVersion(uint8_t &major, uint8_t &minor, uint8_t &release);
+  /* time (micros() of the Controller) the inputs read by GET_LATCHED_INPUTS
+   * were sampled at: the latch time if the expansion timestamps its inputs
+   * (OPTA_CAPABILITY_TIME), otherwise the time they were received */
+  uint32_t getSampleTime() { return (uint32_t)iregs[ADD_SAMPLE_TIME]; }
   virtual void setFailedCommCb(FailedComm_f f);
   auto getIregs() { return iregs; }
   auto getFregs() { return fregs; }
@@ -110,6 +135,22 @@ protected:
   uint8_t msg_get_flash();
   bool parse_ans_get_flash();
 
+  /* set by GET_LATCHED_INPUTS: the snapshot answered is the one of the last
+     Controller::latchInputs() */
+  bool latched = false;
+  /* set by GET_COMMIT_READY: the outputs staged can be committed */
+  bool commit_ready = false;
+  /* bytes of the latch time at the end of the answer to GET_LATCHED_INPUTS
+     (0 without OPTA_CAPABILITY_TIME) */
+  uint8_t latched_time_len();
+  /* sample time from the latch time at position pos of the answer, the
+     time now if pos is negative or the expansion time is not synchronized */
+  void set_sample_time(int pos);
+  uint8_t msg_get_commit_ready();
+  bool parse_ans_get_commit_ready();
+  /* ask the expansion with GET_COMMIT_READY until the outputs staged are
+     ready to be committed (or OPTA_CONTROLLER_COMMIT_READY_MS elapsed) */
+  unsigned int wait_commit_ready();
   std::function<uint8_t()> prepare_msg;
   std::function<bool()> parse_msg;
   unsigned int i2c_rv = 0;
@@ -0,0 +1,107 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaExpansionHealth.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240628
+   DESCRIPTION: Health state of an expansion as seen by the Controller:
+                healthy, degraded (some transactions failed recently) or
+                offline (the expansion does not answer: messages fail at once
+                without using the bus, except for periodic probes)
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       A transaction is failed when the answer is not received or
+                has a wrong CRC after all the retries                         */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_EXPANSION_HEALTH_H
+#define OPTA_EXPANSION_HEALTH_H
+
+#include "OptaControllerCfg.h"
+#include <cstdint>
+
+#define OPTA_EXPANSION_HEALTHY 0
+#define OPTA_EXPANSION_DEGRADED 1
+#define OPTA_EXPANSION_OFFLINE 2
+
+class ExpansionHealth {
+public:
+  /* one of OPTA_EXPANSION_HEALTHY, _DEGRADED, _OFFLINE */
+  uint8_t state;
+  /* consecutive failed and successful transactions */
+  uint16_t failures;
+  uint16_t successes;
+  /* number of times the expansion went offline */
+  uint32_t offline_count;
+  /* messages not sent because the expansion is offline */
+  uint32_t fast_fails;
+  /* offline: time (millis()) of the next probe and current probe interval
+   * (doubled after each failed probe) */
+  unsigned long next_probe;
+  uint32_t probe_interval;
+
+  ExpansionHealth() { reset(); }
+  void reset() {
+    state = OPTA_EXPANSION_HEALTHY;
+    failures = 0;
+    successes = 0;
+    offline_count = 0;
+    fast_fails = 0;
+    next_probe = 0;
+    probe_interval = OPTA_CONTROLLER_PROBE_MIN_MS;
+  }
+
+  /* true if a message can be sent at time now: always, unless the expansion
+   * is offline and it is not yet time for the next probe */
+  bool canSend(unsigned long now) const {
+    return (state != OPTA_EXPANSION_OFFLINE || (long)(now - next_probe) >= 0);
+  }
+  bool isProbeDue(unsigned long now) const {
+    return (state == OPTA_EXPANSION_OFFLINE && (long)(now - next_probe) >= 0);
+  }
+
+  /* result of a transaction at time now, return true if the state changed */
+  bool update(bool ok, unsigned long now) {
+    uint8_t prev = state;
+    if (ok) {
+      failures = 0;
+      if (successes < UINT16_MAX) {
+        successes++;
+      }
+      if (state == OPTA_EXPANSION_OFFLINE) {
+        /* back, but healthy only after some successful transactions */
+        state = OPTA_EXPANSION_DEGRADED;
+        successes = 1;
+        probe_interval = OPTA_CONTROLLER_PROBE_MIN_MS;
+      }
+      if (state == OPTA_EXPANSION_DEGRADED &&
+          successes >= OPTA_CONTROLLER_HEALTHY_AFTER) {
+        state = OPTA_EXPANSION_HEALTHY;
+      }
+    } else {
+      successes = 0;
+      if (failures < UINT16_MAX) {
+        failures++;
+      }
+      if (state == OPTA_EXPANSION_OFFLINE) {
+        /* failed probe: exponential backoff */
+        probe_interval *= 2;
+        if (probe_interval > OPTA_CONTROLLER_PROBE_MAX_MS) {
+          probe_interval = OPTA_CONTROLLER_PROBE_MAX_MS;
+        }
+        next_probe = now + probe_interval;
+      } else if (failures >= OPTA_CONTROLLER_OFFLINE_AFTER) {
+        state = OPTA_EXPANSION_OFFLINE;
+        offline_count++;
+        probe_interval = OPTA_CONTROLLER_PROBE_MIN_MS;
+        next_probe = now + probe_interval;
+      } else {
+        state = OPTA_EXPANSION_DEGRADED;
+      }
+    }
+    return (state != prev);
+  }
+};
+
+#endif
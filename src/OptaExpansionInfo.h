@@ -0,0 +1,62 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaExpansionInfo.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240702
+   DESCRIPTION: Identity of an expansion as answered to the IDENTIFY message
+                (type, product, firmware and protocol version, capabilities
+                and configuration hash), cached by the Controller
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Expansions with a firmware that does not know IDENTIFY are
+                never identified (valid is false)                             */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_EXPANSION_INFO_H
+#define OPTA_EXPANSION_INFO_H
+
+#include "OptaModuleProtocol.h"
+#include <cstdint>
+#include <cstring>
+
+class ExpansionInfo {
+public:
+  bool valid;
+  /* type answered by the expansion (custom expansions have their own type
+   * assigned by the Controller from the product) */
+  uint8_t type;
+  uint8_t fw_major;
+  uint8_t fw_minor;
+  uint8_t fw_release;
+  uint8_t protocol;
+  /* OPTA_CAPABILITY_ bitmask */
+  uint16_t capabilities;
+  /* optional features agreed with SET FEATURES (OPTA_CAPABILITY_ bitmask,
+   * 0 for expansions that do not know the message) */
+  uint16_t features;
+  /* changes when the configuration of the expansion changes */
+  uint32_t cfg_hash;
+  char product[IDENTIFY_PRODUCT_DIM + 1];
+
+  ExpansionInfo() { reset(); }
+  void reset() {
+    valid = false;
+    type = 0;
+    fw_major = 0;
+    fw_minor = 0;
+    fw_release = 0;
+    protocol = 0;
+    capabilities = 0;
+    features = 0;
+    cfg_hash = 0;
+    memset(product, 0, sizeof(product));
+  }
+  bool hasCapability(uint16_t cap) const {
+    return (valid && (capabilities & cap) == cap);
+  }
+  bool hasFeature(uint16_t f) const { return (valid && (features & f) == f); }
+};
+
+#endif
@@ -66,6 +66,78 @@
 #define GET_VERSION_RELEASE_POS (BP_HEADER_DIM + 2)
 
 
+/* ######################## */
+/* IDENTIFY message         */
+/* ######################## */
+
+/* version of the protocol implemented by the expansion (answered by
+   IDENTIFY: expansions that do not answer to IDENTIFY implement version 0) */
+#define OPTA_BLUE_PROTOCOL_VERSION 1
+
+/* capabilities of the expansion (bitmask answered by IDENTIFY), they are
+   also the optional features enabled by SET FEATURES */
+/* the outputs can be read back (warm restart of the Controller) */
+#define OPTA_CAPABILITY_GET_OUTPUTS (1 << 0)
+/* the I2C of the expansion works with Fast-mode Plus (1 MHz) */
+#define OPTA_CAPABILITY_FAST_PLUS (1 << 1)
+/* messages can be sent in fragments (TRANSFER messages) */
+#define OPTA_CAPABILITY_TRANSFER (1 << 2)
+/* frames up to OPTA_I2C_LARGE_BUFFER_DIM bytes */
+#define OPTA_CAPABILITY_LARGE_FRAMES (1 << 3)
+/* the inputs can be latched at the same time on all the expansions (LATCH
+   INPUTS and GET LATCHED INPUTS messages) */
+#define OPTA_CAPABILITY_LATCH (1 << 4)
+/* the outputs can be staged and applied at the same time on all the
+   expansions (COMMIT OUTPUTS message) */
+#define OPTA_CAPABILITY_COMMIT (1 << 5)
+/* the clock of the Controller is distributed to the expansions (TIME SYNC
+   message) and the latched inputs carry the time they were sampled at */
+#define OPTA_CAPABILITY_TIME (1 << 6)
+
+/* I2C clocks: Fast-mode is used until all the expansions have enabled
+   OPTA_CAPABILITY_FAST_PLUS */
+#define OPTA_I2C_FAST_CLOCK 400000
+#define OPTA_I2C_FAST_PLUS_CLOCK 1000000
+
+/* This message is common to all expansions: type, firmware version,
+   protocol version, capabilities, configuration hash and product in one
+   answer */
+#define ARG_IDENTIFY 0x27
+#define LEN_IDENTIFY 0x00
+
+#define ANS_ARG_IDENTIFY ARG_IDENTIFY
+#define ANS_LEN_IDENTIFY 44
+#define IDENTIFY_TYPE_POS (BP_HEADER_DIM)
+#define IDENTIFY_FW_MAJOR_POS (BP_HEADER_DIM + 1)
+#define IDENTIFY_FW_MINOR_POS (BP_HEADER_DIM + 2)
+#define IDENTIFY_FW_RELEASE_POS (BP_HEADER_DIM + 3)
+#define IDENTIFY_PROTOCOL_POS (BP_HEADER_DIM + 4)
+/* 2 bytes, LSB first */
+#define IDENTIFY_CAPABILITIES_POS (BP_HEADER_DIM + 5)
+/* 4 bytes, LSB first */
+#define IDENTIFY_CFG_HASH_POS (BP_HEADER_DIM + 7)
+#define IDENTIFY_PRODUCT_SIZE_POS (BP_HEADER_DIM + 11)
+#define IDENTIFY_PRODUCT_POS (BP_HEADER_DIM + 12)
+#define IDENTIFY_PRODUCT_DIM 32
+
+/* ######################## */
+/* FEATURES message         */
+/* ######################## */
+
+/* The Controller enables the optional features (OPTA_CAPABILITY_ bitmask) it
+   will use with the expansion, the expansion answers with the features
+   actually enabled (the ones it supports); after a reset of the expansion
+   no optional feature is enabled */
+#define ARG_SET_FEATURES 0x28
+#define LEN_SET_FEATURES 0x02
+/* 2 bytes, LSB first */
+#define SET_FEATURES_POS (BP_HEADER_DIM)
+
+#define ANS_ARG_SET_FEATURES ARG_SET_FEATURES
+#define ANS_LEN_SET_FEATURES 0x02
+/* 2 bytes, LSB first */
+#define ANS_SET_FEATURES_POS (BP_HEADER_DIM)
+
 /* ######################## */
 /* REBOOT related messages  */
 /* ######################## */
@@ -106,4 +178,146 @@
 #define ANS_GET_DATA_DIMENSION_POS (BP_HEADER_DIM + 2)
 #define ANS_GET_DATA_DATA_INIT_POS (BP_HEADER_DIM + 3)
 
+/* ######################## */
+/* TRANSFER messages        */
+/* ######################## */
+
+/* A message whose payload does not fit in a frame is sent in fragments: each
+   fragment is a TRANSFER frame (with its own CRC) carrying the argument of
+   the message transferred, a sequence number and a part of the payload. The
+   expansion answers only to the last fragment (with the number of bytes
+   received, the dimension of the answer and a CRC of both for the
+   verification of the whole block), then the answer is read in fragments
+   with TRANSFER ANS. At most OPTA_TRANSFER_MAX_DIM bytes are
+   transferred in each direction */
+#define OPTA_TRANSFER_MAX_DIM 256
+
+#define ARG_TRANSFER 0x29
+/* 3 + bytes of the fragment */
+#define LEN_TRANSFER_MIN 3
+#define TRANSFER_ARG_POS (BP_HEADER_DIM)
+#define TRANSFER_SEQ_POS (BP_HEADER_DIM + 1)
+#define TRANSFER_FLAGS_POS (BP_HEADER_DIM + 2)
+#define TRANSFER_DATA_POS (BP_HEADER_DIM + 3)
+#define TRANSFER_FLAG_FIRST 0x01
+#define TRANSFER_FLAG_LAST 0x02
+/* transfer id (bits 2..7): changed at each transfer and kept by all the
+   attempts of a transfer, the last fragment sent again (its answer got
+   lost) is recognized and not executed twice (firmware before the 6 bits
+   id used only 0x80) */
+#define TRANSFER_FLAG_ID 0xFC
+#define TRANSFER_ID_STEP 0x04
+
+#define ANS_ARG_TRANSFER ARG_TRANSFER
+#define ANS_LEN_TRANSFER 8
+#define ANS_TRANSFER_ARG_POS (BP_HEADER_DIM)
+#define ANS_TRANSFER_STATUS_POS (BP_HEADER_DIM + 1)
+/* 2 bytes, LSB first */
+#define ANS_TRANSFER_RX_DIM_POS (BP_HEADER_DIM + 2)
+/* 2 bytes, LSB first */
+#define ANS_TRANSFER_ANS_DIM_POS (BP_HEADER_DIM + 4)
+/* CRC8 of the payload received and of the answer */
+#define ANS_TRANSFER_RX_CRC_POS (BP_HEADER_DIM + 6)
+#define ANS_TRANSFER_ANS_CRC_POS (BP_HEADER_DIM + 7)
+
+/* status of the transfer */
+#define TRANSFER_OK 0x00
+/* a fragment is missing */
+#define TRANSFER_ERR_SEQUENCE 0x01
+/* more than OPTA_TRANSFER_MAX_DIM bytes */
+#define TRANSFER_ERR_OVERFLOW 0x02
+/* the message cannot be transferred */
+#define TRANSFER_ERR_UNSUPPORTED 0x03
+/* wrong payload */
+#define TRANSFER_ERR_ARGUMENT 0x04
+/* data read back different from the data written (e.g. flash) */
+#define TRANSFER_ERR_VERIFY 0x05
+/* the message is executed by the main loop of the expansion: the last
+   fragment is sent again to get the result */
+#define TRANSFER_BUSY 0x06
+
+/* fragment of the answer starting at sequence number * dimension */
+#define ARG_TRANSFER_ANS 0x2A
+#define LEN_TRANSFER_ANS 2
+#define TRANSFER_ANS_SEQ_POS (BP_HEADER_DIM)
+#define TRANSFER_ANS_DIM_POS (BP_HEADER_DIM + 1)
+
+#define ANS_ARG_TRANSFER_ANS ARG_TRANSFER_ANS
+/* 2 + bytes of the fragment */
+#define ANS_LEN_TRANSFER_ANS_MIN 2
+#define ANS_TRANSFER_ANS_SEQ_POS (BP_HEADER_DIM)
+#define ANS_TRANSFER_ANS_FLAGS_POS (BP_HEADER_DIM + 1)
+#define ANS_TRANSFER_ANS_DATA_POS (BP_HEADER_DIM + 2)
+
+/* messages that can be transferred (payload of the transfer):
+   - ARG_SAVE_IN_DATA_FLASH: address (2 bytes, LSB first) and the data,
+     no answer (the data are read back after the write:
+     TRANSFER_ERR_VERIFY if different)
+   - ARG_GET_DATA_FROM_FLASH: address and dimension (2 bytes each, LSB
+     first), the answer is the data */
+
+/* ######################## */
+/* LATCH INPUTS messages    */
+/* ######################## */
+
+/* The Controller sends LATCH INPUTS to all the expansions one after the other
+   (no answer is read, so that the inputs of all the expansions are sampled
+   within a few frames): each expansion takes a snapshot of its inputs and
+   prepares the answer to GET LATCHED INPUTS, the snapshot is then collected
+   by the Controller with one GET LATCHED INPUTS per expansion; the latch id
+   (never 0) is answered back with the snapshot, 0 if there is no snapshot */
+#define ARG_LATCH_INPUTS 0x2B
+#define LEN_LATCH_INPUTS 0x01
+#define LATCH_INPUTS_ID_POS (BP_HEADER_DIM)
+
+#define ARG_GET_LATCHED_INPUTS 0x2C
+#define LEN_GET_LATCHED_INPUTS 0x00
+
+#define ANS_ARG_GET_LATCHED_INPUTS ARG_GET_LATCHED_INPUTS
+/* 1 + inputs of the expansion (the dimension depends on the expansion type,
+   see ANS_LEN_OD_GET_LATCHED_INPUTS and ANS_LEN_OA_GET_LATCHED_INPUTS) */
+#define ANS_LEN_GET_LATCHED_INPUTS_MIN 0x01
+#define ANS_LATCHED_ID_POS (BP_HEADER_DIM)
+#define ANS_LATCHED_INPUTS_POS (BP_HEADER_DIM + 1)
+
+/* ######################## */
+/* COMMIT OUTPUTS messages  */
+/* ######################## */
+
+/* The new values of the outputs are first staged on each expansion (with
+   the messages of the expansion type, see ARG_OD_STAGE_DIGITAL_OUTPUTS and
+   ARG_OA_SET_DAC without update), staged values do not change the outputs;
+   then the Controller sends COMMIT OUTPUTS to all the expansions one after
+   the other (no answer is read) and each expansion applies the staged
+   values at once; expansions that need time to prepare the staged values
+   (the Opta Analog writes them in the DAC registers in its main loop) are
+   asked with COMMIT READY until they are ready before the commit */
+#define ARG_COMMIT_OUTPUTS 0x2D
+#define LEN_COMMIT_OUTPUTS 0x00
+
+#define ARG_COMMIT_READY 0x2E
+#define LEN_COMMIT_READY 0x00
+
+#define ANS_ARG_COMMIT_READY ARG_COMMIT_READY
+/* 1 if the staged values can be applied at once, 0 otherwise */
+#define ANS_LEN_COMMIT_READY 0x01
+#define ANS_COMMIT_READY_POS (BP_HEADER_DIM)
+
+/* ######################## */
+/* TIME SYNC messages       */
+/* ######################## */
+
+/* The Controller sends TIME SYNC to all the expansions one after the other
+   (no answer is read) with the value of its micros() when the frame ends:
+   each expansion keeps the offset between its own clock and the Controller
+   one and, from TIME SYNC messages far enough apart, the drift of its clock;
+   with OPTA_CAPABILITY_TIME enabled the answer to GET LATCHED INPUTS ends
+   with the Controller time the inputs were latched at (4 bytes, LSB first, 0
+   if the time has not been synchronized yet) */
+#define ARG_TIME_SYNC 0x2F
+#define LEN_TIME_SYNC 0x04
+#define TIME_SYNC_TIME_POS (BP_HEADER_DIM)
+
+#define ANS_LEN_LATCHED_TIME 0x04
+
 #endif
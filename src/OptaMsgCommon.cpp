@@ -17,8 +17,6 @@
 #include "OptaCrc.h"
 #include <stdint.h>
 
-// #define DEBUG_MESSAGE_ON_SERIAL
-
 static bool checkSet(uint8_t *buffer, uint8_t arg, uint8_t len);
 static bool checkGet(uint8_t *buffer, uint8_t arg, uint8_t len);
 static bool checkAnsSet(uint8_t *buffer, uint8_t arg, uint8_t len);
@@ -30,22 +28,6 @@ static void prepareAnsSet(uint8_t *buffer, uint8_t arg, uint8_t len);
 static void prepareAnsGet(uint8_t *buffer, uint8_t arg, uint8_t len);
 
 
-#ifdef DEBUG_MESSAGE_ON_SERIAL
-void debug_message(const char *log, uint8_t *m, uint8_t mlen) {
-  Serial.println();
-  Serial.println(log);
-  Serial.print("(" + String(mlen) + "): ");
-  for (int i = 0; i < mlen; i++) {
-    if (m[i] < 0x10) {
-      Serial.print('0');
-    }
-    Serial.print(m[i], HEX);
-    Serial.print(" ");
-  }
-  Serial.println();
-}
-#endif
-
 bool checkSet(uint8_t *buffer, uint8_t arg, uint8_t len) {
   if (buffer[BP_CMD_POS] == BP_CMD_SET && buffer[BP_ARG_POS] == arg &&
       buffer[BP_LEN_POS] == len) {
@@ -92,9 +74,6 @@ bool checkCrc(uint8_t *buffer, uint8_t mlen) {
   if (!OptaCrc8::verify(buffer[mlen], buffer, mlen)) {
     rv = false;
   }
-#endif
-#ifdef DEBUG_MESSAGE_ON_SERIAL
-  Serial.println("CRC is Ok!");
 #endif
   return rv;
 }
@@ -0,0 +1,208 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaPollGroup.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240626
+   DESCRIPTION: Periodic polling groups of the Controller
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#if defined(ARDUINO_OPTA) || defined(OPTA_PINS)
+#include "OptaPollGroup.h"
+#include "AnalogExpansionAddress.h"
+#include "DigitalExpansionsAddresses.h"
+#include "ExpansionOperations.h"
+#include "OptaController.h"
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollGroup::clear() {
+  used = false;
+  enabled = false;
+  period_us = 0;
+  item_num = 0;
+  cb = nullptr;
+  next = 0;
+  resetStats();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollGroup::resetStats() {
+  runs = 0;
+  overruns = 0;
+  errors = 0;
+  last_jitter_us = 0;
+  max_jitter_us = 0;
+  total_jitter_us = 0;
+  last_duration_us = 0;
+  max_duration_us = 0;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+PollScheduler::PollScheduler(Controller *c) : ctrl(c) {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+int PollScheduler::addGroup(uint32_t period_ms, PollGroupCb_f cb) {
+  if (period_ms == 0) {
+    return -1;
+  }
+  for (int i = 0; i < OPTA_POLL_MAX_GROUPS; i++) {
+    if (!groups[i].used) {
+      groups[i].clear();
+      groups[i].used = true;
+      groups[i].enabled = true;
+      groups[i].period_us = period_ms * 1000;
+      groups[i].cb = cb;
+      groups[i].next = micros();
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool PollScheduler::addItem(int group, uint8_t device, uint8_t what,
+                            uint8_t ch) {
+  if (getGroup(group) == nullptr) {
+    return false;
+  }
+  PollGroup &g = groups[group];
+  if (g.item_num >= OPTA_POLL_MAX_ITEMS) {
+    return false;
+  }
+  g.items[g.item_num].device = device;
+  g.items[g.item_num].what = what;
+  g.items[g.item_num].ch = ch;
+  g.item_num++;
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollScheduler::removeGroup(int group) {
+  if (getGroup(group) != nullptr) {
+    groups[group].clear();
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollScheduler::enableGroup(int group, bool en) {
+  if (getGroup(group) == nullptr) {
+    return;
+  }
+  if (en && !groups[group].enabled) {
+    /* no overrun for the time the group was disabled */
+    groups[group].next = micros();
+  }
+  groups[group].enabled = en;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const PollGroup *PollScheduler::getGroup(int group) const {
+  if (group >= 0 && group < OPTA_POLL_MAX_GROUPS && groups[group].used) {
+    return &groups[group];
+  }
+  return nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollScheduler::resetStats() {
+  for (int i = 0; i < OPTA_POLL_MAX_GROUPS; i++) {
+    groups[i].resetStats();
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollScheduler::run() {
+  bool done[OPTA_POLL_MAX_GROUPS] = {false};
+  /* each group runs at most once per call: the one with the shortest period
+     among the groups released is executed first, then the release times
+     are checked again (they may have come while the group was running) */
+  for (;;) {
+    unsigned long now = micros();
+    int sel = -1;
+    for (int i = 0; i < OPTA_POLL_MAX_GROUPS; i++) {
+      const PollGroup &g = groups[i];
+      if (g.used && g.enabled && !done[i] && (long)(now - g.next) >= 0) {
+        if (sel == -1 || g.period_us < groups[sel].period_us) {
+          sel = i;
+        }
+      }
+    }
+    if (sel == -1) {
+      return;
+    }
+    done[sel] = true;
+    run_group(sel, now);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void PollScheduler::run_group(int group, unsigned long now) {
+  PollGroup &g = groups[group];
+
+  /* releases missed are not recovered: the next release is the first one
+     after now (the group stays aligned to its period) */
+  uint32_t late = (uint32_t)(now - g.next);
+  uint32_t missed = late / g.period_us;
+  g.overruns += missed;
+  g.next += (missed + 1) * g.period_us;
+
+  uint32_t jitter = late - missed * g.period_us;
+  g.last_jitter_us = jitter;
+  if (jitter > g.max_jitter_us) {
+    g.max_jitter_us = jitter;
+  }
+  g.total_jitter_us += jitter;
+  g.runs++;
+
+  unsigned long start = micros();
+  for (int i = 0; i < g.item_num; i++) {
+    if (!run_item(g.items[i])) {
+      g.errors++;
+    }
+  }
+  g.last_duration_us = (uint32_t)(micros() - start);
+  if (g.last_duration_us > g.max_duration_us) {
+    g.max_duration_us = g.last_duration_us;
+  }
+
+  if (g.cb != nullptr) {
+    g.cb(group);
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool PollScheduler::run_item(const PollItem &item) {
+  if (item.device >= ctrl->getExpansionNum()) {
+    return false;
+  }
+  Expansion *exp = ctrl->getExpansionPtr(item.device);
+  if (exp == nullptr) {
+    return false;
+  }
+  if (item.what == GET_RTD || item.what == GET_SINGLE_ANALOG_INPUT) {
+    if (exp->getType() == EXPANSION_OPTA_ANALOG) {
+      exp->write(ADD_OA_PIN, (unsigned int)item.ch);
+    } else {
+      exp->write(CTRL_ADD_EXPANSION_PIN, (unsigned int)item.ch);
+    }
+  }
+  return (exp->execute(item.what) == EXECUTE_OK);
+}
+
+#endif
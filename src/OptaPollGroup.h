@@ -0,0 +1,109 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaPollGroup.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240626
+   DESCRIPTION: Periodic polling groups of the Controller: each group has a
+                period and a list of operations (e.g. "digital inputs of
+                expansion 0 every 5 ms", "RTDs every 1 s") executed by
+                OptaController.update(), with overrun and jitter statistics
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Scheduling is cooperative: groups run only when update() is
+                called, so update() has to be called more often than the
+                shortest period. The values read are stored in the expansion
+                objects of the Controller (get the expansion with
+                OptaController.getExpansion() and read with update = false) */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_POLL_GROUP_H
+#define OPTA_POLL_GROUP_H
+
+#include <cstdint>
+
+#define OPTA_POLL_MAX_GROUPS 8
+#define OPTA_POLL_MAX_ITEMS 8
+
+class Controller;
+
+/* called after the operations of the group have been executed (group is
+ * the index returned by addGroup()) */
+using PollGroupCb_f = void (*)(int group);
+
+/* one operation of a group: execute(what) on expansion device (what is one
+ * of the codes of ExpansionOperations.h, ch is the channel for the
+ * operations on a single channel, e.g. GET_RTD or GET_SINGLE_ANALOG_INPUT) */
+class PollItem {
+public:
+  uint8_t device;
+  uint8_t what;
+  uint8_t ch;
+};
+
+class PollGroup {
+public:
+  PollGroup() { clear(); }
+  void clear();
+  void resetStats();
+
+  bool used;
+  bool enabled;
+  uint32_t period_us;
+  PollItem items[OPTA_POLL_MAX_ITEMS];
+  uint8_t item_num;
+  PollGroupCb_f cb;
+  /* next release time (micros()) */
+  unsigned long next;
+
+  /* ---- statistics ---- */
+
+  /* number of times the group has been executed */
+  uint32_t runs;
+  /* releases missed because the group could not run before the next one
+   * (update() not called often enough or other groups taking too long) */
+  uint32_t overruns;
+  /* operations that failed (I2C error or expansion not present) */
+  uint32_t errors;
+  /* jitter: delay between the release time and the actual execution */
+  uint32_t last_jitter_us;
+  uint32_t max_jitter_us;
+  uint64_t total_jitter_us;
+  uint32_t getAvgJitterUs() const {
+    return (runs > 0) ? (uint32_t)(total_jitter_us / runs) : 0;
+  }
+  /* time spent executing the operations */
+  uint32_t last_duration_us;
+  uint32_t max_duration_us;
+};
+
+class PollScheduler {
+public:
+  PollScheduler(Controller *c);
+
+  /* add a group executed every period_ms (cb, if not null, is called after
+   * the operations of the group), returns the group index or -1 if all the
+   * groups are in use; the group starts at the next update() */
+  int addGroup(uint32_t period_ms, PollGroupCb_f cb = nullptr);
+  /* add the operation what on expansion device to the group */
+  bool addItem(int group, uint8_t device, uint8_t what, uint8_t ch = 0);
+  void removeGroup(int group);
+  void enableGroup(int group, bool en);
+  /* nullptr if group is not in use */
+  const PollGroup *getGroup(int group) const;
+  void resetStats();
+
+  /* execute the groups whose release time has come, shortest period first
+   * (called by OptaController.update()) */
+  void run();
+
+private:
+  void run_group(int group, unsigned long now);
+  bool run_item(const PollItem &item);
+
+  Controller *ctrl;
+  PollGroup groups[OPTA_POLL_MAX_GROUPS];
+};
+
+#endif
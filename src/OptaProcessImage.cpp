@@ -0,0 +1,436 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaProcessImage.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240620
+   DESCRIPTION: Process image of the expansions and background I/O thread of
+                the Controller
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:                                                                     */
+/* -------------------------------------------------------------------------- */
+
+#if defined(ARDUINO_OPTA)
+#include "OptaProcessImage.h"
+#include "AnalogExpansion.h"
+#include "DigitalExpansion.h"
+#include "OptaController.h"
+#include <chrono>
+#include <cstring>
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void InputImage::clear() {
+  type = EXPANSION_NOT_VALID;
+  valid = false;
+  cycle = 0;
+  time = 0;
+  digital = 0;
+  memset(analog, 0, sizeof(analog));
+  for (int i = 0; i < OA_AN_CHANNELS_NUM; i++) {
+    rtd[i] = 0.0f;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void OutputImage::clear(uint8_t t) {
+  type = t;
+  digital = 0;
+  memset(dac, 0, sizeof(dac));
+  memset(pwm_period, 0, sizeof(pwm_period));
+  memset(pwm_pulse, 0, sizeof(pwm_pulse));
+  leds = 0;
+  digital_dirty = false;
+  dac_dirty = 0;
+  pwm_dirty = 0;
+  leds_dirty = false;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+static bool is_digital(uint8_t type) {
+  return (type == EXPANSION_OPTA_DIGITAL_MEC ||
+          type == EXPANSION_OPTA_DIGITAL_STS);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+ProcessImage::ProcessImage(Controller *c)
+    : ctrl(c), th(nullptr), running(false),
+      period(OPTA_PI_DEFAULT_PERIOD_MS), front(0), cycles(0), overruns(0),
+      last_cycle_us(0), max_cycle_us(0) {}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool ProcessImage::begin(uint32_t period_ms, osPriority priority) {
+  if (th != nullptr || period_ms == 0) {
+    return false;
+  }
+  period = period_ms;
+  th = new rtos::Thread(priority, OPTA_PI_THREAD_STACK_SIZE, nullptr,
+                        "OptaBlueIo");
+  if (th == nullptr) {
+    return false;
+  }
+  running = true;
+  if (th->start(mbed::callback(this, &ProcessImage::thread_main)) != osOK) {
+    running = false;
+    delete th;
+    th = nullptr;
+    return false;
+  }
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::end() {
+  if (th == nullptr) {
+    return;
+  }
+  running = false;
+  th->join();
+  delete th;
+  th = nullptr;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::thread_main() {
+  unsigned long next = millis();
+  while (running) {
+    /* hot plug of the expansions */
+    ctrl->update();
+    scan();
+
+    next += period;
+    unsigned long now = millis();
+    if ((long)(next - now) > 0) {
+      rtos::ThisThread::sleep_for(std::chrono::milliseconds(next - now));
+    } else {
+      /* no attempt to recover the cycles lost */
+      overruns++;
+      next = now;
+    }
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::scan() {
+  unsigned long start = micros();
+  uint8_t num = ctrl->getExpansionNum();
+
+  OutputImage sent[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  bool staged[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  for (uint8_t i = 0; i < num; i++) {
+    staged[i] = send_outputs(i, ctrl->getExpansionType(i), sent[i]);
+  }
+  /* the outputs staged on all the expansions change at the same time */
+  if (!ctrl->applyStagedOutputs()) {
+    /* staged but not applied: sent again at the next cycle */
+    for (uint8_t i = 0; i < num; i++) {
+      if (staged[i] && ctrl->isCommitFailed(i)) {
+        mark_dirty(i, ctrl->getExpansionType(i), sent[i]);
+      }
+    }
+  }
+
+  /* the inputs of all the expansions are sampled at the same time, then
+   * collected by read_inputs() */
+  ctrl->latchInputs();
+
+  /* only this function changes the buffers: the front one can be read
+   * without locking */
+  uint8_t back = (front == 0) ? 1 : 0;
+  for (uint8_t i = 0; i < OPTA_CONTROLLER_MAX_EXPANSION_NUM; i++) {
+    InputImage &img = inputs[back][i];
+    img = inputs[front][i];
+    if (i < num) {
+      img.type = ctrl->getExpansionType(i);
+      img.valid = read_inputs(i, img);
+      img.cycle = cycles + 1;
+    } else {
+      img.clear();
+    }
+  }
+
+  mtx.lock();
+  front = back;
+  cycles++;
+  mtx.unlock();
+
+  last_cycle_us = (uint32_t)(micros() - start);
+  if (last_cycle_us > max_cycle_us) {
+    max_cycle_us = last_cycle_us;
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* output image of device (must be called with the mutex locked): outputs
+   written for a different kind of expansion (hot plug) are discarded */
+OutputImage *ProcessImage::use_outputs(uint8_t device, uint8_t type) {
+  OutputImage *o = &outputs[device];
+  if (o->type != type) {
+    if (o->type == EXPANSION_NOT_VALID) {
+      /* written before the first scan */
+      o->type = type;
+    } else {
+      o->clear(type);
+    }
+  }
+  return o;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* stage the outputs changed of device (copied in out): false if they could
+   not be staged (they are sent again at the next cycle) */
+bool ProcessImage::send_outputs(uint8_t device, uint8_t type,
+                                OutputImage &out) {
+  mtx.lock();
+  OutputImage *o = use_outputs(device, type);
+  out = *o;
+  o->digital_dirty = false;
+  o->dac_dirty = 0;
+  o->pwm_dirty = 0;
+  o->leds_dirty = false;
+  mtx.unlock();
+
+  Expansion *exp = ctrl->getExpansionPtr(device);
+  if (exp == nullptr) {
+    return false;
+  }
+
+  unsigned int err = EXECUTE_OK;
+  if (is_digital(type) && out.digital_dirty) {
+    DigitalExpansion *d = static_cast<DigitalExpansion *>(exp);
+    for (int pin = 0; pin < OPTA_DIGITAL_OUT_NUM; pin++) {
+      d->digitalWrite(pin, (out.digital & (1 << pin)) ? HIGH : LOW, false);
+    }
+    err = d->stageOutputs();
+  } else if (type == EXPANSION_OPTA_ANALOG &&
+             (out.dac_dirty || out.pwm_dirty || out.leds_dirty)) {
+    AnalogExpansion *a = static_cast<AnalogExpansion *>(exp);
+    for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+      if (out.dac_dirty & (1 << ch)) {
+        a->setDac(ch, out.dac[ch], false);
+      }
+    }
+    for (int ch = 0; ch < OA_PWM_CHANNELS_NUM; ch++) {
+      if (out.pwm_dirty & (1 << ch)) {
+        a->setPwm(OA_FIRST_PWM_CH + ch, out.pwm_period[ch], out.pwm_pulse[ch],
+                  false);
+      }
+    }
+    if (out.leds_dirty) {
+      for (int led = 0; led < OA_LED_NUM; led++) {
+        if (out.leds & (1 << led)) {
+          a->switchLedOn(led, false);
+        } else {
+          a->switchLedOff(led, false);
+        }
+      }
+    }
+    err = a->stageOutputs();
+  }
+
+  if (err != EXECUTE_OK) {
+    mark_dirty(device, type, out);
+    return false;
+  }
+  return true;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* the outputs of out are sent again at the next cycle (with their last
+   value, if they are changed in the meantime) */
+void ProcessImage::mark_dirty(uint8_t device, uint8_t type,
+                              const OutputImage &out) {
+  mtx.lock();
+  if (outputs[device].type == type) {
+    outputs[device].digital_dirty |= out.digital_dirty;
+    outputs[device].dac_dirty |= out.dac_dirty;
+    outputs[device].pwm_dirty |= out.pwm_dirty;
+    outputs[device].leds_dirty |= out.leds_dirty;
+  }
+  mtx.unlock();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+/* custom expansions are not part of the process image */
+bool ProcessImage::read_inputs(uint8_t device, InputImage &img) {
+  Expansion *exp = ctrl->getExpansionPtr(device);
+  if (exp == nullptr) {
+    return false;
+  }
+
+  bool rv = true;
+  if (is_digital(img.type)) {
+    DigitalExpansion *d = static_cast<DigitalExpansion *>(exp);
+    if (d->execute(GET_LATCHED_INPUTS) == EXECUTE_OK) {
+      img.time = d->getSampleTime();
+      img.digital = 0;
+      for (int pin = 0; pin < OPTA_DIGITAL_IN_NUM; pin++) {
+        if (d->digitalRead(pin, false) == HIGH) {
+          img.digital |= (1 << pin);
+        }
+        img.analog[pin] = (uint16_t)d->analogRead(pin, false);
+      }
+    } else {
+      rv = false;
+    }
+  } else if (img.type == EXPANSION_OPTA_ANALOG) {
+    AnalogExpansion *a = static_cast<AnalogExpansion *>(exp);
+    if (a->execute(GET_LATCHED_INPUTS) == EXECUTE_OK) {
+      img.time = a->getSampleTime();
+      img.digital = 0;
+      for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+        if (a->digitalRead(ch, false) == HIGH) {
+          img.digital |= (1 << ch);
+        }
+        img.analog[ch] = a->getAdc(ch, false);
+      }
+    } else {
+      rv = false;
+    }
+    /* RTD values are read one channel at a time */
+    for (int ch = 0; ch < OA_AN_CHANNELS_NUM; ch++) {
+      if (a->isChRtd(ch)) {
+        a->write(ADD_OA_PIN, (unsigned int)ch);
+        float v = 0.0f;
+        if (a->execute(GET_RTD) == EXECUTE_OK &&
+            exp->read(BASE_OA_RTD_ADDRESS + ch, v)) {
+          img.rtd[ch] = v;
+        } else {
+          rv = false;
+        }
+      }
+    }
+  } else {
+    rv = false;
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool ProcessImage::getInputs(uint8_t device, InputImage &img) {
+  if (device >= OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    return false;
+  }
+  mtx.lock();
+  img = inputs[front][device];
+  mtx.unlock();
+  return (img.type != EXPANSION_NOT_VALID);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+PinStatus ProcessImage::digitalRead(uint8_t device, int pin) {
+  PinStatus rv = LOW;
+  if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM && pin >= 0 &&
+      pin < OPTA_DIGITAL_IN_NUM) {
+    mtx.lock();
+    if (inputs[front][device].digital & (1 << pin)) {
+      rv = HIGH;
+    }
+    mtx.unlock();
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint16_t ProcessImage::analogRead(uint8_t device, int pin) {
+  uint16_t rv = 0;
+  if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM && pin >= 0 &&
+      pin < OPTA_PI_ANALOG_IN_NUM) {
+    mtx.lock();
+    rv = inputs[front][device].analog[pin];
+    mtx.unlock();
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+float ProcessImage::getRtd(uint8_t device, uint8_t ch) {
+  float rv = 0.0f;
+  if (device < OPTA_CONTROLLER_MAX_EXPANSION_NUM && ch < OA_AN_CHANNELS_NUM) {
+    mtx.lock();
+    rv = inputs[front][device].rtd[ch];
+    mtx.unlock();
+  }
+  return rv;
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::digitalWrite(uint8_t device, int pin, PinStatus st) {
+  if (device >= OPTA_CONTROLLER_MAX_EXPANSION_NUM || pin < 0 ||
+      pin >= OPTA_DIGITAL_OUT_NUM) {
+    return;
+  }
+  mtx.lock();
+  if (st == HIGH) {
+    outputs[device].digital |= (1 << pin);
+  } else {
+    outputs[device].digital &= ~(1 << pin);
+  }
+  outputs[device].digital_dirty = true;
+  mtx.unlock();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::setDac(uint8_t device, uint8_t ch, uint16_t value) {
+  if (device >= OPTA_CONTROLLER_MAX_EXPANSION_NUM ||
+      ch >= OA_AN_CHANNELS_NUM) {
+    return;
+  }
+  mtx.lock();
+  outputs[device].dac[ch] = value;
+  outputs[device].dac_dirty |= (1 << ch);
+  mtx.unlock();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::setPwm(uint8_t device, uint8_t ch, uint32_t period,
+                          uint32_t pulse) {
+  if (device >= OPTA_CONTROLLER_MAX_EXPANSION_NUM || ch < OA_FIRST_PWM_CH ||
+      ch > OA_LAST_PWM_CH) {
+    return;
+  }
+  uint8_t i = ch - OA_FIRST_PWM_CH;
+  mtx.lock();
+  outputs[device].pwm_period[i] = period;
+  outputs[device].pwm_pulse[i] = pulse;
+  outputs[device].pwm_dirty |= (1 << i);
+  mtx.unlock();
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void ProcessImage::setLed(uint8_t device, uint8_t led, bool on) {
+  if (device >= OPTA_CONTROLLER_MAX_EXPANSION_NUM || led >= OA_LED_NUM) {
+    return;
+  }
+  mtx.lock();
+  if (on) {
+    outputs[device].leds |= (1 << led);
+  } else {
+    outputs[device].leds &= ~(1 << led);
+  }
+  outputs[device].leds_dirty = true;
+  mtx.unlock();
+}
+
+#endif // ARDUINO_OPTA
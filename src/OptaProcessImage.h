@@ -0,0 +1,165 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaProcessImage.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240620
+   DESCRIPTION: Process image of the expansions and background I/O thread of
+                the Controller: the thread runs the scan cycle (outputs sent,
+                inputs read) at a fixed period and publishes the inputs into
+                a double buffer, the application reads consistent snapshots
+                and writes outputs without waiting for I2C
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       While the I/O thread is running the application must access
+                Opta Digital and Opta Analog expansions only through the
+                process image (OptaController.update() is also called by the
+                I/O thread), other threads can still use custom expansions  */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_PROCESS_IMAGE_H
+#define OPTA_PROCESS_IMAGE_H
+
+#if defined(ARDUINO_OPTA)
+
+#include "AnalogCommonCfg.h"
+#include "Arduino.h"
+#include "DigitalCommonCfg.h"
+#include "OptaBluePrintCfg.h"
+#include "OptaControllerCfg.h"
+#include "mbed.h"
+#include <cstdint>
+
+/* period of the scan cycle used if not specified in begin() */
+#define OPTA_PI_DEFAULT_PERIOD_MS 10
+#define OPTA_PI_THREAD_STACK_SIZE 4096
+/* the Opta Digital has the highest number of analog inputs */
+#define OPTA_PI_ANALOG_IN_NUM OPTA_DIGITAL_IN_NUM
+
+/* inputs of an expansion read in a scan cycle */
+class InputImage {
+public:
+  InputImage() { clear(); }
+  void clear();
+
+  uint8_t type;
+  /* false if at least one input could not be read in the scan cycle (its
+   * value is the one read in the previous cycle) */
+  bool valid;
+  /* number of the scan cycle that read the inputs */
+  uint32_t cycle;
+  /* time (micros() of the Controller) the inputs were sampled at, see
+   * Expansion::getSampleTime() */
+  uint32_t time;
+  /* digital inputs, bit i is input i (Opta Analog: channels configured as
+   * digital input) */
+  uint16_t digital;
+  /* raw value of the analog inputs (Opta Digital: 16 inputs, Opta Analog:
+   * channels configured as ADC) */
+  uint16_t analog[OPTA_PI_ANALOG_IN_NUM];
+  /* Opta Analog: channels configured as RTD */
+  float rtd[OA_AN_CHANNELS_NUM];
+};
+
+/* outputs of an expansion set by the application (and what is still to be
+ * sent to the expansion) */
+class OutputImage {
+public:
+  OutputImage() { clear(EXPANSION_NOT_VALID); }
+  void clear(uint8_t t);
+
+  uint8_t type;
+  /* Opta Digital: bit i is output i */
+  uint8_t digital;
+  /* Opta Analog */
+  uint16_t dac[OA_AN_CHANNELS_NUM];
+  uint32_t pwm_period[OA_PWM_CHANNELS_NUM];
+  uint32_t pwm_pulse[OA_PWM_CHANNELS_NUM];
+  /* bit i is led i */
+  uint8_t leds;
+  /* bit masks of the outputs changed */
+  bool digital_dirty;
+  uint8_t dac_dirty;
+  uint8_t pwm_dirty;
+  bool leds_dirty;
+};
+
+class Controller;
+
+class ProcessImage {
+public:
+  ProcessImage(Controller *c);
+
+  /* start the I/O thread: a scan cycle is executed every period_ms (if a
+   * cycle lasts more than the period the next one starts immediately and
+   * an overrun is counted) */
+  bool begin(uint32_t period_ms = OPTA_PI_DEFAULT_PERIOD_MS,
+             osPriority priority = osPriorityAboveNormal);
+  /* stop the I/O thread at the end of the current scan cycle */
+  void end();
+  bool isRunning() const { return running; }
+
+  /* one scan cycle: outputs changed since the previous cycle are sent and
+   * applied at the same time on all the expansions (see
+   * Controller::commitOutputs()), then the inputs of all the expansions
+   * are latched at the same time (see
+   * Controller::latchInputs()), read and published (called by the
+   * I/O thread, it can also be called by the application if the thread is
+   * not used) */
+  void scan();
+
+  /* ---- inputs (last scan cycle, they never wait for I2C) ---- */
+
+  /* consistent copy of all the inputs of expansion device (false if device
+   * is not valid) */
+  bool getInputs(uint8_t device, InputImage &img);
+  PinStatus digitalRead(uint8_t device, int pin);
+  uint16_t analogRead(uint8_t device, int pin);
+  float getRtd(uint8_t device, uint8_t ch);
+
+  /* ---- outputs (sent at the next scan cycle, only if changed) ---- */
+
+  /* Opta Digital */
+  void digitalWrite(uint8_t device, int pin, PinStatus st);
+  /* Opta Analog (ch from OA_PWM_CH_0 to OA_PWM_CH_3 for setPwm) */
+  void setDac(uint8_t device, uint8_t ch, uint16_t value);
+  void setPwm(uint8_t device, uint8_t ch, uint32_t period, uint32_t pulse);
+  void setLed(uint8_t device, uint8_t led, bool on);
+
+  /* ---- scan cycle statistics ---- */
+
+  uint32_t getCycles() const { return cycles; }
+  /* cycles that lasted more than the period */
+  uint32_t getOverruns() const { return overruns; }
+  uint32_t getLastCycleUs() const { return last_cycle_us; }
+  uint32_t getMaxCycleUs() const { return max_cycle_us; }
+
+private:
+  void thread_main();
+  bool send_outputs(uint8_t device, uint8_t type, OutputImage &out);
+  void mark_dirty(uint8_t device, uint8_t type, const OutputImage &out);
+  bool read_inputs(uint8_t device, InputImage &img);
+  OutputImage *use_outputs(uint8_t device, uint8_t type);
+
+  Controller *ctrl;
+  rtos::Thread *th;
+  /* protects the front input buffer and the output image (never held
+   * during I2C transactions) */
+  rtos::Mutex mtx;
+  volatile bool running;
+  uint32_t period;
+  /* double buffer: the application reads inputs[front], the scan cycle
+   * writes the other one and swaps them when all the expansions are read */
+  InputImage inputs[2][OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+  uint8_t front;
+  OutputImage outputs[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+
+  uint32_t cycles;
+  uint32_t overruns;
+  uint32_t last_cycle_us;
+  uint32_t max_cycle_us;
+};
+
+#endif // ARDUINO_OPTA
+#endif
@@ -0,0 +1,90 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaTopology.cpp
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240701
+   DESCRIPTION: Last known topology of the expansions
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       Without the key value store of mbed (no ARDUINO_OPTA or
+                Zephyr core) nothing is saved and the address assignment is
+                always performed                                              */
+/* -------------------------------------------------------------------------- */
+
+#if defined(ARDUINO_OPTA) || defined(OPTA_PINS)
+#include "OptaTopology.h"
+#include "OptaCrc.h"
+#include <cstring>
+
+#if defined(ARDUINO_OPTA) && !defined(ARDUINO_ARCH_ZEPHYR)
+#include "kvstore_global_api.h"
+#define OPTA_TOPOLOGY_USE_KV
+#endif
+
+/* saved data: version, number of expansions, records, CRC */
+#define OPTA_TOPOLOGY_DIM                                                      \
+  (2 + OPTA_CONTROLLER_MAX_EXPANSION_NUM * sizeof(ExpansionRecord) + 1)
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void Topology::clear() {
+  num = 0;
+  memset(exp, 0, sizeof(exp));
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint8_t Topology::crc() const {
+  uint8_t c = OptaCrc8::calc(&num, 1, 0);
+  return OptaCrc8::calc((const uint8_t *)exp, sizeof(exp), c);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Topology::operator==(const Topology &t) const {
+  return (num == t.num && memcmp(exp, t.exp, sizeof(exp)) == 0);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Topology::load() {
+#if defined(OPTA_TOPOLOGY_USE_KV)
+  uint8_t buf[OPTA_TOPOLOGY_DIM];
+  size_t n = 0;
+  if (kv_get(OPTA_TOPOLOGY_KEY, buf, sizeof(buf), &n) != MBED_SUCCESS ||
+      n != sizeof(buf) || buf[0] != OPTA_TOPOLOGY_VERSION ||
+      buf[1] > OPTA_CONTROLLER_MAX_EXPANSION_NUM) {
+    clear();
+    return false;
+  }
+  num = buf[1];
+  memcpy(exp, buf + 2, sizeof(exp));
+  if (crc() != buf[sizeof(buf) - 1]) {
+    clear();
+    return false;
+  }
+  return true;
+#else
+  clear();
+  return false;
+#endif
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+bool Topology::save() {
+#if defined(OPTA_TOPOLOGY_USE_KV)
+  uint8_t buf[OPTA_TOPOLOGY_DIM];
+  buf[0] = OPTA_TOPOLOGY_VERSION;
+  buf[1] = num;
+  memcpy(buf + 2, exp, sizeof(exp));
+  buf[sizeof(buf) - 1] = crc();
+  return (kv_set(OPTA_TOPOLOGY_KEY, buf, sizeof(buf), 0) == MBED_SUCCESS);
+#else
+  return false;
+#endif
+}
+
+#endif
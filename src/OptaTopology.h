@@ -0,0 +1,56 @@
+/* -------------------------------------------------------------------------- */
+/* FILE NAME:   OptaTopology.h
+   AUTHOR:      Daniele Aimo
+   EMAIL:       d.aimo@arduino.cc
+   DATE:        20240701
+   DESCRIPTION: Last known topology of the expansions (address, type and
+                firmware version of each expansion) saved in the key value
+                store of the Controller, used by Controller::begin() to skip
+                the address assignment when the expansions are unchanged
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       The type saved is the one answered by the expansion (custom
+                expansions are identified again by their product string at
+                each boot)                                                    */
+/* -------------------------------------------------------------------------- */
+
+#ifndef OPTA_TOPOLOGY_H
+#define OPTA_TOPOLOGY_H
+
+#include "OptaBluePrintCfg.h"
+#include <cstdint>
+
+#define OPTA_TOPOLOGY_KEY "/kv/opta_blue_topology"
+/* changed when the layout of the saved data changes */
+#define OPTA_TOPOLOGY_VERSION 1
+
+class ExpansionRecord {
+public:
+  uint8_t address;
+  uint8_t type;
+  uint8_t fw_major;
+  uint8_t fw_minor;
+  uint8_t fw_release;
+};
+
+class Topology {
+public:
+  Topology() { clear(); }
+  void clear();
+  /* read from / write to the key value store, false if there is no valid
+   * topology saved (or no key value store) */
+  bool load();
+  bool save();
+  bool operator==(const Topology &t) const;
+  bool operator!=(const Topology &t) const { return !(*this == t); }
+
+  uint8_t num;
+  ExpansionRecord exp[OPTA_CONTROLLER_MAX_EXPANSION_NUM];
+
+private:
+  uint8_t crc() const;
+};
+
+#endif
@@ -0,0 +1,247 @@
+/* -------------------------------------------------------------------------- */
+/* FILENAME:    main.cpp
+   AUTHOR:      Daniele Aimo (d.aimo@arduino.cc)
+   DATE:        20240612
+   REVISION:    0.0.1
+   DESCRIPTION: Decode the binary dump of the Controller bus trace
+                (BusTrace::dump()) and print every frame with the name of the
+                command and of the argument
+   LICENSE:     Copyright (c) 2024 Arduino SA
+                This Source Code Form is subject to the terms fo the Mozilla
+                Public License (MPL), v 2.0. You can obtain a copy of the MPL
+                at http://mozilla.org/MPL/2.0/.
+   NOTES:       usage: OptaTraceDecoder <dump file>
+                the dump file contains the raw bytes written by the dump
+                function (for example captured from the serial port)         */
+/* -------------------------------------------------------------------------- */
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdio.h>
+#include <vector>
+
+#include "OptaAnalogProtocol.h"
+#include "OptaBlueProtocol.h"
+#include "OptaBusTrace.h"
+#include "OptaCrc.h"
+#include "OptaDigitalProtocol.h"
+#include "OptaModuleProtocol.h"
+
+using namespace std;
+
+#define ARG_NAME(a) {a, #a}
+
+typedef struct {
+  uint8_t arg;
+  const char *name;
+} ArgName_t;
+
+static const ArgName_t arg_names[] = {
+    /* module (common to all expansions) */
+    ARG_NAME(ARG_CONTROLLER_RESET),
+    ARG_NAME(ARG_ADDRESS),
+    ARG_NAME(ARG_ADDRESS_AND_TYPE),
+    ARG_NAME(ARG_GET_PRODUCT_TYPE),
+#ifdef USE_CONFIRM_RX_MESSAGE
+    ARG_NAME(ARG_CONFIRM_ADDRESS_RX),
+#endif
+    ARG_NAME(ARG_IDENTIFY),
+    ARG_NAME(ARG_SET_FEATURES),
+    ARG_NAME(ARG_TRANSFER),
+    ARG_NAME(ARG_TRANSFER_ANS),
+    ARG_NAME(ARG_LATCH_INPUTS),
+    ARG_NAME(ARG_GET_LATCHED_INPUTS),
+    ARG_NAME(ARG_COMMIT_OUTPUTS),
+    ARG_NAME(ARG_COMMIT_READY),
+    ARG_NAME(ARG_TIME_SYNC),
+    ARG_NAME(ARG_GET_VERSION),
+    ARG_NAME(ARG_REBOOT),
+    ARG_NAME(ARG_SAVE_IN_DATA_FLASH),
+    ARG_NAME(ARG_GET_DATA_FROM_FLASH),
+    ARG_NAME(ANS_ARG_GET_DATA_FROM_FLASH),
+    /* digital */
+    ARG_NAME(ARG_OD_GET_DIGITAL_INPUTS),
+    ARG_NAME(ARG_OD_GET_ANALOG_INPUT),
+    ARG_NAME(ARG_OD_SET_DIGITAL_OUTPUTS),
+    ARG_NAME(ARG_OD_GET_ALL_ANALOG_INPUTS),
+    ARG_NAME(ARG_OD_DEFAULT_AND_TIMEOUT),
+    ARG_NAME(ARG_OD_GET_DIGITAL_OUTPUTS),
+    ARG_NAME(ARG_OD_STAGE_DIGITAL_OUTPUTS),
+    /* analog */
+    ARG_NAME(ARG_OA_CH_ADC),
+    ARG_NAME(ARG_OA_GET_ADC),
+    ARG_NAME(ARG_OA_GET_ALL_ADC),
+    ARG_NAME(ARG_OA_CH_DAC),
+    ARG_NAME(ARG_OA_SET_DAC),
+    ARG_NAME(ARG_OA_SET_DAC_DEFAULT),
+    ARG_NAME(ARG_OA_SET_ALL_DAC),
+    ARG_NAME(ARG_OA_CH_RTD),
+    ARG_NAME(ARG_OA_GET_RTD),
+    ARG_NAME(ARG_OA_SET_RTD_UPDATE_TIME),
+    ARG_NAME(ARG_OA_SET_TIMEOUT_TIME),
+    ARG_NAME(ARG_OA_CH_DI),
+    ARG_NAME(ARG_OA_GET_DI),
+    ARG_NAME(ARG_OA_SET_PWM),
+    ARG_NAME(ARD_OA_SET_DEFAULT_PWM),
+    ARG_NAME(ARG_OA_SET_ALL_PWM),
+    ARG_NAME(ARG_OA_SET_ALL_PWM_DEFAULT),
+    ARG_NAME(ARG_OA_SET_GPO),
+    ARG_NAME(ARG_OA_SET_LED),
+    ARG_NAME(ARG_OA_CH_HIGH_IMPEDENCE),
+    ARG_NAME(ANS_ARG_OA_ACK),
+    ARG_NAME(ARG_GET_CHANNEL_FUNCTION),
+};
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const char *getArgName(uint8_t arg) {
+  for (size_t i = 0; i < sizeof(arg_names) / sizeof(ArgName_t); i++) {
+    if (arg_names[i].arg == arg) {
+      return arg_names[i].name;
+    }
+  }
+  return "UNKNOWN";
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+const char *getCmdName(uint8_t cmd) {
+  switch (cmd) {
+  case BP_CMD_SET:
+    return "SET";
+  case BP_CMD_GET:
+    return "GET";
+  case BP_ANS_GET:
+    return "ANS_GET";
+  case BP_ANS_SET:
+    return "ANS_SET";
+  default:
+    return "???";
+  }
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+void printFrame(uint32_t t, uint8_t add, uint8_t dev, uint8_t dir,
+                uint8_t outcome, const uint8_t *d, uint8_t len) {
+  char line[128];
+  char dev_str[4];
+  if (dev == 255) {
+    snprintf(dev_str, sizeof(dev_str), "-");
+  } else {
+    snprintf(dev_str, sizeof(dev_str), "%u", dev);
+  }
+
+  const char *res = "ok";
+  if (dir == OPTA_BUS_TRACE_TX && outcome != OPTA_BUS_TRACE_OK) {
+    res = "nack";
+  } else if (dir == OPTA_BUS_TRACE_RX && outcome == OPTA_BUS_TRACE_TIMEOUT) {
+    res = "timeout";
+  }
+
+  snprintf(line, sizeof(line), "%10u  %s  dev %-3s add 0x%02X  %-7s", t,
+           (dir == OPTA_BUS_TRACE_TX) ? "TX" : "RX", dev_str, add, res);
+  cout << line;
+
+  if (len >= BP_HEADER_DIM) {
+    snprintf(line, sizeof(line), "  %-7s %-30s len %2u",
+             getCmdName(d[BP_CMD_POS]), getArgName(d[BP_ARG_POS]),
+             d[BP_LEN_POS]);
+    cout << line;
+  }
+
+#ifdef BP_USE_CRC
+  if (len > BP_HEADER_DIM) {
+    bool crc_ok = OptaCrc8::verify(d[len - 1], d, len - 1);
+    cout << ((crc_ok) ? "  crc ok " : "  CRC ERR");
+  }
+#endif
+
+  cout << "  |";
+  for (int i = 0; i < len; i++) {
+    snprintf(line, sizeof(line), " %02X", d[i]);
+    cout << line;
+  }
+  cout << endl;
+}
+
+/* -------------------------------------------------------------------------- */
+/*                                  MAIN                                      */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cout << "usage: " << argv[0] << " <dump file>" << endl;
+    return 1;
+  }
+
+  FILE *fp = fopen(argv[1], "rb");
+  if (fp == nullptr) {
+    cout << ">> ERROR: unable to open " << argv[1] << endl;
+    return 1;
+  }
+  vector<uint8_t> buf;
+  uint8_t chunk[256];
+  size_t n = 0;
+  while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  fclose(fp);
+
+  /* the dump may be preceded by other bytes (e.g. text on the serial port) */
+  size_t pos = 0;
+  bool found = false;
+  while (pos + OPTA_BUS_TRACE_HEADER_DIM <= buf.size()) {
+    if (memcmp(&buf[pos], OPTA_BUS_TRACE_MAGIC, OPTA_BUS_TRACE_MAGIC_DIM) ==
+        0) {
+      found = true;
+      break;
+    }
+    pos++;
+  }
+  if (!found) {
+    cout << ">> ERROR: no trace found in " << argv[1] << endl;
+    return 1;
+  }
+
+  uint8_t version = buf[pos + 4];
+  if (version != OPTA_BUS_TRACE_VERSION) {
+    cout << ">> ERROR: unsupported trace version " << (int)version << endl;
+    return 1;
+  }
+  uint16_t frames = buf[pos + 5] | (buf[pos + 6] << 8);
+  uint32_t lost = getU32(&buf[pos + 7]);
+  pos += OPTA_BUS_TRACE_HEADER_DIM;
+
+  cout << "Frames: " << frames << " (overwritten before dump: " << lost << ")"
+       << endl;
+
+  uint32_t first_time = 0;
+  for (uint16_t i = 0; i < frames; i++) {
+    if (pos + OPTA_BUS_TRACE_FRAME_HEADER_DIM > buf.size()) {
+      cout << ">> ERROR: trace truncated at frame " << i << endl;
+      return 1;
+    }
+    const uint8_t *h = &buf[pos];
+    uint32_t t = getU32(h);
+    uint8_t len = h[8];
+    pos += OPTA_BUS_TRACE_FRAME_HEADER_DIM;
+    if (pos + len > buf.size()) {
+      cout << ">> ERROR: trace truncated at frame " << i << endl;
+      return 1;
+    }
+    if (i == 0) {
+      first_time = t;
+    }
+    /* time is printed relative to the first frame */
+    printFrame(t - first_time, h[4], h[5], h[6], h[7], &buf[pos], len);
+    pos += len;
+  }
+  return 0;
+}